@@ -86,6 +86,18 @@ template<class T> class CodeBlock : public CodeBlockCommon, public T {
 		}
 	}
 
+	// Moves the code pointer back to reuse [offset, offset + size), leaving the rest of the space alone.
+	// Nothing may still jump into that range.  Unlike ClearCodeSpace, this doesn't poison.
+	void ReuseCodeSpace(size_t offset, size_t size) {
+		if (!region) {
+			return;
+		}
+		if (PlatformIsWXExclusive()) {
+			ProtectMemoryPages(region + offset, size, MEM_PROT_READ | MEM_PROT_WRITE);
+		}
+		ResetCodePtr(offset);
+	}
+
 	// BeginWrite/EndWrite assume that we keep appending.
 	// If you don't specify a size and we later encounter an executable non-writable block, we're screwed.
 	// These CANNOT be nested. We rely on the memory protection starting at READ|WRITE after start and reset.
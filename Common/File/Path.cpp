@@ -13,6 +13,9 @@
 #include "android/jni/AndroidContentURI.h"
 
 #if HOST_IS_CASE_SENSITIVE
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -376,6 +379,49 @@ bool Path::ComputePathTo(const Path &other, std::string &path) const {
 
 #if HOST_IS_CASE_SENSITIVE
 
+// Case-folded name index of each directory FixFilenameCase had to scan, so that repeated
+// misses in the same directory (very common for memstick and extracted ISO access) cost a
+// stat instead of a full readdir.
+struct DirCaseIndex {
+	time_t mtime;
+	time_t scanTime;
+	std::unordered_map<std::string, std::string> names;  // lowercase -> actual
+};
+
+static std::mutex dirCaseLock;
+static std::unordered_map<std::string, DirCaseIndex> dirCaseCache;
+static FixPathCaseStats dirCaseStats;
+// Keep this bounded, some games walk huge directory trees.
+static const size_t MAX_DIR_CASE_ENTRIES = 1024;
+
+static std::string TrimTrailingSlashes(std::string path) {
+	while (path.size() > 1 && path.back() == '/')
+		path.pop_back();
+	return path;
+}
+
+static bool ScanDirCase(const std::string &path, DirCaseIndex &index) {
+	DIR *dirp = opendir(path.c_str());
+	if (!dirp)
+		return false;
+
+	dirCaseStats.scans++;
+	index.names.clear();
+	index.scanTime = time(nullptr);
+
+	struct dirent *result = NULL;
+	while ((result = readdir(dirp))) {
+		std::string lower = result->d_name;
+		for (char &c : lower)
+			c = tolower(c);
+		// Later entries win, like the old linear scan.
+		index.names[lower] = result->d_name;
+	}
+
+	closedir(dirp);
+	return true;
+}
+
 static bool FixFilenameCase(const std::string &path, std::string &filename) {
 	// Are we lucky?
 	if (File::Exists(Path(path + filename)))
@@ -387,37 +433,68 @@ static bool FixFilenameCase(const std::string &path, std::string &filename) {
 		filename[i] = tolower(filename[i]);
 	}
 
-	//TODO: lookup filename in cache for "path"
-	struct dirent *result = NULL;
-
-	DIR *dirp = opendir(path.c_str());
-	if (!dirp)
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
 		return false;
 
-	bool retValue = false;
+	std::lock_guard<std::mutex> guard(dirCaseLock);
+	const std::string key = TrimTrailingSlashes(path);
+	auto iter = dirCaseCache.find(key);
+	bool fresh = false;
+	if (iter == dirCaseCache.end() || iter->second.mtime != st.st_mtime) {
+		if (iter == dirCaseCache.end() && dirCaseCache.size() >= MAX_DIR_CASE_ENTRIES)
+			dirCaseCache.clear();
+		DirCaseIndex &index = dirCaseCache[key];
+		if (!ScanDirCase(path, index)) {
+			dirCaseCache.erase(key);
+			return false;
+		}
+		index.mtime = st.st_mtime;
+		iter = dirCaseCache.find(key);
+		fresh = true;
+	}
 
-	while ((result = readdir(dirp)))
-	{
-		if (strlen(result->d_name) != filenameSize)
-			continue;
+	auto name = iter->second.names.find(filename);
+	if (name == iter->second.names.end() && !fresh && iter->second.mtime >= iter->second.scanTime) {
+		// mtime only has second granularity, so the directory may have changed after we
+		// scanned it without the mtime moving. Rescan rather than report a false miss.
+		if (!ScanDirCase(path, iter->second))
+			return false;
+		name = iter->second.names.find(filename);
+		fresh = true;
+	}
 
-		size_t i;
-		for (i = 0; i < filenameSize; i++)
-		{
-			if (filename[i] != tolower(result->d_name[i]))
-				break;
-		}
+	if (name == iter->second.names.end())
+		return false;
 
-		if (i < filenameSize)
-			continue;
+	if (!fresh)
+		dirCaseStats.hits++;
+	filename = name->second;
+	return true;
+}
 
-		filename = result->d_name;
-		retValue = true;
+void FixPathCaseInvalidate(const Path &path) {
+	if (path.Type() == PathType::CONTENT_URI)
+		return;
+
+	// Drop the parent's index (its listing changed), and the path itself and anything below it,
+	// in case it was a directory that got removed or renamed.
+	const std::string target = TrimTrailingSlashes(path.ToString());
+	const std::string parent = TrimTrailingSlashes(path.NavigateUp().ToString());
+	std::lock_guard<std::mutex> guard(dirCaseLock);
+	dirCaseCache.erase(parent);
+	for (auto iter = dirCaseCache.begin(); iter != dirCaseCache.end(); ) {
+		const std::string &key = iter->first;
+		if (startsWith(key, target) && (key.size() == target.size() || key[target.size()] == '/'))
+			iter = dirCaseCache.erase(iter);
+		else
+			++iter;
 	}
+}
 
-	closedir(dirp);
-
-	return retValue;
+FixPathCaseStats GetFixPathCaseStats() {
+	std::lock_guard<std::mutex> guard(dirCaseLock);
+	return dirCaseStats;
 }
 
 bool FixPathCase(const Path &realBasePath, std::string &path, FixPathCaseBehavior behavior) {
@@ -2,6 +2,7 @@
 
 #include "ppsspp_config.h"
 
+#include <cstdint>
 #include <string>
 
 #if defined(__APPLE__)
@@ -142,4 +143,15 @@ enum FixPathCaseBehavior {
 
 bool FixPathCase(const Path &basePath, std::string &path, FixPathCaseBehavior behavior);
 
+// FixPathCase caches directory listings. Call this after creating, removing or renaming
+// something at path, so its parent directory gets rescanned.
+void FixPathCaseInvalidate(const Path &path);
+
+struct FixPathCaseStats {
+	uint64_t hits;   // lookups answered from a cached listing
+	uint64_t scans;  // directory listings read from disk
+};
+
+FixPathCaseStats GetFixPathCaseStats();
+
 #endif
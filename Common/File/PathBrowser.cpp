@@ -23,7 +23,7 @@
 #include "android/jni/AndroidContentURI.h"
 #endif
 
-bool LoadRemoteFileList(const Path &url, bool *cancel, std::vector<File::FileInfo> &files) {
+bool LoadRemoteFileList(const Path &url, std::atomic<bool> *cancel, std::vector<File::FileInfo> &files) {
 	_dbg_assert_(url.Type() == PathType::HTTP);
 
 	http::Client http;
@@ -211,7 +211,7 @@ std::string PathBrowser::GetFriendlyPath() const {
 	return str;
 }
 
-bool PathBrowser::GetListing(std::vector<File::FileInfo> &fileInfo, const char *filter, bool *cancel) {
+bool PathBrowser::GetListing(std::vector<File::FileInfo> &fileInfo, const char *filter, std::atomic<bool> *cancel) {
 	std::unique_lock<std::mutex> guard(pendingLock_);
 	while (!IsListingReady() && (!cancel || !*cancel)) {
 		// In case cancel changes, just sleep.
@@ -21,6 +21,7 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -92,7 +93,7 @@ bool Connection::Resolve(const char *host, int port, DNSType type) {
 	return true;
 }
 
-bool Connection::Connect(int maxTries, double timeout, bool *cancelConnect) {
+bool Connection::Connect(int maxTries, double timeout, std::atomic<bool> *cancelConnect) {
 	if (port_ <= 0) {
 		ERROR_LOG(IO, "Bad port");
 		return false;
@@ -313,7 +314,7 @@ int Client::SendRequestWithData(const char *method, const RequestParams &req, co
 		"Host: %s\r\n"
 		"User-Agent: %s\r\n"
 		"Accept: %s\r\n"
-		"Connection: close\r\n"
+		"Connection: %s\r\n"
 		"%s"
 		"\r\n";
 
@@ -322,6 +323,7 @@ int Client::SendRequestWithData(const char *method, const RequestParams &req, co
 		host_.c_str(),
 		userAgent_.c_str(),
 		req.acceptMime,
+		keepAlive_ ? "keep-alive" : "close",
 		otherHeaders ? otherHeaders : "");
 	buffer.Append(data);
 	bool flushed = buffer.FlushSocket(sock(), dataTimeout_, progress->cancelled);
@@ -384,9 +386,24 @@ int Client::ReadResponseHeaders(net::Buffer *readbuf, std::vector<std::string> &
 	return code;
 }
 
+bool Client::CanReuseConnection(const std::vector<std::string> &responseHeaders) const {
+	if (!keepAlive_)
+		return false;
+	std::string connection;
+	if (GetHeaderValue(responseHeaders, "Connection", &connection)) {
+		std::transform(connection.begin(), connection.end(), connection.begin(), tolower);
+		if (connection.find("close") != std::string::npos)
+			return false;
+	}
+	// Without a length, the entity ran until the server closed.
+	std::string length;
+	return GetHeaderValue(responseHeaders, "Content-Length", &length);
+}
+
 int Client::ReadResponseEntity(net::Buffer *readbuf, const std::vector<std::string> &responseHeaders, Buffer *output, RequestProgress *progress) {
 	bool gzip = false;
 	bool chunked = false;
+	bool hasContentLength = false;
 	int contentLength = 0;
 	for (std::string line : responseHeaders) {
 		if (startsWithNoCase(line, "Content-Length:")) {
@@ -396,6 +413,7 @@ int Client::ReadResponseEntity(net::Buffer *readbuf, const std::vector<std::stri
 			}
 			if (size_pos != line.npos) {
 				contentLength = atoi(&line[size_pos]);
+				hasContentLength = true;
 				chunked = false;
 			}
 		} else if (startsWithNoCase(line, "Content-Encoding:")) {
@@ -422,7 +440,11 @@ int Client::ReadResponseEntity(net::Buffer *readbuf, const std::vector<std::stri
 		progress->progress = 0.1f;
 	}
 
-	if (!contentLength) {
+	if (keepAlive_ && hasContentLength && !chunked) {
+		// The server won't close the connection, so stop at the end of the entity.
+		if (!readbuf->ReadExactWithProgress(sock(), contentLength, &progress->progress, &progress->kBps, progress->cancelled, dataTimeout_))
+			return -1;
+	} else if (!contentLength) {
 		// No way to know how far along we are. Let's just not update the progress counter.
 		if (!readbuf->ReadAllWithProgress(sock(), contentLength, nullptr, &progress->kBps, progress->cancelled))
 			return -1;
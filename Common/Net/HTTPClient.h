@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <thread>
@@ -19,7 +20,7 @@ class Connection {
 	// Inits the sockaddr_in.
 	bool Resolve(const char *host, int port, DNSType type = DNSType::ANY);
 
-	bool Connect(int maxTries = 2, double timeout = 20.0f, bool *cancelConnect = nullptr);
+	bool Connect(int maxTries = 2, double timeout = 20.0f, std::atomic<bool> *cancelConnect = nullptr);
 	void Disconnect();
 
 	// Only to be used for bring-up and debugging.
@@ -46,11 +47,11 @@ bool GetHeaderValue(const std::vector<std::string> &responseHeaders, const std::
 
 struct RequestProgress {
 	RequestProgress() {}
-	explicit RequestProgress(bool *c) : cancelled(c) {}
+	explicit RequestProgress(std::atomic<bool> *c) : cancelled(c) {}
 
 	float progress = 0.0f;
 	float kBps = 0.0f;
-	bool *cancelled = nullptr;
+	std::atomic<bool> *cancelled = nullptr;
 };
 
 struct RequestParams {
@@ -91,10 +92,20 @@ class Client : public net::Connection {
 		userAgent_ = value;
 	}
 
+	// Asks the server to keep the connection open after each response. Responses then need a
+	// Content-Length, since the end of the entity can no longer be detected by the socket closing.
+	void SetKeepAlive(bool keepAlive) {
+		keepAlive_ = keepAlive;
+	}
+
+	// Whether the connection can be reused for another request after this response.
+	bool CanReuseConnection(const std::vector<std::string> &responseHeaders) const;
+
 protected:
 	std::string userAgent_;
 	const char *httpVersion_;
 	double dataTimeout_ = 900.0;
+	bool keepAlive_ = false;
 };
 
 // Not particularly efficient, but hey - it's a background download, that's pretty cool :P
@@ -168,7 +179,7 @@ class Download {
 	int resultCode_ = 0;
 	bool completed_ = false;
 	bool failed_ = false;
-	bool cancelled_ = false;
+	std::atomic<bool> cancelled_{};
 	bool hidden_ = false;
 	bool joined_ = false;
 	std::function<void(Download &)> callback_;
@@ -19,6 +19,8 @@
 #include <netinet/in.h>       /*  struct sockaddr_in        */
 #include <arpa/inet.h>        /*  inet (3) funtions         */
 #include <unistd.h>           /*  misc. UNIX functions      */
+#include <poll.h>
+#include <fcntl.h>
 
 #define closesocket close
 
@@ -28,7 +30,14 @@
 #define in6addr_any IN6ADDR_ANY_INIT
 #endif
 
+#if PPSSPP_PLATFORM(LINUX)
+#include <sys/sendfile.h>
+#endif
+
 #include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
 #include <functional>
 
 #include <cstdio>
@@ -55,11 +64,75 @@ NewThreadExecutor::~NewThreadExecutor() {
 	threads_.clear();
 }
 
+// Set on a pool thread while its current func is marked long running.
+static thread_local bool t_longRunning = false;
+
+void WorkerPoolExecutor::Run(std::function<void()> func) {
+	std::lock_guard<std::mutex> guard(mutex_);
+	queue_.push_back(func);
+	if (idle_ == 0 && (int)threads_.size() - longRunning_ < maxThreads_) {
+		threads_.push_back(std::thread(&WorkerPoolExecutor::WorkerLoop, this));
+	} else {
+		cond_.notify_one();
+	}
+}
+
+void WorkerPoolExecutor::MarkLongRunning() {
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (t_longRunning)
+		return;
+	t_longRunning = true;
+	longRunning_++;
+	// This thread no longer counts, so work that queued up behind it can get a thread now.
+	if (!queue_.empty() && idle_ == 0 && (int)threads_.size() - longRunning_ < maxThreads_)
+		threads_.push_back(std::thread(&WorkerPoolExecutor::WorkerLoop, this));
+}
+
+void WorkerPoolExecutor::WorkerLoop() {
+	std::unique_lock<std::mutex> guard(mutex_);
+	while (true) {
+		while (queue_.empty() && !stop_) {
+			idle_++;
+			cond_.wait(guard);
+			idle_--;
+		}
+		if (queue_.empty())
+			return;
+
+		std::function<void()> func = std::move(queue_.front());
+		queue_.pop_front();
+		guard.unlock();
+		func();
+		guard.lock();
+		// The thread rejoins the pool, which may leave it above maxThreads until shutdown.
+		if (t_longRunning) {
+			t_longRunning = false;
+			longRunning_--;
+		}
+	}
+}
+
+WorkerPoolExecutor::~WorkerPoolExecutor() {
+	{
+		std::lock_guard<std::mutex> guard(mutex_);
+		stop_ = true;
+		cond_.notify_all();
+	}
+	for (auto &thread : threads_)
+		thread.join();
+	threads_.clear();
+}
+
 namespace http {
 
 // Note: charset here helps prevent XSS.
 const char *const DEFAULT_MIME_TYPE = "text/html; charset=utf-8";
 
+// How long a worker waits for the next request on a keep-alive connection before handing
+// it back to the poll loop, and how long the poll loop keeps it after that.
+static const double KEEPALIVE_LINGER = 0.05;
+static const double KEEPALIVE_TIMEOUT = 15.0;
+
 Request::Request(int fd)
 	: fd_(fd) {
 	in_ = new net::InputSink(fd);
@@ -110,9 +183,15 @@ void Request::WriteHttpResponseHeader(const char *ver, int status, int64_t size,
 	net::OutputSink *buffer = Out();
 	buffer->Printf("HTTP/%s %03d %s\r\n", ver, status, statusStr);
 	buffer->Push("Server: PPSSPPServer v0.1\r\n");
+	keepAliveResponse_ = false;
 	if (!mimeType || strcmp(mimeType, "websocket") != 0) {
+		std::string connection;
+		if (size >= 0 && GetHeader("connection", &connection)) {
+			std::transform(connection.begin(), connection.end(), connection.begin(), tolower);
+			keepAliveResponse_ = connection.find("keep-alive") != std::string::npos;
+		}
 		buffer->Printf("Content-Type: %s\r\n", mimeType ? mimeType : DEFAULT_MIME_TYPE);
-		buffer->Push("Connection: close\r\n");
+		buffer->Push(keepAliveResponse_ ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
 	}
 	if (size >= 0) {
 		buffer->Printf("Content-Length: %llu\r\n", size);
@@ -141,14 +220,144 @@ void Request::Close() {
 	}
 }
 
-Server::Server(NewThreadExecutor *executor)
+int Request::Detach() {
+	int fd = fd_;
+	fd_ = 0;
+	return fd;
+}
+
+bool Request::KeepAlive() const {
+	// Anything left unread (a body, or a pipelined request) would be lost with our sinks.
+	return keepAliveResponse_ && header_.content_length <= 0 && in_->Empty();
+}
+
+bool Request::WriteFileRange(FILE *fp, int64_t offset, int64_t len) const {
+	// A partially sent range leaves the connection in an unknown state.
+	auto FailKeepAlive = [&]() {
+		keepAliveResponse_ = false;
+		return false;
+	};
+
+	if (!out_->Flush())
+		return FailKeepAlive();
+
+#if PPSSPP_PLATFORM(LINUX)
+	// Large offsets need a 64-bit off_t.
+	if (sizeof(off_t) >= 8 || offset + len <= 0x7FFFFFFF) {
+		int fileFd = fileno(fp);
+		off_t pos = (off_t)offset;
+		int64_t remaining = len;
+		while (remaining > 0) {
+			ssize_t sent = sendfile(fd_, fileFd, &pos, (size_t)std::min(remaining, (int64_t)0x40000000));
+			if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				if (!fd_util::WaitUntilReady(fd_, 20.0, true))
+					return FailKeepAlive();
+				continue;
+			}
+			if (sent < 0 && remaining == len && (errno == EINVAL || errno == ENOSYS)) {
+				// Not supported for this kind of file, copy instead.
+				break;
+			}
+			if (sent <= 0)
+				return FailKeepAlive();
+			remaining -= sent;
+		}
+		if (remaining == 0)
+			return true;
+	}
+#endif
+
+	if (fseek(fp, offset, SEEK_SET) != 0)
+		return FailKeepAlive();
+	const size_t CHUNK_SIZE = 64 * 1024;
+	std::vector<char> buf(CHUNK_SIZE);
+	for (int64_t pos = 0; pos < len; pos += CHUNK_SIZE) {
+		size_t chunklen = (size_t)std::min(len - pos, (int64_t)CHUNK_SIZE);
+		if (fread(&buf[0], chunklen, 1, fp) != 1)
+			return FailKeepAlive();
+		if (!out_->Push(&buf[0], chunklen))
+			return FailKeepAlive();
+	}
+	return out_->Flush();
+}
+
+Server::Server(Executor *executor)
 	: port_(0), executor_(executor) {
 	RegisterHandler("/", std::bind(&Server::HandleListing, this, std::placeholders::_1));
 	SetFallbackHandler(std::bind(&Server::Handle404, this, std::placeholders::_1));
+	if (!CreateWakeup()) {
+		ERROR_LOG(IO, "Unable to create HTTP server wakeup, keep-alive connections will wait for the slice to end");
+	}
 }
 
 Server::~Server() {
 	delete executor_;
+	// Workers may have handed back connections while shutting down.
+	CloseIdleConnections();
+	if (wakeRead_ >= 0)
+		closesocket(wakeRead_);
+#ifndef _WIN32
+	if (wakeWrite_ >= 0)
+		close(wakeWrite_);
+#endif
+}
+
+bool Server::CreateWakeup() {
+#ifdef _WIN32
+	// WSAPoll only takes sockets, so talk to ourselves over loopback.
+	int sock = (int)socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		return false;
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t len = sizeof(addr);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || getsockname(sock, (struct sockaddr *)&addr, &len) < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		closesocket(sock);
+		return false;
+	}
+	fd_util::SetNonBlocking(sock, true);
+	wakeRead_ = sock;
+	wakeWrite_ = sock;
+#else
+	int fds[2];
+	if (pipe(fds) < 0)
+		return false;
+	fd_util::SetNonBlocking(fds[0], true);
+	fd_util::SetNonBlocking(fds[1], true);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	wakeRead_ = fds[0];
+	wakeWrite_ = fds[1];
+#endif
+	return true;
+}
+
+void Server::Wake() {
+	if (wakeWrite_ < 0)
+		return;
+	// If the pipe is full, RunSlice has plenty of wakeups pending already.
+	const char c = 0;
+#ifdef _WIN32
+	send(wakeWrite_, &c, 1, 0);
+#else
+	if (write(wakeWrite_, &c, 1) < 0) {
+		// Nothing to do, see above.
+	}
+#endif
+}
+
+void Server::DrainWakeup() {
+	char buf[64];
+#ifdef _WIN32
+	while (recv(wakeRead_, buf, sizeof(buf), 0) > 0)
+		continue;
+#else
+	while (read(wakeRead_, buf, sizeof(buf)) > 0)
+		continue;
+#endif
 }
 
 void Server::RegisterHandler(const char *url_path, UrlHandlerFunc handler) {
@@ -269,15 +478,94 @@ bool Server::Listen6(int port, bool ipv6_only) {
 }
 
 bool Server::RunSlice(double timeout) {
-	if (listener_ < 0 || port_ == 0) {
+	std::lock_guard<std::mutex> sliceGuard(sliceLock_);
+	if (listener_ < 0 || port_ == 0 || stopping_) {
 		return false;
 	}
 
 	if (timeout <= 0.0) {
 		timeout = 86400.0;
 	}
-	if (!fd_util::WaitUntilReady(listener_, timeout, false)) {
-		return false;
+
+	// Wait on the listener, the wakeup, and all idle keep-alive connections at once.
+	// Nothing wakes us up periodically, an idle server just sleeps here.
+	const size_t FIRST_IDLE = wakeRead_ >= 0 ? 2 : 1;
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;
+#else
+	std::vector<pollfd> fds;
+#endif
+	double endTime = time_now_d() + timeout;
+	bool listenerReady = false;
+	while (!listenerReady) {
+		double now = time_now_d();
+		{
+			std::lock_guard<std::mutex> guard(returnedLock_);
+			idle_.insert(idle_.end(), returned_.begin(), returned_.end());
+			returned_.clear();
+		}
+		for (size_t i = 0; i < idle_.size(); ) {
+			if (now > idle_[i].lastActive + KEEPALIVE_TIMEOUT) {
+				closesocket(idle_[i].fd);
+				idle_[i] = idle_.back();
+				idle_.pop_back();
+			} else {
+				++i;
+			}
+		}
+
+		fds.resize(idle_.size() + FIRST_IDLE);
+		fds[0].fd = listener_;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		if (FIRST_IDLE > 1) {
+			fds[1].fd = wakeRead_;
+			fds[1].events = POLLIN;
+			fds[1].revents = 0;
+		}
+		// Without a wakeup, returned connections are only noticed when something else happens.
+		double nextExpiry = FIRST_IDLE > 1 ? endTime : now + 0.1;
+		for (size_t i = 0; i < idle_.size(); ++i) {
+			fds[i + FIRST_IDLE].fd = idle_[i].fd;
+			fds[i + FIRST_IDLE].events = POLLIN;
+			fds[i + FIRST_IDLE].revents = 0;
+			nextExpiry = std::min(nextExpiry, idle_[i].lastActive + KEEPALIVE_TIMEOUT);
+		}
+
+		int waitMs = std::max(0, (int)ceil((std::min(endTime, nextExpiry) - now) * 1000.0));
+#ifdef _WIN32
+		int result = WSAPoll(&fds[0], (ULONG)fds.size(), waitMs);
+#else
+		int result = poll(&fds[0], (nfds_t)fds.size(), waitMs);
+#endif
+		if (result > 0) {
+			if (FIRST_IDLE > 1 && fds[1].revents != 0) {
+				// Returned connections get picked up at the top of the loop.
+				DrainWakeup();
+				if (stopping_)
+					return false;
+			}
+
+			// Connections with a new request (or a hangup, which the request parse will notice) go to workers.
+			bool handled = false;
+			for (size_t i = fds.size() - 1; i >= FIRST_IDLE; --i) {
+				if (fds[i].revents == 0)
+					continue;
+				int fd = idle_[i - FIRST_IDLE].fd;
+				idle_[i - FIRST_IDLE] = idle_.back();
+				idle_.pop_back();
+				if (fds[i].revents & POLLNVAL) {
+					continue;
+				}
+				executor_->Run(std::bind(&Server::HandleConnection, this, fd, true));
+				handled = true;
+			}
+			listenerReady = (fds[0].revents & POLLIN) != 0;
+			if (handled && !listenerReady)
+				return true;
+		} else if (result < 0 || time_now_d() >= endTime) {
+			return false;
+		}
 	}
 
 	union {
@@ -290,7 +578,7 @@ bool Server::RunSlice(double timeout) {
 	socklen_t client_addr_size = sizeof(client_addr);
 	int conn_fd = accept(listener_, &client_addr.sa, &client_addr_size);
 	if (conn_fd >= 0) {
-		executor_->Run(std::bind(&Server::HandleConnection, this, conn_fd));
+		executor_->Run(std::bind(&Server::HandleConnection, this, conn_fd, false));
 		return true;
 	}
 	else {
@@ -304,31 +592,74 @@ bool Server::Run(int port) {
 		return false;
 	}
 
-	while (true) {
+	while (!stopping_) {
 		RunSlice(0.0);
 	}
-
-	// We'll never get here. Ever.
 	return true;
 }
 
 void Server::Stop() {
-	closesocket(listener_);
+	stopping_ = true;
+	Wake();
+
+	std::lock_guard<std::mutex> sliceGuard(sliceLock_);
+	if (listener_ >= 0)
+		closesocket(listener_);
+	listener_ = -1;
+	CloseIdleConnections();
 }
 
-void Server::HandleConnection(int conn_fd) {
-	Request request(conn_fd);
-	if (!request.IsOK()) {
-		WARN_LOG(IO, "Bad request, ignoring.");
-		return;
-	}
-	HandleRequest(request);
+void Server::CloseIdleConnections() {
+	std::lock_guard<std::mutex> guard(returnedLock_);
+	for (const IdleConnection &conn : idle_)
+		closesocket(conn.fd);
+	idle_.clear();
+	for (const IdleConnection &conn : returned_)
+		closesocket(conn.fd);
+	returned_.clear();
+}
 
-	// TODO: Way to mark the content body as read, read it here if never read.
-	// This allows the handler to stream if need be.
+void Server::ReturnConnection(int conn_fd) {
+	{
+		std::lock_guard<std::mutex> guard(returnedLock_);
+		returned_.push_back({ conn_fd, time_now_d() });
+	}
+	Wake();
+}
 
-	// TODO: Could handle keep alive here.
-	request.Write();
+void Server::HandleConnection(int conn_fd, bool reused) {
+	while (true) {
+		Request request(conn_fd);
+		if (!request.IsOK()) {
+			// A keep-alive client closing the connection also ends up here.
+			if (!reused)
+				WARN_LOG(IO, "Bad request, ignoring.");
+			return;
+		}
+		// Upgraded connections (websockets) stay with their handler until closed.
+		std::string upgrade;
+		if (request.GetHeader("upgrade", &upgrade))
+			executor_->MarkLongRunning();
+		HandleRequest(request);
+
+		// TODO: Way to mark the content body as read, read it here if never read.
+		// This allows the handler to stream if need be.
+
+		if (!request.KeepAlive()) {
+			request.Write();
+			return;
+		}
+
+		request.WritePartial();
+		conn_fd = request.Detach();
+		// Clients reading sequentially usually send the next request right away, so keep the
+		// connection on this worker briefly rather than bouncing it through the poll loop.
+		if (!fd_util::WaitUntilReady(conn_fd, KEEPALIVE_LINGER, false)) {
+			ReturnConnection(conn_fd);
+			return;
+		}
+		reused = true;
+	}
 }
 
 void Server::HandleRequest(const Request &request) {
@@ -1,21 +1,59 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include "Common/Net/HTTPHeaders.h"
 #include "Common/Net/Resolve.h"
 
-class NewThreadExecutor {
+class Executor {
+public:
+	virtual ~Executor() {}
+	virtual void Run(std::function<void()> func) = 0;
+	// Called from inside a running func that will keep going for a long time (like a websocket),
+	// so executors with a thread limit can stop counting it.
+	virtual void MarkLongRunning() {}
+};
+
+class NewThreadExecutor : public Executor {
 public:
 	~NewThreadExecutor();
-	void Run(std::function<void()> func);
+	void Run(std::function<void()> func) override;
 
 private:
 	std::vector<std::thread> threads_;
 };
 
+// Runs work on up to maxThreads threads, started on demand, and queues the rest.
+// Work marked long running doesn't count against maxThreads, so the pool grows past it instead.
+class WorkerPoolExecutor : public Executor {
+public:
+	WorkerPoolExecutor(int maxThreads) : maxThreads_(maxThreads) {}
+	~WorkerPoolExecutor();
+	void Run(std::function<void()> func) override;
+	void MarkLongRunning() override;
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> threads_;
+	std::deque<std::function<void()>> queue_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	int maxThreads_;
+	int idle_ = 0;
+	// Threads currently running long running work.
+	int longRunning_ = 0;
+	bool stop_ = false;
+};
+
 namespace net {
 
 class InputSink;
@@ -55,37 +93,48 @@ class Request {
 	void WritePartial() const;
 	void Write();
 	void Close();
+	// Gives up ownership of the socket, for keep-alive.
+	int Detach();
+
+	// Whether the connection can take another request once this one has been written.
+	bool KeepAlive() const;
 
 	bool IsOK() const { return fd_ > 0; }
 
 	// If size is negative, no Content-Length: line is written.
+	// The connection is kept alive only if the client asked for it and size is known.
 	void WriteHttpResponseHeader(const char *ver, int status, int64_t size = -1, const char *mimeType = nullptr, const char *otherHeaders = nullptr) const;
 
+	// Sends len bytes of fp from offset, after any pending output. Uses sendfile where
+	// available, so the data doesn't get copied through our buffers.
+	bool WriteFileRange(FILE *fp, int64_t offset, int64_t len) const;
+
 private:
 	net::InputSink *in_;
 	net::OutputSink *out_;
 	RequestHeader header_;
 	int fd_;
+	mutable bool keepAliveResponse_ = false;
 };
 
 // Register handlers on this class to serve stuff.
 class Server {
 public:
 	// Takes ownership.
-	Server(NewThreadExecutor *executor);
+	Server(Executor *executor);
 	virtual ~Server();
 
 	typedef std::function<void(const Request &)> UrlHandlerFunc;
 	typedef std::map<std::string, UrlHandlerFunc> UrlHandlerMap;
 
-	// Runs forever, serving request. If you want to do something else than serve pages,
-	// better put this on a thread. Returns false if failed to start serving, never
-	// returns if successful.
+	// Runs until Stop(), serving requests. If you want to do something else than serve pages,
+	// better put this on a thread. Returns false if failed to start serving.
 	bool Run(int port);
 	// May run for (significantly) longer than timeout, but won't wait longer than that
 	// for a new connection to handle.
 	bool RunSlice(double timeout);
 	bool Listen(int port, net::DNSType type = net::DNSType::ANY);
+	// Can be called from another thread, makes a running RunSlice return right away.
 	void Stop();
 
 	void RegisterHandler(const char *url_path, UrlHandlerFunc handler);
@@ -104,7 +153,15 @@ class Server {
 	bool Listen6(int port, bool ipv6_only);
 	bool Listen4(int port);
 
-	void HandleConnection(int conn_fd);
+	void HandleConnection(int conn_fd, bool reused = false);
+	// Hands a keep-alive connection back to RunSlice to wait for its next request.
+	void ReturnConnection(int conn_fd);
+	void CloseIdleConnections();
+
+	// Wakes RunSlice from poll, when a connection is handed back or on Stop().
+	bool CreateWakeup();
+	void Wake();
+	void DrainWakeup();
 
 	// Things like default 404, etc.
 	void HandleRequestDefault(const Request &request);
@@ -113,13 +170,29 @@ class Server {
 	void HandleListing(const Request &request);
 	void Handle404(const Request &request);
 
-	int listener_;
+	int listener_ = -1;
 	int port_ = 0;
+	// Both ends are the same self connected UDP socket on Windows, a pipe elsewhere.
+	int wakeRead_ = -1;
+	int wakeWrite_ = -1;
+	std::atomic<bool> stopping_{};
+	// Held by RunSlice, so Stop() can close the sockets once it has returned.
+	std::mutex sliceLock_;
 
 	UrlHandlerMap handlers_;
 	UrlHandlerFunc fallback_;
 
-	NewThreadExecutor *executor_;
+	struct IdleConnection {
+		int fd;
+		double lastActive;
+	};
+	// Keep-alive connections waiting for a request. RunSlice uses idle_, and CloseIdleConnections
+	// empties it once RunSlice can't be running.  Workers hand connections back through returned_.
+	std::vector<IdleConnection> idle_;
+	std::mutex returnedLock_;
+	std::vector<IdleConnection> returned_;
+
+	Executor *executor_;
 };
 
 }  // namespace http
@@ -22,7 +22,7 @@
 
 namespace net {
 
-bool Buffer::FlushSocket(uintptr_t sock, double timeout, bool *cancelled) {
+bool Buffer::FlushSocket(uintptr_t sock, double timeout, std::atomic<bool> *cancelled) {
 	static constexpr float CANCEL_INTERVAL = 0.25f;
 	for (size_t pos = 0, end = data_.size(); pos < end; ) {
 		bool ready = false;
@@ -47,7 +47,7 @@ bool Buffer::FlushSocket(uintptr_t sock, double timeout, bool *cancelled) {
 	return true;
 }
 
-bool Buffer::ReadAllWithProgress(int fd, int knownSize, float *progress, float *kBps, bool *cancelled) {
+bool Buffer::ReadAllWithProgress(int fd, int knownSize, float *progress, float *kBps, std::atomic<bool> *cancelled) {
 	static constexpr float CANCEL_INTERVAL = 0.25f;
 	std::vector<char> buf;
 	// We're non-blocking and reading from an OS buffer, so try to read as much as we can at a time.
@@ -95,6 +95,53 @@ bool Buffer::ReadAllWithProgress(int fd, int knownSize, float *progress, float *
 	return true;
 }
 
+bool Buffer::ReadExactWithProgress(int fd, int totalSize, float *progress, float *kBps, std::atomic<bool> *cancelled, double timeout) {
+	static constexpr float CANCEL_INTERVAL = 0.25f;
+	std::vector<char> buf;
+	buf.resize(std::max(1024, std::min(totalSize, 65536)));
+
+	double st = time_now_d();
+	double endTimeout = st + timeout;
+	int total = 0;
+	while ((int)size() < totalSize) {
+		bool ready = false;
+		while (!ready) {
+			if (cancelled && *cancelled)
+				return false;
+			ready = fd_util::WaitUntilReady(fd, CANCEL_INTERVAL, false);
+			if (!ready && time_now_d() > endTimeout) {
+				ERROR_LOG(IO, "ReadExactWithProgress timed out");
+				return false;
+			}
+		}
+		int wanted = std::min((int)buf.size(), totalSize - (int)size());
+		int retval = recv(fd, &buf[0], wanted, MSG_NOSIGNAL);
+		if (retval == 0) {
+			// Closed before we got everything.
+			return false;
+		} else if (retval < 0) {
+#if PPSSPP_PLATFORM(WINDOWS)
+			if (WSAGetLastError() != WSAEWOULDBLOCK) {
+#else
+			if (errno != EWOULDBLOCK) {
+#endif
+				ERROR_LOG(IO, "Error reading from buffer: %i", retval);
+				return false;
+			}
+			continue;
+		}
+		char *p = Append((size_t)retval);
+		memcpy(p, &buf[0], retval);
+		total += retval;
+		endTimeout = time_now_d() + timeout;
+		if (progress)
+			*progress = (float)size() / (float)totalSize;
+		if (kBps)
+			*kBps = (float)(total / (time_now_d() - st)) / 1024.0f;
+	}
+	return true;
+}
+
 int Buffer::Read(int fd, size_t sz) {
 	char buf[1024];
 	int retval;
@@ -1,14 +1,19 @@
 ﻿#pragma once
 
+#include <atomic>
+
 #include "Common/Buffer.h"
 
 namespace net {
 
 class Buffer : public ::Buffer {
 public:
-	bool FlushSocket(uintptr_t sock, double timeout, bool *cancelled = nullptr);
+	bool FlushSocket(uintptr_t sock, double timeout, std::atomic<bool> *cancelled = nullptr);
 
-	bool ReadAllWithProgress(int fd, int knownSize, float *progress, float *kBps, bool *cancelled);
+	bool ReadAllWithProgress(int fd, int knownSize, float *progress, float *kBps, std::atomic<bool> *cancelled);
+	// Like ReadAllWithProgress, but stops once the buffer holds totalSize bytes instead of
+	// waiting for the other end to close. For keep-alive connections.
+	bool ReadExactWithProgress(int fd, int totalSize, float *progress, float *kBps, std::atomic<bool> *cancelled, double timeout);
 
 	// < 0: error
 	// >= 0: number of bytes read
@@ -38,7 +38,7 @@ WaitableCounter *ParallelRangeLoopWaitable(ThreadManager *threadMan, const std::
 	} else if (range <= minSize) {
 		// Single background task.
 		WaitableCounter *waitableCounter = new WaitableCounter(1);
-		threadMan->EnqueueTaskOnThread(0, new LoopRangeTask(waitableCounter, loop, lower, upper));
+		threadMan->EnqueueTask(new LoopRangeTask(waitableCounter, loop, lower, upper));
 		return waitableCounter;
 	} else {
 		// Split the range between threads. Allow for some fractional bits.
@@ -57,7 +57,8 @@ WaitableCounter *ParallelRangeLoopWaitable(ThreadManager *threadMan, const std::
 		WaitableCounter *waitableCounter = new WaitableCounter(numTasks);
 		int64_t counter = (int64_t)lower << fractionalBits;
 
-		// Split up tasks as equitable as possible.
+		// Split up tasks as equitable as possible. Any compute worker can pick them up, so
+		// a busy thread doesn't hold up the whole loop.
 		for (int i = 0; i < numTasks; i++) {
 			int start = (int)(counter >> fractionalBits);
 			int end = (int)((counter + delta) >> fractionalBits);
@@ -65,7 +66,7 @@ WaitableCounter *ParallelRangeLoopWaitable(ThreadManager *threadMan, const std::
 				// Let's do the stragglers on the current thread.
 				break;
 			}
-			threadMan->EnqueueTaskOnThread(i, new LoopRangeTask(waitableCounter, loop, start, end));
+			threadMan->EnqueueTask(new LoopRangeTask(waitableCounter, loop, start, end));
 			counter += delta;
 			if ((counter >> fractionalBits) >= upper) {
 				break;
@@ -19,43 +19,228 @@
 //   They should always be scheduled to the first N threads.
 // * For some tasks, splitting the input values up linearly between the threads
 //   is not fair. However, we ignore that for now.
+// * Each worker owns a work-stealing deque for tasks it spawns itself. Tasks from other
+//   threads go through a lock-free global queue per task type, and idle workers of the same
+//   type steal from each other's deques. Tasks for a specific thread go to its own inbox.
+// * Idle compute workers spin for a little while before sleeping, since parallel loops tend
+//   to come in bursts. Sleeping workers are only woken when there's a task for them.
 
 const int MAX_CORES_TO_USE = 16;
 const int MIN_IO_BLOCKING_THREADS = 4;
+const int TASK_TYPE_COUNT = 2;
+
+// Must be powers of two.
+const int WORK_DEQUE_SIZE = 1024;
+const int GLOBAL_QUEUE_SIZE = 4096;
+const int THREAD_INBOX_SIZE = 256;
+
+// How many times an idle compute worker looks for work before going to sleep.
+const int IDLE_SPIN_COUNT = 256;
+
+// Chase-Lev work-stealing deque, per "Correct and Efficient Work-Stealing for Weak Memory Models".
+// Only the owning worker pushes and pops at the bottom, other workers steal from the top.
+// Fixed size - when full, the owner puts tasks on the global queue instead.
+class WorkStealingDeque {
+public:
+	bool Push(Task *task) {
+		int64_t b = bottom_.load(std::memory_order_relaxed);
+		int64_t t = top_.load(std::memory_order_acquire);
+		if (b - t >= WORK_DEQUE_SIZE)
+			return false;
+		buffer_[b & (WORK_DEQUE_SIZE - 1)].store(task, std::memory_order_relaxed);
+		// Publishes the task to thieves (the paper uses a release fence, same thing.)
+		bottom_.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	Task *Pop() {
+		int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+		bottom_.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top_.load(std::memory_order_relaxed);
+
+		Task *task = nullptr;
+		if (t <= b) {
+			task = buffer_[b & (WORK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+			if (t == b) {
+				// Last one, race any thieves for it.
+				if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					task = nullptr;
+				bottom_.store(b + 1, std::memory_order_relaxed);
+			}
+		} else {
+			bottom_.store(b + 1, std::memory_order_relaxed);
+		}
+		return task;
+	}
+
+	Task *Steal() {
+		int64_t t = top_.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = bottom_.load(std::memory_order_acquire);
+		if (t < b) {
+			Task *task = buffer_[t & (WORK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+			if (top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return task;
+		}
+		return nullptr;
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> top_{ 0 };
+	alignas(64) std::atomic<int64_t> bottom_{ 0 };
+	alignas(64) std::atomic<Task *> buffer_[WORK_DEQUE_SIZE]{};
+};
+
+// Bounded multi-producer, multi-consumer ring (Dmitry Vyukov's design), with a locked
+// overflow for bursts that don't fit. Order is kept: once anything has overflowed, new
+// tasks go to the overflow too until it's drained.
+template <int N>
+class InjectionQueue {
+public:
+	InjectionQueue() {
+		for (int i = 0; i < N; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	void Push(Task *task) {
+		if (overflowSize_.load(std::memory_order_acquire) == 0 && TryPush(task))
+			return;
+		std::lock_guard<std::mutex> guard(overflowLock_);
+		overflow_.push_back(task);
+		overflowSize_++;
+	}
+
+	Task *Pop() {
+		Task *task = TryPop();
+		if (task || overflowSize_.load(std::memory_order_acquire) == 0)
+			return task;
+
+		std::lock_guard<std::mutex> guard(overflowLock_);
+		// Something may have landed in the ring before the overflow started.
+		task = TryPop();
+		if (!task && !overflow_.empty()) {
+			task = overflow_.front();
+			overflow_.pop_front();
+			overflowSize_--;
+		}
+		return task;
+	}
+
+private:
+	bool TryPush(Task *task) {
+		size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells_[pos & (N - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0) {
+				if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->task = task;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	Task *TryPop() {
+		size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells_[pos & (N - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0) {
+				if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return nullptr;
+			} else {
+				pos = dequeuePos_.load(std::memory_order_relaxed);
+			}
+		}
+		Task *task = cell->task;
+		cell->sequence.store(pos + N, std::memory_order_release);
+		return task;
+	}
+
+	struct Cell {
+		std::atomic<size_t> sequence;
+		Task *task;
+	};
+
+	alignas(64) std::atomic<size_t> enqueuePos_{ 0 };
+	alignas(64) std::atomic<size_t> dequeuePos_{ 0 };
+	alignas(64) Cell cells_[N];
+
+	std::atomic<int> overflowSize_{ 0 };
+	std::mutex overflowLock_;
+	std::deque<Task *> overflow_;
+};
 
 struct GlobalThreadContext {
-	std::mutex mutex; // associated with each respective condition variable
-	std::deque<Task *> compute_queue;
-	std::atomic<int> compute_queue_size;
-	std::deque<Task *> io_queue;
-	std::atomic<int> io_queue_size;
+	InjectionQueue<GLOBAL_QUEUE_SIZE> queues[TASK_TYPE_COUNT];
+	// Number of sleeping workers per task type, so enqueues can skip waking when nobody sleeps.
+	std::atomic<int> sleepers[TASK_TYPE_COUNT]{};
+	// Range of threads serving each task type.
+	int firstThread[TASK_TYPE_COUNT]{};
+	int numThreads[TASK_TYPE_COUNT]{};
 	std::vector<ThreadContext *> threads_;
-
-	std::atomic<int> roundRobin;
 };
 
 struct ThreadContext {
 	std::thread thread; // the worker thread
-	std::condition_variable cond; // used to signal new work
-	std::mutex mutex; // protects the local queue.
-	std::atomic<int> queue_size;
+	std::condition_variable cond; // used to wake the thread when sleeping
+	std::mutex mutex; // associated with cond.
+	GlobalThreadContext *global;
 	int index;
 	TaskType type;
 	std::atomic<bool> cancelled;
-	std::atomic<Task *> private_single;
-	std::deque<Task *> private_queue;
+	std::atomic<bool> sleeping;
+	WorkStealingDeque deque;
+	InjectionQueue<THREAD_INBOX_SIZE> inbox;
 };
 
+// Which worker (if any) the current thread is.
+static thread_local ThreadContext *currentThread;
+
 ThreadManager::ThreadManager() : global_(new GlobalThreadContext()) {
-	global_->compute_queue_size = 0;
-	global_->io_queue_size = 0;
-	global_->roundRobin = 0;
 }
 
 ThreadManager::~ThreadManager() {
 	delete global_;
 }
 
+static bool WakeThread(GlobalThreadContext *global, ThreadContext *thread) {
+	if (!thread->sleeping.load() || !thread->sleeping.exchange(false))
+		return false;
+	global->sleepers[(int)thread->type]--;
+	// Lock the thread to ensure it gets the message.
+	std::unique_lock<std::mutex> lock(thread->mutex);
+	thread->cond.notify_one();
+	return true;
+}
+
+static void WakeOneThread(GlobalThreadContext *global, TaskType type) {
+	// Pairs with the fence in WorkerThreadFunc: either we see the sleeper, or it sees the task.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (global->sleepers[(int)type].load(std::memory_order_relaxed) == 0)
+		return;
+
+	int first = global->firstThread[(int)type];
+	int count = global->numThreads[(int)type];
+	for (int i = first; i < first + count; ++i) {
+		if (WakeThread(global, global->threads_[i]))
+			return;
+	}
+}
+
 void ThreadManager::Teardown() {
 	for (ThreadContext *&threadCtx : global_->threads_) {
 		threadCtx->cancelled = true;
@@ -63,38 +248,31 @@ void ThreadManager::Teardown() {
 		threadCtx->cond.notify_one();
 	}
 
-	// Purge any cancellable tasks while the threads shut down.
-	if (global_->compute_queue_size > 0 || global_->io_queue_size > 0) {
-		auto drainQueue = [&](std::deque<Task *> &queue, std::atomic<int> &size) {
-			for (auto it = queue.begin(); it != queue.end(); ++it) {
-				if (TeardownTask(*it, false)) {
-					queue.erase(it);
-					size--;
-					return false;
-				}
-			}
-			return true;
-		};
-
-		std::unique_lock<std::mutex> lock(global_->mutex);
-		while (!drainQueue(global_->compute_queue, global_->compute_queue_size))
-			continue;
-		while (!drainQueue(global_->io_queue, global_->io_queue_size))
-			continue;
+	for (ThreadContext *&threadCtx : global_->threads_) {
+		threadCtx->thread.join();
 	}
 
+	// Purge any cancellable tasks, the rest wait on the global queues for the next Init().
+	std::vector<Task *> leftover;
 	for (ThreadContext *&threadCtx : global_->threads_) {
-		threadCtx->thread.join();
-		// TODO: Is it better to just delete these?
-		TeardownTask(threadCtx->private_single, true);
-		for (Task *task : threadCtx->private_queue) {
-			TeardownTask(threadCtx->private_single, true);
-		}
+		while (Task *task = threadCtx->inbox.Pop())
+			leftover.push_back(task);
+		while (Task *task = threadCtx->deque.Pop())
+			leftover.push_back(task);
 		delete threadCtx;
 	}
 	global_->threads_.clear();
+	for (auto &queue : global_->queues) {
+		while (Task *task = queue.Pop())
+			leftover.push_back(task);
+	}
 
-	if (global_->compute_queue_size > 0 || global_->io_queue_size > 0) {
+	bool remaining = false;
+	for (Task *task : leftover) {
+		if (!TeardownTask(task, true))
+			remaining = true;
+	}
+	if (remaining) {
 		WARN_LOG(SYSTEM, "ThreadManager::Teardown() with tasks still enqueued");
 	}
 }
@@ -110,76 +288,73 @@ bool ThreadManager::TeardownTask(Task *task, bool enqueue) {
 	}
 
 	if (enqueue) {
-		if (task->Type() == TaskType::CPU_COMPUTE) {
-			global_->compute_queue.push_back(task);
-			global_->compute_queue_size++;
-		} else if (task->Type() == TaskType::CPU_COMPUTE) {
-			global_->io_queue.push_back(task);
-			global_->io_queue_size++;
-		} else {
-			_assert_(false);
-		}
+		_assert_((int)task->Type() < TASK_TYPE_COUNT);
+		global_->queues[(int)task->Type()].Push(task);
 	}
 	return false;
 }
 
+static Task *FindTask(GlobalThreadContext *global, ThreadContext *thread) {
+	// Tasks for this thread in particular first, then our own, then anyone's.
+	Task *task = thread->inbox.Pop();
+	if (!task)
+		task = thread->deque.Pop();
+	if (!task)
+		task = global->queues[(int)thread->type].Pop();
+	if (!task) {
+		int first = global->firstThread[(int)thread->type];
+		int count = global->numThreads[(int)thread->type];
+		for (int i = 1; i < count && !task; ++i) {
+			ThreadContext *victim = global->threads_[first + (thread->index - first + i) % count];
+			task = victim->deque.Steal();
+		}
+	}
+	return task;
+}
+
 static void WorkerThreadFunc(GlobalThreadContext *global, ThreadContext *thread) {
 	char threadName[16];
 	snprintf(threadName, sizeof(threadName), "PoolWorker %d", thread->index);
 	SetCurrentThreadName(threadName);
+	currentThread = thread;
 
-	const bool isCompute = thread->type == TaskType::CPU_COMPUTE;
-	const auto global_queue_size = [isCompute, &global]() -> int {
-		return isCompute ? global->compute_queue_size.load() : global->io_queue_size.load();
-	};
+	// I/O tasks block anyway, no point in spinning for them.
+	const int spinCount = thread->type == TaskType::CPU_COMPUTE ? IDLE_SPIN_COUNT : 0;
+	std::atomic<int> &sleepers = global->sleepers[(int)thread->type];
 
 	while (!thread->cancelled) {
-		Task *task = thread->private_single.exchange(nullptr);
-
-		// Check the global queue first, then check the private queue and wait if there's nothing to do.
-		if (!task && global_queue_size() > 0) {
-			// Grab one from the global queue if there is any.
-			std::unique_lock<std::mutex> lock(global->mutex);
-			auto &queue = isCompute ? global->compute_queue : global->io_queue;
-			auto &queue_size = isCompute ? global->compute_queue_size : global->io_queue_size;
-
-			if (!queue.empty()) {
-				task = queue.front();
-				queue.pop_front();
-				queue_size--;
-
-				// We are processing one now, so mark that.
-				thread->queue_size++;
-			}
+		Task *task = FindTask(global, thread);
+		for (int i = 0; !task && i < spinCount && !thread->cancelled; ++i) {
+			if (i >= spinCount / 2)
+				std::this_thread::yield();
+			task = FindTask(global, thread);
 		}
 
 		if (!task) {
-			std::unique_lock<std::mutex> lock(thread->mutex);
-			// We must check both queue and single again, while locked.
-			bool wait = true;
-			if (!thread->private_queue.empty()) {
-				task = thread->private_queue.front();
-				thread->private_queue.pop_front();
-				wait = false;
-			} else if (thread->private_single || thread->cancelled) {
-				wait = false;
-			} else {
-				wait = global_queue_size() == 0;
+			// Announce we're going to sleep, then check once more so we can't miss an enqueue.
+			thread->sleeping = true;
+			sleepers++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			task = FindTask(global, thread);
+
+			if (!task) {
+				std::unique_lock<std::mutex> lock(thread->mutex);
+				thread->cond.wait(lock, [&] { return !thread->sleeping.load() || thread->cancelled.load(); });
 			}
-
-			if (wait)
-				thread->cond.wait(lock);
+			// If nobody woke us, undo the announcement ourselves.
+			if (thread->sleeping.exchange(false))
+				sleepers--;
 		}
+
 		// The task itself takes care of notifying anyone waiting on it. Not the
 		// responsibility of the ThreadManager (although it could be!).
 		if (task) {
 			task->Run();
 			task->Release();
-
-			// Reduce the queue size once complete.
-			thread->queue_size--;
 		}
 	}
+
+	currentThread = nullptr;
 }
 
 void ThreadManager::Init(int numRealCores, int numLogicalCoresPerCpu) {
@@ -194,88 +369,51 @@ void ThreadManager::Init(int numRealCores, int numLogicalCoresPerCpu) {
 
 	INFO_LOG(SYSTEM, "ThreadManager::Init(compute threads: %d, all: %d)", numComputeThreads_, numThreads_);
 
+	global_->firstThread[(int)TaskType::CPU_COMPUTE] = 0;
+	global_->numThreads[(int)TaskType::CPU_COMPUTE] = numComputeThreads_;
+	global_->firstThread[(int)TaskType::IO_BLOCKING] = numComputeThreads_;
+	global_->numThreads[(int)TaskType::IO_BLOCKING] = numThreads_ - numComputeThreads_;
+
+	// Create all contexts first, since workers may look at each other right away.
 	for (int i = 0; i < numThreads; i++) {
 		ThreadContext *thread = new ThreadContext();
+		thread->global = global_;
 		thread->cancelled.store(false);
-		thread->private_single.store(nullptr);
+		thread->sleeping.store(false);
 		thread->type = i < numComputeThreads_ ? TaskType::CPU_COMPUTE : TaskType::IO_BLOCKING;
-		thread->thread = std::thread(&WorkerThreadFunc, global_, thread);
 		thread->index = i;
 		global_->threads_.push_back(thread);
 	}
+	for (ThreadContext *thread : global_->threads_) {
+		thread->thread = std::thread(&WorkerThreadFunc, global_, thread);
+	}
 }
 
 void ThreadManager::EnqueueTask(Task *task) {
 	_assert_msg_(IsInitialized(), "ThreadManager not initialized");
 
-	int minThread;
-	int maxThread;
-	if (task->Type() == TaskType::CPU_COMPUTE) {
-		// only the threads reserved for heavy compute.
-		minThread = 0;
-		maxThread = numComputeThreads_;
-	} else {
-		// Only IO blocking threads (to avoid starving compute threads.)
-		minThread = numComputeThreads_;
-		maxThread = numThreads_;
-	}
+	const TaskType type = task->Type();
+	_assert_((int)type < TASK_TYPE_COUNT);
 
-	// Find a thread with no outstanding work.
-	_assert_(maxThread <= (int)global_->threads_.size());
-	for (int threadNum = minThread; threadNum < maxThread; threadNum++) {
-		ThreadContext *thread = global_->threads_[threadNum];
-		if (thread->queue_size.load() == 0) {
-			std::unique_lock<std::mutex> lock(thread->mutex);
-			thread->private_queue.push_back(task);
-			thread->queue_size++;
-			thread->cond.notify_one();
-			// Found it - done.
-			return;
-		}
-	}
+	// Workers keep tasks they spawn themselves, so they stay warm in cache. Idle siblings
+	// will steal them if needed.
+	ThreadContext *current = currentThread;
+	bool queued = current && current->global == global_ && current->type == type && current->deque.Push(task);
+	if (!queued)
+		global_->queues[(int)type].Push(task);
 
-	// Still not scheduled? Put it on the global queue and notify a thread chosen by round-robin.
-	// Not particularly scientific, but hopefully we should not run into this too much.
-	{
-		std::unique_lock<std::mutex> lock(global_->mutex);
-		if (task->Type() == TaskType::CPU_COMPUTE) {
-			global_->compute_queue.push_back(task);
-			global_->compute_queue_size++;
-		} else if (task->Type() == TaskType::IO_BLOCKING) {
-			global_->io_queue.push_back(task);
-			global_->io_queue_size++;
-		} else {
-			_assert_(false);
-		}
-	}
-
-	int chosenIndex = global_->roundRobin++;
-	chosenIndex = minThread + (chosenIndex % (maxThread - minThread));
-	ThreadContext *&chosenThread = global_->threads_[chosenIndex];
-
-	// Lock the thread to ensure it gets the message.
-	std::unique_lock<std::mutex> lock(chosenThread->mutex);
-	chosenThread->cond.notify_one();
+	WakeOneThread(global_, type);
 }
 
 void ThreadManager::EnqueueTaskOnThread(int threadNum, Task *task, bool enforceSequence) {
 	_assert_msg_(threadNum >= 0 && threadNum < (int)global_->threads_.size(), "Bad threadnum or not initialized");
 	ThreadContext *thread = global_->threads_[threadNum];
 
-	// Try first atomically, as highest priority.
-	Task *expected = nullptr;
-	bool queued = !enforceSequence && thread->private_single.compare_exchange_weak(expected, task);
-	// Whether we got that or will have to wait, increase the queue counter.
-	thread->queue_size++;
-
-	if (queued) {
-		std::unique_lock<std::mutex> lock(thread->mutex);
-		thread->cond.notify_one();
-	} else {
-		std::unique_lock<std::mutex> lock(thread->mutex);
-		thread->private_queue.push_back(task);
-		thread->cond.notify_one();
-	}
+	// The inbox is first in, first out, so the sequence is always kept.
+	thread->inbox.Push(task);
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	WakeThread(global_, thread);
 }
 
 int ThreadManager::GetNumLooperThreads() const {
@@ -289,3 +427,7 @@ void ThreadManager::TryCancelTask(uint64_t taskID) {
 bool ThreadManager::IsInitialized() const {
 	return !global_->threads_.empty();
 }
+
+bool ThreadManager::IsWorkerThread() const {
+	return currentThread != nullptr && currentThread->global == global_;
+}
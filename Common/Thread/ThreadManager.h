@@ -52,6 +52,8 @@ class ThreadManager {
 	void Teardown();
 
 	bool IsInitialized() const;
+	// True on this manager's own worker threads, where blocking on other tasks can deadlock.
+	bool IsWorkerThread() const;
 
 	// Currently does nothing. It will always be best-effort - maybe it cancels,
 	// maybe it doesn't. Note that the id is the id() returned by the task. You need to make that
@@ -633,6 +633,10 @@ static ConfigSetting cpuSettings[] = {
 	ConfigSetting("HideSlowWarnings", &g_Config.bHideSlowWarnings, false, true, false),
 	ConfigSetting("HideStateWarnings", &g_Config.bHideStateWarnings, false, true, false),
 	ConfigSetting("PreloadFunctions", &g_Config.bPreloadFunctions, false, true, true),
+	ConfigSetting("JitTraces", &g_Config.bJitTraces, false, true, true),
+	ConfigSetting("JitRecycleCodeSpace", &g_Config.bJitRecycleCodeSpace, false, true, true),
+	ConfigSetting("IRExperimentalPasses", &g_Config.bIRExperimentalPasses, false, true, true),
+	ConfigSetting("DumpIRBlocks", &g_Config.bDumpIRBlocks, false, true, true),
 	ConfigSetting("JitDisableFlags", &g_Config.uJitDisableFlags, (uint32_t)0, true, true),
 	ReportedConfigSetting("CPUSpeed", &g_Config.iLockedCPUSpeed, 0, true, true),
 
@@ -119,6 +119,12 @@ struct Config {
 	bool bHideSlowWarnings;
 	bool bHideStateWarnings;
 	bool bPreloadFunctions;
+	bool bJitTraces;
+	// Reuse the oldest quarter of the x86/ARM64 jit cache when full, instead of clearing it all.
+	bool bJitRecycleCodeSpace;
+	// Run IR passes that haven't been validated on enough game code yet.
+	bool bIRExperimentalPasses;
+	bool bDumpIRBlocks;
 	uint32_t uJitDisableFlags;
 
 	bool bSeparateSASThread;
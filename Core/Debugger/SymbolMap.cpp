@@ -48,10 +48,108 @@
 
 SymbolMap *g_symbolMap;
 
+// While dirty, lookups go to the maps. Edits and lookups often alternate during a batch
+// (like in ScanForFunctions), so only rebuild once this many lookups came without an edit.
+static const int SNAPSHOT_REBUILD_MISSES = 64;
+
+// Last entry starting at or before address, or nullptr.
+template <typename T>
+static const T *SnapshotFindAtOrBefore(const std::vector<T> &entries, u32 address) {
+	auto it = std::upper_bound(entries.begin(), entries.end(), address, [](u32 addr, const T &e) {
+		return addr < e.start;
+	});
+	if (it == entries.begin())
+		return nullptr;
+	return &*(it - 1);
+}
+
+template <typename T>
+static const T *SnapshotFindExact(const std::vector<T> &entries, u32 address) {
+	const T *entry = SnapshotFindAtOrBefore(entries, address);
+	return entry && entry->start == address ? entry : nullptr;
+}
+
+template <typename T>
+static const T *SnapshotFindContaining(const std::vector<T> &entries, u32 address) {
+	const T *entry = SnapshotFindAtOrBefore(entries, address);
+	return entry && entry->start + entry->size > address ? entry : nullptr;
+}
+
+// First entry starting after address (or at it, if inclusive), or nullptr.
+template <typename T>
+static const T *SnapshotFindAfter(const std::vector<T> &entries, u32 address, bool inclusive) {
+	auto it = std::lower_bound(entries.begin(), entries.end(), address, [](const T &e, u32 addr) {
+		return e.start < addr;
+	});
+	if (!inclusive && it != entries.end() && it->start == address)
+		++it;
+	return it == entries.end() ? nullptr : &*it;
+}
+
+const char *SymbolMap::ActiveSnapshot::GetLabelName(u32 address) const {
+	const SnapshotLabel *label = SnapshotFindExact(labels, address);
+	return label ? &labelNames[label->nameOffset] : nullptr;
+}
+
+void SymbolMap::MarkSnapshotDirty() {
+	snapshotDirty_ = true;
+	snapshotMisses_ = 0;
+}
+
+void SymbolMap::PublishSnapshot() {
+	std::lock_guard<std::recursive_mutex> guard(lock_);
+	if (activeNeedUpdate_)
+		UpdateActiveSymbols();
+
+	auto snapshot = std::make_shared<ActiveSnapshot>();
+	snapshot->functions.reserve(activeFunctions.size());
+	for (const auto &it : activeFunctions) {
+		SnapshotFunction func;
+		func.start = it.first;
+		func.size = it.second.size;
+		func.moduleAddress = GetModuleAbsoluteAddr(0, it.second.module);
+		func.index = it.second.index;
+		snapshot->functions.push_back(func);
+	}
+
+	snapshot->data.reserve(activeData.size());
+	for (const auto &it : activeData) {
+		SnapshotData entry;
+		entry.start = it.first;
+		entry.size = it.second.size;
+		entry.moduleAddress = GetModuleAbsoluteAddr(0, it.second.module);
+		entry.type = it.second.type;
+		snapshot->data.push_back(entry);
+	}
+
+	snapshot->labels.reserve(activeLabels.size());
+	for (const auto &it : activeLabels) {
+		SnapshotLabel label;
+		label.start = it.first;
+		label.nameOffset = (u32)snapshot->labelNames.size();
+		snapshot->labelNames.insert(snapshot->labelNames.end(), it.second.name, it.second.name + strlen(it.second.name) + 1);
+		snapshot->labels.push_back(label);
+	}
+
+	std::atomic_store(&snapshot_, std::shared_ptr<const ActiveSnapshot>(std::move(snapshot)));
+	snapshotDirty_ = false;
+}
+
+std::shared_ptr<const SymbolMap::ActiveSnapshot> SymbolMap::GetSnapshot() {
+	if (snapshotDirty_) {
+		if (++snapshotMisses_ < SNAPSHOT_REBUILD_MISSES)
+			return nullptr;
+		PublishSnapshot();
+	}
+	return std::atomic_load(&snapshot_);
+}
+
 void SymbolMap::SortSymbols() {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
 
 	AssignFunctionIndices();
+	// Callers sort once they're done with a batch of changes, a good time to publish.
+	PublishSnapshot();
 }
 
 void SymbolMap::Clear() {
@@ -65,6 +163,7 @@ void SymbolMap::Clear() {
 	activeModuleEnds.clear();
 	modules.clear();
 	activeNeedUpdate_ = false;
+	PublishSnapshot();
 }
 
 bool SymbolMap::LoadSymbolMap(const Path &filename) {
@@ -307,6 +406,15 @@ void SymbolMap::SaveNocashSym(const Path &filename) const {
 }
 
 SymbolType SymbolMap::GetSymbolType(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		if (SnapshotFindExact(snapshot->functions, address))
+			return ST_FUNCTION;
+		if (SnapshotFindExact(snapshot->data, address))
+			return ST_DATA;
+		return ST_NONE;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -357,6 +465,17 @@ bool SymbolMap::GetSymbolInfo(SymbolInfo *info, u32 address, SymbolType symmask)
 }
 
 u32 SymbolMap::GetNextSymbolAddress(u32 address, SymbolType symmask) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = symmask & ST_FUNCTION ? SnapshotFindAfter(snapshot->functions, address, false) : nullptr;
+		const SnapshotData *entry = symmask & ST_DATA ? SnapshotFindAfter(snapshot->data, address, false) : nullptr;
+		if (!func && !entry)
+			return INVALID_ADDRESS;
+		u32 funcAddress = func ? func->start : 0xFFFFFFFF;
+		u32 dataAddress = entry ? entry->start : 0xFFFFFFFF;
+		return std::min(funcAddress, dataAddress);
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -377,6 +496,25 @@ u32 SymbolMap::GetNextSymbolAddress(u32 address, SymbolType symmask) {
 }
 
 std::string SymbolMap::GetDescription(unsigned int address) {
+	char descriptionTemp[256];
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const char *labelName = nullptr;
+		const SnapshotFunction *func = SnapshotFindContaining(snapshot->functions, address);
+		if (func) {
+			labelName = snapshot->GetLabelName(func->start);
+		} else {
+			const SnapshotData *entry = SnapshotFindContaining(snapshot->data, address);
+			if (entry)
+				labelName = snapshot->GetLabelName(entry->start);
+		}
+
+		if (labelName != nullptr)
+			return labelName;
+		sprintf(descriptionTemp, "(%08x)", address);
+		return descriptionTemp;
+	}
+
 	std::lock_guard<std::recursive_mutex> guard(lock_);
 	const char* labelName = NULL;
 
@@ -392,7 +530,6 @@ std::string SymbolMap::GetDescription(unsigned int address) {
 	if (labelName != NULL)
 		return labelName;
 
-	char descriptionTemp[256];
 	sprintf(descriptionTemp, "(%08x)", address);
 	return descriptionTemp;
 }
@@ -434,6 +571,7 @@ std::vector<SymbolEntry> SymbolMap::GetAllSymbols(SymbolType symmask) {
 
 void SymbolMap::AddModule(const char *name, u32 address, u32 size) {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	for (auto it = modules.begin(), end = modules.end(); it != end; ++it) {
 		if (!strcmp(it->name, name)) {
@@ -459,6 +597,7 @@ void SymbolMap::AddModule(const char *name, u32 address, u32 size) {
 
 void SymbolMap::UnloadModule(u32 address, u32 size) {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 	activeModuleEnds.erase(address + size);
 	activeNeedUpdate_ = true;
 }
@@ -530,6 +669,7 @@ std::vector<LoadedModuleInfo> SymbolMap::getAllModules() const {
 
 void SymbolMap::AddFunction(const char* name, u32 address, u32 size, int moduleIndex) {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	if (moduleIndex == -1) {
 		moduleIndex = GetModuleIndex(address);
@@ -579,6 +719,12 @@ void SymbolMap::AddFunction(const char* name, u32 address, u32 size, int moduleI
 }
 
 u32 SymbolMap::GetFunctionStart(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = SnapshotFindContaining(snapshot->functions, address);
+		return func ? func->start : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -609,6 +755,12 @@ u32 SymbolMap::GetFunctionStart(u32 address) {
 }
 
 u32 SymbolMap::FindPossibleFunctionAtAfter(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = SnapshotFindAfter(snapshot->functions, address, true);
+		return func ? func->start : (u32)-1;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -621,6 +773,12 @@ u32 SymbolMap::FindPossibleFunctionAtAfter(u32 address) {
 }
 
 u32 SymbolMap::GetFunctionSize(u32 startAddress) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = SnapshotFindExact(snapshot->functions, startAddress);
+		return func ? func->size : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_) {
 		std::lock_guard<std::recursive_mutex> guard(lock_);
 
@@ -656,6 +814,12 @@ u32 SymbolMap::GetFunctionSize(u32 startAddress) {
 }
 
 u32 SymbolMap::GetFunctionModuleAddress(u32 startAddress) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = SnapshotFindExact(snapshot->functions, startAddress);
+		return func ? func->moduleAddress : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -668,6 +832,12 @@ u32 SymbolMap::GetFunctionModuleAddress(u32 startAddress) {
 }
 
 int SymbolMap::GetFunctionNum(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotFunction *func = SnapshotFindContaining(snapshot->functions, address);
+		return func ? func->index : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -685,6 +855,7 @@ int SymbolMap::GetFunctionNum(u32 address) {
 
 void SymbolMap::AssignFunctionIndices() {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 	int index = 0;
 	for (auto mod = activeModuleEnds.begin(), modend = activeModuleEnds.end(); mod != modend; ++mod) {
 		int moduleIndex = mod->second.index;
@@ -699,6 +870,7 @@ void SymbolMap::AssignFunctionIndices() {
 void SymbolMap::UpdateActiveSymbols() {
 	// return;   (slow in debug mode)
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	activeFunctions.clear();
 	activeLabels.clear();
@@ -750,6 +922,7 @@ bool SymbolMap::SetFunctionSize(u32 startAddress, u32 newSize) {
 		UpdateActiveSymbols();
 
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	auto funcInfo = activeFunctions.find(startAddress);
 	if (funcInfo != activeFunctions.end()) {
@@ -771,6 +944,7 @@ bool SymbolMap::RemoveFunction(u32 startAddress, bool removeName) {
 		UpdateActiveSymbols();
 
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	auto it = activeFunctions.find(startAddress);
 	if (it == activeFunctions.end())
@@ -800,6 +974,7 @@ bool SymbolMap::RemoveFunction(u32 startAddress, bool removeName) {
 
 void SymbolMap::AddLabel(const char* name, u32 address, int moduleIndex) {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	if (moduleIndex == -1) {
 		moduleIndex = GetModuleIndex(address);
@@ -851,6 +1026,7 @@ void SymbolMap::SetLabelName(const char* name, u32 address) {
 		UpdateActiveSymbols();
 
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 	auto labelInfo = activeLabels.find(address);
 	if (labelInfo == activeLabels.end()) {
 		AddLabel(name, address);
@@ -893,6 +1069,12 @@ const char *SymbolMap::GetLabelNameRel(u32 relAddress, int moduleIndex) const {
 }
 
 std::string SymbolMap::GetLabelString(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const char *label = snapshot->GetLabelName(address);
+		return label ? label : "";
+	}
+
 	std::lock_guard<std::recursive_mutex> guard(lock_);
 	const char *label = GetLabelName(address);
 	if (label == NULL)
@@ -917,6 +1099,7 @@ bool SymbolMap::GetLabelValue(const char* name, u32& dest) {
 
 void SymbolMap::AddData(u32 address, u32 size, DataType type, int moduleIndex) {
 	std::lock_guard<std::recursive_mutex> guard(lock_);
+	MarkSnapshotDirty();
 
 	if (moduleIndex == -1) {
 		moduleIndex = GetModuleIndex(address);
@@ -965,6 +1148,12 @@ void SymbolMap::AddData(u32 address, u32 size, DataType type, int moduleIndex) {
 }
 
 u32 SymbolMap::GetDataStart(u32 address) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotData *entry = SnapshotFindContaining(snapshot->data, address);
+		return entry ? entry->start : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -998,6 +1187,12 @@ u32 SymbolMap::GetDataStart(u32 address) {
 }
 
 u32 SymbolMap::GetDataSize(u32 startAddress) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotData *entry = SnapshotFindExact(snapshot->data, startAddress);
+		return entry ? entry->size : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -1009,6 +1204,12 @@ u32 SymbolMap::GetDataSize(u32 startAddress) {
 }
 
 u32 SymbolMap::GetDataModuleAddress(u32 startAddress) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotData *entry = SnapshotFindExact(snapshot->data, startAddress);
+		return entry ? entry->moduleAddress : INVALID_ADDRESS;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
@@ -1020,6 +1221,12 @@ u32 SymbolMap::GetDataModuleAddress(u32 startAddress) {
 }
 
 DataType SymbolMap::GetDataType(u32 startAddress) {
+	auto snapshot = GetSnapshot();
+	if (snapshot) {
+		const SnapshotData *entry = SnapshotFindExact(snapshot->data, startAddress);
+		return entry ? entry->type : DATATYPE_NONE;
+	}
+
 	if (activeNeedUpdate_)
 		UpdateActiveSymbols();
 
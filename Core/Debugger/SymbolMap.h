@@ -17,9 +17,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
 #include <string>
 #include <mutex>
 
@@ -121,9 +123,14 @@ class SymbolMap {
 	void UpdateActiveSymbols();
 
 private:
+	struct ActiveSnapshot;
+
 	void AssignFunctionIndices();
 	const char *GetLabelName(u32 address);
 	const char *GetLabelNameRel(u32 relAddress, int moduleIndex) const;
+	void MarkSnapshotDirty();
+	void PublishSnapshot();
+	std::shared_ptr<const ActiveSnapshot> GetSnapshot();
 
 	struct FunctionEntry {
 		u32 start;
@@ -170,6 +177,41 @@ class SymbolMap {
 	std::map<SymbolKey, DataEntry> data;
 	std::vector<ModuleEntry> modules;
 
+	// Flattened, immutable copy of the active symbols as sorted arrays, for lookups that
+	// don't need to take lock_. The maps above stay the mutable staging area, and a new
+	// snapshot is published once a batch of changes is done.
+	struct SnapshotFunction {
+		u32 start;
+		u32 size;
+		u32 moduleAddress;
+		int index;
+	};
+
+	struct SnapshotData {
+		u32 start;
+		u32 size;
+		u32 moduleAddress;
+		DataType type;
+	};
+
+	struct SnapshotLabel {
+		u32 start;
+		u32 nameOffset;
+	};
+
+	struct ActiveSnapshot {
+		std::vector<SnapshotFunction> functions;
+		std::vector<SnapshotData> data;
+		std::vector<SnapshotLabel> labels;
+		std::vector<char> labelNames;
+
+		const char *GetLabelName(u32 address) const;
+	};
+
+	std::shared_ptr<const ActiveSnapshot> snapshot_;
+	std::atomic<bool> snapshotDirty_{ true };
+	std::atomic<int> snapshotMisses_{ 0 };
+
 	mutable std::recursive_mutex lock_;
 	bool sawUnknownModule = false;
 };
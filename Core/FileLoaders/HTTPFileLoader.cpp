@@ -19,9 +19,17 @@
 
 #include "Common/Log.h"
 #include "Common/StringUtils.h"
+#include "Common/Thread/ParallelLoop.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/Config.h"
 #include "Core/FileLoaders/HTTPFileLoader.h"
 
+// Each extra connection costs a handshake, so only split reads that are worth it.
+static const size_t MIN_PARALLEL_CHUNK = 128 * 1024;
+static const int MAX_CONNECTIONS = 4;
+static const size_t MIN_READAHEAD = 64 * 1024;
+static const size_t MAX_READAHEAD = 4 * 1024 * 1024;
+
 HTTPFileLoader::HTTPFileLoader(const ::Path &filename)
 	: url_(filename.ToString()), progress_(&cancel_), filename_(filename) {
 }
@@ -51,7 +59,7 @@ void HTTPFileLoader::Prepare() {
 
 					if (url.ToString() == url_.ToString() || url.ToString() == resourceURL.ToString()) {
 						ERROR_LOG(LOADER, "HTTP request failed, hit a redirect loop");
-						latestError_ = "Could not connect (redirect loop)";
+						SetLatestError("Could not connect (redirect loop)");
 						return;
 					}
 
@@ -62,14 +70,14 @@ void HTTPFileLoader::Prepare() {
 
 				// No Location header?
 				ERROR_LOG(LOADER, "HTTP request failed, invalid redirect");
-				latestError_ = "Could not connect (invalid response)";
+				SetLatestError("Could not connect (invalid response)");
 				return;
 			}
 
 			if (code != 200) {
 				// Leave size at 0, invalid.
 				ERROR_LOG(LOADER, "HTTP request failed, got %03d for %s", code, filename_.c_str());
-				latestError_ = "Could not connect (invalid response)";
+				SetLatestError("Could not connect (invalid response)");
 				Disconnect();
 				return;
 			}
@@ -101,7 +109,7 @@ void HTTPFileLoader::Prepare() {
 			}
 		}
 
-		// TODO: Keepalive instead.
+		// Range requests use their own pooled connections.
 		Disconnect();
 
 		if (!acceptsRange) {
@@ -118,13 +126,13 @@ void HTTPFileLoader::Prepare() {
 int HTTPFileLoader::SendHEAD(const Url &url, std::vector<std::string> &responseHeaders) {
 	if (!url.Valid()) {
 		ERROR_LOG(LOADER, "HTTP request failed, invalid URL");
-		latestError_ = "Invalid URL";
+		SetLatestError("Invalid URL");
 		return -400;
 	}
 
 	if (!client_.Resolve(url.Host().c_str(), url.Port())) {
 		ERROR_LOG(LOADER, "HTTP request failed, unable to resolve: |%s| port %d", url.Host().c_str(), url.Port());
-		latestError_ = "Could not connect (name not resolved)";
+		SetLatestError("Could not connect (name not resolved)");
 		return -400;
 	}
 
@@ -132,7 +140,7 @@ int HTTPFileLoader::SendHEAD(const Url &url, std::vector<std::string> &responseH
 	Connect();
 	if (!connected_) {
 		ERROR_LOG(LOADER, "HTTP request failed, failed to connect: %s port %d", url.Host().c_str(), url.Port());
-		latestError_ = "Could not connect (refused to connect)";
+		SetLatestError("Could not connect (refused to connect)");
 		return -400;
 	}
 
@@ -140,7 +148,7 @@ int HTTPFileLoader::SendHEAD(const Url &url, std::vector<std::string> &responseH
 	int err = client_.SendRequest("HEAD", req, nullptr, &progress_);
 	if (err < 0) {
 		ERROR_LOG(LOADER, "HTTP request failed, failed to send request: %s port %d", url.Host().c_str(), url.Port());
-		latestError_ = "Could not connect (could not request data)";
+		SetLatestError("Could not connect (could not request data)");
 		Disconnect();
 		return -400;
 	}
@@ -151,6 +159,9 @@ int HTTPFileLoader::SendHEAD(const Url &url, std::vector<std::string> &responseH
 
 HTTPFileLoader::~HTTPFileLoader() {
 	Disconnect();
+	for (http::Client *client : idleClients_)
+		delete client;
+	idleClients_.clear();
 }
 
 bool HTTPFileLoader::Exists() {
@@ -178,90 +189,238 @@ Path HTTPFileLoader::GetPath() const {
 
 size_t HTTPFileLoader::ReadAt(s64 absolutePos, size_t bytes, void *data, Flags flags) {
 	Prepare();
-	std::lock_guard<std::mutex> guard(readAtMutex_);
 
 	s64 absoluteEnd = std::min(absolutePos + (s64)bytes, filesize_);
 	if (absolutePos >= filesize_ || bytes == 0) {
 		// Read outside of the file or no read at all, just fail immediately.
 		return 0;
 	}
+	bytes = (size_t)(absoluteEnd - absolutePos);
+
+	u8 *dest = (u8 *)data;
+	size_t fromBuffer = 0;
+	size_t window = 0;
+	{
+		std::lock_guard<std::mutex> guard(readAheadMutex_);
+		const s64 bufferEnd = readAheadPos_ + (s64)readAheadData_.size();
+		if (absolutePos >= readAheadPos_ && absolutePos < bufferEnd) {
+			fromBuffer = (size_t)std::min((s64)bytes, bufferEnd - absolutePos);
+			memcpy(dest, &readAheadData_[absolutePos - readAheadPos_], fromBuffer);
+		}
 
-	Connect();
-	if (!connected_) {
-		return 0;
+		if (absolutePos == lastReadEnd_) {
+			readAheadWindow_ = std::min(std::max(readAheadWindow_ * 2, MIN_READAHEAD), MAX_READAHEAD);
+		} else {
+			readAheadWindow_ = 0;
+		}
+		lastReadEnd_ = absoluteEnd;
+		window = readAheadWindow_;
 	}
 
-	char requestHeaders[4096];
-	// Note that the Range header is *inclusive*.
-	snprintf(requestHeaders, sizeof(requestHeaders),
-		"Range: bytes=%lld-%lld\r\n", absolutePos, absoluteEnd - 1);
+	if (fromBuffer == bytes)
+		return bytes;
+
+	const s64 pos = absolutePos + fromBuffer;
+	const size_t remaining = bytes - fromBuffer;
+	const size_t extra = flags == Flags::HINT_UNCACHED ? 0 : (size_t)std::min((s64)window, filesize_ - absoluteEnd);
+	if (extra == 0)
+		return fromBuffer + FetchRange(pos, remaining, dest + fromBuffer);
+
+	std::vector<u8> fetched(remaining + extra);
+	size_t readBytes = FetchRange(pos, fetched.size(), fetched.data());
+	memcpy(dest + fromBuffer, fetched.data(), std::min(readBytes, remaining));
+	if (readBytes > remaining) {
+		std::lock_guard<std::mutex> guard(readAheadMutex_);
+		readAheadPos_ = absoluteEnd;
+		readAheadData_.assign(fetched.begin() + remaining, fetched.begin() + readBytes);
+	}
+	return fromBuffer + std::min(readBytes, remaining);
+}
 
-	http::RequestParams req(url_.Resource(), "*/*");
-	int err = client_.SendRequest("GET", req, requestHeaders, &progress_);
-	if (err < 0) {
-		latestError_ = "Invalid response reading data";
-		Disconnect();
-		return 0;
+class HTTPRangeTask : public Task {
+public:
+	HTTPRangeTask(HTTPFileLoader *loader, s64 pos, size_t bytes, u8 *data, size_t *result, WaitableCounter *counter)
+		: loader_(loader), pos_(pos), bytes_(bytes), data_(data), result_(result), counter_(counter) {}
+
+	TaskType Type() const override {
+		return TaskType::IO_BLOCKING;
 	}
 
-	net::Buffer readbuf;
-	std::vector<std::string> responseHeaders;
-	int code = client_.ReadResponseHeaders(&readbuf, responseHeaders, &progress_);
-	if (code != 206) {
-		ERROR_LOG(LOADER, "HTTP server did not respond with range, received code=%03d", code);
-		latestError_ = "Invalid response reading data";
-		Disconnect();
-		return 0;
+	void Run() override {
+		*result_ = loader_->ReadRange(pos_, bytes_, data_);
+		counter_->Count();
+	}
+
+private:
+	HTTPFileLoader *loader_;
+	s64 pos_;
+	size_t bytes_;
+	u8 *data_;
+	size_t *result_;
+	WaitableCounter *counter_;
+};
+
+size_t HTTPFileLoader::FetchRange(s64 pos, size_t bytes, u8 *data) {
+	const int chunks = (int)std::min((size_t)MAX_CONNECTIONS, bytes / MIN_PARALLEL_CHUNK);
+	// On a worker, waiting for chunk tasks could deadlock if they're queued behind us.
+	if (chunks <= 1 || !g_threadManager.IsInitialized() || g_threadManager.IsWorkerThread())
+		return ReadRange(pos, bytes, data);
+
+	// Round chunks to 2KB so they line up with ISO sectors.
+	const size_t chunkSize = ((bytes / chunks) + 2047) & ~(size_t)2047;
+	size_t results[MAX_CONNECTIONS]{};
+	WaitableCounter *counter = new WaitableCounter(chunks - 1);
+	for (int i = 1; i < chunks; ++i) {
+		const size_t offset = chunkSize * i;
+		const size_t size = i == chunks - 1 ? bytes - offset : chunkSize;
+		g_threadManager.EnqueueTask(new HTTPRangeTask(this, pos + offset, size, data + offset, &results[i], counter));
+	}
+	results[0] = ReadRange(pos, chunkSize, data);
+	counter->WaitAndRelease();
+
+	// Only the contiguous prefix counts if any request came up short.
+	size_t total = 0;
+	for (int i = 0; i < chunks; ++i) {
+		const size_t size = i == chunks - 1 ? bytes - chunkSize * i : chunkSize;
+		total += results[i];
+		if (results[i] != size)
+			break;
 	}
+	return total;
+}
+
+size_t HTTPFileLoader::ReadRange(s64 pos, size_t bytes, u8 *data) {
+	const s64 end = pos + (s64)bytes;
+	// A pooled connection may have been closed by the server while idle, so allow one retry.
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		bool reused = false;
+		http::Client *client = AcquireClient(&reused);
+		if (!client) {
+			return 0;
+		}
 
-	// TODO: Expire cache via ETag, etc.
-	// We don't support multipart/byteranges responses.
-	bool supportedResponse = false;
-	for (std::string header : responseHeaders) {
-		if (startsWithNoCase(header, "Content-Range:")) {
-			// TODO: More correctness.  Whitespace can be missing or different.
-			s64 first = -1, last = -1, total = -1;
-			std::string lowerHeader = header;
-			std::transform(lowerHeader.begin(), lowerHeader.end(), lowerHeader.begin(), tolower);
-			if (sscanf(lowerHeader.c_str(), "content-range: bytes %lld-%lld/%lld", &first, &last, &total) >= 2) {
-				if (first == absolutePos && last == absoluteEnd - 1) {
-					supportedResponse = true;
+		char requestHeaders[4096];
+		// Note that the Range header is *inclusive*.
+		snprintf(requestHeaders, sizeof(requestHeaders),
+			"Range: bytes=%lld-%lld\r\n", pos, end - 1);
+
+		http::RequestProgress progress(&cancel_);
+		http::RequestParams req(url_.Resource(), "*/*");
+		net::Buffer readbuf;
+		std::vector<std::string> responseHeaders;
+		int code = client->SendRequest("GET", req, requestHeaders, &progress);
+		if (code >= 0)
+			code = client->ReadResponseHeaders(&readbuf, responseHeaders, &progress);
+		if (code < 0 && reused && !cancel_) {
+			ReleaseClient(client, false);
+			continue;
+		}
+		if (code < 0) {
+			SetLatestError("Invalid response reading data");
+			ReleaseClient(client, false);
+			return 0;
+		}
+		if (code != 206) {
+			ERROR_LOG(LOADER, "HTTP server did not respond with range, received code=%03d", code);
+			SetLatestError("Invalid response reading data");
+			ReleaseClient(client, false);
+			return 0;
+		}
+
+		// TODO: Expire cache via ETag, etc.
+		// We don't support multipart/byteranges responses.
+		bool supportedResponse = false;
+		for (std::string header : responseHeaders) {
+			if (startsWithNoCase(header, "Content-Range:")) {
+				// TODO: More correctness.  Whitespace can be missing or different.
+				s64 first = -1, last = -1, total = -1;
+				std::string lowerHeader = header;
+				std::transform(lowerHeader.begin(), lowerHeader.end(), lowerHeader.begin(), tolower);
+				if (sscanf(lowerHeader.c_str(), "content-range: bytes %lld-%lld/%lld", &first, &last, &total) >= 2) {
+					if (first == pos && last == end - 1) {
+						supportedResponse = true;
+					} else {
+						ERROR_LOG(LOADER, "Unexpected HTTP range: got %lld-%lld, wanted %lld-%lld.", first, last, pos, end - 1);
+					}
 				} else {
-					ERROR_LOG(LOADER, "Unexpected HTTP range: got %lld-%lld, wanted %lld-%lld.", first, last, absolutePos, absoluteEnd - 1);
+					ERROR_LOG(LOADER, "Unexpected HTTP range response: %s", header.c_str());
 				}
-			} else {
-				ERROR_LOG(LOADER, "Unexpected HTTP range response: %s", header.c_str());
 			}
 		}
+
+		// TODO: Would be nice to read directly.
+		net::Buffer output;
+		int res = client->ReadResponseEntity(&readbuf, responseHeaders, &output, &progress);
+		if (res != 0) {
+			ERROR_LOG(LOADER, "Unable to read HTTP response entity: %d", res);
+			// Let's take anything we got anyway.  Not worse than returning nothing?
+		}
+		ReleaseClient(client, res == 0 && supportedResponse && client->CanReuseConnection(responseHeaders));
+
+		if (!supportedResponse) {
+			ERROR_LOG(LOADER, "HTTP server did not respond with the range we wanted.");
+			SetLatestError("Invalid response reading data");
+			return 0;
+		}
+
+		size_t readBytes = std::min(output.size(), bytes);
+		output.Take(readBytes, (char *)data);
+		return readBytes;
 	}
+	return 0;
+}
 
-	// TODO: Would be nice to read directly.
-	net::Buffer output;
-	int res = client_.ReadResponseEntity(&readbuf, responseHeaders, &output, &progress_);
-	if (res != 0) {
-		ERROR_LOG(LOADER, "Unable to read HTTP response entity: %d", res);
-		// Let's take anything we got anyway.  Not worse than returning nothing?
+http::Client *HTTPFileLoader::AcquireClient(bool *reused) {
+	{
+		std::lock_guard<std::mutex> guard(poolMutex_);
+		if (!idleClients_.empty()) {
+			http::Client *client = idleClients_.back();
+			idleClients_.pop_back();
+			*reused = true;
+			return client;
+		}
 	}
 
-	// TODO: Keepalive instead.
-	Disconnect();
+	*reused = false;
+	http::Client *client = new http::Client();
+	client->SetUserAgent(StringFromFormat("PPSSPP/%s", PPSSPP_GIT_VERSION));
+	client->SetKeepAlive(true);
+	client->SetDataTimeout(20.0);
+	if (!client->Resolve(url_.Host().c_str(), url_.Port())) {
+		ERROR_LOG(LOADER, "HTTP request failed, unable to resolve: |%s| port %d", url_.Host().c_str(), url_.Port());
+		SetLatestError("Could not connect (name not resolved)");
+		delete client;
+		return nullptr;
+	}
 
-	if (!supportedResponse) {
-		ERROR_LOG(LOADER, "HTTP server did not respond with the range we wanted.");
-		latestError_ = "Invalid response reading data";
-		return 0;
+	// Latency is important here, so reduce the timeout.
+	if (!client->Connect(3, 10.0, &cancel_)) {
+		SetLatestError("Could not connect (refused to connect)");
+		delete client;
+		return nullptr;
 	}
+	return client;
+}
 
-	size_t readBytes = output.size();
-	output.Take(readBytes, (char *)data);
-	filepos_ = absolutePos + readBytes;
-	return readBytes;
+void HTTPFileLoader::ReleaseClient(http::Client *client, bool reusable) {
+	if (reusable) {
+		std::lock_guard<std::mutex> guard(poolMutex_);
+		if ((int)idleClients_.size() < MAX_CONNECTIONS) {
+			idleClients_.push_back(client);
+			return;
+		}
+	}
+	delete client;
 }
 
 void HTTPFileLoader::Connect() {
 	if (!connected_) {
-		cancel_ = false;
 		// Latency is important here, so reduce the timeout.
 		connected_ = client_.Connect(3, 10.0, &cancel_);
 	}
 }
+
+void HTTPFileLoader::SetLatestError(const char *error) {
+	std::lock_guard<std::mutex> guard(errorLock_);
+	latestError_ = error;
+}
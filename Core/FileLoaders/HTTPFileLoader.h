@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "Common/File/Path.h"
@@ -51,14 +53,26 @@ class HTTPFileLoader : public FileLoader {
 	}
 
 	std::string LatestError() const override {
+		std::lock_guard<std::mutex> guard(errorLock_);
 		return latestError_;
 	}
 
 private:
+	friend class HTTPRangeTask;
+
 	void Prepare();
 	int SendHEAD(const Url &url, std::vector<std::string> &responseHeaders);
 
+	// Reads [pos, pos + bytes), split over several pooled connections when large.
+	size_t FetchRange(s64 pos, size_t bytes, u8 *data);
+	// A single range request over a pooled connection.
+	size_t ReadRange(s64 pos, size_t bytes, u8 *data);
+	http::Client *AcquireClient(bool *reused);
+	void ReleaseClient(http::Client *client, bool reusable);
+
 	void Connect();
+	// Range requests fail from several threads at once, so this is locked.
+	void SetLatestError(const char *error);
 
 	void Disconnect() {
 		if (connected_) {
@@ -68,15 +82,26 @@ class HTTPFileLoader : public FileLoader {
 	}
 
 	s64 filesize_ = 0;
-	s64 filepos_ = 0;
 	Url url_;
 	http::Client client_;
 	http::RequestProgress progress_;
 	::Path filename_;
 	bool connected_ = false;
-	bool cancel_ = false;
-	const char *latestError_ = "";
+	// Once set, stays set: the loader is on its way out.
+	std::atomic<bool> cancel_{};
+	mutable std::mutex errorLock_;
+	std::string latestError_;
 
 	std::once_flag preparedFlag_;
-	std::mutex readAtMutex_;
+
+	// Idle keep-alive connections for range requests.
+	std::mutex poolMutex_;
+	std::vector<http::Client *> idleClients_;
+
+	// Data fetched past the end of the last read. The window doubles while reads stay sequential.
+	std::mutex readAheadMutex_;
+	std::vector<u8> readAheadData_;
+	s64 readAheadPos_ = 0;
+	s64 lastReadEnd_ = -1;
+	size_t readAheadWindow_ = 0;
 };
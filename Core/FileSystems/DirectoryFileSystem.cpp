@@ -76,6 +76,10 @@ DirectoryFileSystem::DirectoryFileSystem(IHandleAllocator *_hAlloc, const Path &
 
 DirectoryFileSystem::~DirectoryFileSystem() {
 	CloseAll();
+#if HOST_IS_CASE_SENSITIVE
+	FixPathCaseStats stats = GetFixPathCaseStats();
+	DEBUG_LOG(FILESYS, "Path case fixing: %llu cached lookups, %llu directory scans", (unsigned long long)stats.hits, (unsigned long long)stats.scans);
+#endif
 }
 
 // TODO(scoped): Merge the two below functions somehow.
@@ -298,6 +302,11 @@ bool DirectoryFileHandle::Open(const Path &basePath, std::string &fileName, File
 	if (access & (FILEACCESS_APPEND | FILEACCESS_CREATE | FILEACCESS_WRITE)) {
 		MemoryStick_NotifyWrite();
 	}
+#if HOST_IS_CASE_SENSITIVE
+	if (success && (access & FILEACCESS_CREATE)) {
+		FixPathCaseInvalidate(fullName);
+	}
+#endif
 
 	return success;
 }
@@ -452,6 +461,7 @@ bool DirectoryFileSystem::MkDir(const std::string &dirname) {
 		result = false;
 	else
 		result = File::CreateFullPath(GetLocalPath(fixedCase));
+	FixPathCaseInvalidate(GetLocalPath(fixedCase));
 #else
 	result = File::CreateFullPath(GetLocalPath(dirname));
 #endif
@@ -465,6 +475,7 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #if HOST_IS_CASE_SENSITIVE
 	// Maybe we're lucky?
 	if (File::DeleteDirRecursively(fullName)) {
+		FixPathCaseInvalidate(fullName);
 		MemoryStick_NotifyWrite();
 		return (bool)ReplayApplyDisk(ReplayAction::RMDIR, true, CoreTiming::GetGlobalTimeUs());
 	}
@@ -478,6 +489,9 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #endif
 
 	bool result = File::DeleteDirRecursively(fullName);
+#if HOST_IS_CASE_SENSITIVE
+	FixPathCaseInvalidate(fullName);
+#endif
 	MemoryStick_NotifyWrite();
 	return ReplayApplyDisk(ReplayAction::RMDIR, result, CoreTiming::GetGlobalTimeUs()) != 0;
 }
@@ -524,6 +538,13 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 	}
 #endif
 
+#if HOST_IS_CASE_SENSITIVE
+	if (retValue) {
+		FixPathCaseInvalidate(fullFrom);
+		FixPathCaseInvalidate(fullToPath);
+	}
+#endif
+
 	// TODO: Better error codes.
 	int result = retValue ? 0 : (int)SCE_KERNEL_ERROR_ERRNO_FILE_ALREADY_EXISTS;
 	MemoryStick_NotifyWrite();
@@ -546,6 +567,8 @@ bool DirectoryFileSystem::RemoveFile(const std::string &filename) {
 
 		retValue = File::Delete(localPath);
 	}
+	if (retValue)
+		FixPathCaseInvalidate(localPath);
 #endif
 
 	MemoryStick_NotifyWrite();
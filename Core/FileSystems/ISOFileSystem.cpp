@@ -19,8 +19,11 @@
 #include <cstdio>
 #include <ctype.h>
 #include <algorithm>
+#include <deque>
+#include <unordered_set>
 
 #include "Common/CommonTypes.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Core/FileSystems/ISOFileSystem.h"
@@ -29,6 +32,11 @@
 #include "Core/Reporting.h"
 
 const int sectorSize = 2048;
+static const size_t MAX_PATH_CACHE_ENTRIES = 8192;
+// Limits for the background preread, so a corrupt or hostile directory tree can't keep it busy forever.
+// Anything past these is still read lazily on lookup, like before.
+static const int MAX_PREREAD_DEPTH = 32;
+static const int MAX_PREREAD_ENTRIES = 65536;
 
 bool parseLBN(std::string filename, u32 *sectorStart, u32 *readSize) {
 	// The format of this is: "/sce_lbn" "0x"? HEX* ANY* "_size" "0x"? HEX* ANY*
@@ -173,10 +181,94 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 }
 
 ISOFileSystem::~ISOFileSystem() {
+	{
+		std::unique_lock<std::mutex> guard(lock_);
+		prereadCancel_ = true;
+		while (prereadRunning_)
+			prereadCond_.wait(guard);
+	}
 	delete blockDevice;
 	delete treeroot;
 }
 
+class ISODirectoryPrereadTask : public Task {
+public:
+	ISODirectoryPrereadTask(ISOFileSystem *fs) : fs_(fs) {}
+
+	TaskType Type() const override {
+		return TaskType::IO_BLOCKING;
+	}
+
+	void Run() override {
+		fs_->PrereadDirectoryTree();
+	}
+
+	// If the thread manager tears down before we ran, the destructor must not wait for us.
+	bool Cancellable() override {
+		return true;
+	}
+
+	void Cancel() override {
+		fs_->PrereadFinished();
+	}
+
+private:
+	ISOFileSystem *fs_;
+};
+
+void ISOFileSystem::StartDirectoryPreread() {
+	if (!g_threadManager.IsInitialized() || treeroot->dirsize == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		if (prereadRunning_)
+			return;
+		prereadRunning_ = true;
+	}
+	g_threadManager.EnqueueTask(new ISODirectoryPrereadTask(this));
+}
+
+void ISOFileSystem::PrereadDirectoryTree() {
+	// Breadth first, taking the lock one directory at a time so emulation never waits long.
+	// Directories are tracked by start sector, so links back up the tree (corrupt ISOs) are only read once.
+	std::deque<std::pair<TreeEntry *, int>> queue;
+	std::unordered_set<u32> visited;
+	queue.push_back(std::make_pair(treeroot, 0));
+	visited.insert(treeroot->startsector);
+	int count = 0;
+	int entries = 0;
+	while (!queue.empty() && !prereadCancel_ && entries < MAX_PREREAD_ENTRIES) {
+		TreeEntry *dir = queue.front().first;
+		const int depth = queue.front().second;
+		queue.pop_front();
+
+		std::lock_guard<std::mutex> guard(lock_);
+		if (!dir->valid)
+			ReadDirectory(dir);
+		count++;
+		entries += (int)dir->children.size();
+		if (depth + 1 >= MAX_PREREAD_DEPTH)
+			continue;
+		for (TreeEntry *child : dir->children) {
+			if (!child->isDirectory || child->name == "." || child->name == "..")
+				continue;
+			if (!visited.insert(child->startsector).second)
+				continue;
+			queue.push_back(std::make_pair(child, depth + 1));
+		}
+	}
+
+	DEBUG_LOG(FILESYS, "Preread %d ISO directories, %d entries%s", count, entries, prereadCancel_ ? " (cancelled)" : (queue.empty() ? "" : " (limit reached)"));
+	PrereadFinished();
+}
+
+void ISOFileSystem::PrereadFinished() {
+	std::lock_guard<std::mutex> guard(lock_);
+	prereadRunning_ = false;
+	prereadCond_.notify_all();
+}
+
 void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 	for (u32 secnum = root->startsector, endsector = root->startsector + (root->dirsize + 2047) / 2048; secnum < endsector; ++secnum) {
 		u8 theSector[2048];
@@ -186,7 +278,9 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 			root->valid = true;  // Prevents re-reading
 			return;
 		}
-		lastReadBlock_ = secnum;  // Hm, this could affect timing... but lazy loading is probably more realistic.
+		// Applied to lastReadBlock_ by LoadDirectory. Hm, this could affect timing... but lazy loading is probably more realistic.
+		root->lastSector = secnum;
+		root->readSectors = true;
 
 		for (int offset = 0; offset < 2048; ) {
 			DirectoryEntry &dir = *(DirectoryEntry *)&theSector[offset];
@@ -243,11 +337,22 @@ void ISOFileSystem::ReadDirectory(TreeEntry *root) {
 				}
 			}
 			root->children.push_back(entry);
+			root->childIndex.emplace(entry->name, entry);
 		}
 	}
 	root->valid = true;
 }
 
+void ISOFileSystem::LoadDirectory(TreeEntry *entry) {
+	if (entry->valid && entry->touched)
+		return;
+	if (!entry->valid)
+		ReadDirectory(entry);
+	entry->touched = true;
+	if (entry->readSectors)
+		lastReadBlock_ = entry->lastSector;
+}
+
 ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bool catchError) {
 	const size_t pathLength = path.length();
 
@@ -269,40 +374,50 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 	if (pathLength <= pathIndex)
 		return treeroot;
 
+	// Every directory on a cached path has already been loaded and touched, so a hit has no
+	// side effects to replay.
+	const std::string relativePath = path.substr(pathIndex);
+	auto cached = pathCache_.find(relativePath);
+	if (cached != pathCache_.end())
+		return cached->second;
+
 	TreeEntry *entry = treeroot;
+	bool allValid = true;
 	while (true) {
-		if (!entry->valid) {
-			ReadDirectory(entry);
-		}
+		LoadDirectory(entry);
+		allValid = allValid && entry->valid;
 		TreeEntry *nextEntry = nullptr;
-		std::string name = "";
+		size_t nameLength = 0;
 		if (pathLength > pathIndex) {
 			size_t nextSlashIndex = path.find_first_of('/', pathIndex);
 			if (nextSlashIndex == std::string::npos)
 				nextSlashIndex = pathLength;
 
 			const std::string firstPathComponent = path.substr(pathIndex, nextSlashIndex - pathIndex);
-			for (size_t i = 0; i < entry->children.size(); i++) {
-				const std::string &n = entry->children[i]->name;
-				if (firstPathComponent == n) {
-					//yay we got it
-					nextEntry = entry->children[i];
-					name = n;
-					break;
-				}
+			auto child = entry->childIndex.find(firstPathComponent);
+			if (child != entry->childIndex.end()) {
+				nextEntry = child->second;
+				nameLength = firstPathComponent.length();
 			}
 		}
-		
+
 		if (nextEntry) {
 			entry = nextEntry;
-			if (!entry->valid)
-				ReadDirectory(entry);
-			pathIndex += name.length();
+			LoadDirectory(entry);
+			allValid = allValid && entry->valid;
+			pathIndex += nameLength;
 			if (pathIndex < pathLength && path[pathIndex] == '/')
 				++pathIndex;
 
-			if (pathLength <= pathIndex)
+			if (pathLength <= pathIndex) {
+				// Directories that failed to read fully get retried, like before, so don't cache through them.
+				if (allValid) {
+					if (pathCache_.size() >= MAX_PATH_CACHE_ENTRIES)
+						pathCache_.clear();
+					pathCache_[relativePath] = entry;
+				}
 				return entry;
+			}
 		} else {
 			if (catchError)
 				ERROR_LOG(FILESYS, "File '%s' not found", path.c_str());
@@ -313,6 +428,7 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(const std::string &path, bo
 }
 
 int ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename) {
+	std::lock_guard<std::mutex> guard(lock_);
 	OpenFileEntry entry;
 	entry.isRawSector = false;
 	entry.isBlockSectorMode = false;
@@ -385,6 +501,7 @@ bool ISOFileSystem::OwnsHandle(u32 handle) {
 }
 
 int ISOFileSystem::Ioctl(u32 handle, u32 cmd, u32 indataPtr, u32 inlen, u32 outdataPtr, u32 outlen, int &usec) {
+	std::lock_guard<std::mutex> guard(lock_);
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter == entries.end()) {
 		ERROR_LOG(FILESYS, "Ioctl on a bad file handle");
@@ -466,6 +583,7 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 }
 
 size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size, int &usec) {
+	std::lock_guard<std::mutex> guard(lock_);
 	EntryMap::iterator iter = entries.find(handle);
 	if (iter != entries.end()) {
 		OpenFileEntry &e = iter->second;
@@ -616,6 +734,7 @@ PSPFileInfo ISOFileSystem::GetFileInfo(std::string filename) {
 		return fileInfo;
 	}
 
+	std::lock_guard<std::mutex> guard(lock_);
 	TreeEntry *entry = GetFromPath(filename, false);
 	PSPFileInfo x; 
 	if (entry) {
@@ -633,6 +752,7 @@ PSPFileInfo ISOFileSystem::GetFileInfo(std::string filename) {
 
 std::vector<PSPFileInfo> ISOFileSystem::GetDirListing(std::string path) {
 	std::vector<PSPFileInfo> myVector;
+	std::lock_guard<std::mutex> guard(lock_);
 	TreeEntry *entry = GetFromPath(path);
 	if (!entry)
 		return myVector;
@@ -699,6 +819,7 @@ void ISOFileSystem::DoState(PointerWrap &p) {
 	if (!s)
 		return;
 
+	std::lock_guard<std::mutex> guard(lock_);
 	int n = (int) entries.size();
 	Do(p, n);
 
@@ -17,9 +17,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "FileSystem.h"
 
@@ -56,7 +60,12 @@ class ISOFileSystem : public IFileSystem {
 
 	bool ComputeRecursiveDirSizeIfFast(const std::string &path, int64_t *size) override { return false; }
 
+	// Reads the rest of the directory tree on a worker, so later lookups don't stall on disc reads.
+	void StartDirectoryPreread();
+
 private:
+	friend class ISODirectoryPrereadTask;
+
 	struct TreeEntry {
 		~TreeEntry();
 
@@ -73,6 +82,14 @@ class ISOFileSystem : public IFileSystem {
 
 		bool valid = false;
 		std::vector<TreeEntry *> children;
+		// First child with each name, filled in by ReadDirectory.
+		std::unordered_map<std::string, TreeEntry *> childIndex;
+
+		// Whether emulation has looked into this directory yet. The preread doesn't count, so
+		// the first real lookup can still apply the seek position of the lazy read.
+		bool touched = false;
+		bool readSectors = false;
+		u32 lastSector = 0;
 	};
 
 	struct OpenFileEntry {
@@ -93,7 +110,19 @@ class ISOFileSystem : public IFileSystem {
 
 	TreeEntry entireISO;
 
+	// Lookups already resolved, by path relative to the root.
+	std::unordered_map<std::string, TreeEntry *> pathCache_;
+
+	// Guards the tree and blockDevice while a preread is running.
+	std::mutex lock_;
+	std::condition_variable prereadCond_;
+	bool prereadRunning_ = false;
+	std::atomic<bool> prereadCancel_{};
+
 	void ReadDirectory(TreeEntry *root);
+	void LoadDirectory(TreeEntry *entry);
+	void PrereadDirectoryTree();
+	void PrereadFinished();
 	TreeEntry *GetFromPath(const std::string &path, bool catchError = true);
 	std::string EntryFullPath(TreeEntry *e);
 };
@@ -54,6 +54,15 @@ extern "C" struct hostent *gethostbyname(const char *name);
 #include <errno.h>
 //#include <sqlite3.h>
 
+#if !defined(_WIN32)
+#include <poll.h>
+#endif
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #ifndef MSG_NOSIGNAL
 // Default value to 0x00 (do nothing) in systems where it's not supported.
 #define MSG_NOSIGNAL 0x00
@@ -79,6 +88,34 @@ SceNetAdhocctlUserNode * _db_user = NULL;
 // Game Database
 SceNetAdhocctlGameNode * _db_game = NULL;
 
+// Group Lookup Key (Game Node + Group Name)
+struct GroupLookupKey {
+	SceNetAdhocctlGameNode * game;
+	uint64_t name;
+
+	bool operator ==(const GroupLookupKey &other) const {
+		return game == other.game && name == other.name;
+	}
+};
+
+struct GroupLookupHash {
+	size_t operator ()(const GroupLookupKey &key) const {
+		return std::hash<uint64_t>()(key.name ^ (uint64_t)(uintptr_t)key.game);
+	}
+};
+
+// Lookup Indexes into the Databases above
+static std::unordered_map<uint32_t, SceNetAdhocctlUserNode *> _db_user_by_ip;
+static std::unordered_multimap<uint64_t, SceNetAdhocctlUserNode *> _db_user_by_mac;
+static std::unordered_map<std::string, SceNetAdhocctlGameNode *> _db_game_by_id;
+static std::unordered_map<GroupLookupKey, SceNetAdhocctlGroupNode *, GroupLookupHash> _db_group_by_name;
+
+// Users with queued TX Data
+static std::vector<SceNetAdhocctlUserNode *> _db_tx_pending;
+
+// Status Logfile needs rewriting
+static bool _db_status_dirty = false;
+
 // Server Status
 std::atomic<bool> adhocServerRunning(false);
 std::thread adhocServerThread;
@@ -500,6 +537,107 @@ void change_blocking_mode(int fd, int nonblocking);
 int create_listen_socket(uint16_t port);
 int server_loop(int server);
 
+/**
+ * MAC Address Lookup Key
+ * @param mac MAC Address
+ * @return Key for _db_user_by_mac
+ */
+static uint64_t mac_lookup_key(const SceNetEtherAddr * mac)
+{
+	uint64_t key = 0;
+	memcpy(&key, mac->data, sizeof(mac->data));
+	return key;
+}
+
+/**
+ * Product Code Lookup Key (compares like strncmp)
+ * @param product Product Code
+ * @return Key for _db_game_by_id
+ */
+static std::string game_lookup_key(const SceNetAdhocctlProductCode * product)
+{
+	return std::string(product->data, strnlen(product->data, PRODUCT_CODE_LENGTH));
+}
+
+/**
+ * Group Name Lookup Key (compares like strncmp)
+ * @param game Game Node
+ * @param group Group Name
+ * @return Key for _db_group_by_name
+ */
+static GroupLookupKey group_lookup_key(SceNetAdhocctlGameNode * game, const SceNetAdhocctlGroupName * group)
+{
+	GroupLookupKey key{ game, 0 };
+	static_assert(sizeof(key.name) == ADHOCCTL_GROUPNAME_LEN, "Group name must fit the key");
+	memcpy(&key.name, group->data, strnlen((const char *)group->data, ADHOCCTL_GROUPNAME_LEN));
+	return key;
+}
+
+/**
+ * Queue Packet for User (sent by flush_user_sends)
+ * @param user User Node
+ * @param data Packet Data
+ * @param len Packet Length
+ */
+static void queue_user_send(SceNetAdhocctlUserNode * user, const void * data, uint32_t len)
+{
+	// Client isn't reading anymore, the timeout will take care of it
+	if(user->txpos + len > SERVER_USER_TX_MAXIMUM)
+	{
+		ERROR_LOG(SCENET, "AdhocServer: TX buffer full for %s, dropping %u bytes", ip2str(*(in_addr*)&user->resolver.ip).c_str(), len);
+		return;
+	}
+
+	// Grow Buffer
+	if(user->txpos + len > user->txsize)
+	{
+		uint32_t size = std::max(std::max(user->txsize * 2, user->txpos + len), (uint32_t)sizeof(user->rx));
+		uint8_t * tx = (uint8_t *)realloc(user->tx, size);
+		if(tx == NULL)
+		{
+			ERROR_LOG(SCENET, "AdhocServer: Out of memory queueing %u bytes", len);
+			return;
+		}
+		user->tx = tx;
+		user->txsize = size;
+	}
+
+	// First queued Packet since the last Flush
+	if(user->txpos == 0) _db_tx_pending.push_back(user);
+
+	memcpy(user->tx + user->txpos, data, len);
+	user->txpos += len;
+}
+
+/**
+ * Send queued Packets of all Users, one send per User
+ */
+static void flush_user_sends()
+{
+	size_t remaining = 0;
+	for(size_t i = 0; i < _db_tx_pending.size(); i++)
+	{
+		SceNetAdhocctlUserNode * user = _db_tx_pending[i];
+
+		int sent = send(user->stream, (const char*)user->tx, user->txpos, MSG_NOSIGNAL);
+		if(sent > 0)
+		{
+			// Keep the Rest for when the Socket is writable again
+			memmove(user->tx, user->tx + sent, user->txpos - sent);
+			user->txpos -= sent;
+		}
+		else if(sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			// Connection is broken, the receive side will log the User out
+			ERROR_LOG(SCENET, "AdhocServer: flush_user_sends[send user] (Socket error %d)", errno);
+			user->txpos = 0;
+		}
+
+		if(user->txpos > 0) _db_tx_pending[remaining++] = user;
+	}
+	_db_tx_pending.resize(remaining);
+}
+
 void __AdhocServerInit() {
 	// Database Product name will update if new game region played on my server to list possible crosslinks
 	productids = std::vector<db_productid>(default_productids, default_productids + ARRAY_SIZE(default_productids));
@@ -517,8 +655,8 @@ void login_user_stream(int fd, uint32_t ip)
 	if(_db_user_count < SERVER_USER_MAXIMUM)
 	{
 		// Check IP Duplication
-		SceNetAdhocctlUserNode * u = _db_user;
-		while(u != NULL && u->resolver.ip != ip) u = u->next;
+		auto existing = _db_user_by_ip.find(ip);
+		SceNetAdhocctlUserNode * u = existing != _db_user_by_ip.end() ? existing->second : NULL;
 
 		if (u != NULL) { // IP Already existed
 			WARN_LOG(SCENET, "AdhocServer: Already Existing IP: %s\n", ip2str(*(in_addr*)&u->resolver.ip).c_str());
@@ -546,6 +684,7 @@ void login_user_stream(int fd, uint32_t ip)
 				user->next = _db_user;
 				if(_db_user != NULL) _db_user->prev = user;
 				_db_user = user;
+				_db_user_by_ip[ip] = user;
 
 				// Initialize Death Clock
 				user->last_recv = time(NULL);
@@ -557,7 +696,7 @@ void login_user_stream(int fd, uint32_t ip)
 				_db_user_count++;
 
 				// Update Status Log
-				update_status();
+				_db_status_dirty = true;
 
 				// Exit Function
 				return;
@@ -590,8 +729,8 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 	if(valid_product_code == 1 && memcmp(&data->mac, "\xFF\xFF\xFF\xFF\xFF\xFF", sizeof(data->mac)) != 0 && memcmp(&data->mac, "\x00\x00\x00\x00\x00\x00", sizeof(data->mac)) != 0 && data->name.data[0] != 0)
 	{
 		// Check for duplicated MAC as most games identify Players by MAC
-		SceNetAdhocctlUserNode* u = _db_user;
-		while (u != NULL && !IsMatch(u->resolver.mac, data->mac)) u = u->next;
+		auto existing = _db_user_by_mac.find(mac_lookup_key(&data->mac));
+		SceNetAdhocctlUserNode* u = existing != _db_user_by_mac.end() ? existing->second : NULL;
 
 		if (u != NULL) { // MAC Already existed
 			WARN_LOG(SCENET, "AdhocServer: Already Existing MAC: %s [%s]\n", mac2str(&data->mac).c_str(), ip2str(*(in_addr*)&u->resolver.ip).c_str());
@@ -601,8 +740,8 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 		game_product_override(&data->game);
 
 		// Find existing Game
-		SceNetAdhocctlGameNode * game = _db_game;
-		while(game != NULL && strncmp(game->game.data, data->game.data, PRODUCT_CODE_LENGTH) != 0) game = game->next;
+		auto existingGame = _db_game_by_id.find(game_lookup_key(&data->game));
+		SceNetAdhocctlGameNode * game = existingGame != _db_game_by_id.end() ? existingGame->second : NULL;
 
 		// Game not found
 		if(game == NULL)
@@ -623,6 +762,7 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 				game->next = _db_game;
 				if(_db_game != NULL) _db_game->prev = game;
 				_db_game = game;
+				_db_game_by_id[game_lookup_key(&game->game)] = game;
 			}
 		}
 
@@ -631,6 +771,7 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 		{
 			// Save MAC
 			user->resolver.mac = data->mac;
+			_db_user_by_mac.insert(std::make_pair(mac_lookup_key(&user->resolver.mac), user));
 
 			// Save Nickname
 			user->resolver.name = data->name;
@@ -648,7 +789,7 @@ void login_user_data(SceNetAdhocctlUserNode * user, SceNetAdhocctlLoginPacketC2S
 			INFO_LOG(SCENET, "AdhocServer: %s (MAC: %s - IP: %s) started playing %s", (char *)user->resolver.name.data, mac2str(&user->resolver.mac).c_str(), ip2str(*(in_addr*)&user->resolver.ip).c_str(), safegamestr);
 
 			// Update Status Log
-			update_status();
+			_db_status_dirty = true;
 
 			// Leave Function
 			return;
@@ -684,6 +825,20 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	// Unlink Rightside
 	if(user->next != NULL) user->next->prev = user->prev;
 
+	// Remove from IP Index
+	_db_user_by_ip.erase(user->resolver.ip);
+
+	// Queued Data
+	if(user->txpos > 0)
+	{
+		// Last Attempt (ie. Shutdown Message)
+		send(user->stream, (const char*)user->tx, user->txpos, MSG_NOSIGNAL);
+
+		// Remove from Send Queue
+		_db_tx_pending.erase(std::find(_db_tx_pending.begin(), _db_tx_pending.end(), user));
+	}
+	free(user->tx);
+
 	// Close Stream
 	closesocket(user->stream);
 
@@ -696,6 +851,17 @@ void logout_user(SceNetAdhocctlUserNode * user)
 		strncpy(safegamestr, user->game->game.data, PRODUCT_CODE_LENGTH);
 		INFO_LOG(SCENET, "AdhocServer: %s (MAC: %s - IP: %s) stopped playing %s", (char *)user->resolver.name.data, mac2str(&user->resolver.mac).c_str(), ip2str(*(in_addr*)&user->resolver.ip).c_str(), safegamestr);
 
+		// Remove from MAC Index
+		auto range = _db_user_by_mac.equal_range(mac_lookup_key(&user->resolver.mac));
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			if(it->second == user)
+			{
+				_db_user_by_mac.erase(it);
+				break;
+			}
+		}
+
 		// Fix Game Player Count
 		user->game->playercount--;
 
@@ -711,6 +877,9 @@ void logout_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->game->next != NULL) user->game->next->prev = user->game->prev;
 
+			// Remove from Game Index
+			_db_game_by_id.erase(game_lookup_key(&user->game->game));
+
 			// Free Game Node Memory
 			free(user->game);
 		}
@@ -730,7 +899,7 @@ void logout_user(SceNetAdhocctlUserNode * user)
 	_db_user_count--;
 
 	// Update Status Log
-	update_status();
+	_db_status_dirty = true;
 }
 
 /**
@@ -797,8 +966,8 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 		if(user->group == NULL)
 		{
 			// Find Group in Game Node
-			SceNetAdhocctlGroupNode * g = user->game->group;
-			while(g != NULL && strncmp((char *)g->group.data, (char *)group->data, ADHOCCTL_GROUPNAME_LEN) != 0) g = g->next;
+			auto existing = _db_group_by_name.find(group_lookup_key(user->game, group));
+			SceNetAdhocctlGroupNode * g = existing != _db_group_by_name.end() ? existing->second : NULL;
 
 			// BSSID Packet
 			SceNetAdhocctlConnectBSSIDPacketS2C bssid;
@@ -831,6 +1000,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 
 					// Copy Group Name
 					g->group = *group;
+					_db_group_by_name[group_lookup_key(g->game, &g->group)] = g;
 
 					// Increase Group Counter for Game
 					g->game->groupcount++;
@@ -863,8 +1033,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 					packet.ip = user->resolver.ip;
 
 					// Send Data
-					int iResult = send(peer->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-					if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: connect_user[send peer] (Socket error %d)", errno);
+					queue_user_send(peer, &packet, sizeof(packet));
 
 					// Set Player Name
 					packet.name = peer->resolver.name;
@@ -876,8 +1045,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 					packet.ip = peer->resolver.ip;
 
 					// Send Data
-					iResult = send(user->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-					if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: connect_user[send user] (Socket error %d)", errno);
+					queue_user_send(user, &packet, sizeof(packet));
 
 					// Set BSSID
 					if(peer->group_next == NULL) bssid.mac = peer->resolver.mac;
@@ -898,8 +1066,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 				g->playercount++;
 
 				// Send Network BSSID to User
-				int iResult = send(user->stream, (const char*)&bssid, sizeof(bssid), MSG_NOSIGNAL);
-				if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: connect_user[send user bssid] (Socket error %d)", errno);
+				queue_user_send(user, &bssid, sizeof(bssid));
 
 				// Notify User
 				char safegamestr[10];
@@ -911,7 +1078,7 @@ void connect_user(SceNetAdhocctlUserNode * user, SceNetAdhocctlGroupName * group
 				INFO_LOG(SCENET, "AdhocServer: %s (MAC: %s - IP: %s) joined %s group %s", (char *)user->resolver.name.data, mac2str(&user->resolver.mac).c_str(), ip2str(*(in_addr*)&user->resolver.ip).c_str(), safegamestr, safegroupstr);
 
 				// Update Status Log
-				update_status();
+				_db_status_dirty = true;
 
 				// Exit Function
 				return;
@@ -990,8 +1157,7 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 			packet.ip = user->resolver.ip;
 
 			// Send Data
-			int iResult = send(peer->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-			if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: disconnect_user[send peer] (Socket error %d)", errno);
+			queue_user_send(peer, &packet, sizeof(packet));
 
 			// Move Pointer
 			peer = peer->group_next;
@@ -1018,6 +1184,9 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 			// Unlink Rightside
 			if(user->group->next != NULL) user->group->next->prev = user->group->prev;
 
+			// Remove from Group Index
+			_db_group_by_name.erase(group_lookup_key(user->group->game, &user->group->group));
+
 			// Free Group Memory
 			free(user->group);
 
@@ -1031,7 +1200,7 @@ void disconnect_user(SceNetAdhocctlUserNode * user)
 		user->group_prev = NULL;
 
 		// Update Status Log
-		update_status();
+		_db_status_dirty = true;
 
 		// Exit Function
 		return;
@@ -1089,14 +1258,12 @@ void send_scan_results(SceNetAdhocctlUserNode * user)
 			}
 
 			// Send Group Packet
-			int iResult = send(user->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-			if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: send_scan_result[send user] (Socket error %d)", errno);
+			queue_user_send(user, &packet, sizeof(packet));
 		}
 
 		// Notify Player of End of Scan
 		uint8_t opcode = OPCODE_SCAN_COMPLETE;
-		int iResult = send(user->stream, (const char*)&opcode, 1, MSG_NOSIGNAL);
-		if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: send_scan_result[send peer complete] (Socket error %d)", errno);
+		queue_user_send(user, &opcode, 1);
 
 		// Notify User
 		char safegamestr[10];
@@ -1154,8 +1321,7 @@ void spread_message(SceNetAdhocctlUserNode *user, const char *message)
 				strcpy(packet.base.message, message);
 
 				// Send Data
-				int iResult = send(user->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-				if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: spread_message[send user chat] (Socket error %d)", errno);
+				queue_user_send(user, &packet, sizeof(packet));
 			}
 		}
 
@@ -1196,8 +1362,7 @@ void spread_message(SceNetAdhocctlUserNode *user, const char *message)
 			packet.name = user->resolver.name;
 
 			// Send Data
-			int iResult = send(peer->stream, (const char*)&packet, sizeof(packet), MSG_NOSIGNAL);
-			if (iResult < 0) ERROR_LOG(SCENET, "AdhocServer: spread_message[send peer chat] (Socket error %d)", errno);
+			queue_user_send(peer, &packet, sizeof(packet));
 
 			// Move Pointer
 			peer = peer->group_next;
@@ -1427,6 +1592,9 @@ void game_product_override(SceNetAdhocctlProductCode * product)
  */
 void update_status()
 {
+	// Logfile will be current
+	_db_status_dirty = false;
+
 	// Open Logfile
 	FILE * log = File::OpenCFile(Path(SERVER_STATUS_XMLOUT), "w");
 
@@ -1876,6 +2044,140 @@ int create_listen_socket(uint16_t port)
 	return -1;
 }
 
+/**
+ * Handle one Packet from the RX Buffer
+ * @param user User Node
+ * @return true if a Packet was handled and the User is still logged in
+ */
+static bool process_user_packet(SceNetAdhocctlUserNode * user)
+{
+	// Handlers log the User out (and free it) on invalid Requests, which is the only way the Count drops here
+	uint32_t usercount = _db_user_count;
+
+	// Remaining RX Data
+	uint32_t rxpos = user->rxpos;
+
+	// Waiting for Login Packet
+	if(get_user_state(user) == USER_STATE_WAITING)
+	{
+		// Valid Opcode
+		if(user->rx[0] == OPCODE_LOGIN)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlLoginPacketC2S))
+			{
+				// Clone Packet
+				SceNetAdhocctlLoginPacketC2S packet = *(SceNetAdhocctlLoginPacketC2S *)user->rx;
+
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlLoginPacketC2S));
+
+				// Login User (Data)
+				login_user_data(user, &packet);
+			}
+		}
+
+		// Invalid Opcode
+		else
+		{
+			// Notify User
+			WARN_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Waiting State from %s", user->rx[0], ip2str(*(in_addr*)&user->resolver.ip).c_str());
+
+			// Logout User
+			logout_user(user);
+		}
+	}
+
+	// Logged-In User
+	else if(get_user_state(user) == USER_STATE_LOGGED_IN)
+	{
+		// Ping Packet
+		if(user->rx[0] == OPCODE_PING)
+		{
+			// Delete Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+		}
+
+		// Group Connect Packet
+		else if(user->rx[0] == OPCODE_CONNECT)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlConnectPacketC2S))
+			{
+				// Cast Packet
+				SceNetAdhocctlConnectPacketC2S * packet = (SceNetAdhocctlConnectPacketC2S *)user->rx;
+
+				// Clone Group Name
+				SceNetAdhocctlGroupName group = packet->group;
+
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlConnectPacketC2S));
+
+				// Change Game Group
+				connect_user(user, &group);
+			}
+		}
+
+		// Group Disconnect Packet
+		else if(user->rx[0] == OPCODE_DISCONNECT)
+		{
+			// Remove Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+
+			// Leave Game Group
+			disconnect_user(user);
+		}
+
+		// Network Scan Packet
+		else if(user->rx[0] == OPCODE_SCAN)
+		{
+			// Remove Packet from RX Buffer
+			clear_user_rxbuf(user, 1);
+
+			// Send Network List
+			send_scan_results(user);
+		}
+
+		// Chat Text Packet
+		else if(user->rx[0] == OPCODE_CHAT)
+		{
+			// Enough Data available
+			if(user->rxpos >= sizeof(SceNetAdhocctlChatPacketC2S))
+			{
+				// Cast Packet
+				SceNetAdhocctlChatPacketC2S * packet = (SceNetAdhocctlChatPacketC2S *)user->rx;
+
+				// Clone Buffer for Message
+				char message[64];
+				memset(message, 0, sizeof(message));
+				strncpy(message, packet->message, sizeof(message) - 1);
+
+				// Remove Packet from RX Buffer
+				clear_user_rxbuf(user, sizeof(SceNetAdhocctlChatPacketC2S));
+
+				// Spread Chat Message
+				spread_message(user, message);
+			}
+		}
+
+		// Invalid Opcode
+		else
+		{
+			// Notify User
+			WARN_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Logged-In State from %s (MAC: %s - IP: %s)", user->rx[0], (char *)user->resolver.name.data, mac2str(&user->resolver.mac).c_str(), ip2str(*(in_addr*)&user->resolver.ip).c_str());
+
+			// Logout User
+			logout_user(user);
+		}
+	}
+
+	// User is gone
+	if(_db_user_count != usercount) return false;
+
+	// Nothing consumed means the Packet is incomplete
+	return user->rxpos != rxpos;
+}
+
 /**
  * Server Main Loop
  * @param server Server Listening Socket
@@ -1890,10 +2192,49 @@ int server_loop(int server)
 	// Create Empty Status Logfile
 	update_status();
 
+	// Poll Descriptors (Listener first, then one per User)
+#ifdef _WIN32
+	std::vector<WSAPOLLFD> fds;
+#else
+	std::vector<pollfd> fds;
+#endif
+	std::vector<SceNetAdhocctlUserNode *> fdusers;
+
+	// Last Timeout and Status Logfile Check
+	time_t last_check = time(NULL);
+
 	// Handling Loop
 	while (adhocServerRunning) //(_status == 1)
 	{
+		// Wait for Logins, Data or Room to send queued Data
+		fds.resize(1);
+		fds[0].fd = server;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fdusers.clear();
+		for(SceNetAdhocctlUserNode * user = _db_user; user != NULL; user = user->next)
+		{
+			fds.resize(fds.size() + 1);
+			fds.back().fd = user->stream;
+			fds.back().events = POLLIN | (user->txpos > 0 ? POLLOUT : 0);
+			fds.back().revents = 0;
+			fdusers.push_back(user);
+		}
+
+		// Wake up regularly to notice Shutdown
+#ifdef _WIN32
+		int pollresult = WSAPoll(&fds[0], (ULONG)fds.size(), 100);
+#else
+		int pollresult = poll(&fds[0], (nfds_t)fds.size(), 100);
+#endif
+		if(pollresult < 0 && errno != EINTR)
+		{
+			ERROR_LOG(SCENET, "AdhocServer: poll failed (Socket error %d)", errno);
+			sleep_ms(10);
+		}
+
 		// Login Block
+		if(pollresult > 0 && (fds[0].revents & POLLIN))
 		{
 			// Login Result
 			int loginresult = 0;
@@ -1935,157 +2276,66 @@ int server_loop(int server)
 			} while(loginresult != -1);
 		}
 
-		// Receive Data from Users
-		SceNetAdhocctlUserNode * user = _db_user;
-		while(user != NULL)
+		// Receive Data from Users with Activity (only the User being handled can be logged out here)
+		for(size_t i = 1; pollresult > 0 && i < fds.size(); i++)
 		{
-			// Next User (for safe delete)
-			SceNetAdhocctlUserNode * next = user->next;
+			// Nothing to read (or only writable again, which the Flush below handles)
+			if((fds[i].revents & (POLLIN | POLLERR | POLLHUP)) == 0) continue;
+
+			// User Node
+			SceNetAdhocctlUserNode * user = fdusers[i - 1];
 
 			// Receive Data from User
 			int recvresult = recv(user->stream, (char*)user->rx + user->rxpos, sizeof(user->rx) - user->rxpos, MSG_NOSIGNAL);
 
-			// Connection Closed or Timed Out
-			if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK) || get_user_state(user) == USER_STATE_TIMED_OUT)
+			// Connection Closed
+			if(recvresult == 0 || (recvresult == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
 			{
 				// Logout User
 				logout_user(user);
+				continue;
 			}
 
-			// Received Data (or leftovers in RX-Buffer)
-			else if(recvresult > 0 || user->rxpos > 0)
+			// New Incoming Data
+			if(recvresult > 0)
 			{
-				// New Incoming Data
-				if(recvresult > 0)
-				{
-					// Move RX Pointer
-					user->rxpos += recvresult;
-
-					// Update Death Clock
-					user->last_recv = time(NULL);
-				}
-
-				// Waiting for Login Packet
-				if(get_user_state(user) == USER_STATE_WAITING)
-				{
-					// Valid Opcode
-					if(user->rx[0] == OPCODE_LOGIN)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlLoginPacketC2S))
-						{
-							// Clone Packet
-							SceNetAdhocctlLoginPacketC2S packet = *(SceNetAdhocctlLoginPacketC2S *)user->rx;
-
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlLoginPacketC2S));
-
-							// Login User (Data)
-							login_user_data(user, &packet);
-						}
-					}
-
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						WARN_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Waiting State from %s", user->rx[0], ip2str(*(in_addr*)&user->resolver.ip).c_str());
-
-						// Logout User
-						logout_user(user);
-					}
-				}
-
-				// Logged-In User
-				else if(get_user_state(user) == USER_STATE_LOGGED_IN)
-				{
-					// Ping Packet
-					if(user->rx[0] == OPCODE_PING)
-					{
-						// Delete Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-					}
-
-					// Group Connect Packet
-					else if(user->rx[0] == OPCODE_CONNECT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlConnectPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlConnectPacketC2S * packet = (SceNetAdhocctlConnectPacketC2S *)user->rx;
-
-							// Clone Group Name
-							SceNetAdhocctlGroupName group = packet->group;
-
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlConnectPacketC2S));
-
-							// Change Game Group
-							connect_user(user, &group);
-						}
-					}
-
-					// Group Disconnect Packet
-					else if(user->rx[0] == OPCODE_DISCONNECT)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
-
-						// Leave Game Group
-						disconnect_user(user);
-					}
-
-					// Network Scan Packet
-					else if(user->rx[0] == OPCODE_SCAN)
-					{
-						// Remove Packet from RX Buffer
-						clear_user_rxbuf(user, 1);
+				// Move RX Pointer
+				user->rxpos += recvresult;
 
-						// Send Network List
-						send_scan_results(user);
-					}
-
-					// Chat Text Packet
-					else if(user->rx[0] == OPCODE_CHAT)
-					{
-						// Enough Data available
-						if(user->rxpos >= sizeof(SceNetAdhocctlChatPacketC2S))
-						{
-							// Cast Packet
-							SceNetAdhocctlChatPacketC2S * packet = (SceNetAdhocctlChatPacketC2S *)user->rx;
+				// Update Death Clock
+				user->last_recv = time(NULL);
+			}
 
-							// Clone Buffer for Message
-							char message[64];
-							memset(message, 0, sizeof(message));
-							strncpy(message, packet->message, sizeof(message) - 1);
+			// Handle every complete Packet
+			while(user->rxpos > 0 && process_user_packet(user));
+		}
 
-							// Remove Packet from RX Buffer
-							clear_user_rxbuf(user, sizeof(SceNetAdhocctlChatPacketC2S));
+		// Timeouts and Status Logfile (once a second is plenty)
+		time_t now = time(NULL);
+		if(now != last_check)
+		{
+			last_check = now;
 
-							// Spread Chat Message
-							spread_message(user, message);
-						}
-					}
+			// Drop Users that stopped talking
+			SceNetAdhocctlUserNode * user = _db_user;
+			while(user != NULL)
+			{
+				// Next User (for safe delete)
+				SceNetAdhocctlUserNode * next = user->next;
 
-					// Invalid Opcode
-					else
-					{
-						// Notify User
-						WARN_LOG(SCENET, "AdhocServer: Invalid Opcode 0x%02X in Logged-In State from %s (MAC: %s - IP: %s)", user->rx[0], (char *)user->resolver.name.data, mac2str(&user->resolver.mac).c_str(), ip2str(*(in_addr*)&user->resolver.ip).c_str());
+				// Logout User
+				if(get_user_state(user) == USER_STATE_TIMED_OUT) logout_user(user);
 
-						// Logout User
-						logout_user(user);
-					}
-				}
+				// Move Pointer
+				user = next;
 			}
 
-			// Move Pointer
-			user = next;
+			// Update Status Log
+			if(_db_status_dirty) update_status();
 		}
 
-		// Prevent needless CPU Overload (1ms Sleep)
-		sleep_ms(10);
+		// Send everything the Handlers queued up
+		flush_user_sends();
 
 		// Don't do anything if it's paused, otherwise the log will be flooded
 		while (adhocServerRunning && Core_IsStepping() && coreState != CORE_POWERDOWN) sleep_ms(10);
@@ -39,6 +39,9 @@
 // Server User Timeout (in seconds)
 #define SERVER_USER_TIMEOUT 15
 
+// Server User Send Queue Limit (in bytes)
+#define SERVER_USER_TX_MAXIMUM (256 * 1024)
+
 // Server SQLite3 Database
 #define SERVER_DATABASE "database.db"
 
@@ -220,6 +223,11 @@ typedef struct SceNetAdhocctlUserNode {
 	// RX Buffer
 	uint8_t rx[1024];
 	uint32_t rxpos;
+
+	// TX Buffer (packets are queued and sent once per server loop iteration)
+	uint8_t * tx;
+	uint32_t txpos;
+	uint32_t txsize;
 } SceNetAdhocctlUserNode;
 
 // Double-Linked Game List
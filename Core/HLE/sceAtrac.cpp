@@ -16,9 +16,13 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
 
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
+#include "Common/Thread/ThreadManager.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/FunctionWrappers.h"
 #include "Core/MIPS/MIPS.h"
@@ -70,6 +74,17 @@
 // Note that this buffer is THE view of the audio stream.  On a PSP, the firmware does not manage
 // any cache or separate version of the buffer - at most it manages decode state from earlier in
 // the buffer.
+//
+// Notes about decode-ahead
+//
+// When all the data is loaded, the upcoming packets are known, so they are decoded ahead of time
+// on a worker thread.  The worker has its own codec context, which is primed exactly the way
+// SeekToSample primes the main one, and is then fed the same sequence of packets.  Therefore it
+// produces the same PCM the main context would, and sceAtracDecodeData just copies it out.
+//
+// Each decoded frame keeps a copy of its packet, which is compared with the buffer when taken.  On
+// any mismatch (different position, changed data, a bad frame, other output mode) the worker is
+// stopped and the main context is re-primed at the current position and used as before.
 
 #define ATRAC_ERROR_API_FAIL                 0x80630002
 #define ATRAC_ERROR_NO_ATRACID               0x80630003
@@ -175,6 +190,108 @@ struct AVPacket {
 };
 #endif
 
+#ifdef USE_FFMPEG
+struct AtracAheadParams {
+	u32 codecType;
+	u16 channels;
+	int jointStereo;
+	u16 bytesPerFrame;
+	u16 outputChannels;
+	// Size of all the data, which is fully loaded while decoding ahead.
+	u32 dataSize;
+	// Copies of the packets decoded only to prime the context, like SeekToSample does.
+	std::vector<std::vector<u8>> prime;
+	// Offset of the first packet sceAtracDecodeData will want.
+	u32 firstOffset;
+};
+
+struct AtracAheadFrame {
+	u32 offset = 0;
+	std::vector<u8> packet;
+	AtracDecodeResult result = ATDECODE_FAILED;
+	int numSamples = 0;
+	int outputChannels = 0;
+	// Interleaved output for the whole frame, as swr_convert would produce it.
+	std::vector<s16> pcm;
+};
+
+enum class AtracAheadTake {
+	GOT,
+	// Not decoded yet, the caller should decode this one itself and try again next time.
+	NOT_READY,
+	FAILED,
+};
+
+class AtracDecodeAhead : public std::enable_shared_from_this<AtracDecodeAhead> {
+public:
+	~AtracDecodeAhead() {
+		ReleaseFFMPEGContext();
+	}
+
+	// Packets are copied from data on the calling thread, the worker never reads it.
+	bool Init(AtracAheadParams &&params, const u8 *data);
+	// Cancels without waiting.  The worker owns its context and is done after its current packet.
+	void Stop();
+	// Never waits.  Frames before offset are dropped, since the caller decoded those itself.
+	// Queues more packets from data, which must be the same buffer as passed to Init.
+	AtracAheadTake Take(u32 offset, const u8 *data, AtracAheadFrame *frame);
+
+	void Run();
+	// The queued task was dropped without running, like at thread manager teardown.
+	void TaskCancelled();
+
+	// Frames to keep decoded ahead of the game.
+	static const size_t DEPTH = 4;
+
+private:
+	void FeedLocked(const u8 *data);
+	void KickLocked();
+	AtracDecodeResult DecodePacket(const u8 *data, int size);
+	void ReleaseFFMPEGContext();
+
+	AtracAheadParams params_{};
+	AVCodecContext *codecCtx_ = nullptr;
+	SwrContext *swrCtx_ = nullptr;
+	AVFrame *frame_ = nullptr;
+	AVPacket *packet_ = nullptr;
+
+	std::mutex lock_;
+	// Packets copied by the game's thread, waiting for the worker.
+	std::deque<AtracAheadFrame> pending_;
+	std::deque<AtracAheadFrame> frames_;
+	size_t decoding_ = 0;
+	u32 nextOffset_ = 0;
+	bool primed_ = false;
+	bool running_ = false;
+	bool finished_ = false;
+	bool cancelled_ = false;
+};
+
+class AtracDecodeAheadTask : public Task {
+public:
+	AtracDecodeAheadTask(std::shared_ptr<AtracDecodeAhead> ahead) : ahead_(ahead) {}
+
+	TaskType Type() const override {
+		return TaskType::CPU_COMPUTE;
+	}
+
+	void Run() override {
+		ahead_->Run();
+	}
+
+	bool Cancellable() override {
+		return true;
+	}
+
+	void Cancel() override {
+		ahead_->TaskCancelled();
+	}
+
+private:
+	std::shared_ptr<AtracDecodeAhead> ahead_;
+};
+#endif // USE_FFMPEG
+
 struct Atrac {
 	Atrac() : atracID_(-1), dataBuf_(0), decodePos_(0), bufferPos_(0),
 		channels_(0), outputChannels_(2), bitrate_(64), bytesPerFrame_(0), bufferMaxSize_(0), jointStereo_(0),
@@ -199,8 +316,11 @@ struct Atrac {
 
 	void ResetData() {
 #ifdef USE_FFMPEG
+		StopDecodeAhead();
+		aheadHistory_.clear();
 		ReleaseFFMPEGContext();
 #endif // USE_FFMPEG
+		codecStale_ = false;
 
 		if (dataBuf_)
 			delete [] dataBuf_;
@@ -240,6 +360,14 @@ struct Atrac {
 		if (!s)
 			return;
 
+		if (p.mode == p.MODE_READ) {
+#ifdef USE_FFMPEG
+			StopDecodeAhead();
+			aheadHistory_.clear();
+#endif // USE_FFMPEG
+			codecStale_ = false;
+		}
+
 		Do(p, channels_);
 		Do(p, outputChannels_);
 		if (s >= 5) {
@@ -429,6 +557,8 @@ struct Atrac {
 	bool failedDecode_;
 	// Indicates that the dataBuf_ array should not be used.
 	bool ignoreDataBuf_;
+	// The main codec context skipped packets decoded ahead, and needs priming before use.
+	bool codecStale_ = false;
 
 	u32 codecType_;
 	AtracStatus bufferState_;
@@ -443,9 +573,73 @@ struct Atrac {
 	SwrContext      *swrCtx_ = nullptr;
 	AVFrame         *frame_ = nullptr;
 	AVPacket        *packet_ = nullptr;
+
+	std::shared_ptr<AtracDecodeAhead> decodeAhead_;
+	// The last packets consumed while decoding ahead, starting with the prime.  Replaying these
+	// warms our context up the same way seeking does, see SeekToSample's backfill.
+	std::deque<std::vector<u8>> aheadHistory_;
+	static const size_t AHEAD_HISTORY_PACKETS = 2;
 #endif // USE_FFMPEG
 
 #ifdef USE_FFMPEG
+	void RecordAheadPacket(std::vector<u8> &&packet) {
+		aheadHistory_.push_back(std::move(packet));
+		while (aheadHistory_.size() > AHEAD_HISTORY_PACKETS)
+			aheadHistory_.pop_front();
+	}
+
+	void StopDecodeAhead() {
+		if (decodeAhead_) {
+			decodeAhead_->Stop();
+			decodeAhead_.reset();
+		}
+	}
+
+	bool CanDecodeAhead() const {
+		// Only when the packets can't change under us (other than by the game writing to them.)
+		if (bufferState_ != ATRAC_STATUS_ALL_DATA_LOADED || failedDecode_ || codecCtx_ == nullptr)
+			return false;
+		if (codecType_ != PSP_MODE_AT_3 && codecType_ != PSP_MODE_AT_3_PLUS)
+			return false;
+		return g_threadManager.IsInitialized();
+	}
+
+	bool StartDecodeAhead(int sample, u32 primeStart, u32 primeEnd) {
+		// Same as the first packet _AtracDecodeData will read after seeking to sample.
+		const u32 offsetSamples = firstSampleOffset_ + FirstOffsetExtra();
+		const int unalignedSamples = (int)((offsetSamples + sample) % SamplesPerFrame());
+
+		AtracAheadParams params;
+		params.codecType = codecType_;
+		params.channels = channels_;
+		params.jointStereo = jointStereo_;
+		params.bytesPerFrame = bytesPerFrame_;
+		params.outputChannels = outputChannels_;
+		params.dataSize = first_.size;
+		params.firstOffset = FileOffsetBySample(sample - unalignedSamples);
+
+		const u8 *data = BufferStart();
+		if (!data) {
+			return false;
+		}
+		for (u32 pos = primeStart; pos < primeEnd; pos += bytesPerFrame_) {
+			params.prime.emplace_back(data + pos, data + pos + bytesPerFrame_);
+		}
+
+		// Our context would have decoded exactly these, if it had been primed.
+		aheadHistory_.clear();
+		for (const std::vector<u8> &packet : params.prime)
+			RecordAheadPacket(std::vector<u8>(packet));
+
+		auto ahead = std::make_shared<AtracDecodeAhead>();
+		if (!ahead->Init(std::move(params), data)) {
+			aheadHistory_.clear();
+			return false;
+		}
+		decodeAhead_ = ahead;
+		return true;
+	}
+
 	void ReleaseFFMPEGContext() {
 		// All of these allow null pointers.
 		av_freep(&frame_);
@@ -474,7 +668,10 @@ struct Atrac {
 
 	void ForceSeekToSample(int sample) {
 #ifdef USE_FFMPEG
+		StopDecodeAhead();
 		avcodec_flush_buffers(codecCtx_);
+		codecStale_ = false;
+		aheadHistory_.clear();
 
 		// Discard any pending packet data.
 		packet_->size = 0;
@@ -492,14 +689,8 @@ struct Atrac {
 		// Discard any pending packet data.
 		packet_->size = 0;
 
-		// It seems like the PSP aligns the sample position to 0x800...?
-		const u32 offsetSamples = firstSampleOffset_ + FirstOffsetExtra();
-		const u32 unalignedSamples = (offsetSamples + sample) % SamplesPerFrame();
-		int seekFrame = sample + offsetSamples - unalignedSamples;
-
 		if ((sample != currentSample_ || sample == 0) && codecCtx_ != nullptr) {
-			// Prefill the decode buffer with packets before the first sample offset.
-			avcodec_flush_buffers(codecCtx_);
+			StopDecodeAhead();
 
 			int adjust = 0;
 			if (sample == 0) {
@@ -509,21 +700,57 @@ struct Atrac {
 			const u32 off = FileOffsetBySample(sample + adjust);
 			const u32 backfill = bytesPerFrame_ * 2;
 			const u32 start = off - dataOff_ < backfill ? dataOff_ : off - backfill;
-			for (u32 pos = start; pos < off; pos += bytesPerFrame_) {
-				av_init_packet(packet_);
-				packet_->data = BufferStart() + pos;
-				packet_->size = bytesPerFrame_;
-				packet_->pos = pos;
-
-				// Process the packet, we don't care about success.
-				DecodePacket();
+			if (CanDecodeAhead() && StartDecodeAhead(sample, start, off)) {
+				// The worker primes its own context, ours is only needed again if it stops.
+				codecStale_ = true;
+			} else {
+				PrimeCodec(start, off);
 			}
+		} else if (codecStale_ && !decodeAhead_) {
+			ResyncCodec();
 		}
 #endif // USE_FFMPEG
 
 		currentSample_ = sample;
 	}
 
+#ifdef USE_FFMPEG
+	void PrimeCodec(u32 start, u32 off) {
+		// Prefill the decode buffer with packets before the first sample offset.
+		avcodec_flush_buffers(codecCtx_);
+		codecStale_ = false;
+		aheadHistory_.clear();
+
+		for (u32 pos = start; pos < off; pos += bytesPerFrame_) {
+			av_init_packet(packet_);
+			packet_->data = BufferStart() + pos;
+			packet_->size = bytesPerFrame_;
+			packet_->pos = pos;
+
+			// Process the packet, we don't care about success.
+			DecodePacket();
+		}
+	}
+
+	// Before our context decodes again after frames came from decode-ahead, it needs to catch up.
+	// Like a seek, a flush and the last couple of packets are enough to warm it up.
+	void ResyncCodec() {
+		avcodec_flush_buffers(codecCtx_);
+		codecStale_ = false;
+
+		for (std::vector<u8> &packet : aheadHistory_) {
+			av_init_packet(packet_);
+			packet_->data = packet.data();
+			packet_->size = (int)packet.size();
+			packet_->pos = 0;
+
+			// Same as PrimeCodec, we don't care about success.
+			DecodePacket();
+		}
+		packet_->size = 0;
+	}
+#endif // USE_FFMPEG
+
 	uint32_t CurBufferAddress(int adjust = 0) {
 		u32 off = FileOffsetBySample(currentSample_ + adjust);
 		if (off < first_.size && ignoreDataBuf_) {
@@ -1182,6 +1409,58 @@ static u32 sceAtracAddStreamData(int atracID, u32 bytesToAdd) {
 	return hleLogSuccessI(ME, 0);
 }
 
+#ifdef USE_FFMPEG
+// Copies out the next frame if it was decoded ahead, following the same rules as the regular path.
+static AtracAheadTake AtracTakeDecodedAhead(Atrac *atrac, u8 *outbuf, u32 outbufPtr, int skipSamples, u32 maxSamples, u32 *numSamplesOut) {
+	const u32 off = atrac->FileOffsetBySample(atrac->currentSample_ - skipSamples);
+	if (off >= atrac->first_.size) {
+		return AtracAheadTake::FAILED;
+	}
+
+	AtracAheadFrame frame;
+	AtracAheadTake take = atrac->decodeAhead_->Take(off, atrac->BufferStart(), &frame);
+	if (take != AtracAheadTake::GOT) {
+		return take;
+	}
+	if (frame.outputChannels != atrac->outputChannels_) {
+		return AtracAheadTake::FAILED;
+	}
+	// The game might have changed the data since it was decoded.
+	const u32 packetSize = std::min((u32)atrac->bytesPerFrame_, atrac->first_.size - off);
+	if (frame.packet.size() != packetSize || memcmp(frame.packet.data(), atrac->BufferStart() + off, packetSize) != 0) {
+		return AtracAheadTake::FAILED;
+	}
+
+	int skipped = std::min(skipSamples, frame.numSamples);
+	u32 numSamples = std::min(maxSamples, (u32)(frame.numSamples - skipped));
+	if (skipped > 0 && numSamples == 0) {
+		// The regular path waits for another frame here.
+		return AtracAheadTake::FAILED;
+	}
+	atrac->RecordAheadPacket(std::move(frame.packet));
+	// Our context didn't see this packet.
+	atrac->codecStale_ = true;
+
+	if (outbuf != nullptr && numSamples != 0) {
+		const u32 outBytes = numSamples * atrac->outputChannels_ * sizeof(s16);
+		memcpy(outbuf, frame.pcm.data() + skipped * atrac->outputChannels_, outBytes);
+		if (outbufPtr != 0) {
+			uint32_t packetAddr = atrac->CurBufferAddress(-skipSamples);
+			if (packetAddr != 0 && MemBlockInfoDetailed()) {
+				const std::string tag = GetMemWriteTagAt("AtracDecode/", packetAddr, packetSize);
+				NotifyMemInfo(MemBlockFlags::READ, packetAddr, packetSize, tag.c_str(), tag.size());
+				NotifyMemInfo(MemBlockFlags::WRITE, outbufPtr, outBytes, tag.c_str(), tag.size());
+			} else {
+				NotifyMemInfo(MemBlockFlags::WRITE, outbufPtr, outBytes, "AtracDecode");
+			}
+		}
+	}
+
+	*numSamplesOut = numSamples;
+	return AtracAheadTake::GOT;
+}
+#endif // USE_FFMPEG
+
 u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u32 *finish, int *remains) {
 	Atrac *atrac = getAtrac(atracID);
 
@@ -1227,10 +1506,27 @@ u32 _AtracDecodeData(int atracID, u8 *outbuf, u32 outbufPtr, u32 *SamplesNum, u3
 				atrac->SeekToSample(atrac->currentSample_);
 
 				AtracDecodeResult res = ATDECODE_FEEDME;
-				while (atrac->FillPacket(-skipSamples)) {
+#ifdef USE_FFMPEG
+				if (atrac->decodeAhead_) {
+					AtracAheadTake take = AtracTakeDecodedAhead(atrac, outbuf, outbufPtr, skipSamples, maxSamples, &numSamples);
+					if (take == AtracAheadTake::GOT) {
+						res = ATDECODE_GOTFRAME;
+					} else if (take == AtracAheadTake::FAILED) {
+						atrac->StopDecodeAhead();
+					}
+					if (res != ATDECODE_GOTFRAME && atrac->codecStale_) {
+						atrac->ResyncCodec();
+					}
+				}
+#endif // USE_FFMPEG
+				while (res != ATDECODE_GOTFRAME && atrac->FillPacket(-skipSamples)) {
 					uint32_t packetAddr = atrac->CurBufferAddress(-skipSamples);
 #ifdef USE_FFMPEG
 					int packetSize = atrac->packet_->size;
+					if (atrac->decodeAhead_) {
+						// Decode-ahead is just behind, it may still be ahead next time.
+						atrac->RecordAheadPacket(std::vector<u8>(atrac->packet_->data, atrac->packet_->data + packetSize));
+					}
 #endif // USE_FFMPEG
 					res = atrac->DecodePacket();
 					if (res == ATDECODE_FAILED) {
@@ -1807,6 +2103,227 @@ static u32 sceAtracResetPlayPosition(int atracID, int sample, int bytesWrittenFi
 }
 
 #ifdef USE_FFMPEG
+bool AtracDecodeAhead::Init(AtracAheadParams &&params, const u8 *data) {
+	params_ = std::move(params);
+	nextOffset_ = params_.firstOffset;
+
+	const AVCodec *codec = avcodec_find_decoder(params_.codecType == PSP_MODE_AT_3 ? AV_CODEC_ID_ATRAC3 : AV_CODEC_ID_ATRAC3P);
+	codecCtx_ = avcodec_alloc_context3(codec);
+	if (!codecCtx_) {
+		return false;
+	}
+
+	// Must match __AtracSetContext.
+	if (params_.codecType == PSP_MODE_AT_3) {
+		codecCtx_->extradata = (uint8_t *)av_mallocz(14);
+		codecCtx_->extradata_size = 14;
+		codecCtx_->extradata[0] = 1;
+		codecCtx_->extradata[3] = params_.channels << 3;
+		codecCtx_->extradata[6] = params_.jointStereo;
+		codecCtx_->extradata[8] = params_.jointStereo;
+		codecCtx_->extradata[10] = 1;
+	}
+	codecCtx_->channels = params_.channels;
+	codecCtx_->channel_layout = params_.channels == 1 ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
+	codecCtx_->block_align = params_.bytesPerFrame;
+	codecCtx_->sample_rate = 44100;
+	codecCtx_->request_sample_fmt = AV_SAMPLE_FMT_S16;
+	if (avcodec_open2(codecCtx_, codec, nullptr) < 0) {
+		return false;
+	}
+
+	swrCtx_ = swr_alloc_set_opts(nullptr,
+		av_get_default_channel_layout(params_.outputChannels), AV_SAMPLE_FMT_S16, codecCtx_->sample_rate,
+		av_get_default_channel_layout(params_.channels), codecCtx_->sample_fmt, codecCtx_->sample_rate,
+		0, nullptr);
+	if (!swrCtx_ || swr_init(swrCtx_) < 0) {
+		return false;
+	}
+
+	frame_ = av_frame_alloc();
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 12, 100)
+	packet_ = av_packet_alloc();
+#else
+	packet_ = new AVPacket;
+	av_init_packet(packet_);
+	packet_->data = nullptr;
+	packet_->size = 0;
+#endif
+
+	std::lock_guard<std::mutex> guard(lock_);
+	FeedLocked(data);
+	KickLocked();
+	return true;
+}
+
+void AtracDecodeAhead::ReleaseFFMPEGContext() {
+	av_freep(&frame_);
+	swr_free(&swrCtx_);
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(55, 52, 0)
+	avcodec_free_context(&codecCtx_);
+#else
+	avcodec_close(codecCtx_);
+	av_freep(&codecCtx_);
+#endif
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 12, 100)
+	av_packet_free(&packet_);
+#else
+	if (packet_)
+		av_free_packet(packet_);
+	delete packet_;
+	packet_ = nullptr;
+#endif
+}
+
+void AtracDecodeAhead::FeedLocked(const u8 *data) {
+	// Copying here means the game can't change a packet while it's being decoded.
+	while (!finished_ && nextOffset_ < params_.dataSize && pending_.size() + decoding_ + frames_.size() < DEPTH) {
+		AtracAheadFrame frame;
+		frame.offset = nextOffset_;
+		frame.outputChannels = params_.outputChannels;
+		u32 packetSize = std::min((u32)params_.bytesPerFrame, params_.dataSize - nextOffset_);
+		frame.packet.assign(data + nextOffset_, data + nextOffset_ + packetSize);
+		pending_.push_back(std::move(frame));
+		nextOffset_ += params_.bytesPerFrame;
+	}
+}
+
+void AtracDecodeAhead::KickLocked() {
+	if (running_ || finished_ || cancelled_ || (primed_ && pending_.empty()))
+		return;
+	running_ = true;
+	g_threadManager.EnqueueTask(new AtracDecodeAheadTask(shared_from_this()));
+}
+
+void AtracDecodeAhead::Stop() {
+	std::lock_guard<std::mutex> guard(lock_);
+	cancelled_ = true;
+	pending_.clear();
+	frames_.clear();
+}
+
+void AtracDecodeAhead::TaskCancelled() {
+	std::lock_guard<std::mutex> guard(lock_);
+	running_ = false;
+	finished_ = true;
+	pending_.clear();
+}
+
+AtracAheadTake AtracDecodeAhead::Take(u32 offset, const u8 *data, AtracAheadFrame *frame) {
+	std::lock_guard<std::mutex> guard(lock_);
+	while (!frames_.empty() && frames_.front().offset < offset)
+		frames_.pop_front();
+	FeedLocked(data);
+	KickLocked();
+
+	if (frames_.empty()) {
+		if (cancelled_ || (finished_ && decoding_ == 0) || (pending_.empty() && decoding_ == 0))
+			return AtracAheadTake::FAILED;
+		return AtracAheadTake::NOT_READY;
+	}
+	if (frames_.front().offset != offset)
+		return AtracAheadTake::FAILED;
+	*frame = std::move(frames_.front());
+	frames_.pop_front();
+	FeedLocked(data);
+	KickLocked();
+	return frame->result == ATDECODE_GOTFRAME ? AtracAheadTake::GOT : AtracAheadTake::FAILED;
+}
+
+// Mirrors Atrac::DecodePacket.
+AtracDecodeResult AtracDecodeAhead::DecodePacket(const u8 *data, int size) {
+	av_init_packet(packet_);
+	packet_->data = (uint8_t *)data;
+	packet_->size = size;
+	packet_->pos = 0;
+
+	int got_frame = 0;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 48, 101)
+	int err = avcodec_send_packet(codecCtx_, packet_);
+	if (err < 0) {
+		return ATDECODE_FAILED;
+	}
+
+	err = avcodec_receive_frame(codecCtx_, frame_);
+	int bytes_read = 0;
+	if (err >= 0) {
+		bytes_read = frame_->pkt_size;
+		got_frame = 1;
+	} else if (err != AVERROR(EAGAIN)) {
+		bytes_read = err;
+	}
+#else
+	int bytes_read = avcodec_decode_audio4(codecCtx_, frame_, &got_frame, packet_);
+#endif
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 12, 100)
+	av_packet_unref(packet_);
+#else
+	av_free_packet(packet_);
+#endif
+	if (bytes_read == AVERROR_PATCHWELCOME) {
+		return ATDECODE_BADFRAME;
+	} else if (bytes_read < 0) {
+		return ATDECODE_FAILED;
+	}
+	return got_frame ? ATDECODE_GOTFRAME : ATDECODE_FEEDME;
+}
+
+void AtracDecodeAhead::Run() {
+	while (true) {
+		AtracAheadFrame frame;
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			if (cancelled_ || finished_ || (primed_ && pending_.empty())) {
+				running_ = false;
+				return;
+			}
+			if (primed_) {
+				frame = std::move(pending_.front());
+				pending_.pop_front();
+				decoding_++;
+			}
+		}
+
+		if (!primed_) {
+			// Same as Atrac::PrimeCodec on a fresh context.
+			avcodec_flush_buffers(codecCtx_);
+			bool failed = false;
+			for (const std::vector<u8> &packet : params_.prime) {
+				if (DecodePacket(packet.data(), (int)packet.size()) == ATDECODE_FAILED) {
+					// The main context would set failedDecode_ here, let it do that.
+					failed = true;
+					break;
+				}
+			}
+			primed_ = true;
+			if (failed) {
+				std::lock_guard<std::mutex> guard(lock_);
+				finished_ = true;
+			}
+			continue;
+		}
+
+		frame.result = DecodePacket(frame.packet.data(), (int)frame.packet.size());
+		if (frame.result == ATDECODE_GOTFRAME) {
+			frame.numSamples = frame_->nb_samples;
+			frame.pcm.resize(frame.numSamples * params_.outputChannels);
+			u8 *out = (u8 *)frame.pcm.data();
+			if (swr_convert(swrCtx_, &out, frame.numSamples, (const u8 **)frame_->extended_data, frame.numSamples) < 0) {
+				frame.result = ATDECODE_FAILED;
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(lock_);
+		// Anything unusual is left to the regular path.
+		if (frame.result != ATDECODE_GOTFRAME || frame.offset + params_.bytesPerFrame >= params_.dataSize) {
+			finished_ = true;
+			pending_.clear();
+		}
+		decoding_--;
+		frames_.push_back(std::move(frame));
+	}
+}
+
 static int __AtracUpdateOutputMode(Atrac *atrac, int wanted_channels) {
 	if (atrac->swrCtx_ && atrac->outputChannels_ == wanted_channels)
 		return 0;
@@ -391,6 +391,7 @@ void __MpegInit() {
 	mpegLibVersion = 0x010A;
 	streamIdGen = 1;
 	actionPostPut = __KernelRegisterActionType(PostPutAction::Create);
+	__MediaEngineResetDebugStats();
 
 #ifdef USE_FFMPEG
 #if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 18, 100)
@@ -15,7 +15,10 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "ppsspp_config.h"
 #include "Common/Serialize/SerializeFuncs.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/TimeUtil.h"
 #include "Core/Config.h"
 #include "Core/Debugger/MemBlockInfo.h"
 #include "Core/HW/MediaEngine.h"
@@ -29,6 +32,18 @@
 
 #include <algorithm>
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+
+#if PPSSPP_ARCH(ARM_NEON)
+#if defined(_MSC_VER) && PPSSPP_ARCH(ARM64)
+#include <arm64_neon.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
 #ifdef USE_FFMPEG
 
 extern "C" {
@@ -41,6 +56,35 @@ extern "C" {
 }
 #endif // USE_FFMPEG
 
+// Totals across all contexts, for the debug overlay.  Only touched under statsLock.
+static std::mutex statsLock;
+static int statsFramesDecoded;
+static int statsFramesConverted;
+static double statsDecodeTime;
+static double statsConvertTime;
+
+void __MediaEngineResetDebugStats() {
+	std::lock_guard<std::mutex> guard(statsLock);
+	statsFramesDecoded = 0;
+	statsFramesConverted = 0;
+	statsDecodeTime = 0.0;
+	statsConvertTime = 0.0;
+}
+
+void __MediaEngineGetDebugStats(char *stats, size_t bufsize) {
+	std::lock_guard<std::mutex> guard(statsLock);
+	if (statsFramesDecoded == 0) {
+		snprintf(stats, bufsize, "Video: no frames decoded\n");
+		return;
+	}
+	snprintf(stats, bufsize,
+		"Video: %d frames decoded, %0.3f ms avg\n"
+		"Video: %d frames converted, %0.3f ms avg%s\n",
+		statsFramesDecoded, statsDecodeTime * 1000.0 / statsFramesDecoded,
+		statsFramesConverted, statsFramesConverted > 0 ? statsConvertTime * 1000.0 / statsFramesConverted : 0.0,
+		g_threadManager.IsInitialized() ? " (on workers)" : "");
+}
+
 #ifdef USE_FFMPEG
 static AVPixelFormat getSwsFormat(int pspFormat)
 {
@@ -362,6 +406,16 @@ bool MediaEngine::openContext(bool keepReadPos) {
 void MediaEngine::closeContext()
 {
 #ifdef USE_FFMPEG
+	waitForConversion();
+	if (m_framesDecoded > 0) {
+		DEBUG_LOG(ME, "Video: %d frames decoded (%0.3f ms avg), %d converted (%0.3f ms avg)",
+			m_framesDecoded, m_decodeTime * 1000.0 / m_framesDecoded,
+			m_framesConverted, m_framesConverted > 0 ? m_convertTime * 1000.0 / m_framesConverted : 0.0);
+	}
+	m_framesDecoded = 0;
+	m_framesConverted = 0;
+	m_decodeTime = 0.0;
+	m_convertTime = 0.0;
 	if (m_buffer)
 		av_free(m_buffer);
 	if (m_pFrameRGB)
@@ -563,6 +617,7 @@ bool MediaEngine::setVideoStream(int streamNum, bool force) {
 bool MediaEngine::setVideoDim(int width, int height)
 {
 #ifdef USE_FFMPEG
+	waitForConversion();
 	auto codecIter = m_pCodecCtxs.find(m_videoStream);
 	if (codecIter == m_pCodecCtxs.end())
 		return false;
@@ -664,6 +719,10 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 	if (!m_pFrame)
 		return false;
 
+	// The previous frame may still be converting from m_pFrame.
+	waitForConversion();
+	double startTime = time_now_d();
+
 	AVPacket packet;
 	av_init_packet(&packet);
 	int frameFinished;
@@ -708,8 +767,7 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 					// Update the linesize for the new format too.  We started with the largest size, so it should fit.
 					m_pFrameRGB->linesize[0] = getPixelFormatBytes(videoPixelMode) * m_desWidth;
 
-					sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
-						m_pCodecCtx->height, m_pFrameRGB->data, m_pFrameRGB->linesize);
+					startConversion(m_pCodecCtx->height);
 				}
 
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(55, 58, 100)
@@ -751,6 +809,17 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 		av_free_packet(&packet);
 #endif
 	}
+	// Note: this is time on the calling thread, so it only includes conversion if there were no workers.
+	double elapsed = time_now_d() - startTime;
+	if (bGetFrame)
+		m_framesDecoded++;
+	m_decodeTime += elapsed;
+	{
+		std::lock_guard<std::mutex> guard(statsLock);
+		if (bGetFrame)
+			statsFramesDecoded++;
+		statsDecodeTime += elapsed;
+	}
 	return bGetFrame;
 #else
 	// If video engine is not available, just add to the timestamp at least.
@@ -759,15 +828,91 @@ bool MediaEngine::stepVideo(int videoPixelMode, bool skipFrame) {
 #endif // USE_FFMPEG
 }
 
+#ifdef USE_FFMPEG
+class MediaConvertTask : public Task {
+public:
+	MediaConvertTask(MediaEngine *engine, int height) : engine_(engine), height_(height) {}
+
+	TaskType Type() const override {
+		return TaskType::CPU_COMPUTE;
+	}
+
+	void Run() override {
+		engine_->convertFrame(height_);
+	}
+
+private:
+	MediaEngine *engine_;
+	int height_;
+};
+#endif
+
+// The conversion overlaps with emulation until someone needs the pixels (usually soon after.)
+void MediaEngine::startConversion(int height) {
+#ifdef USE_FFMPEG
+	if (!g_threadManager.IsInitialized()) {
+		convertFrame(height);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(m_convertLock);
+		m_convertPending = true;
+	}
+	g_threadManager.EnqueueTask(new MediaConvertTask(this, height));
+#endif
+}
+
+void MediaEngine::convertFrame(int height) {
+#ifdef USE_FFMPEG
+	double startTime = time_now_d();
+	sws_scale(m_sws_ctx, m_pFrame->data, m_pFrame->linesize, 0,
+		height, m_pFrameRGB->data, m_pFrameRGB->linesize);
+	double elapsed = time_now_d() - startTime;
+
+	{
+		std::lock_guard<std::mutex> guard(statsLock);
+		statsFramesConverted++;
+		statsConvertTime += elapsed;
+	}
+
+	std::lock_guard<std::mutex> guard(m_convertLock);
+	m_framesConverted++;
+	m_convertTime += elapsed;
+	m_convertPending = false;
+	m_convertCond.notify_all();
+#endif
+}
+
+void MediaEngine::waitForConversion() {
+	std::unique_lock<std::mutex> guard(m_convertLock);
+	while (m_convertPending)
+		m_convertCond.wait(guard);
+}
+
 // Helpers that null out alpha (which seems to be the case on the PSP.)
 // Some games depend on this, for example Sword Art Online (doesn't clear A's from buffer.)
 inline void writeVideoLineRGBA(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON, investigate why AV_PIX_FMT_RGB0 does not work.
+	// TODO: Investigate why AV_PIX_FMT_RGB0 does not work.
 	u32_le *dest = (u32_le *)destp;
 	const u32_le *src = (u32_le *)srcp;
 
 	const u32 mask = 0x00FFFFFF;
-	for (int i = 0; i < width; ++i) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i maskx4 = _mm_set1_epi32(mask);
+	for (; i + 4 <= width; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_and_si128(pixels, maskx4));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint32x4_t maskx4 = vdupq_n_u32(mask);
+	for (; i + 4 <= width; i += 4) {
+		uint32x4_t pixels = vld1q_u32((const uint32_t *)(src + i));
+		vst1q_u32((uint32_t *)(dest + i), vandq_u32(pixels, maskx4));
+	}
+#endif
+	for (; i < width; ++i) {
 		dest[i] = src[i] & mask;
 	}
 }
@@ -776,26 +921,35 @@ inline void writeVideoLineABGR5650(void *destp, const void *srcp, int width) {
 	memcpy(destp, srcp, width * sizeof(u16));
 }
 
-inline void writeVideoLineABGR5551(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON.
+inline void writeVideoLine16Masked(void *destp, const void *srcp, int width, u16 mask) {
 	u16_le *dest = (u16_le *)destp;
 	const u16_le *src = (u16_le *)srcp;
 
-	const u16 mask = 0x7FFF;
-	for (int i = 0; i < width; ++i) {
+	int i = 0;
+#if defined(_M_SSE)
+	const __m128i maskx8 = _mm_set1_epi16(mask);
+	for (; i + 8 <= width; i += 8) {
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_and_si128(pixels, maskx8));
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	const uint16x8_t maskx8 = vdupq_n_u16(mask);
+	for (; i + 8 <= width; i += 8) {
+		uint16x8_t pixels = vld1q_u16((const uint16_t *)(src + i));
+		vst1q_u16((uint16_t *)(dest + i), vandq_u16(pixels, maskx8));
+	}
+#endif
+	for (; i < width; ++i) {
 		dest[i] = src[i] & mask;
 	}
 }
 
-inline void writeVideoLineABGR4444(void *destp, const void *srcp, int width) {
-	// TODO: Use SSE/NEON.
-	u16_le *dest = (u16_le *)destp;
-	const u16_le *src = (u16_le *)srcp;
+inline void writeVideoLineABGR5551(void *destp, const void *srcp, int width) {
+	writeVideoLine16Masked(destp, srcp, width, 0x7FFF);
+}
 
-	const u16 mask = 0x0FFF;
-	for (int i = 0; i < width; ++i) {
-		dest[i] = src[i] & mask;
-	}
+inline void writeVideoLineABGR4444(void *destp, const void *srcp, int width) {
+	writeVideoLine16Masked(destp, srcp, width, 0x0FFF);
 }
 
 int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMode) {
@@ -808,6 +962,7 @@ int MediaEngine::writeVideoImage(u32 bufferPtr, int frameWidth, int videoPixelMo
 	u8 *buffer = Memory::GetPointerWrite(bufferPtr);
 
 #ifdef USE_FFMPEG
+	waitForConversion();
 	if (!m_pFrame || !m_pFrameRGB)
 		return 0;
 
@@ -898,6 +1053,7 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 	u8 *buffer = Memory::GetPointerWrite(bufferPtr);
 
 #ifdef USE_FFMPEG
+	waitForConversion();
 	if (!m_pFrame || !m_pFrameRGB)
 		return 0;
 
@@ -990,6 +1146,7 @@ int MediaEngine::writeVideoImageWithRange(u32 bufferPtr, int frameWidth, int vid
 
 u8 *MediaEngine::getFrameImage() {
 #ifdef USE_FFMPEG
+	waitForConversion();
 	return m_pFrameRGB->data[0];
 #else
 	return NULL;
@@ -24,7 +24,9 @@
 
 // An approximation of what the interface will look like. Similar to JPCSP's.
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include "Common/CommonTypes.h"
 #include "Core/HLE/sceMpeg.h"
 #include "Core/HW/MpegDemux.h"
@@ -50,6 +52,10 @@ inline s64 getMpegTimeStamp(const u8 *buf) {
 bool InitFFmpeg();
 #endif
 
+// Video decode and colour conversion timings, summed over all contexts.
+void __MediaEngineResetDebugStats();
+void __MediaEngineGetDebugStats(char *stats, size_t bufsize);
+
 class MediaEngine
 {
 public:
@@ -92,12 +98,18 @@ class MediaEngine
 	int VideoWidth() { return m_desWidth; }
 	int VideoHeight() { return m_desHeight; }
 
+	// Called by the conversion task, converts the last decoded frame into m_buffer.
+	void convertFrame(int height);
+
 	void DoState(PointerWrap &p);
 
 private:
 	bool SetupStreams();
 	bool setVideoDim(int width = 0, int height = 0);
 	void updateSwsFormat(int videoPixelMode);
+	void startConversion(int height);
+	// Must be called before touching m_pFrame, m_pFrameRGB or m_buffer.
+	void waitForConversion();
 	int getNextAudioFrame(u8 **buf, int *headerCode1, int *headerCode2);
 
 public:  // TODO: Very little of this below should be public.
@@ -144,4 +156,15 @@ class MediaEngine
 
 	// used for audio type 
 	int m_audioType;
+
+	// Time spent (in seconds) decoding and colour converting video frames, for profiling.
+	int m_framesDecoded = 0;
+	int m_framesConverted = 0;
+	double m_decodeTime = 0.0;
+	double m_convertTime = 0.0;
+
+private:
+	std::mutex m_convertLock;
+	std::condition_variable m_convertCond;
+	bool m_convertPending = false;
 };
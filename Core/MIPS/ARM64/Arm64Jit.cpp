@@ -111,6 +111,7 @@ Arm64Jit::Arm64Jit(MIPSState *mipsState) : blocks(mipsState, this), gpr(mipsStat
 	fpr.SetEmitter(this, &fp);
 	AllocCodeSpace(1024 * 1024 * 16);  // 32MB is the absolute max because that's what an ARM branch instruction can reach, backwards and forwards.
 	GenerateFixedCode(jo);
+	blocks.InitCodeRegions(jitStartOffset, region_size, g_Config.bJitRecycleCodeSpace);
 	js.startDefaultPrefix = mips_->HasDefaultPrefix();
 	js.currentRoundingFunc = convertS0ToSCRATCH1[mips_->fcr31 & 3];
 
@@ -177,6 +178,25 @@ void Arm64Jit::ClearCache() {
 	blocks.Clear();
 	ClearCodeSpace(jitStartOffset);
 	FlushIcacheSection(region + jitStartOffset, region + region_size - jitStartOffset);
+	blocks.InitCodeRegions(jitStartOffset, region_size, g_Config.bJitRecycleCodeSpace);
+}
+
+void Arm64Jit::RecycleCodeSpace() {
+	if (!blocks.RecyclesCodeRegions()) {
+		INFO_LOG(JIT, "Space left: %d", (int)GetSpaceLeft());
+		ClearCache();
+		return;
+	}
+
+	// Reuse the oldest code region rather than throwing everything away.
+	for (int i = 0; i < JitBlockCache::NUM_CODE_REGIONS; ++i) {
+		size_t offset, size;
+		blocks.EvictNextCodeRegion(&offset, &size);
+		ReuseCodeSpace(offset, size);
+		if (!blocks.IsFull())
+			return;
+	}
+	ClearCache();
 }
 
 void Arm64Jit::InvalidateCacheAt(u32 em_address, int length) {
@@ -222,9 +242,8 @@ void Arm64Jit::CompileDelaySlot(int flags) {
 
 void Arm64Jit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
-	if (GetSpaceLeft() < 0x10000 || blocks.IsFull()) {
-		INFO_LOG(JIT, "Space left: %d", (int)GetSpaceLeft());
-		ClearCache();
+	if (blocks.GetCodeRegionSpaceLeft() < 0x10000 || blocks.IsFull()) {
+		RecycleCodeSpace();
 	}
 
 	BeginWrite(4);
@@ -350,7 +369,7 @@ const u8 *Arm64Jit::DoJit(u32 em_address, JitBlock *b) {
 		}
 
 		// Safety check, in case we get a bunch of really large jit ops without a lot of branching.
-		if (GetSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
+		if (blocks.GetCodeRegionSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
 			FlushAll();
 			WriteExit(GetCompilerPC(), js.nextExit++);
 			js.compiling = false;
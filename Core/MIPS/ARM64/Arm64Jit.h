@@ -194,6 +194,7 @@ class Arm64Jit : public Arm64Gen::ARM64CodeBlock, public JitInterface, public MI
 
 private:
 	void GenerateFixedCode(const JitOptions &jo);
+	void RecycleCodeSpace();
 	void FlushAll();
 	void FlushPrefixV();
 
@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "Common/File/FileUtil.h"
 #include "Common/Log.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/Serialize/SerializeFuncs.h"
@@ -41,6 +42,10 @@ IRFrontend::IRFrontend(bool startDefaultPrefix) {
 	CBreakPoints::SetSkipFirst(0);
 }
 
+IRFrontend::~IRFrontend() {
+	CloseBlockDump();
+}
+
 void IRFrontend::DoState(PointerWrap &p) {
 	auto s = p.Section("Jit", 1, 2);
 	if (!s)
@@ -222,6 +227,50 @@ MIPSOpcode IRFrontend::GetOffsetInstruction(int offset) {
 }
 
 void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
+	CompileToIR(em_address, preload);
+	mipsBytes = js.compilerPC - em_address;
+	if (blockDump_ && !js.cancel)
+		DumpBlock(em_address, mipsBytes);
+	OptimizeIR(ir, instructions, em_address, mipsBytes);
+}
+
+void IRFrontend::DoJitRaw(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes) {
+	CompileToIR(em_address, false);
+	mipsBytes = js.compilerPC - em_address;
+	instructions = ir.GetInstructions();
+}
+
+bool IRFrontend::OpenBlockDump(const Path &filename) {
+	CloseBlockDump();
+	blockDump_ = File::OpenCFile(filename, "a");
+	if (!blockDump_) {
+		ERROR_LOG(JIT, "Unable to open %s for dumping IR blocks", filename.c_str());
+		return false;
+	}
+	INFO_LOG(JIT, "Dumping IR blocks to %s", filename.c_str());
+	return true;
+}
+
+void IRFrontend::CloseBlockDump() {
+	if (blockDump_)
+		fclose(blockDump_);
+	blockDump_ = nullptr;
+	dumpedBlocks_.clear();
+}
+
+void IRFrontend::DumpBlock(u32 em_address, u32 mipsBytes) {
+	// Blocks get recompiled after invalidation, usually with the same code.
+	if (!dumpedBlocks_.insert(em_address).second)
+		return;
+
+	// One line per block: the address followed by each opcode, all in hex.
+	fprintf(blockDump_, "%08x", em_address);
+	for (u32 cpc = em_address; cpc != em_address + mipsBytes; cpc += 4)
+		fprintf(blockDump_, " %08x", Memory::Read_Opcode_JIT(cpc).encoding);
+	fprintf(blockDump_, "\n");
+}
+
+void IRFrontend::CompileToIR(u32 em_address, bool preload) {
 	js.cancel = false;
 	js.preloading = preload;
 	js.blockStart = em_address;
@@ -253,26 +302,29 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		// Clear the instructions to signal this was not compiled.
 		ir.Clear();
 	}
+}
 
-	mipsBytes = js.compilerPC - em_address;
-
+void IRFrontend::OptimizeIR(const IRWriter &original, std::vector<IRInst> &instructions, u32 em_address, u32 mipsBytes) {
 	IRWriter simplified;
-	IRWriter *code = &ir;
+	const IRWriter *code = &original;
 	if (!js.hadBreakpoints) {
-		static const IRPassFunc passes[] = {
-			&ApplyMemoryValidation,
-			&RemoveLoadStoreLeftRight,
-			&OptimizeFPMoves,
-			&PropagateConstants,
-			&PurgeTemps,
-			// &ReorderLoadStore,
-			// &MergeLoadStore,
-			// &ThreeOpToTwoOp,
-		};
-		if (IRApplyPasses(passes, ARRAY_SIZE(passes), ir, simplified, opts))
+		size_t count;
+		const IRNamedPass *named = GetPasses(count);
+		IRPassFunc passes[16];
+		size_t used = 0;
+		_dbg_assert_(count <= ARRAY_SIZE(passes));
+		for (size_t i = 0; i < count; ++i) {
+			if (!named[i].experimental || opts.experimentalPasses)
+				passes[used++] = named[i].func;
+		}
+
+		std::unordered_map<u32, u32> exitLiveGPRs;
+		IROptions passOpts = GetPassOptions(original.GetInstructions(), exitLiveGPRs);
+
+		if (IRApplyPasses(passes, used, original, simplified, passOpts))
 			logBlocks = 1;
 		code = &simplified;
-		//if (ir.GetInstructions().size() >= 24)
+		//if (original.GetInstructions().size() >= 24)
 		//	logBlocks = 1;
 	}
 
@@ -281,7 +333,7 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 	if (logBlocks > 0 && dontLogBlocks == 0) {
 		char temp2[256];
 		NOTICE_LOG(JIT, "=============== mips %08x ===============", em_address);
-		for (u32 cpc = em_address; cpc != GetCompilerPC(); cpc += 4) {
+		for (u32 cpc = em_address; cpc != em_address + mipsBytes; cpc += 4) {
 			temp2[0] = 0;
 			MIPSDisAsm(Memory::Read_Opcode_JIT(cpc), cpc, temp2, true);
 			NOTICE_LOG(JIT, "M: %08x   %s", cpc, temp2);
@@ -289,10 +341,10 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 	}
 
 	if (logBlocks > 0 && dontLogBlocks == 0) {
-		NOTICE_LOG(JIT, "=============== Original IR (%d instructions) ===============", (int)ir.GetInstructions().size());
-		for (size_t i = 0; i < ir.GetInstructions().size(); i++) {
+		NOTICE_LOG(JIT, "=============== Original IR (%d instructions) ===============", (int)original.GetInstructions().size());
+		for (size_t i = 0; i < original.GetInstructions().size(); i++) {
 			char buf[256];
-			DisassembleIR(buf, sizeof(buf), ir.GetInstructions()[i]);
+			DisassembleIR(buf, sizeof(buf), original.GetInstructions()[i]);
 			NOTICE_LOG(JIT, "%s", buf);
 		}
 		NOTICE_LOG(JIT, "===============        end         =================");
@@ -314,6 +366,147 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		dontLogBlocks--;
 }
 
+const IRNamedPass *IRFrontend::GetPasses(size_t &count) {
+	static const IRNamedPass passes[] = {
+		{ "ApplyMemoryValidation", &ApplyMemoryValidation, false },
+		{ "RemoveLoadStoreLeftRight", &RemoveLoadStoreLeftRight, false },
+		{ "OptimizeFPMoves", &OptimizeFPMoves, false },
+		{ "PropagateConstants", &PropagateConstants, false },
+		{ "PurgeTemps", &PurgeTemps, false },
+		{ "EliminateDeadGPRs", &EliminateDeadGPRs, true },
+		{ "VectorizeVFPU", &VectorizeVFPU, true },
+		{ "ReorderLoadStore", &ReorderLoadStore, true },
+		{ "MergeLoadStore", &MergeLoadStore, true },
+		// Only helps backends with two operand instructions.
+		// { "ThreeOpToTwoOp", &ThreeOpToTwoOp, false },
+	};
+	count = ARRAY_SIZE(passes);
+	return passes;
+}
+
+IROptions IRFrontend::GetPassOptions(const std::vector<IRInst> &instructions, std::unordered_map<u32, u32> &exitLiveGPRs) {
+	IROptions passOpts = opts;
+	exitLiveGPRs.clear();
+	if ((opts.disableFlags & (uint32_t)JitDisable::REG_LIVENESS) != 0)
+		return passOpts;
+
+	for (const IRInst &inst : instructions) {
+		switch (inst.op) {
+		case IROp::ExitToConst:
+		case IROp::ExitToConstIfEq:
+		case IROp::ExitToConstIfNeq:
+		case IROp::ExitToConstIfGtZ:
+		case IROp::ExitToConstIfGeZ:
+		case IROp::ExitToConstIfLtZ:
+		case IROp::ExitToConstIfLeZ:
+			if (exitLiveGPRs.find(inst.constant) == exitLiveGPRs.end())
+				exitLiveGPRs[inst.constant] = GetLiveGPRsAt(inst.constant);
+			break;
+		default:
+			break;
+		}
+	}
+	passOpts.exitLiveGPRs = &exitLiveGPRs;
+	return passOpts;
+}
+
+u32 IRFrontend::GetLiveGPRsAt(u32 address) {
+	auto it = liveness_.upper_bound(address);
+	if (it != liveness_.begin()) {
+		--it;
+		if (it->second.Contains(address))
+			return it->second.LiveAt(address);
+	}
+
+	MIPSAnalyst::FunctionLiveness liveness;
+	if (!MIPSAnalyst::ComputeFunctionLiveness(address, liveness))
+		return 0xFFFFFFFF;
+
+	// Shouldn't grow large, but let's not keep every function around forever.
+	if (liveness_.size() >= 1024)
+		liveness_.clear();
+	u32 live = liveness.LiveAt(address);
+	liveness_[liveness.start] = std::move(liveness);
+	return live;
+}
+
+void IRFrontend::InvalidateLiveness(u32 address, u32 length) {
+	for (auto it = liveness_.begin(); it != liveness_.end(); ) {
+		if (it->second.start < address + length && address < it->second.end)
+			it = liveness_.erase(it);
+		else
+			++it;
+	}
+}
+
+static IROp InvertExitCondition(IROp op) {
+	switch (op) {
+	case IROp::ExitToConstIfEq: return IROp::ExitToConstIfNeq;
+	case IROp::ExitToConstIfNeq: return IROp::ExitToConstIfEq;
+	case IROp::ExitToConstIfGtZ: return IROp::ExitToConstIfLeZ;
+	case IROp::ExitToConstIfLeZ: return IROp::ExitToConstIfGtZ;
+	case IROp::ExitToConstIfGeZ: return IROp::ExitToConstIfLtZ;
+	case IROp::ExitToConstIfLtZ: return IROp::ExitToConstIfGeZ;
+	case IROp::ExitToConstIfFpTrue: return IROp::ExitToConstIfFpFalse;
+	case IROp::ExitToConstIfFpFalse: return IROp::ExitToConstIfFpTrue;
+	default: return IROp::Nop;
+	}
+}
+
+// Rewrites the tail of a block so that it falls through to target instead of exiting there.
+static bool ChainExit(std::vector<IRInst> &insts, u32 target) {
+	size_t n = insts.size();
+	if (n >= 1 && insts[n - 1].op == IROp::ExitToConst && insts[n - 1].constant == target) {
+		// Unconditional jump or taken branch, just drop the exit.
+		insts.pop_back();
+		return true;
+	}
+
+	// The not taken side of a branch.  Only safe when nothing (like a likely delay slot) sits between the exits.
+	if (n >= 2 && insts[n - 1].op == IROp::ExitToConst && insts[n - 2].constant == target) {
+		IROp inverted = InvertExitCondition(insts[n - 2].op);
+		if (inverted != IROp::Nop) {
+			insts[n - 2].op = inverted;
+			insts[n - 2].constant = insts[n - 1].constant;
+			insts.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool IRFrontend::DoJitTrace(const std::vector<u32> &path, std::vector<IRInst> &instructions, int &numBlocks) {
+	std::vector<IRInst> trace;
+	numBlocks = 0;
+
+	for (u32 em_address : path) {
+		CompileToIR(em_address, false);
+		if (js.cancel || js.hadBreakpoints || ir.GetInstructions().empty())
+			break;
+		// The previous block must be able to fall through into this one.
+		if (numBlocks != 0 && !ChainExit(trace, em_address))
+			break;
+
+		trace.insert(trace.end(), ir.GetInstructions().begin(), ir.GetInstructions().end());
+		numBlocks++;
+	}
+
+	// A single block is no better than what we already have.
+	if (numBlocks < 2) {
+		instructions.clear();
+		return false;
+	}
+
+	IRWriter combined;
+	for (const IRInst &inst : trace)
+		combined.Write(inst);
+	// The block we stopped at may have had breakpoints, but it's not part of the trace.
+	js.hadBreakpoints = false;
+	OptimizeIR(combined, instructions, path[0], 0);
+	return true;
+}
+
 void IRFrontend::Comp_RunBlock(MIPSOpcode op) {
 	// This shouldn't be necessary, the dispatcher should catch us before we get here.
 	ERROR_LOG(JIT, "Comp_RunBlock should never be reached!");
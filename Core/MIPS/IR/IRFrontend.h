@@ -1,16 +1,25 @@
 #pragma once
 
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "Common/CommonTypes.h"
+#include "Common/File/Path.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/JitCommon/JitState.h"
+#include "Core/MIPS/MIPSAnalyst.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
 #include "Core/MIPS/IR/IRInst.h"
+#include "Core/MIPS/IR/IRPassSimplify.h"
 
 namespace MIPSComp {
 
 class IRFrontend : public MIPSFrontendInterface {
 public:
 	IRFrontend(bool startDefaultPrefix);
+	~IRFrontend();
 	void Comp_Generic(MIPSOpcode op) override;
 
 	void Comp_RunBlock(MIPSOpcode op) override;
@@ -89,6 +98,20 @@ class IRFrontend : public MIPSFrontendInterface {
 	bool CheckRounding(u32 blockAddress);  // returns true if we need a do-over
 
 	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	// Compiles the blocks at the path addresses into a single trace, stopping at the first that can't be chained.
+	// Returns false if fewer than two blocks could be combined.
+	bool DoJitTrace(const std::vector<u32> &path, std::vector<IRInst> &instructions, int &numBlocks);
+	// Like DoJit, but without running any passes.  For testing and benchmarking the passes.
+	void DoJitRaw(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes);
+
+	// The passes DoJit runs, in order.  Experimental ones only run if the options allow.
+	static const IRNamedPass *GetPasses(size_t &count);
+	// Options for those passes, including liveness for the block's constant exits.
+	IROptions GetPassOptions(const std::vector<IRInst> &instructions, std::unordered_map<u32, u32> &exitLiveGPRs);
+
+	// Writes each compiled block's MIPS code to a text file, once per address.
+	bool OpenBlockDump(const Path &filename);
+	void CloseBlockDump();
 
 	void EatPrefix() override {
 		js.EatPrefix();
@@ -98,7 +121,18 @@ class IRFrontend : public MIPSFrontendInterface {
 		opts = o;
 	}
 
+	// Cached function liveness must be dropped when the code changes.
+	void InvalidateLiveness(u32 address, u32 length);
+	void ClearLiveness() {
+		liveness_.clear();
+	}
+
 private:
+	void CompileToIR(u32 em_address, bool preload);
+	void OptimizeIR(const IRWriter &original, std::vector<IRInst> &instructions, u32 em_address, u32 mipsBytes);
+	u32 GetLiveGPRsAt(u32 address);
+	void DumpBlock(u32 em_address, u32 mipsBytes);
+
 	void RestoreRoundingMode(bool force = false);
 	void ApplyRoundingMode(bool force = false);
 	void UpdateRoundingMode();
@@ -139,6 +173,12 @@ class IRFrontend : public MIPSFrontendInterface {
 
 	int dontLogBlocks = 0;
 	int logBlocks = 0;
+
+	// Keyed by function start address.
+	std::map<u32, MIPSAnalyst::FunctionLiveness> liveness_;
+
+	FILE *blockDump_ = nullptr;
+	std::unordered_set<u32> dumpedBlocks_;
 };
 
 }  // namespace
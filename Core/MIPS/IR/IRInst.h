@@ -1,5 +1,6 @@
 #pragma once
 
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -378,6 +379,10 @@ class IRWriter {
 struct IROptions {
 	uint32_t disableFlags;
 	bool unalignedLoadStore;
+	// Bitmask of GPRs live at each constant exit target, if known.  Missing targets are all live.
+	const std::unordered_map<u32, u32> *exitLiveGPRs;
+	// Also run the passes marked experimental.
+	bool experimentalPasses;
 };
 
 const IRMeta *GetIRMeta(IROp op);
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 
 #include "ppsspp_config.h"
@@ -39,6 +40,20 @@
 #define mips mips
 #endif
 
+// Set only while a load or store touches memory, so a fastmem fault can be traced back to the op.
+const IRInst *volatile g_irMemoryOp = nullptr;
+
+// The fences keep the compiler from moving the access itself outside.
+inline static void BeginMemoryAccess(const IRInst *inst) {
+	g_irMemoryOp = inst;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+inline static void EndMemoryAccess() {
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	g_irMemoryOp = nullptr;
+}
+
 alignas(16) static const float vec4InitValues[8][4] = {
 	{ 0.0f, 0.0f, 0.0f, 0.0f },
 	{ 1.0f, 1.0f, 1.0f, 1.0f },
@@ -187,95 +202,131 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			break;
 
 		case IROp::Load8:
+			BeginMemoryAccess(inst);
 			mips->r[inst->dest] = Memory::ReadUnchecked_U8(mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Load8Ext:
+			BeginMemoryAccess(inst);
 			mips->r[inst->dest] = SignExtend8ToU32(Memory::ReadUnchecked_U8(mips->r[inst->src1] + inst->constant));
+			EndMemoryAccess();
 			break;
 		case IROp::Load16:
+			BeginMemoryAccess(inst);
 			mips->r[inst->dest] = Memory::ReadUnchecked_U16(mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Load16Ext:
+			BeginMemoryAccess(inst);
 			mips->r[inst->dest] = SignExtend16ToU32(Memory::ReadUnchecked_U16(mips->r[inst->src1] + inst->constant));
+			EndMemoryAccess();
 			break;
 		case IROp::Load32:
+			BeginMemoryAccess(inst);
 			mips->r[inst->dest] = Memory::ReadUnchecked_U32(mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Load32Left:
 		{
+			BeginMemoryAccess(inst);
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 destMask = 0x00ffffff >> shift;
 			mips->r[inst->dest] = (mips->r[inst->dest] & destMask) | (mem << (24 - shift));
+			EndMemoryAccess();
 			break;
 		}
 		case IROp::Load32Right:
 		{
+			BeginMemoryAccess(inst);
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 destMask = 0xffffff00 << (24 - shift);
 			mips->r[inst->dest] = (mips->r[inst->dest] & destMask) | (mem >> shift);
+			EndMemoryAccess();
 			break;
 		}
 		case IROp::LoadFloat:
+			BeginMemoryAccess(inst);
 			mips->f[inst->dest] = Memory::ReadUnchecked_Float(mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 
 		case IROp::Store8:
+			BeginMemoryAccess(inst);
 			Memory::WriteUnchecked_U8(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Store16:
+			BeginMemoryAccess(inst);
 			Memory::WriteUnchecked_U16(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Store32:
+			BeginMemoryAccess(inst);
 			Memory::WriteUnchecked_U32(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 		case IROp::Store32Left:
 		{
+			BeginMemoryAccess(inst);
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 memMask = 0xffffff00 << shift;
 			u32 result = (mips->r[inst->src3] >> (24 - shift)) | (mem & memMask);
 			Memory::WriteUnchecked_U32(result, addr & 0xfffffffc);
+			EndMemoryAccess();
 			break;
 		}
 		case IROp::Store32Right:
 		{
+			BeginMemoryAccess(inst);
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 memMask = 0x00ffffff >> (24 - shift);
 			u32 result = (mips->r[inst->src3] << shift) | (mem & memMask);
 			Memory::WriteUnchecked_U32(result, addr & 0xfffffffc);
+			EndMemoryAccess();
 			break;
 		}
 		case IROp::StoreFloat:
+			BeginMemoryAccess(inst);
 			Memory::WriteUnchecked_Float(mips->f[inst->src3], mips->r[inst->src1] + inst->constant);
+			EndMemoryAccess();
 			break;
 
 		case IROp::LoadVec4:
 		{
+			BeginMemoryAccess(inst);
 			u32 base = mips->r[inst->src1] + inst->constant;
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_load_ps((const float *)Memory::GetPointerUnchecked(base)));
+#elif PPSSPP_ARCH(ARM64_NEON)
+			vst1q_f32(&mips->f[inst->dest], vld1q_f32((const float *)Memory::GetPointerUnchecked(base)));
 #else
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = Memory::ReadUnchecked_Float(base + 4 * i);
 #endif
+			EndMemoryAccess();
 			break;
 		}
 		case IROp::StoreVec4:
 		{
+			BeginMemoryAccess(inst);
 			u32 base = mips->r[inst->src1] + inst->constant;
 #if defined(_M_SSE)
 			_mm_store_ps((float *)Memory::GetPointerUnchecked(base), _mm_load_ps(&mips->f[inst->dest]));
+#elif PPSSPP_ARCH(ARM64_NEON)
+			vst1q_f32((float *)Memory::GetPointerUnchecked(base), vld1q_f32(&mips->f[inst->dest]));
 #else
 			for (int i = 0; i < 4; i++)
 				Memory::WriteUnchecked_Float(mips->f[inst->dest + i], base + 4 * i);
 #endif
+			EndMemoryAccess();
 			break;
 		}
 
@@ -283,6 +334,8 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_load_ps(vec4InitValues[inst->src1]));
+#elif PPSSPP_ARCH(ARM64_NEON)
+			vst1q_f32(&mips->f[inst->dest], vld1q_f32(vec4InitValues[inst->src1]));
 #else
 			memcpy(&mips->f[inst->dest], vec4InitValues[inst->src1], 4 * sizeof(float));
 #endif
@@ -353,6 +406,8 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_div_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2])));
+#elif PPSSPP_ARCH(ARM64_NEON)
+			vst1q_f32(&mips->f[inst->dest], vdivq_f32(vld1q_f32(&mips->f[inst->src1]), vld1q_f32(&mips->f[inst->src2])));
 #else
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] / mips->f[inst->src2 + i];
@@ -364,6 +419,8 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_mul_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_set1_ps(mips->f[inst->src2])));
+#elif PPSSPP_ARCH(ARM64_NEON)
+			vst1q_f32(&mips->f[inst->dest], vmulq_n_f32(vld1q_f32(&mips->f[inst->src1]), mips->f[inst->src2]));
 #else
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] * mips->f[inst->src2];
@@ -21,3 +21,6 @@ inline static u32 ReverseBits32(u32 v) {
 }
 
 u32 IRInterpret(MIPSState *ms, const IRInst *inst, int count);
+
+// The load or store IRInterpret is in the middle of, nullptr outside memory accesses.
+extern const IRInst *volatile g_irMemoryOp;
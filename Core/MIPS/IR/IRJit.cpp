@@ -15,11 +15,13 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
 #include <set>
 
 #include "ext/xxhash.h"
 #include "Common/Profiler/Profiler.h"
 
+#include "Common/File/FileUtil.h"
 #include "Common/Log.h"
 #include "Common/Serialize/Serializer.h"
 #include "Common/StringUtils.h"
@@ -27,7 +29,9 @@
 #include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/ELF/ParamSFO.h"
 #include "Core/HLE/sceKernelMemory.h"
+#include "Core/MemFault.h"
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
@@ -39,6 +43,7 @@
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
 
 namespace MIPSComp {
 
@@ -50,10 +55,22 @@ IRJit::IRJit(MIPSState *mipsState) : frontend_(mipsState->HasDefaultPrefix()), m
 	IROptions opts{};
 	opts.disableFlags = g_Config.uJitDisableFlags;
 	opts.unalignedLoadStore = (opts.disableFlags & (uint32_t)JitDisable::LSU_UNALIGNED) == 0;
+	opts.experimentalPasses = g_Config.bIRExperimentalPasses;
 	frontend_.SetOptions(opts);
+
+	if (g_Config.bJitTraces)
+		traceThreshold_ = 1000;
+
+	if (g_Config.bDumpIRBlocks) {
+		// Appends, so that a corpus can be built up over several sessions.
+		const Path dumpDirectory = GetSysDirectory(DIRECTORY_DUMP);
+		if (File::CreateFullPath(dumpDirectory))
+			frontend_.OpenBlockDump(dumpDirectory / (g_paramSFO.GetDiscID() + "_irblocks.txt"));
+	}
 }
 
 IRJit::~IRJit() {
+	frontend_.CloseBlockDump();
 }
 
 void IRJit::DoState(PointerWrap &p) {
@@ -66,10 +83,14 @@ void IRJit::UpdateFCR31() {
 void IRJit::ClearCache() {
 	INFO_LOG(JIT, "IRJit: Clearing the cache!");
 	blocks_.Clear();
+	runningBlock_ = -1;
+	resumeBlock_ = -1;
+	frontend_.ClearLiveness();
 }
 
 void IRJit::InvalidateCacheAt(u32 em_address, int length) {
 	blocks_.InvalidateICache(em_address, length);
+	frontend_.InvalidateLiveness(em_address, length);
 }
 
 void IRJit::Compile(u32 em_address) {
@@ -135,6 +156,88 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 	return true;
 }
 
+// Recompiles the hot block and the blocks it usually continues into as one trace.
+// Exits the trace doesn't follow go back to the regular blocks, which are left alone.
+void IRJit::CompileTrace(int headBlockNum) {
+	PROFILE_THIS_SCOPE("jitc");
+
+	// Note: careful with IRBlock pointers, allocating a block may move them.
+	const int MAX_TRACE_BLOCKS = 8;
+	const u32 MAX_TRACE_SPAN = 0x10000;
+
+	u32 headStart, headSize;
+	blocks_.GetBlock(headBlockNum)->GetRange(headStart, headSize);
+
+	std::vector<u32> path;
+	std::vector<std::pair<u32, u32>> ranges;
+	path.push_back(headStart);
+	ranges.push_back(std::make_pair(headStart, headStart + headSize));
+	u32 coverStart = headStart;
+	u32 coverEnd = headStart + headSize;
+
+	const IRBlock *cur = blocks_.GetBlock(headBlockNum);
+	while ((int)path.size() < MAX_TRACE_BLOCKS) {
+		u32 next = cur->GetLikelySuccessor();
+		// Stop when we loop back, the rest of the loop will be its own trace head.
+		if (next == 0 || std::find(path.begin(), path.end(), next) != path.end())
+			break;
+		const IRBlock *nextBlock = blocks_.GetBlock(blocks_.GetBlockNumberFromStartAddress(next));
+		if (!nextBlock || !nextBlock->IsValid() || nextBlock->GetTraceLength() != 0)
+			break;
+
+		u32 start, size;
+		nextBlock->GetRange(start, size);
+		u32 newStart = std::min(coverStart, start);
+		u32 newEnd = std::max(coverEnd, start + size);
+		if (newEnd - newStart > MAX_TRACE_SPAN)
+			break;
+
+		coverStart = newStart;
+		coverEnd = newEnd;
+		path.push_back(next);
+		ranges.push_back(std::make_pair(start, start + size));
+		cur = nextBlock;
+	}
+
+	if (path.size() < 2)
+		return;
+
+	std::vector<IRInst> instructions;
+	int numBlocks = 0;
+	if (!frontend_.DoJitTrace(path, instructions, numBlocks) || instructions.size() > 0xFFFF)
+		return;
+
+	// The frontend may have stopped early, only cover what went in.
+	coverStart = headStart;
+	coverEnd = headStart + headSize;
+	for (int i = 1; i < numBlocks; ++i) {
+		coverStart = std::min(coverStart, ranges[i].first);
+		coverEnd = std::max(coverEnd, ranges[i].second);
+	}
+
+	int traceNum = blocks_.AllocateBlock(headStart);
+	if ((traceNum & ~MIPS_EMUHACK_VALUE_MASK) != 0) {
+		ERROR_LOG(JIT, "Ran out of block numbers compiling trace, clearing cache");
+		ClearCache();
+		return;
+	}
+
+	blocks_.GetBlock(headBlockNum)->Destroy(headBlockNum);
+
+	IRBlock *b = blocks_.GetBlock(traceNum);
+	b->SetInstructions(instructions);
+	b->SetOriginalSize(headSize);
+	b->SetCoveredRange(coverStart, coverEnd - coverStart);
+	b->SetTraceLength(numBlocks);
+	blocks_.FinalizeBlock(traceNum);
+	DEBUG_LOG(JIT, "Formed trace of %d blocks at %08x", numBlocks, headStart);
+
+	if (frontend_.CheckRounding(headStart)) {
+		// Our assumptions are all wrong so it's clean-slate time.
+		ClearCache();
+	}
+}
+
 void IRJit::CompileFunction(u32 start_address, u32 length) {
 	PROFILE_THIS_SCOPE("jitc");
 
@@ -213,7 +316,13 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 
 	// ApplyRoundingMode(true);
 	// IR Dispatcher
-	
+
+	// Without fastmem, the accesses are validated instead and can't fault.
+	const bool recoverFaults = g_Config.bFastMemory;
+	const auto runBlocks = [](void *jit) {
+		((IRJit *)jit)->RunBlocks();
+	};
+
 	while (true) {
 		// RestoreRoundingMode(true);
 		CoreTiming::Advance();
@@ -221,29 +330,111 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 		if (coreState != 0) {
 			break;
 		}
-		while (mips_->downcount >= 0) {
-			u32 inst = Memory::ReadUnchecked_U32(mips_->pc);
-			u32 opcode = inst & 0xFF000000;
-			if (opcode == MIPS_EMUHACK_OPCODE) {
-				u32 data = inst & 0xFFFFFF;
-				IRBlock *block = blocks_.GetBlock(data);
-				u32 startPC = mips_->pc;
-				mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
-				if (!Memory::IsValidAddress(mips_->pc) || (mips_->pc & 3) != 0) {
-					Core_ExecException(mips_->pc, startPC, ExecExceptionType::JUMP);
-					break;
-				}
-			} else {
-				// RestoreRoundingMode(true);
-				Compile(mips_->pc);
-				// ApplyRoundingMode(true);
-			}
+
+		u32 faultAddress;
+		if (!recoverFaults) {
+			RunBlocks();
+		} else if (!Memory::MemFault_CallWithRecovery(runBlocks, this, &faultAddress)) {
+			HandleFastmemFault(faultAddress);
 		}
 	}
 
 	// RestoreRoundingMode(true);
 }
 
+void IRJit::RunBlocks() {
+	if (resumeBlock_ != -1) {
+		// Finish the block a skipped bad access was in.
+		IRBlock *block = blocks_.GetBlock(resumeBlock_);
+		const IRInst *end = block->GetInstructions() + block->GetNumInstructions();
+		u32 startPC = mips_->pc;
+		resumeBlock_ = -1;
+		mips_->pc = IRInterpret(mips_, resumeInst_, (int)(end - resumeInst_));
+		if (!Memory::IsValidAddress(mips_->pc) || (mips_->pc & 3) != 0) {
+			Core_ExecException(mips_->pc, startPC, ExecExceptionType::JUMP);
+			return;
+		}
+	}
+
+	while (mips_->downcount >= 0) {
+		u32 inst = Memory::ReadUnchecked_U32(mips_->pc);
+		u32 opcode = inst & 0xFF000000;
+		if (opcode == MIPS_EMUHACK_OPCODE) {
+			u32 data = inst & 0xFFFFFF;
+			IRBlock *block = blocks_.GetBlock(data);
+			u32 startPC = mips_->pc;
+			runningBlock_ = data;
+			mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
+			if (!Memory::IsValidAddress(mips_->pc) || (mips_->pc & 3) != 0) {
+				Core_ExecException(mips_->pc, startPC, ExecExceptionType::JUMP);
+				break;
+			}
+			if (traceThreshold_ != 0) {
+				// The block may have been invalidated (or even cleared) while running.
+				block = blocks_.GetBlock(data);
+				if (block && block->IsValid() && block->RecordExecution(mips_->pc, traceThreshold_))
+					CompileTrace(data);
+			}
+		} else {
+			// RestoreRoundingMode(true);
+			Compile(mips_->pc);
+			// ApplyRoundingMode(true);
+		}
+	}
+}
+
+static int IRMemoryAccessSize(IROp op) {
+	switch (op) {
+	case IROp::Load8:
+	case IROp::Load8Ext:
+	case IROp::Store8:
+		return 1;
+	case IROp::Load16:
+	case IROp::Load16Ext:
+	case IROp::Store16:
+		return 2;
+	case IROp::LoadVec4:
+	case IROp::StoreVec4:
+		return 16;
+	default:
+		// Words, floats, and the aligned word accesses of the left/right ops.
+		return 4;
+	}
+}
+
+void IRJit::HandleFastmemFault(u32 guestAddress) {
+	// Only an interpreted load or store can be skipped.  The block's own instructions are
+	// still there even if it was invalidated meanwhile, until the cache is cleared.
+	const IRInst *inst = g_irMemoryOp;
+	g_irMemoryOp = nullptr;
+	const IRBlock *block = blocks_.GetBlock(runningBlock_);
+	bool inBlock = false;
+	if (inst && block && block->GetInstructions()) {
+		const IRInst *begin = block->GetInstructions();
+		inBlock = inst >= begin && inst < begin + block->GetNumInstructions();
+	}
+
+	bool isWrite = false;
+	int size = 4;
+	char info[256] = "IR: unknown\n";
+	if (inBlock) {
+		isWrite = (GetIRMeta(inst->op)->flags & IRFLAG_SRC3) != 0;
+		size = IRMemoryAccessSize(inst->op);
+		char disasm[192];
+		DisassembleIR(disasm, sizeof(disasm), *inst);
+		snprintf(info, sizeof(info), "IR: %s\n", disasm);
+	}
+
+	if (Memory::MemFault_HandleRecoveredFault(guestAddress, inBlock ? inst : nullptr, isWrite, size, info)) {
+		// Like the JIT, the access is skipped and the block continues after it.
+		resumeBlock_ = runningBlock_;
+		resumeInst_ = inst + 1;
+	} else {
+		// Same as the JIT crash handlers.
+		coreState = CORE_RUNTIME_ERROR;
+	}
+}
+
 bool IRJit::DescribeCodePtr(const u8 *ptr, std::string &name) {
 	// Used in target disassembly viewer.
 	return false;
@@ -295,7 +486,7 @@ void IRBlockCache::FinalizeBlock(int i, bool preload) {
 	}
 
 	u32 startAddr, size;
-	blocks_[i].GetRange(startAddr, size);
+	blocks_[i].GetCoveredRange(startAddr, size);
 
 	u32 startPage = AddressToPage(startAddr);
 	u32 endPage = AddressToPage(startAddr + size);
@@ -368,6 +559,8 @@ JitBlockDebugInfo IRBlockCache::GetBlockDebugInfo(int blockNum) const {
 	uint32_t start, size;
 	ir.GetRange(start, size);
 	debugInfo.originalAddress = start;  // TODO
+	debugInfo.execCount = ir.GetExecCount();
+	debugInfo.traceLength = ir.GetTraceLength();
 
 	for (u32 addr = start; addr < start + size; addr += 4) {
 		char temp[256];
@@ -490,9 +683,38 @@ u64 IRBlock::CalculateHash() const {
 }
 
 bool IRBlock::OverlapsRange(u32 addr, u32 size) const {
+	u32 start, coveredSize;
+	GetCoveredRange(start, coveredSize);
 	addr &= 0x3FFFFFFF;
-	u32 origAddr = origAddr_ & 0x3FFFFFFF;
-	return addr + size > origAddr && addr < origAddr + origSize_;
+	start &= 0x3FFFFFFF;
+	return addr + size > start && addr < start + coveredSize;
+}
+
+bool IRBlock::RecordExecution(u32 nextPC, u32 threshold) {
+	if (successors_[0] == nextPC) {
+		successorCounts_[0]++;
+	} else if (successors_[1] == nextPC) {
+		successorCounts_[1]++;
+		if (successorCounts_[1] > successorCounts_[0]) {
+			std::swap(successors_[0], successors_[1]);
+			std::swap(successorCounts_[0], successorCounts_[1]);
+		}
+	} else {
+		// Replace the less common one.  With many targets, there's no likely one anyway.
+		successors_[1] = nextPC;
+		successorCounts_[1] = 1;
+	}
+
+	return ++execCount_ == threshold && traceLength_ == 0;
+}
+
+u32 IRBlock::GetLikelySuccessor() const {
+	// Need some history, and a strong bias, to be worth following.
+	if (execCount_ < 16)
+		return 0;
+	if ((u64)successorCounts_[0] * 4 >= (u64)execCount_ * 3)
+		return successors_[0];
+	return 0;
 }
 
 MIPSOpcode IRJit::GetOriginalOp(MIPSOpcode op) {
@@ -47,6 +47,12 @@ class IRBlock {
 		origSize_ = b.origSize_;
 		origFirstOpcode_ = b.origFirstOpcode_;
 		hash_ = b.hash_;
+		execCount_ = b.execCount_;
+		memcpy(successors_, b.successors_, sizeof(successors_));
+		memcpy(successorCounts_, b.successorCounts_, sizeof(successorCounts_));
+		traceLength_ = b.traceLength_;
+		coverStart_ = b.coverStart_;
+		coverSize_ = b.coverSize_;
 		b.instr_ = nullptr;
 	}
 
@@ -84,6 +90,28 @@ class IRBlock {
 		size = origSize_;
 	}
 
+	// Traces cover more code than the first block, this is what invalidation should check.
+	void SetCoveredRange(u32 start, u32 size) {
+		coverStart_ = start;
+		coverSize_ = size;
+	}
+	void GetCoveredRange(u32 &start, u32 &size) const {
+		if (coverSize_ != 0) {
+			start = coverStart_;
+			size = coverSize_;
+		} else {
+			GetRange(start, size);
+		}
+	}
+
+	// Counts an execution and where it went.  Returns true when the block just became hot.
+	bool RecordExecution(u32 nextPC, u32 threshold);
+	// Returns the successor taken most of the time, or 0 if there isn't a clear one.
+	u32 GetLikelySuccessor() const;
+	u32 GetExecCount() const { return execCount_; }
+	void SetTraceLength(int blocks) { traceLength_ = blocks; }
+	int GetTraceLength() const { return traceLength_; }
+
 	void Finalize(int number);
 	void Destroy(int number);
 
@@ -96,6 +124,14 @@ class IRBlock {
 	u32 origSize_;
 	u64 hash_ = 0;
 	MIPSOpcode origFirstOpcode_ = MIPSOpcode(0x68FFFFFF);
+
+	// Profiling for trace formation, only updated when traces are enabled.
+	u32 execCount_ = 0;
+	u32 successors_[2]{};
+	u32 successorCounts_[2]{};
+	int traceLength_ = 0;
+	u32 coverStart_ = 0;
+	u32 coverSize_ = 0;
 };
 
 class IRBlockCache : public JitBlockCacheDebugInterface {
@@ -172,6 +208,9 @@ class IRJit : public JitInterface {
 
 private:
 	bool CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	void CompileTrace(int headBlockNum);
+	void RunBlocks();
+	void HandleFastmemFault(u32 guestAddress);
 	bool ReplaceJalTo(u32 dest);
 
 	JitOptions jo;
@@ -181,6 +220,14 @@ class IRJit : public JitInterface {
 
 	MIPSState *mips_;
 
+	// Executions before a block is recompiled as a trace, 0 if disabled.
+	u32 traceThreshold_ = 0;
+
+	// The interpreted block, so a fastmem fault can continue after the access.
+	int runningBlock_ = -1;
+	int resumeBlock_ = -1;
+	const IRInst *resumeInst_ = nullptr;
+
 	// where to write branch-likely trampolines. not used atm
 	// u32 blTrampolines_;
 	// int blTrampolineCount_;
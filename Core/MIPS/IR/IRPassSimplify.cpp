@@ -6,9 +6,11 @@
 #include "Common/Data/Convert/SmallDataConvert.h"
 #include "Common/Log.h"
 #include "Core/Config.h"
+#include "Core/MemMap.h"
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/IR/IRPassSimplify.h"
 #include "Core/MIPS/IR/IRRegCache.h"
+#include "Core/MIPS/JitCommon/JitState.h"
 
 // #define CONDITIONAL_DISABLE { for (IRInst inst : in.GetInstructions()) { out.Write(inst); } return false; }
 #define CONDITIONAL_DISABLE
@@ -162,7 +164,7 @@ bool OptimizeFPMoves(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	return logBlocks;
 }
 
-// Might be useful later on x86.
+// Might be useful later on x86.  The IR interpreter has three operand ops, so this only adds Movs there.
 bool ThreeOpToTwoOp(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	CONDITIONAL_DISABLE;
 
@@ -1043,8 +1045,6 @@ static std::vector<IRInst> ReorderLoadStoreOps(std::vector<IRInst> &ops) {
 		case IROp::Load16:
 		case IROp::Load16Ext:
 		case IROp::Load32:
-		case IROp::Load32Left:
-		case IROp::Load32Right:
 			modifiesReg = true;
 			if (ops[i].src1 == ops[i].dest) {
 				// Can't ever reorder these, since it changes.
@@ -1055,10 +1055,9 @@ static std::vector<IRInst> ReorderLoadStoreOps(std::vector<IRInst> &ops) {
 		case IROp::Store8:
 		case IROp::Store16:
 		case IROp::Store32:
-		case IROp::Store32Left:
-		case IROp::Store32Right:
 			break;
 
+		// Left/right ops at nearby offsets may touch the same word, so they keep their order.
 		case IROp::LoadFloat:
 		case IROp::LoadVec4:
 			usesFloatReg = true;
@@ -1112,6 +1111,8 @@ static std::vector<IRInst> ReorderLoadStoreOps(std::vector<IRInst> &ops) {
 
 bool ReorderLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	CONDITIONAL_DISABLE;
+	if ((opts.disableFlags & (uint32_t)MIPSComp::JitDisable::LSU_COMBINE) != 0)
+		DISABLE;
 
 	bool logBlocks = false;
 
@@ -1131,11 +1132,7 @@ bool ReorderLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts)
 			return;
 		}
 
-		std::vector<IRInst> loadStoreUnsorted = loadStoreQueue;
 		std::vector<IRInst> loadStoreSorted = ReorderLoadStoreOps(loadStoreQueue);
-		if (memcmp(&loadStoreSorted[0], &loadStoreUnsorted[0], sizeof(IRInst) * loadStoreSorted.size()) != 0) {
-			logBlocks = true;
-		}
 
 		queuing = false;
 		for (IRInst queued : loadStoreSorted) {
@@ -1304,11 +1301,15 @@ bool ReorderLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts)
 			break;
 		}
 	}
+	// Blocks normally end with an exit, but just in case.
+	flushQueue();
 	return logBlocks;
 }
 
 bool MergeLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 	CONDITIONAL_DISABLE;
+	if ((opts.disableFlags & (uint32_t)MIPSComp::JitDisable::LSU_COMBINE) != 0)
+		DISABLE;
 
 	bool logBlocks = false;
 
@@ -1387,7 +1388,7 @@ bool MergeLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 			break;
 
 		case IROp::Load32:
-			if (prev.src1 == inst.src1 && prev.src2 == inst.src2) {
+			if (prev.src1 == inst.src1 && prev.constant == inst.constant) {
 				// A store and then an immediate load.  This is sadly common in minis.
 				if (prev.op == IROp::Store32 && prev.src3 == inst.dest) {
 					// Even the same reg, a volatile variable?  Skip it.
@@ -1411,7 +1412,7 @@ bool MergeLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts) {
 			break;
 
 		case IROp::LoadFloat:
-			if (prev.src1 == inst.src1 && prev.src2 == inst.src2) {
+			if (prev.src1 == inst.src1 && prev.constant == inst.constant) {
 				// A store and then an immediate load, of a float.
 				if (prev.op == IROp::StoreFloat && prev.src3 == inst.dest) {
 					// Volatile float, I suppose?
@@ -1496,3 +1497,359 @@ bool ApplyMemoryValidation(const IRWriter &in, IRWriter &out, const IROptions &o
 	}
 	return logBlocks;
 }
+
+static u32 ExitLiveGPRs(const IROptions &opts, u32 target) {
+	if (!opts.exitLiveGPRs)
+		return 0xFFFFFFFF;
+	auto it = opts.exitLiveGPRs->find(target);
+	return it == opts.exitLiveGPRs->end() ? 0xFFFFFFFF : it->second;
+}
+
+static int IRGPRLoadSize(IROp op) {
+	switch (op) {
+	case IROp::Load8:
+	case IROp::Load8Ext:
+		return 1;
+	case IROp::Load16:
+	case IROp::Load16Ext:
+		return 2;
+	case IROp::Load32:
+	case IROp::Load32Left:
+	case IROp::Load32Right:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+bool EliminateDeadGPRs(const IRWriter &in, IRWriter &out, const IROptions &opts) {
+	CONDITIONAL_DISABLE;
+	if (!opts.exitLiveGPRs)
+		DISABLE;
+
+	const std::vector<IRInst> &insts = in.GetInstructions();
+	std::vector<bool> dead(insts.size(), false);
+
+	// Walk backwards tracking which MIPS GPRs might still be read.  Temps and other regs are left to other passes.
+	bool logBlocks = false;
+	u32 live = 0xFFFFFFFF;
+	for (int i = (int)insts.size() - 1; i >= 0; --i) {
+		const IRInst &inst = insts[i];
+		const IRMeta *m = GetIRMeta(inst.op);
+
+		switch (inst.op) {
+		case IROp::ExitToConst:
+			live = ExitLiveGPRs(opts, inst.constant);
+			continue;
+
+		case IROp::ExitToConstIfEq:
+		case IROp::ExitToConstIfNeq:
+		case IROp::ExitToConstIfGtZ:
+		case IROp::ExitToConstIfGeZ:
+		case IROp::ExitToConstIfLtZ:
+		case IROp::ExitToConstIfLeZ:
+			live |= ExitLiveGPRs(opts, inst.constant);
+			break;
+
+		case IROp::Interpret:
+		case IROp::CallReplacement:
+		case IROp::Syscall:
+		case IROp::Break:
+		case IROp::Breakpoint:
+		case IROp::MemoryCheck:
+		case IROp::ExitToPC:
+		case IROp::ExitToReg:
+			live = 0xFFFFFFFF;
+			break;
+
+		default:
+			if (!m || (m->flags & IRFLAG_EXIT) != 0) {
+				// Any other way out, we don't know what's next.
+				live = 0xFFFFFFFF;
+			}
+			break;
+		}
+		if (!m)
+			continue;
+
+		int dest = IRDestGPR(inst);
+		if (dest > 0 && dest < 32 && (m->flags & IRFLAG_EXIT) == 0) {
+			// A load from a bad address still has to fault, so only drop loads from constant valid addresses.
+			const int loadSize = IRGPRLoadSize(inst.op);
+			const bool mayFault = loadSize != 0 && (inst.src1 != MIPS_REG_ZERO || !Memory::IsValidRange(inst.constant & ~(loadSize - 1), loadSize));
+			if ((live & (1U << dest)) == 0 && !mayFault) {
+				// Nothing reads this before it's overwritten or we leave, so drop it.
+				dead[i] = true;
+				continue;
+			}
+			if ((m->flags & IRFLAG_SRC3DST) == 0)
+				live &= ~(1U << dest);
+		}
+
+		if (m->types[1] == 'G' && inst.src1 < 32)
+			live |= 1U << inst.src1;
+		if (m->types[2] == 'G' && inst.src2 < 32)
+			live |= 1U << inst.src2;
+		if ((m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) != 0 && m->types[0] == 'G' && inst.src3 < 32)
+			live |= 1U << inst.src3;
+	}
+
+	for (size_t i = 0; i < insts.size(); ++i) {
+		if (!dead[i])
+			out.Write(insts[i]);
+	}
+	return logBlocks;
+}
+
+static IROp FPUToVec4Op(IROp op) {
+	switch (op) {
+	case IROp::FAdd: return IROp::Vec4Add;
+	case IROp::FSub: return IROp::Vec4Sub;
+	case IROp::FMul: return IROp::Vec4Mul;
+	case IROp::FDiv: return IROp::Vec4Div;
+	case IROp::FMov: return IROp::Vec4Mov;
+	case IROp::FNeg: return IROp::Vec4Neg;
+	case IROp::FAbs: return IROp::Vec4Abs;
+	default: return IROp::Nop;
+	}
+}
+
+// Whether an instruction reads or writes the FPR reg, including through Vec2/Vec4 operands.
+static void IRAccessesFPR(const IRInst &inst, const IRMeta *m, int reg, bool &reads, bool &writes) {
+	reads = false;
+	writes = false;
+	const u8 regs[3] = { inst.dest, inst.src1, inst.src2 };
+	for (int i = 0; i < 3 && m->types[i] != 0; ++i) {
+		int count = m->types[i] == 'F' ? 1 : m->types[i] == '2' ? 2 : m->types[i] == 'V' ? 4 : 0;
+		if (reg < regs[i] || reg >= regs[i] + count)
+			continue;
+		if (i != 0 || (m->flags & (IRFLAG_SRC3 | IRFLAG_SRC3DST)) != 0)
+			reads = true;
+		if (i == 0 && (m->flags & IRFLAG_SRC3) == 0)
+			writes = true;
+	}
+}
+
+static bool IsVectorizeBarrier(const IRInst &inst, const IRMeta *m) {
+	if (!m || (m->flags & IRFLAG_EXIT) != 0)
+		return true;
+	switch (inst.op) {
+	case IROp::Interpret:
+	case IROp::CallReplacement:
+	// Moving arithmetic across these would change its rounding.
+	case IROp::RestoreRoundingMode:
+	case IROp::ApplyRoundingMode:
+	case IROp::UpdateRoundingMode:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Whether the aligned group of four FPRs at reg is free to use as scratch after instruction end.
+// Temps are dead at exits, so it's enough that nothing reads them before writing them.
+static bool IsVec4ScratchDeadAfter(const std::vector<IRInst> &insts, int end, int reg) {
+	bool written[4]{};
+	for (int j = end + 1; j < (int)insts.size(); ++j) {
+		const IRInst &inst = insts[j];
+		const IRMeta *m = GetIRMeta(inst.op);
+		if (!m || inst.op == IROp::Interpret || inst.op == IROp::CallReplacement)
+			return false;
+		for (int k = 0; k < 4; ++k) {
+			bool reads, writes;
+			IRAccessesFPR(inst, m, reg + k, reads, writes);
+			if (reads && !written[k])
+				return false;
+			written[k] = written[k] || writes;
+		}
+		if ((m->flags & IRFLAG_EXIT) != 0)
+			break;
+	}
+	return true;
+}
+
+struct VectorizeGroup {
+	int lanes[4];
+	int dest;
+	int src1;
+	int src2;
+	bool scale;
+	// Vec4Shuffle masks to put the sources in lane order, 0xE4 when already in order.
+	u8 shuffle1;
+	u8 shuffle2;
+	// Where the shuffled sources go.
+	int scratch1;
+	int scratch2;
+};
+
+// Combines four scalar FPU ops on the lanes of aligned groups of four FPRs into one Vec4 op.
+// These come from scalar VFPU code (vadd.s on each component) and ops on rows the frontend can't do as Vec4.
+// Sources may be any lanes of one aligned group each, those get a Vec4Shuffle into a free temp group first.
+// Strided sources, like the rows of a matrix, span four groups and are left alone: gathering them costs
+// as many moves as the scalar ops it would save.
+bool VectorizeVFPU(const IRWriter &in, IRWriter &out, const IROptions &opts) {
+	CONDITIONAL_DISABLE;
+	if ((opts.disableFlags & (uint32_t)MIPSComp::JitDisable::SIMD) != 0)
+		DISABLE;
+
+	// How far past the first lane to look for the others.
+	static const int MAX_DISTANCE = 16;
+	static const u8 NO_SHUFFLE = 0xE4;
+	static const int scratchRegs[] = { IRVTEMP_0, IRVTEMP_PFX_T, IRVTEMP_PFX_S, IRVTEMP_PFX_D };
+
+	const std::vector<IRInst> &insts = in.GetInstructions();
+	const int n = (int)insts.size();
+	// For each lane member, the index of its group, or -1.
+	std::vector<int> groupOf(n, -1);
+	std::vector<VectorizeGroup> groups;
+
+	auto overlaps = [](int a, int b) {
+		return a < b + 4 && b < a + 4;
+	};
+
+	auto tryGroup = [&](int first, bool scale, VectorizeGroup &g) {
+		const IRInst &head = insts[first];
+		const IRMeta *m = GetIRMeta(head.op);
+		bool binary = m->types[2] == 'F';
+		g.scale = scale;
+		g.dest = head.dest & ~3;
+		g.src1 = head.src1 & ~3;
+		g.src2 = scale || !binary ? head.src2 : head.src2 & ~3;
+		// With a scalar inside the destination, the lanes after it would see the new value.
+		if (scale && g.src2 >= g.dest && g.src2 < g.dest + 4)
+			return false;
+
+		int from1[4], from2[4];
+		for (int k = 0; k < 4; ++k)
+			g.lanes[k] = -1;
+		int found = 0;
+		int last = first;
+		for (int j = first; j < n && j <= first + MAX_DISTANCE && found < 4; ++j) {
+			const IRInst &inst = insts[j];
+			if (j != first && IsVectorizeBarrier(inst, GetIRMeta(inst.op)))
+				break;
+			if (inst.op != head.op)
+				continue;
+			int l = inst.dest & 3;
+			if (g.lanes[l] != -1 || (inst.dest & ~3) != g.dest || (inst.src1 & ~3) != g.src1)
+				continue;
+			if (binary && (scale ? inst.src2 != g.src2 : (inst.src2 & ~3) != g.src2))
+				continue;
+			g.lanes[l] = j;
+			from1[l] = inst.src1 & 3;
+			from2[l] = inst.src2 & 3;
+			found++;
+			last = j;
+		}
+		if (found != 4)
+			return false;
+
+		g.shuffle1 = 0;
+		g.shuffle2 = 0;
+		for (int k = 0; k < 4; ++k) {
+			g.shuffle1 |= from1[k] << (k * 2);
+			g.shuffle2 |= from2[k] << (k * 2);
+		}
+		if (!binary || scale)
+			g.shuffle2 = NO_SHUFFLE;
+
+		// Every lane moves down to the last one, so nothing in between may depend on it or change its inputs.
+		for (int k = 0; k < 4; ++k) {
+			for (int j = g.lanes[k] + 1; j < last; ++j) {
+				if (j == g.lanes[0] || j == g.lanes[1] || j == g.lanes[2] || j == g.lanes[3])
+					continue;
+				const IRInst &inst = insts[j];
+				const IRMeta *jm = GetIRMeta(inst.op);
+				bool reads, writes;
+				IRAccessesFPR(inst, jm, g.dest + k, reads, writes);
+				if (reads || writes)
+					return false;
+				IRAccessesFPR(inst, jm, g.src1 + from1[k], reads, writes);
+				if (writes)
+					return false;
+				if (binary) {
+					IRAccessesFPR(inst, jm, scale ? g.src2 : g.src2 + from2[k], reads, writes);
+					if (writes)
+						return false;
+				}
+			}
+			// The lanes themselves only touch their own lane, unless the sources were shuffled in place.
+			for (int o = 0; o < 4; ++o) {
+				if (g.lanes[o] >= g.lanes[k])
+					continue;
+				if (g.dest + o == g.src1 + from1[k] || (binary && !scale && g.dest + o == g.src2 + from2[k]))
+					return false;
+			}
+		}
+
+		// Find temp groups for the shuffled sources, free after the last lane and clear of the operands.
+		g.scratch1 = -1;
+		g.scratch2 = -1;
+		for (int reg : scratchRegs) {
+			bool needed = (g.shuffle1 != NO_SHUFFLE && g.scratch1 == -1) || (g.shuffle2 != NO_SHUFFLE && g.scratch2 == -1);
+			if (!needed)
+				break;
+			if (overlaps(reg, g.dest) || overlaps(reg, g.src1) || (binary && overlaps(reg, g.src2 & ~3)))
+				continue;
+			if (!IsVec4ScratchDeadAfter(insts, last, reg))
+				continue;
+			if (g.shuffle1 != NO_SHUFFLE && g.scratch1 == -1)
+				g.scratch1 = reg;
+			else
+				g.scratch2 = reg;
+		}
+		if ((g.shuffle1 != NO_SHUFFLE && g.scratch1 == -1) || (g.shuffle2 != NO_SHUFFLE && g.scratch2 == -1))
+			return false;
+		return true;
+	};
+
+	bool logBlocks = false;
+	int lastGroupEnd = -1;
+	for (int i = 0; i < n; ++i) {
+		// Keep groups from interleaving, so each can be checked against the original order.
+		if (i <= lastGroupEnd || FPUToVec4Op(insts[i].op) == IROp::Nop)
+			continue;
+
+		// A shared scalar would also work as a broadcast shuffle, but Vec4Scale is cheaper.
+		VectorizeGroup g;
+		bool formed = insts[i].op == IROp::FMul && tryGroup(i, true, g);
+		if (!formed)
+			formed = tryGroup(i, false, g);
+		if (!formed)
+			continue;
+
+		int last = std::max(std::max(g.lanes[0], g.lanes[1]), std::max(g.lanes[2], g.lanes[3]));
+		for (int k = 0; k < 4; ++k)
+			groupOf[g.lanes[k]] = (int)groups.size();
+		groups.push_back(g);
+		lastGroupEnd = last;
+	}
+
+	for (int i = 0; i < n; ++i) {
+		if (groupOf[i] == -1) {
+			out.Write(insts[i]);
+			continue;
+		}
+		const VectorizeGroup &g = groups[groupOf[i]];
+		if (std::max(std::max(g.lanes[0], g.lanes[1]), std::max(g.lanes[2], g.lanes[3])) != i)
+			continue;
+
+		IRInst inst = insts[i];
+		inst.op = g.scale ? IROp::Vec4Scale : FPUToVec4Op(inst.op);
+		inst.dest = g.dest;
+		inst.src1 = g.src1;
+		if (g.shuffle1 != NO_SHUFFLE) {
+			out.Write(IROp::Vec4Shuffle, g.scratch1, g.src1, g.shuffle1);
+			inst.src1 = g.scratch1;
+		}
+		if (GetIRMeta(inst.op)->types[2] == 'V') {
+			inst.src2 = g.src2;
+			if (g.shuffle2 != NO_SHUFFLE) {
+				out.Write(IROp::Vec4Shuffle, g.scratch2, g.src2, g.shuffle2);
+				inst.src2 = g.scratch2;
+			}
+		}
+		out.Write(inst);
+	}
+	return logBlocks;
+}
@@ -5,6 +5,13 @@
 typedef bool (*IRPassFunc)(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool IRApplyPasses(const IRPassFunc *passes, size_t c, const IRWriter &in, IRWriter &out, const IROptions &opts);
 
+struct IRNamedPass {
+	const char *name;
+	IRPassFunc func;
+	// Only run when IROptions::experimentalPasses is set, until validated on dumped game blocks.
+	bool experimental;
+};
+
 // Block optimizer passes of varying usefulness.
 bool RemoveLoadStoreLeftRight(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool PropagateConstants(const IRWriter &in, IRWriter &out, const IROptions &opts);
@@ -14,4 +21,6 @@ bool ThreeOpToTwoOp(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool OptimizeFPMoves(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool ReorderLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool MergeLoadStore(const IRWriter &in, IRWriter &out, const IROptions &opts);
+bool EliminateDeadGPRs(const IRWriter &in, IRWriter &out, const IROptions &opts);
+bool VectorizeVFPU(const IRWriter &in, IRWriter &out, const IROptions &opts);
 bool ApplyMemoryValidation(const IRWriter &in, IRWriter &out, const IROptions &opts);
@@ -85,7 +85,7 @@ bool JitBlock::ContainsAddress(u32 em_address) {
 }
 
 bool JitBlockCache::IsFull() const {
-	return num_blocks_ >= MAX_NUM_BLOCKS - 1;
+	return MAX_NUM_BLOCKS - num_blocks_ + (int)freeBlocks_.size() <= 1;
 }
 
 void JitBlockCache::Init() {
@@ -118,7 +118,11 @@ void JitBlockCache::Clear() {
 	for (int i = 0; i < num_blocks_; i++)
 		DestroyBlock(i, DestroyType::CLEAR);
 	links_to_.clear();
+	entryOffsets_.clear();
+	freeBlocks_.clear();
+	evictedAddresses_.clear();
 	num_blocks_ = 0;
+	currentCodeRegion_ = 0;
 
 	blockMemRanges_[JITBLOCK_RANGE_SCRATCH] = std::make_pair(0xFFFFFFFF, 0x00000000);
 	blockMemRanges_[JITBLOCK_RANGE_RAMBOTTOM] = std::make_pair(0xFFFFFFFF, 0x00000000);
@@ -138,8 +142,18 @@ const JitBlock *JitBlockCache::GetBlock(int no) const {
 	return &blocks_[no];
 }
 
+int JitBlockCache::NextBlockNum() {
+	if (!freeBlocks_.empty()) {
+		int block_num = freeBlocks_.back();
+		freeBlocks_.pop_back();
+		return block_num;
+	}
+	return num_blocks_++;
+}
+
 int JitBlockCache::AllocateBlock(u32 startAddress) {
-	JitBlock &b = blocks_[num_blocks_];
+	const int block_num = NextBlockNum();
+	JitBlock &b = blocks_[block_num];
 
 	b.proxyFor = 0;
 	// If there's an existing pure proxy block at the address, we need to ditch it and create a new one,
@@ -164,9 +178,8 @@ int JitBlockCache::AllocateBlock(u32 startAddress) {
 		b.exitPtrs[i] = 0;
 		b.linkStatus[i] = false;
 	}
-	b.blockNum = num_blocks_;
-	num_blocks_++; //commit the current block
-	return num_blocks_ - 1;
+	b.blockNum = block_num;
+	return block_num;
 }
 
 void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, const u8 *codePtr) {
@@ -181,7 +194,8 @@ void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, cons
 		blocks_[num].proxyFor->push_back(rootAddress);
 	}
 
-	JitBlock &b = blocks_[num_blocks_];
+	const int block_num = NextBlockNum();
+	JitBlock &b = blocks_[block_num];
 	b.invalid = false;
 	b.originalAddress = startAddress;
 	b.originalSize = size;
@@ -191,17 +205,16 @@ void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, cons
 		b.linkStatus[i] = false;
 	}
 	b.exitAddress[0] = rootAddress;
-	b.blockNum = num_blocks_;
+	b.blockNum = block_num;
 	b.proxyFor = new std::vector<u32>();
 	b.SetPureProxy();  // flag as pure proxy block.
 
 	// Make binary searches and stuff work ok
 	b.normalEntry = codePtr;
 	b.checkedEntry = codePtr;
-	proxyBlockMap_.emplace(startAddress, num_blocks_);
-	AddBlockMap(num_blocks_);
-
-	num_blocks_++; //commit the current block
+	b.codeSize = 0;
+	proxyBlockMap_.emplace(startAddress, block_num);
+	AddBlockMap(block_num);
 }
 
 void JitBlockCache::AddBlockMap(int block_num) {
@@ -249,6 +262,9 @@ void JitBlockCache::FinalizeBlock(int block_num, bool block_link) {
 	b.compiledHash = HashJitBlock(b);
 
 	AddBlockMap(block_num);
+	entryOffsets_[(u32)codeBlock_->GetOffset(b.normalEntry)] = block_num;
+	if (!evictedAddresses_.empty() && evictedAddresses_.erase(b.originalAddress) != 0)
+		numRecompiles_++;
 
 	if (block_link) {
 		for (int i = 0; i < MAX_JIT_BLOCK_EXITS; i++) {
@@ -304,39 +320,25 @@ bool JitBlockCache::RangeMayHaveEmuHacks(u32 start, u32 end) const {
 	return false;
 }
 
-static int binary_search(JitBlock blocks_[], const u8 *baseoff, int imin, int imax) {
-	while (imin < imax) {
-		int imid = (imin + imax) / 2;
-		if (blocks_[imid].normalEntry < baseoff)
-			imin = imid + 1;
-		else
-			imax = imid;
-	}
-	if ((imax == imin) && (blocks_[imin].normalEntry == baseoff))
-		return imin;
-	else
-		return -1;
-}
-
 int JitBlockCache::GetBlockNumberFromEmuHackOp(MIPSOpcode inst, bool ignoreBad) const {
 	if (!num_blocks_ || !MIPS_IS_EMUHACK(inst)) // definitely not a JIT block
 		return -1;
 	int off = (inst & MIPS_EMUHACK_VALUE_MASK);
 
 	const u8 *baseoff = codeBlock_->GetBasePtr() + off;
-	if (baseoff < codeBlock_->GetBasePtr() || baseoff >= codeBlock_->GetCodePtr()) {
+	if (!codeBlock_->IsInSpace(baseoff)) {
 		if (!ignoreBad) {
 			ERROR_LOG(JIT, "JitBlockCache: Invalid Emuhack Op %08x", inst.encoding);
 		}
 		return -1;
 	}
 
-	int bl = binary_search(blocks_, baseoff, 0, num_blocks_ - 1);
-	if (bl >= 0 && blocks_[bl].invalid) {
+	// Blocks aren't in code order once regions get reused, so we can't binary search.
+	auto it = entryOffsets_.find((u32)off);
+	if (it == entryOffsets_.end() || blocks_[it->second].invalid) {
 		return -1;
-	} else {
-		return bl;
 	}
+	return it->second;
 }
 
 MIPSOpcode JitBlockCache::GetEmuHackOpForBlock(int blockNum) const {
@@ -511,7 +513,8 @@ void JitBlockCache::DestroyBlock(int block_num, DestroyType type) {
 			int proxied_blocknum = GetBlockNumberFromStartAddress((*b->proxyFor)[i], false);
 			// If it was already cleared, we don't know which to destroy.
 			if (proxied_blocknum != -1) {
-				DestroyBlock(proxied_blocknum, type);
+				// When evicting, the root may be in another region that stays around, so it must be unlinked.
+				DestroyBlock(proxied_blocknum, type == DestroyType::EVICT ? DestroyType::INVALIDATE : type);
 			}
 		}
 		b->proxyFor->clear();
@@ -554,7 +557,7 @@ void JitBlockCache::DestroyBlock(int block_num, DestroyType type) {
 
 	if (b->checkedEntry) {
 		// We can skip this if we're clearing anyway, which cuts down on protect back and forth on WX exclusive.
-		if (type != DestroyType::CLEAR) {
+		if (type != DestroyType::CLEAR && type != DestroyType::EVICT) {
 			u8 *writableEntry = codeBlock_->GetWritablePtrFromCodePtr(b->checkedEntry);
 			MIPSComp::jit->UnlinkBlock(writableEntry, b->originalAddress);
 		}
@@ -563,6 +566,108 @@ void JitBlockCache::DestroyBlock(int block_num, DestroyType type) {
 	}
 }
 
+void JitBlockCache::InitCodeRegions(size_t startOffset, size_t endOffset, bool recycle) {
+	recycleCodeRegions_ = recycle;
+	codeSpaceEnd_ = endOffset;
+	// Keep region boundaries on a coarse grid, so they don't share pages under WX exclusive.
+	// The first region just starts wherever the fixed code ended.
+	const size_t align = 0x10000;
+	codeRegionStart_ = startOffset;
+	codeRegionGrid_ = (startOffset + align - 1) & ~(align - 1);
+	codeRegionSize_ = ((endOffset - codeRegionGrid_) / NUM_CODE_REGIONS) & ~(align - 1);
+	currentCodeRegion_ = 0;
+}
+
+size_t JitBlockCache::CodeRegionBegin(int region) const {
+	return region == 0 ? codeRegionStart_ : codeRegionGrid_ + region * codeRegionSize_;
+}
+
+size_t JitBlockCache::CodeRegionEnd(int region) const {
+	return codeRegionGrid_ + (region + 1) * codeRegionSize_;
+}
+
+size_t JitBlockCache::GetCodeRegionSpaceLeft() const {
+	const size_t offset = codeBlock_->GetOffset(codeBlock_->GetCodePtr());
+	const size_t end = recycleCodeRegions_ ? CodeRegionEnd(currentCodeRegion_) : codeSpaceEnd_;
+	return offset < end ? end - offset : 0;
+}
+
+void JitBlockCache::EvictNextCodeRegion(size_t *offset, size_t *size) {
+	_dbg_assert_(recycleCodeRegions_);
+	currentCodeRegion_ = (currentCodeRegion_ + 1) % NUM_CODE_REGIONS;
+	*offset = CodeRegionBegin(currentCodeRegion_);
+	*size = CodeRegionEnd(currentCodeRegion_) - *offset;
+
+	const u8 *regionBegin = codeBlock_->GetBasePtr() + *offset;
+	const u8 *regionEnd = regionBegin + *size;
+	auto inRegion = [&](const JitBlock &b) {
+		return b.checkedEntry >= regionBegin && b.checkedEntry < regionEnd;
+	};
+
+	// Includes invalid blocks, their code is still there and might have been linked to.
+	std::vector<int> evicting;
+	std::unordered_set<u32> evictingAddresses;
+	for (int block_num = 0; block_num < num_blocks_; ++block_num) {
+		const JitBlock &b = blocks_[block_num];
+		if (inRegion(b)) {
+			evicting.push_back(block_num);
+			if (!b.IsPureProxy())
+				evictingAddresses.insert(b.originalAddress);
+		}
+	}
+
+	for (int block_num : evicting) {
+		JitBlock &b = blocks_[block_num];
+		DestroyBlock(block_num, DestroyType::EVICT);
+
+		for (int e = 0; e < MAX_JIT_BLOCK_EXITS; e++) {
+			if (b.exitAddress[e] == INVALID_EXIT)
+				continue;
+			auto range = links_to_.equal_range(b.exitAddress[e]);
+			for (auto it = range.first; it != range.second; ++it) {
+				if (it->second == block_num) {
+					links_to_.erase(it);
+					break;
+				}
+			}
+		}
+		if (!b.IsPureProxy()) {
+			auto it = entryOffsets_.find((u32)codeBlock_->GetOffset(b.normalEntry));
+			if (it != entryOffsets_.end() && it->second == block_num)
+				entryOffsets_.erase(it);
+			evictedAddresses_.insert(b.originalAddress);
+		}
+
+		// Leave the slot in a state nothing will match, until it's reused.
+		b.checkedEntry = nullptr;
+		b.normalEntry = nullptr;
+		b.codeSize = 0;
+		b.originalSize = 0;
+		freeBlocks_.push_back(block_num);
+	}
+
+	// Blocks elsewhere may jump straight into this region.  We don't keep track of which
+	// exits were physically linked, so destroy anything that exits to an evicted address.
+	// Their checked entry gets sent back to the dispatcher, so it's safe to leave their code.
+	if (!evictingAddresses.empty()) {
+		for (int block_num = 0; block_num < num_blocks_; ++block_num) {
+			const JitBlock &b = blocks_[block_num];
+			if (b.invalid || b.IsPureProxy() || inRegion(b))
+				continue;
+			for (int e = 0; e < MAX_JIT_BLOCK_EXITS; e++) {
+				if (b.exitAddress[e] != INVALID_EXIT && evictingAddresses.count(b.exitAddress[e])) {
+					DestroyBlock(block_num, DestroyType::INVALIDATE);
+					break;
+				}
+			}
+		}
+	}
+
+	numEvictions_++;
+	numEvictedBlocks_ += (int)evicting.size();
+	INFO_LOG(JIT, "Evicted code region %d (%d blocks)", currentCodeRegion_, (int)evicting.size());
+}
+
 void JitBlockCache::InvalidateICache(u32 address, const u32 length) {
 	// Convert the logical address to a physical address for the block map
 	const u32 pAddr = address & 0x1FFFFFFF;
@@ -640,11 +745,14 @@ void JitBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 	double totalBloat = 0.0;
 	double maxBloat = 0.0;
 	double minBloat = 1000000000.0;
+	double liveCodeSize = 0.0;
 	for (int i = 0; i < num_blocks_; i++) {
 		const JitBlock *b = GetBlock(i);
 		double codeSize = (double)b->codeSize;
 		if (codeSize == 0)
 			continue;
+		if (!b->invalid)
+			liveCodeSize += codeSize;
 		double origSize = (double)(4 * b->originalSize);
 		double bloat = codeSize / origSize;
 		if (bloat < minBloat) {
@@ -658,10 +766,18 @@ void JitBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 		totalBloat += bloat;
 		bcStats.bloatMap[(float)bloat] = b->originalAddress;
 	}
-	bcStats.numBlocks = num_blocks_;
+	bcStats.numBlocks = num_blocks_ - (int)freeBlocks_.size();
 	bcStats.minBloat = (float)minBloat;
 	bcStats.maxBloat = (float)maxBloat;
-	bcStats.avgBloat = (float)(totalBloat / (double)num_blocks_);
+	bcStats.avgBloat = (float)(totalBloat / (double)bcStats.numBlocks);
+
+	bcStats.numEvictions = numEvictions_;
+	bcStats.numEvictedBlocks = numEvictedBlocks_;
+	bcStats.numRecompiles = numRecompiles_;
+	if (codeRegionSize_ != 0) {
+		const size_t total = CodeRegionEnd(NUM_CODE_REGIONS - 1) - codeRegionStart_;
+		bcStats.codeOccupancy = (float)(liveCodeSize / (double)total);
+	}
 }
 
 JitBlockDebugInfo JitBlockCache::GetBlockDebugInfo(int blockNum) const {
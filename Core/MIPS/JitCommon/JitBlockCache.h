@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
 
@@ -44,6 +45,11 @@ struct BlockCacheStats {
 	float maxBloat;
 	u32 maxBloatBlock;
 	std::map<float, u32> bloatMap;
+	// Code region recycling, see JitBlockCache::EvictNextCodeRegion().
+	int numEvictions = 0;
+	int numEvictedBlocks = 0;
+	int numRecompiles = 0;
+	float codeOccupancy = 0.0f;
 };
 
 enum class DestroyType {
@@ -51,6 +57,8 @@ enum class DestroyType {
 	INVALIDATE,
 	// Skips jit unlink, since it'll be poisoned anyway.
 	CLEAR,
+	// Skips jit unlink, since the code region is about to be reused.
+	EVICT,
 };
 
 // Define this in order to get VTune profile support for the Jit generated code.
@@ -102,6 +110,9 @@ struct JitBlockDebugInfo {
 	std::vector<std::string> origDisasm;
 	std::vector<std::string> irDisasm;  // if any
 	std::vector<std::string> targetDisasm;
+	// Only tracked by backends that form traces.
+	uint32_t execCount = 0;
+	int traceLength = 0;
 };
 
 class JitBlockCacheDebugInterface {
@@ -132,6 +143,18 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 	bool IsFull() const;
 	void ComputeStats(BlockCacheStats &bcStats) const override;
 
+	// Splits the code space into regions that are reused oldest first when space runs out,
+	// instead of clearing everything.  Offsets are relative to the code block's base.
+	// Without recycle, it's all one region and the jit should clear the cache when it's full.
+	void InitCodeRegions(size_t startOffset, size_t endOffset, bool recycle);
+	bool RecyclesCodeRegions() const {
+		return recycleCodeRegions_;
+	}
+	size_t GetCodeRegionSpaceLeft() const;
+	// Destroys every block in the next (oldest) region, and anything linked directly into it.
+	// The caller should continue emitting code at offset.
+	void EvictNextCodeRegion(size_t *offset, size_t *size);
+
 	// Code Cache
 	JitBlock *GetBlock(int block_num);
 	const JitBlock *GetBlock(int block_num) const;
@@ -170,9 +193,14 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 
 	enum {
 		MAX_BLOCK_INSTRUCTIONS = 0x4000,
+		NUM_CODE_REGIONS = 4,
 	};
 
 private:
+	int NextBlockNum();
+	size_t CodeRegionBegin(int region) const;
+	size_t CodeRegionEnd(int region) const;
+
 	void LinkBlockExits(int i);
 	void LinkBlock(int i);
 	void UnlinkBlock(int i);
@@ -189,6 +217,22 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 	int num_blocks_;
 	std::unordered_multimap<u32, int> links_to_;
 	std::map<std::pair<u32,u32>, u32> block_map_; // (end_addr, start_addr) -> number
+	// Code offset of normalEntry -> number, for finalized (non-proxy) blocks.
+	std::unordered_map<u32, int> entryOffsets_;
+	// Slots below num_blocks_ freed by eviction.
+	std::vector<int> freeBlocks_;
+
+	bool recycleCodeRegions_ = false;
+	size_t codeSpaceEnd_ = 0;
+	size_t codeRegionStart_ = 0;
+	size_t codeRegionGrid_ = 0;
+	size_t codeRegionSize_ = 0;
+	int currentCodeRegion_ = 0;
+
+	std::unordered_set<u32> evictedAddresses_;
+	int numEvictions_ = 0;
+	int numEvictedBlocks_ = 0;
+	int numRecompiles_ = 0;
 
 	enum {
 		JITBLOCK_RANGE_SCRATCH = 0,
@@ -200,6 +200,8 @@ namespace MIPSComp {
 		LSU_UNALIGNED = 0x2000,
 		LSU_FPU = 0x4000,
 		LSU_VFPU = 0x8000,
+		LSU_COMBINE = 0x00010000,
+		REG_LIVENESS = 0x00020000,
 
 		SIMD = 0x00100000,
 		BLOCKLINK = 0x00200000,
@@ -169,6 +169,7 @@ void MIPSState::Shutdown() {
 		MIPSComp::jit = nullptr;
 		delete oldjit;
 	}
+	MIPSInterpret_ShutdownCache();
 }
 
 void MIPSState::Reset() {
@@ -344,14 +345,17 @@ int MIPSState::RunLoopUntil(u64 globalTicks) {
 }
 
 void MIPSState::InvalidateICache(u32 address, int length) {
-	// Only really applies to jit.
+	// Applies to the jit and the interpreter's decode cache.
 	std::lock_guard<std::recursive_mutex> guard(MIPSComp::jitLock);
 	if (MIPSComp::jit)
 		MIPSComp::jit->InvalidateCacheAt(address, length);
+	if (length > 0)
+		MIPSInterpret_InvalidateCache(address, (u32)length);
 }
 
 void MIPSState::ClearJitCache() {
 	std::lock_guard<std::recursive_mutex> guard(MIPSComp::jitLock);
 	if (MIPSComp::jit)
 		MIPSComp::jit->ClearCache();
+	MIPSInterpret_ClearCache();
 }
@@ -755,6 +755,136 @@ namespace MIPSAnalyst {
 		return results;
 	}
 	
+	// Keeps analysis reasonably quick, larger functions are rare and usually generated code.
+	static const u32 MAX_LIVENESS_FUNC_SIZE = 0x10000;
+
+	static bool FindFunctionRange(u32 addr, u32 &start, u32 &end) {
+		std::lock_guard<std::recursive_mutex> guard(functions_lock);
+		for (const AnalyzedFunction &f : functions) {
+			if (addr >= f.start && addr <= f.end) {
+				start = f.start;
+				end = f.end + 4;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ComputeFunctionLiveness(u32 addr, FunctionLiveness &result) {
+		const u32 ALL_LIVE = 0xFFFFFFFF;
+
+		u32 start, end;
+		if (!FindFunctionRange(addr, start, end) || end <= start || end - start > MAX_LIVENESS_FUNC_SIZE)
+			return false;
+		if (!Memory::IsValidRange(start, end - start))
+			return false;
+
+		const int count = (end - start) / 4;
+		struct InstrFlow {
+			u32 uses;
+			u32 defs;
+			// Successor addresses, 0 if unused.  ALL_LIVE in uses means we don't care.
+			u32 next[3];
+		};
+		std::vector<InstrFlow> flow(count);
+
+		for (int i = 0; i < count; ++i) {
+			const u32 pc = start + i * 4;
+			MIPSOpcode op = Memory::Read_Opcode_JIT(pc);
+			MIPSInfo info = MIPSGetInfo(op);
+			InstrFlow &f = flow[i];
+			f.uses = 0;
+			f.defs = 0;
+			f.next[0] = pc + 4;
+			f.next[1] = 0;
+			f.next[2] = 0;
+
+			// Syscalls, replacements, and unknown instructions may look at any reg.
+			if (MIPS_IS_EMUHACK(op) || IsSyscall(op) || info.value == 0 || (info & BAD_INSTRUCTION) != 0) {
+				f.uses = ALL_LIVE;
+				continue;
+			}
+
+			MIPSGPReg outReg = GetOutGPReg(op);
+			// Ops like mtic only say they use "other" things, which may well be a GPR.
+			if ((info & (IN_OTHER | OUT_OTHER)) != 0 && (info & (IN_RS | IN_RT)) == 0 && outReg == MIPS_REG_INVALID) {
+				f.uses = ALL_LIVE;
+				continue;
+			}
+
+			if (info & IN_RS)
+				f.uses |= 1U << MIPS_GET_RS(op);
+			if (info & IN_RT)
+				f.uses |= 1U << MIPS_GET_RT(op);
+			if (outReg != MIPS_REG_INVALID) {
+				// A conditional move may keep the old value, so it's really a read.
+				if (info & IS_CONDMOVE)
+					f.uses |= 1U << outReg;
+				else
+					f.defs |= 1U << outReg;
+			}
+
+			if (info & LIKELY) {
+				// Skips the delay slot when not taken.
+				f.next[1] = pc + 8;
+			}
+
+			// Now figure out where the delay slot goes, if this was a branch.
+			if (i == 0)
+				continue;
+			MIPSOpcode branchOp = Memory::Read_Opcode_JIT(pc - 4);
+			MIPSInfo branchInfo = MIPSGetInfo(branchOp);
+			if ((branchInfo & DELAYSLOT) == 0 || MIPS_IS_EMUHACK(branchOp))
+				continue;
+
+			if ((info & DELAYSLOT) != 0 || (branchInfo & OUT_RA) != 0 || (branchInfo & (IS_JUMP | IN_IMM26)) == IS_JUMP) {
+				// Calls, register jumps, and branches in delay slots - who knows what gets read.
+				f.uses = ALL_LIVE;
+				continue;
+			}
+
+			u32 target;
+			if (branchInfo & IS_JUMP)
+				target = ((pc - 4) & 0xF0000000) | ((branchOp & 0x03FFFFFF) << 2);
+			else
+				target = pc + ((s32)(s16)(branchOp & 0xFFFF) << 2);
+			// Also include the fall through, in case something jumps right into a delay slot.
+			f.next[0] = target;
+			f.next[1] = pc + 4;
+		}
+
+		result.start = start;
+		result.end = end;
+		result.liveIn.assign(count, 0);
+
+		// Iterate backwards to a fixed point, loops usually need just a couple passes.
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (int i = count - 1; i >= 0; --i) {
+				const InstrFlow &f = flow[i];
+				u32 live = ALL_LIVE;
+				if (f.uses != ALL_LIVE) {
+					u32 out = 0;
+					for (u32 next : f.next) {
+						if (next == 0)
+							continue;
+						out |= result.LiveAt(next);
+					}
+					live = f.uses | (out & ~f.defs);
+				}
+				// The zero reg is never interesting.
+				live &= ~1U;
+				if (live != result.liveIn[i]) {
+					result.liveIn[i] = live;
+					changed = true;
+				}
+			}
+		}
+
+		return true;
+	}
+
 	void Reset() {
 		std::lock_guard<std::recursive_mutex> guard(functions_lock);
 		functions.clear();
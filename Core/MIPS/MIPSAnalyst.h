@@ -83,6 +83,25 @@ namespace MIPSAnalyst
 	// This tells us if the reg is clobbered within intrs of addr (e.g. it is surely not used.)
 	bool IsRegisterClobbered(MIPSGPReg reg, u32 addr, int instrs);
 
+	// GPRs that may be read before being written, for each instruction in a function.
+	// Calls, returns, and anything leaving the function conservatively keep every reg live.
+	struct FunctionLiveness {
+		u32 start = 0;
+		u32 end = 0;
+		std::vector<u32> liveIn;
+
+		bool Contains(u32 addr) const {
+			return addr >= start && addr < end && (addr & 3) == 0;
+		}
+		// Bitmask of live GPRs on entry to addr.  All bits are set for addresses outside.
+		u32 LiveAt(u32 addr) const {
+			return Contains(addr) ? liveIn[(addr - start) / 4] : 0xFFFFFFFF;
+		}
+	};
+
+	// Uses the scanned function containing addr.  Returns false if there's none.
+	bool ComputeFunctionLiveness(u32 addr, FunctionLiveness &result);
+
 	struct AnalyzedFunction {
 		u32 start;
 		u32 end;
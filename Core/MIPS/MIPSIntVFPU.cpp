@@ -618,6 +618,12 @@ namespace MIPSInt
 		default:
 			ApplySwizzleS(s, sz);
 		}
+		// A full quad of sine or cosine goes through the four lane versions, anything smaller per lane below.
+		const bool sinCos4 = n == 4 && (optype == 18 || optype == 19 || optype == 26);
+		if (sinCos4 && optype == 19)
+			vfpu_cos4(s, d);
+		else if (sinCos4)
+			vfpu_sin4(s, d);
 		for (int i = 0; i < n; i++) {
 			switch (optype) {
 			case 0: d[i] = s[i]; break; //vmov
@@ -629,14 +635,14 @@ namespace MIPSInt
 			case 16: d[i] = 1.0f / s[i]; break; //vrcp
 			case 17: d[i] = USE_VFPU_SQRT ? vfpu_rsqrt(s[i]) : 1.0f / sqrtf(s[i]); break; //vrsq
 				
-			case 18: { d[i] = vfpu_sin(s[i]); } break; //vsin
-			case 19: { d[i] = vfpu_cos(s[i]); } break; //vcos
+			case 18: if (!sinCos4) d[i] = vfpu_sin(s[i]); break; //vsin
+			case 19: if (!sinCos4) d[i] = vfpu_cos(s[i]); break; //vcos
 			case 20: d[i] = powf(2.0f, s[i]); break; //vexp2
 			case 21: d[i] = logf(s[i])/log(2.0f); break; //vlog2
 			case 22: d[i] = USE_VFPU_SQRT ? vfpu_sqrt(s[i])  : fabsf(sqrtf(s[i])); break; //vsqrt
 			case 23: d[i] = (float)(asinf(s[i]) / M_PI_2); break; //vasin
 			case 24: d[i] = -1.0f / s[i]; break; // vnrcp
-			case 26: { d[i] = -vfpu_sin(s[i]); } break; // vnsin
+			case 26: d[i] = sinCos4 ? -d[i] : -vfpu_sin(s[i]); break; // vnsin
 			case 28: d[i] = 1.0f / powf(2.0, s[i]); break; // vrexp2
 			default:
 				_dbg_assert_msg_( false, "Invalid VV2Op op type %d", optype);
@@ -15,6 +15,9 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <cstring>
+
 #include "Core/Core.h"
 #include "Core/System.h"
 #include "Core/MemMap.h"
@@ -957,6 +960,95 @@ void MIPSInterpret(MIPSOpcode op) {
 #define _RD   ((op>>11) & 0x1F)
 #define R(i)   (curMips->r[i])
 
+// Decoded instruction cache for the interpreter, so we don't walk the encoding tables twice
+// (once for the handler, once for the cycle estimate) for every instruction we run.
+// Pages are allocated on first execution and kept until MIPSInterpret_ShutdownCache().
+// Each entry remembers the opcode it was decoded from, and we compare it against memory on
+// every lookup, since games are free to write code without telling us.
+struct InterpretCacheEntry {
+	MIPSInterpretFunc func;
+	u32 op;
+	u32 cycles;
+};
+
+static const u32 INTERPRET_CACHE_PAGE_SHIFT = 12;
+static const u32 INTERPRET_CACHE_PAGE_ENTRIES = (1 << INTERPRET_CACHE_PAGE_SHIFT) / 4;
+// Covers everything up to the end of the largest possible user memory (0x0C000000.)
+static const u32 INTERPRET_CACHE_PAGES = 0x0C000000 >> INTERPRET_CACHE_PAGE_SHIFT;
+
+struct InterpretCachePage {
+	InterpretCacheEntry entries[INTERPRET_CACHE_PAGE_ENTRIES];
+};
+
+static InterpretCachePage *interpretCache[INTERPRET_CACHE_PAGES];
+static bool interpretCacheEnabled = true;
+
+static inline const InterpretCacheEntry *LookupInterpretCache(u32 pc) {
+	const u32 addr = pc & 0x3FFFFFFF;
+	const u32 pageIndex = addr >> INTERPRET_CACHE_PAGE_SHIFT;
+	if (pageIndex >= INTERPRET_CACHE_PAGES || (pc & 3) != 0)
+		return nullptr;
+
+	InterpretCachePage *page = interpretCache[pageIndex];
+	if (!page) {
+		if (!interpretCacheEnabled || !Memory::IsValidRange(pc & ~((1 << INTERPRET_CACHE_PAGE_SHIFT) - 1), 1 << INTERPRET_CACHE_PAGE_SHIFT))
+			return nullptr;
+		page = new InterpretCachePage();
+		interpretCache[pageIndex] = page;
+	} else if (!interpretCacheEnabled) {
+		return nullptr;
+	}
+
+	const u32 op = Memory::ReadUnchecked_U32(pc);
+	InterpretCacheEntry &entry = page->entries[(addr >> 2) & (INTERPRET_CACHE_PAGE_ENTRIES - 1)];
+	if (entry.op != op || !entry.func) {
+		const MIPSInstruction *instr = MIPSGetInstruction(MIPSOpcode(op));
+		// Let MIPSInterpret() report these.
+		if (!instr || !instr->interpret)
+			return nullptr;
+		entry.func = instr->interpret;
+		entry.cycles = instr->flags.cycles;
+		entry.op = op;
+	}
+	return &entry;
+}
+
+void MIPSInterpret_InvalidateCache(u32 address, u32 length) {
+	const u32 start = address & 0x3FFFFFFF;
+	if (length == 0 || start >= INTERPRET_CACHE_PAGES << INTERPRET_CACHE_PAGE_SHIFT)
+		return;
+	const u32 end = std::min(start + std::min(length, 0x3FFFFFFFU), INTERPRET_CACHE_PAGES << INTERPRET_CACHE_PAGE_SHIFT);
+
+	for (u32 pageIndex = start >> INTERPRET_CACHE_PAGE_SHIFT; pageIndex <= (end - 1) >> INTERPRET_CACHE_PAGE_SHIFT; ++pageIndex) {
+		InterpretCachePage *page = interpretCache[pageIndex];
+		if (!page)
+			continue;
+		const u32 pageStart = pageIndex << INTERPRET_CACHE_PAGE_SHIFT;
+		const u32 first = (std::max(start, pageStart) - pageStart) >> 2;
+		const u32 last = (std::min(end, pageStart + (1 << INTERPRET_CACHE_PAGE_SHIFT)) - pageStart + 3) >> 2;
+		memset(&page->entries[first], 0, (last - first) * sizeof(InterpretCacheEntry));
+	}
+}
+
+void MIPSInterpret_ClearCache() {
+	// Don't free here, this may be called while the interpreter is running.
+	for (InterpretCachePage *page : interpretCache) {
+		if (page)
+			memset(page, 0, sizeof(InterpretCachePage));
+	}
+}
+
+void MIPSInterpret_ShutdownCache() {
+	for (InterpretCachePage *&page : interpretCache) {
+		delete page;
+		page = nullptr;
+	}
+}
+
+void MIPSInterpret_EnableCache(bool enable) {
+	interpretCacheEnabled = enable;
+}
+
 
 int MIPSInterpret_RunUntil(u64 globalTicks)
 {
@@ -971,8 +1063,7 @@ int MIPSInterpret_RunUntil(u64 globalTicks)
 			// int cycles = 0;
 			{
 				again:
-				MIPSOpcode op = MIPSOpcode(Memory::Read_U32(curMips->pc));
-				//MIPSOpcode op = Memory::Read_Opcode_JIT(mipsr4k.pc);
+				const InterpretCacheEntry *cached = LookupInterpretCache(curMips->pc);
 
 		//2: check for breakpoint (VERY SLOW)
 #if defined(_DEBUG)
@@ -990,8 +1081,16 @@ int MIPSInterpret_RunUntil(u64 globalTicks)
 #endif
 
 				bool wasInDelaySlot = curMips->inDelaySlot;
-				MIPSInterpret(op);
-				curMips->downcount -= MIPSGetInstructionCycleEstimate(op);
+				if (cached) {
+					// The instruction may invalidate the cache (syscalls, cache ops), so don't touch cached after.
+					const u32 cycles = cached->cycles;
+					cached->func(MIPSOpcode(cached->op));
+					curMips->downcount -= cycles;
+				} else {
+					MIPSOpcode op = MIPSOpcode(Memory::Read_U32(curMips->pc));
+					MIPSInterpret(op);
+					curMips->downcount -= MIPSGetInstructionCycleEstimate(op);
+				}
 
 				if (curMips->inDelaySlot)
 				{
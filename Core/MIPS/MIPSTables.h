@@ -127,6 +127,11 @@ void MIPSDisAsm(MIPSOpcode op, u32 pc, char *out, bool tabsToSpaces = false);
 MIPSInfo MIPSGetInfo(MIPSOpcode op);
 void MIPSInterpret(MIPSOpcode op); //only for those rare ones
 int MIPSInterpret_RunUntil(u64 globalTicks);
+void MIPSInterpret_InvalidateCache(u32 address, u32 length);
+void MIPSInterpret_ClearCache();
+void MIPSInterpret_ShutdownCache();
+// Mostly for benchmarking, the cache is on by default.
+void MIPSInterpret_EnableCache(bool enable);
 MIPSInterpretFunc MIPSGetInterpretFunc(MIPSOpcode op);
 
 int MIPSGetInstructionCycleEstimate(MIPSOpcode op);
@@ -885,19 +885,64 @@ float vfpu_rsqrt(float a) {
 	return val.f;
 }
 
-float vfpu_sin(float a) {
+// sin/cos(x * pi/2) for |x| < 2 are evaluated from a table of sin/cos in steps of pi/512 over
+// [0, pi], plus short polynomials for the remainder.  The angle is rounded to double exactly like
+// (double)x * M_PI_2, and after conversion to float the result matches glibc's sin/cos of that
+// angle for every float in range.  Filled by InitVFPUSinCos().
+static const int VFPU_SINCOS_TABLE_STEPS = 256;
+static double vfpu_angle_table[2 * VFPU_SINCOS_TABLE_STEPS + 1];
+static double vfpu_sin_table[2 * VFPU_SINCOS_TABLE_STEPS + 1];
+static double vfpu_cos_table[2 * VFPU_SINCOS_TABLE_STEPS + 1];
+
+// Angle must be in [0, pi].
+static inline void vfpu_sincos_kernel(double angle, double &s, double &c) {
+	int i = (int)(angle * (VFPU_SINCOS_TABLE_STEPS / M_PI_2) + 0.5);
+	// Exact, since the angle is within a factor of two of the table angle (or i is 0.)
+	// The table angle is loaded rather than computed so this can't be fused.
+	double d = angle - vfpu_angle_table[i];
+	double d2 = d * d;
+	double sin_d = d * (1.0 - d2 * (1.0 / 6.0) + d2 * d2 * (1.0 / 120.0));
+	double cos_d = 1.0 - d2 * 0.5 + d2 * d2 * (1.0 / 24.0);
+	s = vfpu_sin_table[i] * cos_d + vfpu_cos_table[i] * sin_d;
+	c = vfpu_cos_table[i] * cos_d - vfpu_sin_table[i] * sin_d;
+}
+
+// These take the reduced value (-2 < x < 2) and return the result with the low bits masked.
+static inline float vfpu_sin_reduced(float x) {
+	double s, c;
+	vfpu_sincos_kernel(fabs((double)x * M_PI_2), s, c);
+	float2int result;
+	result.f = (float)(x < 0.0f ? -s : s);
+	result.i &= 0xFFFFFFFC;
+	return result.f;
+}
+
+static inline float vfpu_cos_reduced(float x) {
+	double s, c;
+	vfpu_sincos_kernel(fabs((double)x * M_PI_2), s, c);
+	float2int result;
+	result.f = (float)c;
+	result.i &= 0xFFFFFFFC;
+	return result.f;
+}
+
+// Applies the modulus for sin.  Returns false if out is already the result, otherwise out is
+// the reduced value to pass to vfpu_sin_reduced().
+static inline bool vfpu_sin_reduce(float a, float &out) {
 	float2int val;
 	val.f = a;
 
 	int32_t k = get_uexp(val.i);
 	if (k == 255) {
 		val.i = (val.i & 0xFF800001) | 1;
-		return val.f;
+		out = val.f;
+		return false;
 	}
 
 	if (k < 0x68) {
 		val.i &= 0x80000000;
-		return val.f;
+		out = val.f;
+		return false;
 	}
 
 	// Okay, now modulus by 4 to begin with (identical wave every 4.)
@@ -919,30 +964,34 @@ float vfpu_sin(float a) {
 
 	if (k <= 0 || mantissa == 0) {
 		val.i &= 0x80000000;
-		return val.f;
+		out = val.f;
+		return false;
 	}
 
 	// This is the value with modulus applied.
 	val.i = (val.i & 0x80000000) | (k << 23) | (mantissa & ~(1 << 23));
-	val.f = (float)sin((double)val.f * M_PI_2);
-	val.i &= 0xFFFFFFFC;
-	return val.f;
+	out = val.f;
+	return true;
 }
 
-float vfpu_cos(float a) {
+// Same for cos, but the result of vfpu_cos_reduced() must be negated if negate is set.
+static inline bool vfpu_cos_reduce(float a, float &out, bool &negate) {
 	float2int val;
 	val.f = a;
-	bool negate = false;
+	negate = false;
 
 	int32_t k = get_uexp(val.i);
 	if (k == 255) {
 		// Note: unlike sin, cos always returns +NAN.
 		val.i = (val.i & 0x7F800001) | 1;
-		return val.f;
+		out = val.f;
+		return false;
 	}
 
-	if (k < 0x68)
-		return 1.0f;
+	if (k < 0x68) {
+		out = 1.0f;
+		return false;
+	}
 
 	// Okay, now modulus by 4 to begin with (identical wave every 4.)
 	int32_t mantissa = get_mant(val.i);
@@ -961,17 +1010,35 @@ float vfpu_cos(float a) {
 	mantissa <<= norm_shift;
 	k -= norm_shift;
 
-	if (k <= 0 || mantissa == 0)
-		return negate ? -1.0f : 1.0f;
+	if (k <= 0 || mantissa == 0) {
+		out = negate ? -1.0f : 1.0f;
+		return false;
+	}
 
 	// This is the value with modulus applied.
 	val.i = (val.i & 0x80000000) | (k << 23) | (mantissa & ~(1 << 23));
 	if (val.f == 1.0f || val.f == -1.0f) {
-		return negate ? 0.0f : -0.0f;
+		out = negate ? 0.0f : -0.0f;
+		return false;
 	}
-	val.f = (float)cos((double)val.f * M_PI_2);
-	val.i &= 0xFFFFFFFC;
-	return negate ? -val.f : val.f;
+	out = val.f;
+	return true;
+}
+
+float vfpu_sin(float a) {
+	float reduced;
+	if (!vfpu_sin_reduce(a, reduced))
+		return reduced;
+	return vfpu_sin_reduced(reduced);
+}
+
+float vfpu_cos(float a) {
+	float reduced;
+	bool negate;
+	if (!vfpu_cos_reduce(a, reduced, negate))
+		return reduced;
+	float result = vfpu_cos_reduced(reduced);
+	return negate ? -result : result;
 }
 
 void vfpu_sincos(float a, float &s, float &c) {
@@ -1031,21 +1098,13 @@ void vfpu_sincos(float a, float &s, float &c) {
 	} else if (val.f == -1.0f) {
 		i_sine.f = negate ? 1.0f : -1.0f;
 		i_cosine.f = negate ? 0.0f : -0.0f;
-	} else if (negate) {
-		i_sine.f = (float)sin((double)-val.f * M_PI_2);
-		i_cosine.f = -(float)cos((double)val.f * M_PI_2);
 	} else {
-		double angle = (double)val.f * M_PI_2;
-#if defined(__linux__)
-		double d_sine;
-		double d_cosine;
-		sincos(angle, &d_sine, &d_cosine);
-		i_sine.f = (float)d_sine;
-		i_cosine.f = (float)d_cosine;
-#else
-		i_sine.f = (float)sin(angle);
-		i_cosine.f = (float)cos(angle);
-#endif
+		double d_sine, d_cosine;
+		vfpu_sincos_kernel(fabs((double)val.f * M_PI_2), d_sine, d_cosine);
+		if (val.f < 0.0f)
+			d_sine = -d_sine;
+		i_sine.f = (float)(negate ? -d_sine : d_sine);
+		i_cosine.f = (float)(negate ? -d_cosine : d_cosine);
 	}
 
 	i_sine.i &= 0xFFFFFFFC;
@@ -1055,6 +1114,40 @@ void vfpu_sincos(float a, float &s, float &c) {
 	return ;
 }
 
+// The modulus is per lane, then the table lookups and polynomials run for all four lanes in one
+// loop without branches, with lanes that didn't need them evaluating a dummy angle.
+void vfpu_sin4(const float *a, float *out) {
+	float reduced[4];
+	bool evaluate[4];
+	for (int i = 0; i < 4; ++i)
+		evaluate[i] = vfpu_sin_reduce(a[i], reduced[i]);
+	for (int i = 0; i < 4; ++i) {
+		float x = evaluate[i] ? reduced[i] : 0.0f;
+		float result = vfpu_sin_reduced(x);
+		out[i] = evaluate[i] ? result : reduced[i];
+	}
+}
+
+void vfpu_cos4(const float *a, float *out) {
+	float reduced[4];
+	bool evaluate[4];
+	bool negate[4];
+	for (int i = 0; i < 4; ++i)
+		evaluate[i] = vfpu_cos_reduce(a[i], reduced[i], negate[i]);
+	for (int i = 0; i < 4; ++i) {
+		float x = evaluate[i] ? reduced[i] : 0.0f;
+		float result = vfpu_cos_reduced(x);
+		if (negate[i])
+			result = -result;
+		out[i] = evaluate[i] ? result : reduced[i];
+	}
+}
+
 void InitVFPUSinCos() {
-	// TODO: Could prepare a CORDIC table here.
+	const double step = M_PI_2 / VFPU_SINCOS_TABLE_STEPS;
+	for (int i = 0; i <= 2 * VFPU_SINCOS_TABLE_STEPS; ++i) {
+		vfpu_angle_table[i] = i * step;
+		vfpu_sin_table[i] = sin(vfpu_angle_table[i]);
+		vfpu_cos_table[i] = cos(vfpu_angle_table[i]);
+	}
 }
@@ -53,6 +53,9 @@ inline int Xpose(int v) {
 extern float vfpu_sin(float);
 extern float vfpu_cos(float);
 extern void vfpu_sincos(float, float&, float&);
+// Four lanes at a time, same results as vfpu_sin/vfpu_cos per lane.
+extern void vfpu_sin4(const float *a, float *out);
+extern void vfpu_cos4(const float *a, float *out);
 
 inline float vfpu_asin(float angle) {
 	return (float)(asinf(angle) / M_PI_2);
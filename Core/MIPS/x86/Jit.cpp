@@ -113,6 +113,7 @@ Jit::Jit(MIPSState *mipsState)
 	fpr.SetEmitter(this);
 	AllocCodeSpace(1024 * 1024 * 16);
 	GenerateFixedCode(jo);
+	blocks.InitCodeRegions(GetOffset(GetCodePtr()), region_size, g_Config.bJitRecycleCodeSpace);
 
 	safeMemFuncs.Init(&thunks);
 
@@ -213,6 +214,25 @@ void Jit::ClearCache()
 	blocks.Clear();
 	ClearCodeSpace(0);
 	GenerateFixedCode(jo);
+	blocks.InitCodeRegions(GetOffset(GetCodePtr()), region_size, g_Config.bJitRecycleCodeSpace);
+}
+
+void Jit::RecycleCodeSpace() {
+	if (!blocks.RecyclesCodeRegions()) {
+		INFO_LOG(JIT, "Space left: %d", (int)GetSpaceLeft());
+		ClearCache();
+		return;
+	}
+
+	// Reuse the oldest code region rather than throwing everything away.
+	for (int i = 0; i < JitBlockCache::NUM_CODE_REGIONS; ++i) {
+		size_t offset, size;
+		blocks.EvictNextCodeRegion(&offset, &size);
+		ReuseCodeSpace(offset, size);
+		if (!blocks.IsFull())
+			return;
+	}
+	ClearCache();
 }
 
 void Jit::SaveFlags() {
@@ -271,8 +291,8 @@ void Jit::EatInstruction(MIPSOpcode op) {
 
 void Jit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
-	if (GetSpaceLeft() < 0x10000 || blocks.IsFull()) {
-		ClearCache();
+	if (blocks.GetCodeRegionSpaceLeft() < 0x10000 || blocks.IsFull()) {
+		RecycleCodeSpace();
 	}
 
 	if (!Memory::IsValidAddress(em_address) || (em_address & 3) != 0) {
@@ -405,7 +425,7 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 		}
 
 		// Safety check, in case we get a bunch of really large jit ops without a lot of branching.
-		if (GetSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
+		if (blocks.GetCodeRegionSpaceLeft() < 0x800 || js.numInstructions >= JitBlockCache::MAX_BLOCK_INSTRUCTIONS) {
 			FlushAll();
 			WriteExit(GetCompilerPC(), js.nextExit++);
 			js.compiling = false;
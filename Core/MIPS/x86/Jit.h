@@ -181,6 +181,7 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 
 private:
 	void GenerateFixedCode(JitOptions &jo);
+	void RecycleCodeSpace();
 	void GetStateAndFlushAll(RegCacheState &state);
 	void RestoreState(const RegCacheState& state);
 	void FlushAll();
@@ -23,6 +23,13 @@
 
 #include "Common/MachineContext.h"
 
+#if defined(MACHINE_CONTEXT_SUPPORTED) && !PPSSPP_PLATFORM(WINDOWS) && !defined(__APPLE__)
+// Faults are handled by a signal handler on the faulting thread, so it can longjmp back.
+#define MEMFAULT_RECOVERY
+#include <setjmp.h>
+#include <signal.h>
+#endif
+
 #if PPSSPP_ARCH(AMD64) || PPSSPP_ARCH(X86)
 #include "Common/x64Analyzer.h"
 
@@ -33,10 +40,13 @@
 #endif
 
 #include "Common/Log.h"
+#include "Common/StringUtils.h"
 #include "Core/Config.h"
 #include "Core/Core.h"
 #include "Core/MemFault.h"
 #include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 
 namespace Memory {
@@ -47,6 +57,11 @@ MemoryExceptionType g_lastMemoryExceptionType;
 
 std::unordered_set<const uint8_t *> g_ignoredAddresses;
 
+#ifdef MEMFAULT_RECOVERY
+static thread_local sigjmp_buf *volatile t_recovery = nullptr;
+static thread_local uint32_t t_recoveryFaultAddress = 0;
+#endif
+
 void MemFault_Init() {
 	g_numReportedBadAccesses = 0;
 	g_lastCrashAddress = nullptr;
@@ -62,6 +77,70 @@ void MemFault_IgnoreLastCrash() {
 	g_ignoredAddresses.insert(g_lastCrashAddress);
 }
 
+// Returns true if the access should be skipped, otherwise reports it.
+static bool ReportBadAccess(uint32_t guestAddress, uintptr_t hostAddress, const uint8_t *codePtr, bool canSkip, MemoryExceptionType type, const std::string &infoString) {
+	if (canSkip && (g_Config.bIgnoreBadMemAccess || g_ignoredAddresses.find(codePtr) != g_ignoredAddresses.end())) {
+		// Note that handling bad accesses like this is pretty slow.
+		g_numReportedBadAccesses++;
+		if (g_numReportedBadAccesses < 100) {
+			ERROR_LOG(MEMMAP, "Bad memory access detected and ignored: %08x (%p)", guestAddress, (void *)hostAddress);
+		}
+		return true;
+	}
+
+	// Either bIgnoreBadMemAccess is off, or we failed recovery analysis.
+	uint32_t approximatePC = currentMIPS->pc;
+	Core_MemoryExceptionInfo(guestAddress, approximatePC, type, infoString);
+
+	// There's a small chance we can resume from this type of crash.
+	g_lastCrashAddress = codePtr;
+	ERROR_LOG(MEMMAP, "Bad memory access detected! %08x (%p) Stopping emulation. Info:\n%s", guestAddress, (void *)hostAddress, infoString.c_str());
+	return false;
+}
+
+int64_t MemFault_GetNumSkippedBadAccesses() {
+	return g_numReportedBadAccesses;
+}
+
+bool MemFault_CallWithRecovery(void (*func)(void *), void *userdata, uint32_t *faultAddress) {
+#ifdef MEMFAULT_RECOVERY
+	sigjmp_buf recovery;
+	// Saving the signal mask would cost a syscall on every call, so the fault path unblocks
+	// what the handler blocked instead, after jumping out of it.
+	if (sigsetjmp(recovery, 0) != 0) {
+		t_recovery = nullptr;
+		sigset_t faultSignals;
+		sigemptyset(&faultSignals);
+		sigaddset(&faultSignals, SIGSEGV);
+		sigaddset(&faultSignals, SIGBUS);
+		pthread_sigmask(SIG_UNBLOCK, &faultSignals, nullptr);
+		*faultAddress = t_recoveryFaultAddress;
+		return false;
+	}
+
+	t_recovery = &recovery;
+	func(userdata);
+	t_recovery = nullptr;
+#else
+	func(userdata);
+#endif
+	return true;
+}
+
+bool MemFault_HandleRecoveredFault(uint32_t guestAddress, const void *codeKey, bool isWrite, int size, const std::string &info) {
+	std::lock_guard<std::recursive_mutex> guard(MIPSComp::jitLock);
+
+	MemoryExceptionType type;
+	if (size > 4)
+		type = isWrite ? MemoryExceptionType::WRITE_BLOCK : MemoryExceptionType::READ_BLOCK;
+	else
+		type = isWrite ? MemoryExceptionType::WRITE_WORD : MemoryExceptionType::READ_WORD;
+	g_lastCrashAddress = nullptr;
+	g_lastMemoryExceptionType = type;
+	std::string infoString = StringFromFormat("%d byte %s\n", size, isWrite ? "write" : "read") + info;
+	return ReportBadAccess(guestAddress, (uintptr_t)base + guestAddress, (const uint8_t *)codeKey, codeKey != nullptr, type, infoString);
+}
+
 #ifdef MACHINE_CONTEXT_SUPPORTED
 
 static bool DisassembleNativeAt(const uint8_t *codePtr, int instructionSize, std::string *dest) {
@@ -91,25 +170,34 @@ bool HandleFault(uintptr_t hostAddress, void *ctx) {
 	SContext *context = (SContext *)ctx;
 	const uint8_t *codePtr = (uint8_t *)(context->CTX_PC);
 
+	uintptr_t baseAddress = (uintptr_t)base;
+#ifdef MASKED_PSP_MEMORY
+	const uintptr_t addressSpaceSize = 0x40000000ULL;
+#else
+	const uintptr_t addressSpaceSize = 0x100000000ULL;
+#endif
+
+	// TODO: Check that codePtr is within the current JIT space.
+	bool inJitSpace = MIPSComp::jit && MIPSComp::jit->CodeInRange(codePtr);
+
+#ifdef MEMFAULT_RECOVERY
+	if (!inJitSpace && t_recovery && g_irMemoryOp && hostAddress >= baseAddress && hostAddress < baseAddress + addressSpaceSize) {
+		// In an IR interpreter access, it reports the fault itself.  Jumps out before taking the lock.
+		t_recoveryFaultAddress = (uint32_t)(hostAddress - baseAddress);
+		siglongjmp(*t_recovery, 1);
+	}
+#endif
+
 	std::lock_guard<std::recursive_mutex> guard(MIPSComp::jitLock);
 
 	// We set this later if we think it can be resumed from.
 	g_lastCrashAddress = nullptr;
 
-	// TODO: Check that codePtr is within the current JIT space.
-	bool inJitSpace = MIPSComp::jit && MIPSComp::jit->CodeInRange(codePtr);
 	if (!inJitSpace) {
 		// This is a crash in non-jitted code. Not something we want to handle here, ignore.
 		return false;
 	}
 
-	uintptr_t baseAddress = (uintptr_t)base;
-#ifdef MASKED_PSP_MEMORY
-	const uintptr_t addressSpaceSize = 0x40000000ULL;
-#else
-	const uintptr_t addressSpaceSize = 0x100000000ULL;
-#endif
-
 	// Check whether hostAddress is within the PSP memory space, which (likely) means it was a guest executable that did the bad access.
 	bool invalidHostAddress = hostAddress == (uintptr_t)0xFFFFFFFFFFFFFFFFULL;
 	if (hostAddress < baseAddress || hostAddress >= baseAddress + addressSpaceSize) {
@@ -195,28 +283,16 @@ bool HandleFault(uintptr_t hostAddress, void *ctx) {
 
 	g_lastMemoryExceptionType = type;
 
-	if (success && (g_Config.bIgnoreBadMemAccess || g_ignoredAddresses.find(codePtr) != g_ignoredAddresses.end())) {
+	if (ReportBadAccess(guestAddress, hostAddress, codePtr, success, type, infoString)) {
 		if (!info.isMemoryWrite) {
 			// It was a read. Fill the destination register with 0.
 			// TODO
 		}
-		// Move on to the next instruction. Note that handling bad accesses like this is pretty slow.
+		// Move on to the next instruction.
 		context->CTX_PC += info.instructionSize;
-		g_numReportedBadAccesses++;
-		if (g_numReportedBadAccesses < 100) {
-			ERROR_LOG(MEMMAP, "Bad memory access detected and ignored: %08x (%p)", guestAddress, (void *)hostAddress);
-		}
 	} else {
-		// Either bIgnoreBadMemAccess is off, or we failed recovery analysis.
-		uint32_t approximatePC = currentMIPS->pc;
-		Core_MemoryExceptionInfo(guestAddress, approximatePC, type, infoString);
-
-		// There's a small chance we can resume from this type of crash.
-		g_lastCrashAddress = codePtr;
-
 		// Redirect execution to a crash handler that will switch to CoreState::CORE_RUNTIME_ERROR immediately.
 		context->CTX_PC = (uintptr_t)MIPSComp::jit->GetCrashHandler();
-		ERROR_LOG(MEMMAP, "Bad memory access detected! %08x (%p) Stopping emulation. Info:\n%s", guestAddress, (void *)hostAddress, infoString.c_str());
 	}
 	return true;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 namespace Memory {
 
@@ -18,4 +19,14 @@ void MemFault_IgnoreLastCrash();
 // just leave it as-is.
 bool HandleFault(uintptr_t hostAddress, void *context);
 
+// Interpreters using fastmem can't be patched to skip an access like the JIT, so instead
+// this runs func so that a fault in PSP memory during an IR interpreter access on this thread longjmps back out.
+// Returns false with the PSP address if that happened.  Where that's not supported, just runs func.
+bool MemFault_CallWithRecovery(void (*func)(void *), void *userdata, uint32_t *faultAddress);
+// Reports a recovered fault like one in the JIT, codeKey identifies the access for ignoring it.
+// size is the access size in bytes.  Returns true if the access should be skipped, otherwise emulation should stop.
+bool MemFault_HandleRecoveredFault(uint32_t guestAddress, const void *codeKey, bool isWrite, int size, const std::string &info);
+// How many bad accesses were skipped since MemFault_Init.
+int64_t MemFault_GetNumSkippedBadAccesses();
+
 }
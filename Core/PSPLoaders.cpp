@@ -92,7 +92,8 @@ void InitMemoryForGameISO(FileLoader *fileLoader) {
 		if (!bd)
 			return;
 
-		std::shared_ptr<IFileSystem> iso = std::shared_ptr<IFileSystem>(new ISOFileSystem(&pspFileSystem, bd));
+		std::shared_ptr<ISOFileSystem> iso = std::make_shared<ISOFileSystem>(&pspFileSystem, bd);
+		iso->StartDirectoryPreread();
 		fileSystem = iso;
 		blockSystem = std::shared_ptr<IFileSystem>(new ISOBlockSystem(iso));
 	}
@@ -159,7 +160,8 @@ bool ReInitMemoryForGameISO(FileLoader *fileLoader) {
 		if (!bd)
 			return false;
 
-		std::shared_ptr<IFileSystem> iso = std::shared_ptr<IFileSystem>(new ISOFileSystem(&pspFileSystem, bd));
+		std::shared_ptr<ISOFileSystem> iso = std::make_shared<ISOFileSystem>(&pspFileSystem, bd);
+		iso->StartDirectoryPreread();
 		fileSystem = iso;
 		blockSystem = std::shared_ptr<IFileSystem>(new ISOBlockSystem(iso));
 	}
@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "ppsspp_config.h"
+#include <atomic>
 #include <deque>
 #include <thread>
 #include <mutex>
@@ -73,7 +74,7 @@ namespace Reporting
 	static std::mutex pendingMessageLock;
 	static std::condition_variable pendingMessageCond;
 	static std::deque<int> pendingMessages;
-	static bool pendingMessagesDone = false;
+	static std::atomic<bool> pendingMessagesDone{};
 	static std::thread messageThread;
 	static std::thread compatThread;
 
@@ -25,7 +25,8 @@
 #include "Core/Util/BlockAllocator.h"
 #include "Core/Reporting.h"
 
-// Slow freaking thing but works (eventually) :)
+// Blocks live in an address ordered linked list, which also decides first fit.
+// The treap index over the same blocks is only there to find them faster.
 
 BlockAllocator::BlockAllocator(int grain) : bottom_(NULL), top_(NULL), grain_(grain)
 {
@@ -44,6 +45,7 @@ void BlockAllocator::Init(u32 rangeStart, u32 rangeSize, bool suballoc) {
 	top_ = new Block(rangeStart_, rangeSize_, false, NULL, NULL);
 	bottom_ = top_;
 	suballoc_ = suballoc;
+	IndexRebuild();
 }
 
 void BlockAllocator::Shutdown()
@@ -55,6 +57,7 @@ void BlockAllocator::Shutdown()
 		bottom_ = next;
 	}
 	top_ = NULL;
+	root_ = nullptr;
 }
 
 u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromTop, const char *tag)
@@ -77,63 +80,55 @@ u32 BlockAllocator::AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromT
 	if (!fromTop)
 	{
 		//Allocate from bottom of mem
-		for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+		Block *bp = TreeFirstFit(root_, size, grain);
+		if (bp != NULL)
 		{
 			Block &b = *bp;
 			u32 offset = b.start % grain;
 			if (offset != 0)
 				offset = grain - offset;
 			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
+			if (b.size == needed)
 			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetAllocated(tag, suballoc_);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeAfter(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeBefore(&b, offset);
-					b.taken = true;
-					b.SetAllocated(tag, suballoc_);
-					return b.start;
-				}
+				if (offset >= grain_)
+					InsertFreeBefore(&b, offset);
 			}
+			else
+			{
+				InsertFreeAfter(&b, b.size - needed);
+				if (offset >= grain_)
+					InsertFreeBefore(&b, offset);
+			}
+			b.taken = true;
+			b.SetAllocated(tag, suballoc_);
+			IndexUpdate(&b);
+			return b.start;
 		}
 	}
 	else
 	{
 		// Allocate from top of mem.
-		for (Block *bp = top_; bp != NULL; bp = bp->prev)
+		Block *bp = TreeLastFit(root_, size, grain);
+		if (bp != NULL)
 		{
 			Block &b = *bp;
 			u32 offset = (b.start + b.size - size) % grain;
 			u32 needed = offset + size;
-			if (b.taken == false && b.size >= needed)
+			if (b.size == needed)
 			{
-				if (b.size == needed)
-				{
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetAllocated(tag, suballoc_);
-					return b.start;
-				}
-				else
-				{
-					InsertFreeBefore(&b, b.size - needed);
-					if (offset >= grain_)
-						InsertFreeAfter(&b, offset);
-					b.taken = true;
-					b.SetAllocated(tag, suballoc_);
-					return b.start;
-				}
+				if (offset >= grain_)
+					InsertFreeAfter(&b, offset);
 			}
+			else
+			{
+				InsertFreeBefore(&b, b.size - needed);
+				if (offset >= grain_)
+					InsertFreeAfter(&b, offset);
+			}
+			b.taken = true;
+			b.SetAllocated(tag, suballoc_);
+			IndexUpdate(&b);
+			return b.start;
 		}
 	}
 
@@ -197,6 +192,7 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 					InsertFreeAfter(&b, b.size - alignedSize);
 				b.taken = true;
 				b.SetAllocated(tag, suballoc_);
+				IndexUpdate(&b);
 				CheckBlocks();
 				return position;
 			}
@@ -207,6 +203,7 @@ u32 BlockAllocator::AllocAt(u32 position, u32 size, const char *tag)
 					InsertFreeAfter(&b, b.size - alignedSize);
 				b.taken = true;
 				b.SetAllocated(tag, suballoc_);
+				IndexUpdate(&b);
 
 				return position;
 			}
@@ -232,6 +229,7 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (prev != NULL && prev->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		IndexErase(fromBlock);
 		prev->size += fromBlock->size;
 		if (fromBlock->next == NULL)
 			top_ = prev;
@@ -252,6 +250,7 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 	while (next != NULL && next->taken == false)
 	{
 		DEBUG_LOG(SCEKERNEL, "Block Alloc found adjacent free blocks - merging");
+		IndexErase(next);
 		fromBlock->size += next->size;
 		fromBlock->next = next->next;
 		delete next;
@@ -262,6 +261,8 @@ void BlockAllocator::MergeFreeBlocks(Block *fromBlock)
 		top_ = fromBlock;
 	else
 		next->prev = fromBlock;
+
+	IndexUpdate(fromBlock);
 }
 
 bool BlockAllocator::Free(u32 position)
@@ -309,6 +310,8 @@ BlockAllocator::Block *BlockAllocator::InsertFreeBefore(Block *b, u32 size)
 
 	b->start += size;
 	b->size -= size;
+	IndexInsert(inserted);
+	IndexUpdate(b);
 	return inserted;
 }
 
@@ -322,6 +325,8 @@ BlockAllocator::Block *BlockAllocator::InsertFreeAfter(Block *b, u32 size)
 		inserted->next->prev = inserted;
 
 	b->size -= size;
+	IndexUpdate(b);
+	IndexInsert(inserted);
 	return inserted;
 }
 
@@ -345,32 +350,14 @@ const char *BlockAllocator::GetBlockTag(u32 addr) const {
 	return b->tag;
 }
 
-inline BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr)
+BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr)
 {
-	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
-	{
-		Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
-	}
-	return NULL;
+	return TreeFind(root_, addr);
 }
 
 const BlockAllocator::Block *BlockAllocator::GetBlockFromAddress(u32 addr) const
 {
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
-	{
-		const Block &b = *bp;
-		if (b.start <= addr && b.start + b.size > addr)
-		{
-			// Got one!
-			return bp;
-		}
-	}
-	return NULL;
+	return TreeFind(root_, addr);
 }
 
 u32 BlockAllocator::GetBlockStartFromAddress(u32 addr) const
@@ -404,16 +391,7 @@ void BlockAllocator::ListBlocks() const
 
 u32 BlockAllocator::GetLargestFreeBlockSize() const
 {
-	u32 maxFreeBlock = 0;
-	for (const Block *bp = bottom_; bp != NULL; bp = bp->next)
-	{
-		const Block &b = *bp;
-		if (!b.taken)
-		{
-			if (b.size > maxFreeBlock)
-				maxFreeBlock = b.size;
-		}
-	}
+	u32 maxFreeBlock = root_ ? root_->maxFree : 0;
 	if (maxFreeBlock & (grain_ - 1))
 		WARN_LOG_REPORT(HLE, "GetLargestFreeBlockSize: free size %08x does not align to grain %08x.", maxFreeBlock, grain_);
 	return maxFreeBlock;
@@ -435,6 +413,190 @@ u32 BlockAllocator::GetTotalFreeBytes() const
 	return sum;
 }
 
+void BlockAllocator::IndexInsert(Block *b)
+{
+	// Any deterministic spread is fine, the shape of the tree never affects results.
+	nextPriority_ ^= nextPriority_ << 13;
+	nextPriority_ ^= nextPriority_ >> 17;
+	nextPriority_ ^= nextPriority_ << 5;
+	b->priority = nextPriority_;
+	b->left = NULL;
+	b->right = NULL;
+	b->UpdateMaxFree();
+	root_ = TreeInsert(root_, b);
+}
+
+void BlockAllocator::IndexErase(Block *b)
+{
+	root_ = TreeErase(root_, b);
+}
+
+void BlockAllocator::IndexUpdate(Block *b)
+{
+	TreeUpdate(root_, b);
+}
+
+void BlockAllocator::IndexRebuild()
+{
+	root_ = nullptr;
+	for (Block *bp = bottom_; bp != NULL; bp = bp->next)
+		IndexInsert(bp);
+}
+
+// Equal starts only happen with zero sized blocks, and in that case new blocks go to the right,
+// which matches where InsertFreeAfter() puts them in the list.
+BlockAllocator::Block *BlockAllocator::TreeInsert(Block *node, Block *b)
+{
+	if (node == NULL)
+		return b;
+
+	if (b->start < node->start)
+	{
+		node->left = TreeInsert(node->left, b);
+		if (node->left->priority > node->priority)
+		{
+			Block *l = node->left;
+			node->left = l->right;
+			node->UpdateMaxFree();
+			l->right = node;
+			node = l;
+		}
+	}
+	else
+	{
+		node->right = TreeInsert(node->right, b);
+		if (node->right->priority > node->priority)
+		{
+			Block *r = node->right;
+			node->right = r->left;
+			node->UpdateMaxFree();
+			r->left = node;
+			node = r;
+		}
+	}
+	node->UpdateMaxFree();
+	return node;
+}
+
+BlockAllocator::Block *BlockAllocator::TreeMerge(Block *a, Block *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (a->priority > b->priority)
+	{
+		a->right = TreeMerge(a->right, b);
+		a->UpdateMaxFree();
+		return a;
+	}
+	b->left = TreeMerge(a, b->left);
+	b->UpdateMaxFree();
+	return b;
+}
+
+BlockAllocator::Block *BlockAllocator::TreeErase(Block *node, Block *b)
+{
+	if (node == NULL)
+		return NULL;
+	if (node == b)
+		return TreeMerge(node->left, node->right);
+
+	if (b->start < node->start)
+		node->left = TreeErase(node->left, b);
+	else if (b->start > node->start)
+		node->right = TreeErase(node->right, b);
+	else
+	{
+		node->left = TreeErase(node->left, b);
+		node->right = TreeErase(node->right, b);
+	}
+	node->UpdateMaxFree();
+	return node;
+}
+
+// Starts can move (but never past a neighbor), so we can still find the path by start.
+void BlockAllocator::TreeUpdate(Block *node, Block *b)
+{
+	if (node == NULL)
+		return;
+
+	if (node != b)
+	{
+		if (b->start < node->start)
+			TreeUpdate(node->left, b);
+		else if (b->start > node->start)
+			TreeUpdate(node->right, b);
+		else
+		{
+			TreeUpdate(node->left, b);
+			TreeUpdate(node->right, b);
+		}
+	}
+	node->UpdateMaxFree();
+}
+
+BlockAllocator::Block *BlockAllocator::TreeFind(Block *node, u32 addr)
+{
+	while (node != NULL)
+	{
+		if (addr < node->start)
+			node = node->left;
+		else if (addr - node->start < node->size)
+			return node;
+		else if (node->size == 0 && node->start == addr)
+		{
+			// A zero sized block might hide the real one on either side.
+			Block *found = TreeFind(node->left, addr);
+			return found ? found : TreeFind(node->right, addr);
+		}
+		else
+			node = node->right;
+	}
+	return NULL;
+}
+
+// Lowest free block that fits, exactly as a walk up from bottom_ would find it.
+BlockAllocator::Block *BlockAllocator::TreeFirstFit(Block *node, u32 size, u32 grain)
+{
+	if (node == NULL || node->maxFree < size)
+		return NULL;
+
+	Block *found = TreeFirstFit(node->left, size, grain);
+	if (found != NULL)
+		return found;
+
+	if (!node->taken)
+	{
+		u32 offset = node->start % grain;
+		if (offset != 0)
+			offset = grain - offset;
+		if (node->size >= offset + size)
+			return node;
+	}
+	return TreeFirstFit(node->right, size, grain);
+}
+
+// Highest free block that fits, exactly as a walk down from top_ would find it.
+BlockAllocator::Block *BlockAllocator::TreeLastFit(Block *node, u32 size, u32 grain)
+{
+	if (node == NULL || node->maxFree < size)
+		return NULL;
+
+	Block *found = TreeLastFit(node->right, size, grain);
+	if (found != NULL)
+		return found;
+
+	if (!node->taken)
+	{
+		u32 offset = (node->start + node->size - size) % grain;
+		if (node->size >= offset + size)
+			return node;
+	}
+	return TreeLastFit(node->left, size, grain);
+}
+
 void BlockAllocator::DoState(PointerWrap &p)
 {
 	auto s = p.Section("BlockAllocator", 1);
@@ -459,6 +621,7 @@ void BlockAllocator::DoState(PointerWrap &p)
 			top_->next->DoState(p);
 			top_ = top_->next;
 		}
+		IndexRebuild();
 	}
 	else
 	{
@@ -483,11 +646,20 @@ void BlockAllocator::DoState(PointerWrap &p)
 }
 
 BlockAllocator::Block::Block(u32 _start, u32 _size, bool _taken, Block *_prev, Block *_next)
-: start(_start), size(_size), taken(_taken), prev(_prev), next(_next)
+: start(_start), size(_size), taken(_taken), prev(_prev), next(_next), left(NULL), right(NULL), priority(0), maxFree(0)
 {
 	truncate_cpy(tag, "(untitled)");
 }
 
+void BlockAllocator::Block::UpdateMaxFree()
+{
+	maxFree = taken ? 0 : size;
+	if (left != NULL && left->maxFree > maxFree)
+		maxFree = left->maxFree;
+	if (right != NULL && right->maxFree > maxFree)
+		maxFree = right->maxFree;
+}
+
 void BlockAllocator::Block::SetAllocated(const char *_tag, bool suballoc) {
 	NotifyMemInfo(suballoc ? MemBlockFlags::SUB_ALLOC : MemBlockFlags::ALLOC, start, size, _tag ? _tag : "");
 	if (_tag)
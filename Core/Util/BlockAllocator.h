@@ -64,16 +64,26 @@ class BlockAllocator
 		Block(u32 _start, u32 _size, bool _taken, Block *_prev, Block *_next);
 		void SetAllocated(const char *_tag, bool suballoc);
 		void DoState(PointerWrap &p);
+		void UpdateMaxFree();
 		u32 start;
 		u32 size;
 		bool taken;
 		char tag[32];
 		Block *prev;
 		Block *next;
+
+		// Index (a treap ordered by start) links, not saved.
+		Block *left;
+		Block *right;
+		u32 priority;
+		// Largest free block size in this subtree.
+		u32 maxFree;
 	};
 
 	Block *bottom_;
 	Block *top_;
+	Block *root_ = nullptr;
+	u32 nextPriority_ = 0x2545F491;
 	u32 rangeStart_;
 	u32 rangeSize_;
 
@@ -85,4 +95,17 @@ class BlockAllocator
 	const Block *GetBlockFromAddress(u32 addr) const;
 	Block *InsertFreeBefore(Block *b, u32 size);
 	Block *InsertFreeAfter(Block *b, u32 size);
+
+	// The index mirrors the block list, so lookups and first fit don't need to walk it.
+	void IndexInsert(Block *b);
+	void IndexErase(Block *b);
+	void IndexUpdate(Block *b);
+	void IndexRebuild();
+	static Block *TreeInsert(Block *node, Block *b);
+	static Block *TreeErase(Block *node, Block *b);
+	static Block *TreeMerge(Block *a, Block *b);
+	static void TreeUpdate(Block *node, Block *b);
+	static Block *TreeFind(Block *node, u32 addr);
+	static Block *TreeFirstFit(Block *node, u32 size, u32 grain);
+	static Block *TreeLastFit(Block *node, u32 size, u32 grain);
 };
@@ -194,17 +194,10 @@ static void DiscHandler(const http::Request &request, const Path &filename) {
 		sprintf(contentRange, "Content-Range: bytes %lld-%lld/%lld\r\n", begin, last, sz);
 		request.WriteHttpResponseHeader("1.0", 206, len, "application/octet-stream", contentRange);
 
-		const size_t CHUNK_SIZE = 16 * 1024;
-		char *buf = new char[CHUNK_SIZE];
-		for (s64 pos = 0; pos < len; pos += CHUNK_SIZE) {
-			s64 chunklen = std::min(len - pos, (s64)CHUNK_SIZE);
-			if (fread(buf, chunklen, 1, fp) != 1)
-				break;
-			request.Out()->Push(buf, chunklen);
+		if (!request.WriteFileRange(fp, begin, len)) {
+			WARN_LOG(FILESYS, "Failed to send range %lld-%lld of %s", begin, last, filename.c_str());
 		}
 		fclose(fp);
-		delete[] buf;
-		request.Out()->Flush();
 	} else {
 		request.WriteHttpResponseHeader("1.0", 418, -1, "text/plain");
 		request.Out()->Push("This server only supports range requests.");
@@ -314,7 +307,7 @@ static void ForwardDebuggerRequest(const http::Request &request) {
 static void ExecuteWebServer() {
 	SetCurrentThreadName("HTTPServer");
 
-	auto http = new http::Server(new NewThreadExecutor());
+	auto http = new http::Server(new WorkerPoolExecutor(16));
 	http->RegisterHandler("/", &HandleListing);
 	// This lists all the (current) recent ISOs.
 	http->SetFallbackHandler(&HandleFallback);
@@ -48,6 +48,140 @@
 // GL_TRIANGLES. Still need to sw transform to compute the extra two corners though.
 //
 
+#if defined(_M_SSE)
+#define TRANSFORM_BATCH_SSE
+#elif PPSSPP_ARCH(ARM64_NEON)
+#define TRANSFORM_BATCH_NEON
+static inline void Transpose4(float32x4_t &a, float32x4_t &b, float32x4_t &c, float32x4_t &d) {
+	float32x4_t t0 = vzip1q_f32(a, c);
+	float32x4_t t1 = vzip2q_f32(a, c);
+	float32x4_t t2 = vzip1q_f32(b, d);
+	float32x4_t t3 = vzip2q_f32(b, d);
+	a = vzip1q_f32(t0, t2);
+	b = vzip2q_f32(t0, t2);
+	c = vzip1q_f32(t1, t3);
+	d = vzip2q_f32(t1, t3);
+}
+#endif
+
+// The batched paths do the exact same multiplies and adds in the same order as
+// Vec3ByMatrix43() / Vec3ByMatrix44(), just four vertices at a time.
+void TransformVertexPositions43(TransformedVertex *verts, int count, const float m[12]) {
+	int i = 0;
+#if defined(TRANSFORM_BATCH_SSE)
+	__m128 mv[12];
+	for (int j = 0; j < 12; ++j)
+		mv[j] = _mm_set1_ps(m[j]);
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(verts[i + 0].pos);
+		__m128 y = _mm_loadu_ps(verts[i + 1].pos);
+		__m128 z = _mm_loadu_ps(verts[i + 2].pos);
+		__m128 w = _mm_loadu_ps(verts[i + 3].pos);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[0], x), _mm_mul_ps(mv[3], y)), _mm_add_ps(_mm_mul_ps(mv[6], z), mv[9]));
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[1], x), _mm_mul_ps(mv[4], y)), _mm_add_ps(_mm_mul_ps(mv[7], z), mv[10]));
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mv[2], x), _mm_mul_ps(mv[5], y)), _mm_add_ps(_mm_mul_ps(mv[8], z), mv[11]));
+		_MM_TRANSPOSE4_PS(ox, oy, oz, w);
+		_mm_storeu_ps(verts[i + 0].pos, ox);
+		_mm_storeu_ps(verts[i + 1].pos, oy);
+		_mm_storeu_ps(verts[i + 2].pos, oz);
+		_mm_storeu_ps(verts[i + 3].pos, w);
+	}
+#elif defined(TRANSFORM_BATCH_NEON)
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t x = vld1q_f32(verts[i + 0].pos);
+		float32x4_t y = vld1q_f32(verts[i + 1].pos);
+		float32x4_t z = vld1q_f32(verts[i + 2].pos);
+		float32x4_t w = vld1q_f32(verts[i + 3].pos);
+		Transpose4(x, y, z, w);
+		float32x4_t ox = vaddq_f32(vaddq_f32(vmulq_n_f32(x, m[0]), vmulq_n_f32(y, m[3])), vaddq_f32(vmulq_n_f32(z, m[6]), vdupq_n_f32(m[9])));
+		float32x4_t oy = vaddq_f32(vaddq_f32(vmulq_n_f32(x, m[1]), vmulq_n_f32(y, m[4])), vaddq_f32(vmulq_n_f32(z, m[7]), vdupq_n_f32(m[10])));
+		float32x4_t oz = vaddq_f32(vaddq_f32(vmulq_n_f32(x, m[2]), vmulq_n_f32(y, m[5])), vaddq_f32(vmulq_n_f32(z, m[8]), vdupq_n_f32(m[11])));
+		Transpose4(ox, oy, oz, w);
+		vst1q_f32(verts[i + 0].pos, ox);
+		vst1q_f32(verts[i + 1].pos, oy);
+		vst1q_f32(verts[i + 2].pos, oz);
+		vst1q_f32(verts[i + 3].pos, w);
+	}
+#endif
+	for (; i < count; ++i) {
+		float in[3] = { verts[i].x, verts[i].y, verts[i].z };
+		Vec3ByMatrix43(verts[i].pos, in, m);
+	}
+}
+
+void TransformVertexViewProj(TransformedVertex *verts, int count, const float view[12], const float proj[16], float fogEnd, float fogSlope) {
+	int i = 0;
+#if defined(TRANSFORM_BATCH_SSE)
+	__m128 vm[12];
+	__m128 pm[16];
+	for (int j = 0; j < 12; ++j)
+		vm[j] = _mm_set1_ps(view[j]);
+	for (int j = 0; j < 16; ++j)
+		pm[j] = _mm_set1_ps(proj[j]);
+	const __m128 fogEndx4 = _mm_set1_ps(fogEnd);
+	const __m128 fogSlopex4 = _mm_set1_ps(fogSlope);
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_loadu_ps(verts[i + 0].pos);
+		__m128 y = _mm_loadu_ps(verts[i + 1].pos);
+		__m128 z = _mm_loadu_ps(verts[i + 2].pos);
+		__m128 w = _mm_loadu_ps(verts[i + 3].pos);
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		__m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vm[0], x), _mm_mul_ps(vm[3], y)), _mm_add_ps(_mm_mul_ps(vm[6], z), vm[9]));
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vm[1], x), _mm_mul_ps(vm[4], y)), _mm_add_ps(_mm_mul_ps(vm[7], z), vm[10]));
+		__m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vm[2], x), _mm_mul_ps(vm[5], y)), _mm_add_ps(_mm_mul_ps(vm[8], z), vm[11]));
+		__m128 fog = _mm_mul_ps(_mm_add_ps(vz, fogEndx4), fogSlopex4);
+		__m128 px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pm[0], vx), _mm_mul_ps(pm[4], vy)), _mm_add_ps(_mm_mul_ps(pm[8], vz), pm[12]));
+		__m128 py = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pm[1], vx), _mm_mul_ps(pm[5], vy)), _mm_add_ps(_mm_mul_ps(pm[9], vz), pm[13]));
+		__m128 pz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pm[2], vx), _mm_mul_ps(pm[6], vy)), _mm_add_ps(_mm_mul_ps(pm[10], vz), pm[14]));
+		__m128 pw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pm[3], vx), _mm_mul_ps(pm[7], vy)), _mm_add_ps(_mm_mul_ps(pm[11], vz), pm[15]));
+		_MM_TRANSPOSE4_PS(px, py, pz, pw);
+		_mm_storeu_ps(verts[i + 0].pos, px);
+		_mm_storeu_ps(verts[i + 1].pos, py);
+		_mm_storeu_ps(verts[i + 2].pos, pz);
+		_mm_storeu_ps(verts[i + 3].pos, pw);
+
+		float fogs[4];
+		_mm_storeu_ps(fogs, fog);
+		for (int j = 0; j < 4; ++j)
+			verts[i + j].fog = fogs[j];
+	}
+#elif defined(TRANSFORM_BATCH_NEON)
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t x = vld1q_f32(verts[i + 0].pos);
+		float32x4_t y = vld1q_f32(verts[i + 1].pos);
+		float32x4_t z = vld1q_f32(verts[i + 2].pos);
+		float32x4_t w = vld1q_f32(verts[i + 3].pos);
+		Transpose4(x, y, z, w);
+		float32x4_t vx = vaddq_f32(vaddq_f32(vmulq_n_f32(x, view[0]), vmulq_n_f32(y, view[3])), vaddq_f32(vmulq_n_f32(z, view[6]), vdupq_n_f32(view[9])));
+		float32x4_t vy = vaddq_f32(vaddq_f32(vmulq_n_f32(x, view[1]), vmulq_n_f32(y, view[4])), vaddq_f32(vmulq_n_f32(z, view[7]), vdupq_n_f32(view[10])));
+		float32x4_t vz = vaddq_f32(vaddq_f32(vmulq_n_f32(x, view[2]), vmulq_n_f32(y, view[5])), vaddq_f32(vmulq_n_f32(z, view[8]), vdupq_n_f32(view[11])));
+		float32x4_t fog = vmulq_n_f32(vaddq_f32(vz, vdupq_n_f32(fogEnd)), fogSlope);
+		float32x4_t px = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, proj[0]), vmulq_n_f32(vy, proj[4])), vaddq_f32(vmulq_n_f32(vz, proj[8]), vdupq_n_f32(proj[12])));
+		float32x4_t py = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, proj[1]), vmulq_n_f32(vy, proj[5])), vaddq_f32(vmulq_n_f32(vz, proj[9]), vdupq_n_f32(proj[13])));
+		float32x4_t pz = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, proj[2]), vmulq_n_f32(vy, proj[6])), vaddq_f32(vmulq_n_f32(vz, proj[10]), vdupq_n_f32(proj[14])));
+		float32x4_t pw = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, proj[3]), vmulq_n_f32(vy, proj[7])), vaddq_f32(vmulq_n_f32(vz, proj[11]), vdupq_n_f32(proj[15])));
+		Transpose4(px, py, pz, pw);
+		vst1q_f32(verts[i + 0].pos, px);
+		vst1q_f32(verts[i + 1].pos, py);
+		vst1q_f32(verts[i + 2].pos, pz);
+		vst1q_f32(verts[i + 3].pos, pw);
+
+		float fogs[4];
+		vst1q_f32(fogs, fog);
+		for (int j = 0; j < 4; ++j)
+			verts[i + j].fog = fogs[j];
+	}
+#endif
+	for (; i < count; ++i) {
+		float world[3] = { verts[i].x, verts[i].y, verts[i].z };
+		float v[3];
+		Vec3ByMatrix43(v, world, view);
+		verts[i].fog = (v[2] + fogEnd) * fogSlope;
+		Vec3ByMatrix44(verts[i].pos, v, proj);
+	}
+}
+
 // The verts are in the order:  BR BL TL TR
 static void SwapUVs(TransformedVertex &a, TransformedVertex &b) {
 	float tempu = a.u;
@@ -265,15 +399,23 @@ void SoftwareTransform::Decode(int prim, u32 vertType, const DecVtxFormat &decVt
 			// The w of uv is also never used (hardcoded to 1.0.)
 		}
 	} else {
+		// Without skinning, the world transform doesn't depend on anything else, so batch it.
+		// The world positions stay in transformed[].pos until the view/proj batch at the end.
+		if (!skinningEnabled) {
+			for (int index = 0; index < maxIndex; index++) {
+				reader.Goto(index);
+				reader.ReadPos(transformed[index].pos);
+			}
+			TransformVertexPositions43(transformed, maxIndex, gstate.worldMatrix);
+		}
+
 		// Okay, need to actually perform the full transform.
 		for (int index = 0; index < maxIndex; index++) {
 			reader.Goto(index);
 
-			float v[3] = {0, 0, 0};
 			Vec4f c0 = Vec4f(1, 1, 1, 1);
 			Vec4f c1 = Vec4f(0, 0, 0, 0);
 			float uv[3] = {0, 0, 1};
-			float fogCoef = 1.0f;
 
 			float out[3];
 			float pos[3];
@@ -297,7 +439,7 @@ void SoftwareTransform::Decode(int prim, u32 vertType, const DecVtxFormat &decVt
 				reader.ReadNrm(normal.AsArray());
 
 			if (!skinningEnabled) {
-				Vec3ByMatrix43(out, pos, gstate.worldMatrix);
+				memcpy(out, transformed[index].pos, sizeof(out));
 				if (reader.hasNormal()) {
 					if (gstate.areNormalsReversed()) {
 						normal = -normal;
@@ -461,19 +603,16 @@ void SoftwareTransform::Decode(int prim, u32 vertType, const DecVtxFormat &decVt
 			uv[0] = uv[0] * widthFactor;
 			uv[1] = uv[1] * heightFactor;
 
-			// Transform the coord by the view matrix.
-			Vec3ByMatrix43(v, out, gstate.viewMatrix);
-			fogCoef = (v[2] + fog_end) * fog_slope;
-
-			// TODO: Write to a flexible buffer, we don't always need all four components.
-			Vec3ByMatrix44(transformed[index].pos, v, projMatrix_.m);
-			transformed[index].fog = fogCoef;
+			// View, projection and fog happen in a batch below.
+			memcpy(transformed[index].pos, out, sizeof(out));
 			memcpy(&transformed[index].uv, uv, 3 * sizeof(float));
 			transformed[index].color0_32 = c0.ToRGBA();
 			transformed[index].color1_32 = c1.ToRGBA();
-
-			// Vertex depth rounding is done in the shader, to simulate the 16-bit depth buffer.
 		}
+
+		// TODO: Write to a flexible buffer, we don't always need all four components.
+		TransformVertexViewProj(transformed, maxIndex, gstate.viewMatrix, projMatrix_.m, fog_end, fog_slope);
+		// Vertex depth rounding is done in the shader, to simulate the 16-bit depth buffer.
 	}
 
 	// Here's the best opportunity to try to detect rectangles used to clear the screen, and
@@ -60,6 +60,12 @@ struct SoftwareTransformParams {
 	bool usesHalfZ;
 };
 
+// Batched parts of the transform, exposed for testing.  Results match the per vertex Vec3ByMatrix43/44.
+// Transforms pos (xyz only) in place.
+void TransformVertexPositions43(TransformedVertex *verts, int count, const float m[12]);
+// Takes world space pos, writes the projected pos and fog.
+void TransformVertexViewProj(TransformedVertex *verts, int count, const float view[12], const float proj[16], float fogEnd, float fogSlope);
+
 class SoftwareTransform {
 public:
 	SoftwareTransform(SoftwareTransformParams &params) : params_(params) {
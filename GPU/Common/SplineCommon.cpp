@@ -17,10 +17,15 @@
 
 #include <string.h>
 #include <algorithm>
+#include <type_traits>
+#include <vector>
 
 #include "Common/Common.h"
 #include "Common/CPUDetect.h"
 #include "Common/Profiler/Profiler.h"
+#include "Common/Thread/ParallelLoop.h"
+#include "Common/Thread/ThreadManager.h"
+#include "ext/xxhash.h"
 #include "GPU/Common/GPUStateUtils.h"
 #include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/DrawEngineCommon.h"
@@ -333,15 +338,37 @@ void ControlPoints::Convert(const SimpleVertex *const *points, int size) {
 	defcolor = points[0]->color_32;
 }
 
+// Below this many output vertices, handing patch rows to workers costs more than it saves.
+static const int PARALLEL_TESS_MIN_VERTICES = 4096;
+
 template<class Surface>
 class SubdivisionSurface {
 public:
 	template <bool sampleNrm, bool sampleCol, bool sampleTex, bool useSSE4, bool patchFacing>
 	static void Tessellate(OutputBuffers &output, const Surface &surface, const ControlPoints &points, const Weight2D &weights) {
+		// Each patch row writes a disjoint set of output vertices (shared spline edges are only
+		// written by the row that starts at them, see GetTessStart), so rows can go to workers.
+		auto tessellateRows = [&](int lower, int upper) {
+			TessellateRows<sampleNrm, sampleCol, sampleTex, useSSE4, patchFacing>(output, surface, points, weights, lower, upper);
+		};
+		const int numVerts = surface.GetNumVertices();
+		if (surface.num_patches_u > 1 && numVerts >= PARALLEL_TESS_MIN_VERTICES && g_threadManager.IsInitialized()) {
+			const int rowVerts = std::max(1, numVerts / surface.num_patches_u);
+			const int minRows = std::max(1, PARALLEL_TESS_MIN_VERTICES / 2 / rowVerts);
+			ParallelRangeLoop(&g_threadManager, tessellateRows, 0, surface.num_patches_u, minRows);
+		} else {
+			tessellateRows(0, surface.num_patches_u);
+		}
+
+		surface.BuildIndex(output.indices, output.count);
+	}
+
+	template <bool sampleNrm, bool sampleCol, bool sampleTex, bool useSSE4, bool patchFacing>
+	static void TessellateRows(OutputBuffers &output, const Surface &surface, const ControlPoints &points, const Weight2D &weights, int lower, int upper) {
 		const float inv_u = 1.0f / (float)surface.tess_u;
 		const float inv_v = 1.0f / (float)surface.tess_v;
 
-		for (int patch_u = 0; patch_u < surface.num_patches_u; ++patch_u) {
+		for (int patch_u = lower; patch_u < upper; ++patch_u) {
 			const int start_u = surface.GetTessStart(patch_u);
 			for (int patch_v = 0; patch_v < surface.num_patches_v; ++patch_v) {
 				const int start_v = surface.GetTessStart(patch_v);
@@ -402,8 +429,6 @@ class SubdivisionSurface {
 				}
 			}
 		}
-
-		surface.BuildIndex(output.indices, output.count);
 	}
 
 	using TessFunc = void(*)(OutputBuffers &, const Surface &, const ControlPoints &, const Weight2D &);
@@ -424,14 +449,100 @@ class SubdivisionSurface {
 	}
 };
 
+// Many games resubmit the same static patches every frame, so the tessellated output is
+// kept around keyed by a hash of the control points and everything that affects tessellation.
+// The full key is stored too, so a hash collision can't hand back another patch's vertices.
+struct TessellationCacheEntry {
+	std::vector<u32> key;
+	std::vector<SimpleVertex> vertices;
+	std::vector<u16> indices;
+};
+
+static std::unordered_map<u64, TessellationCacheEntry> tessellationCache;
+static size_t tessellationCacheBytes = 0;
+static const size_t MAX_TESSELLATION_CACHE_BYTES = 16 * 1024 * 1024;
+
+static void ClearTessellationCache() {
+	tessellationCache.clear();
+	tessellationCacheBytes = 0;
+}
+
+static size_t TessellationCacheEntryBytes(const TessellationCacheEntry &entry) {
+	return sizeof(u32) * entry.key.size() + sizeof(SimpleVertex) * entry.vertices.size() + sizeof(u16) * entry.indices.size();
+}
+
+static void PushKeyFloats(std::vector<u32> &key, const float *values, int count) {
+	const size_t pos = key.size();
+	key.resize(pos + count);
+	memcpy(&key[pos], values, sizeof(float) * count);
+}
+
+template<class Surface>
+static void BuildTessellationKey(std::vector<u32> &key, const Surface &surface, u32 origVertType, const ControlPoints &points) {
+	const int num_points = surface.num_points_u * surface.num_points_v;
+	const u32 params[] = {
+		(u32)surface.tess_u, (u32)surface.tess_v,
+		(u32)surface.num_points_u, (u32)surface.num_points_v,
+		(u32)surface.type_u, (u32)surface.type_v,
+		(u32)surface.primType,
+		(u32)surface.patchFacing | ((u32)gstate.isLightingEnabled() << 1) | ((u32)std::is_same<Surface, SplineSurface>::value << 2),
+		origVertType & (GE_VTYPE_NRM_MASK | GE_VTYPE_COL_MASK | GE_VTYPE_TC_MASK),
+		(u32)points.defcolor,
+	};
+
+	// Vec3f may be padded to a full SIMD register, so only the components get packed, as raw bits.
+	key.clear();
+	key.reserve(ARRAY_SIZE(params) + num_points * 9);
+	key.insert(key.end(), params, params + ARRAY_SIZE(params));
+	for (int i = 0; i < num_points; ++i)
+		PushKeyFloats(key, points.pos[i].AsArray(), 3);
+	if (origVertType & GE_VTYPE_TC_MASK) {
+		for (int i = 0; i < num_points; ++i)
+			PushKeyFloats(key, points.tex[i].AsArray(), 2);
+	}
+	if (origVertType & GE_VTYPE_COL_MASK) {
+		for (int i = 0; i < num_points; ++i)
+			PushKeyFloats(key, points.col[i].AsArray(), 4);
+	}
+}
+
 template<class Surface>
 void SoftwareTessellation(OutputBuffers &output, const Surface &surface, u32 origVertType, const ControlPoints &points) {
+	// Only called from the GPU thread, so the key buffer can be shared.
+	static std::vector<u32> key;
+	BuildTessellationKey(key, surface, origVertType, points);
+	const u64 hash = XXH3_64bits(key.data(), key.size() * sizeof(u32));
+	const int numVerts = surface.GetNumVertices();
+	auto cached = tessellationCache.find(hash);
+	if (cached != tessellationCache.end() && (int)cached->second.vertices.size() == numVerts && cached->second.key == key) {
+		const TessellationCacheEntry &entry = cached->second;
+		memcpy(output.vertices, entry.vertices.data(), sizeof(SimpleVertex) * entry.vertices.size());
+		memcpy(output.indices + output.count, entry.indices.data(), sizeof(u16) * entry.indices.size());
+		output.count += (int)entry.indices.size();
+		return;
+	}
+
 	using WeightType = typename Surface::WeightType;
 	u32 key_u = WeightType::ToKey(surface.tess_u, surface.num_points_u, surface.type_u);
 	u32 key_v = WeightType::ToKey(surface.tess_v, surface.num_points_v, surface.type_v);
 	Weight2D weights(WeightType::weightsCache, key_u, key_v);
 
+	const int startCount = output.count;
 	SubdivisionSurface<Surface>::Tessellate(output, surface, points, weights, origVertType);
+
+	const int numIndices = output.count - startCount;
+	const size_t bytes = sizeof(u32) * key.size() + sizeof(SimpleVertex) * numVerts + sizeof(u16) * numIndices;
+	if (tessellationCacheBytes + bytes > MAX_TESSELLATION_CACHE_BYTES)
+		ClearTessellationCache();
+	if (bytes <= MAX_TESSELLATION_CACHE_BYTES) {
+		// On a collision, the newer patch simply replaces the older one.
+		TessellationCacheEntry &entry = tessellationCache[hash];
+		tessellationCacheBytes -= TessellationCacheEntryBytes(entry);
+		entry.key = key;
+		entry.vertices.assign(output.vertices, output.vertices + numVerts);
+		entry.indices.assign(output.indices + startCount, output.indices + output.count);
+		tessellationCacheBytes += bytes;
+	}
 }
 
 template void SoftwareTessellation<BezierSurface>(OutputBuffers &output, const BezierSurface &surface, u32 origVertType, const ControlPoints &points);
@@ -483,6 +594,7 @@ using namespace Spline;
 void DrawEngineCommon::ClearSplineBezierWeights() {
 	Bezier3DWeight::weightsCache.Clear();
 	Spline3DWeight::weightsCache.Clear();
+	Spline::ClearTessellationCache();
 }
 
 // Specialize to make instance (to avoid link error).
@@ -97,6 +97,9 @@ struct GPUStatistics {
 		numColorCopies = 0;
 		numCopiesForShaderBlend = 0;
 		numCopiesForSelfTex = 0;
+		numStateRunHits = 0;
+		numStateRunMisses = 0;
+		numStateRunCommands = 0;
 		msProcessingDisplayLists = 0;
 		vertexGPUCycles = 0;
 		otherGPUCycles = 0;
@@ -128,6 +131,9 @@ struct GPUStatistics {
 	int numColorCopies;
 	int numCopiesForShaderBlend;
 	int numCopiesForSelfTex;
+	int numStateRunHits;
+	int numStateRunMisses;
+	int numStateRunCommands;
 	double msProcessingDisplayLists;
 	int vertexGPUCycles;
 	int otherGPUCycles;
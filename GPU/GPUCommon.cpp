@@ -23,6 +23,7 @@
 #include "Common/Serialize/SerializeFuncs.h"
 #include "Common/Serialize/SerializeList.h"
 #include "Common/TimeUtil.h"
+#include "ext/xxhash.h"
 #include "Core/Reporting.h"
 #include "GPU/GeDisasm.h"
 #include "GPU/GPU.h"
@@ -436,6 +437,9 @@ GPUCommon::~GPUCommon() {
 }
 
 void GPUCommon::UpdateCmdInfo() {
+	// Cached runs were split based on the flags.
+	stateRunCache_.clear();
+
 	if (g_Config.bSoftwareSkinning) {
 		cmdInfo_[GE_CMD_VERTEXTYPE].flags &= ~FLAG_FLUSHBEFOREONCHANGE;
 		cmdInfo_[GE_CMD_VERTEXTYPE].func = &GPUCommon::Execute_VertexTypeSkinning;
@@ -498,6 +502,7 @@ void GPUCommon::Reinitialize() {
 	nextListID = 0;
 	currentList = nullptr;
 	isbreak = false;
+	stateRunCache_.clear();
 	drawCompleteTicks = 0;
 	busyTicks = 0;
 	timeSpentStepping_ = 0.0;
@@ -1142,11 +1147,25 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("gpuloop");
 	const CommandInfo *cmdInfo = cmdInfo_;
 	int dc = downcount;
+	// Only check the state run cache right after something executed, that's where runs start.
+	bool runStart = true;
 	for (; dc > 0; --dc) {
 		// We know that display list PCs have the upper nibble == 0 - no need to mask the pointer
 		const u32 op = *(const u32_le *)(Memory::base + list.pc);
 		const u32 cmd = op >> 24;
 		const CommandInfo &info = cmdInfo[cmd];
+		if ((info.flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) == 0) {
+			if (runStart) {
+				runStart = false;
+				if (ReplayStateRun(list, dc)) {
+					// Already moved past the run, but the loop will count one down.
+					++dc;
+					continue;
+				}
+			}
+		} else {
+			runStart = true;
+		}
 		const u32 diff = op ^ gstate.cmdmem[cmd];
 		if (diff == 0) {
 			if (info.flags & FLAG_EXECUTE) {
@@ -1177,6 +1196,88 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	downcount = 0;
 }
 
+bool GPUCommon::ReplayStateRun(DisplayList &list, int &dc) {
+	enum {
+		MIN_RUN_LENGTH = 8,
+		MAX_RUN_LENGTH = 256,
+		MAX_CACHED_RUNS = 8192,
+	};
+
+	const u32_le *src = (const u32_le *)(Memory::base + list.pc);
+	auto it = stateRunCache_.find(list.pc);
+	if (it != stateRunCache_.end() && it->second.firstOp == src[0]) {
+		const StateRun &run = it->second;
+		if (run.length == 0 || (int)run.length > dc)
+			return false;
+		if (XXH3_64bits(src, run.length * 4) != run.hash)
+			it = stateRunCache_.end();
+	} else {
+		it = stateRunCache_.end();
+	}
+
+	if (it == stateRunCache_.end()) {
+		if (stateRunCache_.size() >= MAX_CACHED_RUNS)
+			stateRunCache_.clear();
+
+		u32 maxLength = std::min(std::min(dc, (int)MAX_RUN_LENGTH), (int)(Memory::ValidSize(list.pc, MAX_RUN_LENGTH * 4) / 4));
+		u32 length = 0;
+		while (length < maxLength && (cmdInfo_[src[length] >> 24].flags & (FLAG_EXECUTE | FLAG_EXECUTEONCHANGE)) == 0)
+			length++;
+
+		it = stateRunCache_.emplace(list.pc, StateRun()).first;
+		StateRun &run = it->second;
+		run.firstOp = src[0];
+		run.ops.clear();
+		gpuStats.numStateRunMisses++;
+		if (length < MIN_RUN_LENGTH) {
+			run.length = 0;
+			return false;
+		}
+
+		// Keep only the last write to each command, in the order they were first written.
+		s16 slot[256];
+		memset(slot, -1, sizeof(slot));
+		for (u32 i = 0; i < length; ++i) {
+			const u32 op = src[i];
+			const u32 cmd = op >> 24;
+			if (slot[cmd] < 0) {
+				slot[cmd] = (s16)run.ops.size();
+				run.ops.push_back(op);
+			} else {
+				run.ops[slot[cmd]] = op;
+			}
+		}
+		run.length = length;
+		run.hash = XXH3_64bits(src, length * 4);
+	} else {
+		gpuStats.numStateRunHits++;
+	}
+
+	// Same as FastRunLoop() would do, minus writes that get overwritten within the run anyway.
+	const StateRun &run = it->second;
+	for (u32 op : run.ops) {
+		const u32 cmd = op >> 24;
+		const u32 diff = op ^ gstate.cmdmem[cmd];
+		if (diff == 0)
+			continue;
+		const uint64_t flags = cmdInfo_[cmd].flags;
+		if (flags & FLAG_FLUSHBEFOREONCHANGE) {
+			if (drawEngineCommon_->GetNumDrawCalls()) {
+				drawEngineCommon_->DispatchFlush();
+			}
+		}
+		gstate.cmdmem[cmd] = op;
+		uint64_t dirty = flags >> 8;
+		if (dirty)
+			gstate_c.Dirty(dirty);
+	}
+
+	gpuStats.numStateRunCommands += run.length;
+	list.pc += run.length * 4;
+	dc -= run.length;
+	return true;
+}
+
 void GPUCommon::BeginFrame() {
 	immCount_ = 0;
 	if (dumpNextFrame_) {
@@ -3236,8 +3337,11 @@ void GPUCommon::UpdateUVScaleOffset() {
 
 size_t GPUCommon::FormatGPUStatsCommon(char *buffer, size_t size) {
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
+	int totalCommands = gpuStats.gpuCommandsAtCallLevel[0] + gpuStats.gpuCommandsAtCallLevel[1] + gpuStats.gpuCommandsAtCallLevel[2] + gpuStats.gpuCommandsAtCallLevel[3];
+	int stateRunLookups = gpuStats.numStateRunHits + gpuStats.numStateRunMisses;
 	return snprintf(buffer, size,
-		"DL processing time: %0.2f ms\n"
+		"DL processing time: %0.2f ms (%0.1f commands/us)\n"
+		"State run cache: %d/%d hits (%0.1f%%), %d commands replayed\n"
 		"Draw calls: %d, flushes %d, clears %d (cached: %d)\n"
 		"Num Tracked Vertex Arrays: %d\n"
 		"Commands per call level: %i %i %i %i\n"
@@ -3248,6 +3352,10 @@ size_t GPUCommon::FormatGPUStatsCommon(char *buffer, size_t size) {
 		"Copies: depth %d, color %d, reint %d, blend %d, selftex %d\n"
 		"GPU cycles executed: %d (%f per vertex)\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
+		gpuStats.msProcessingDisplayLists > 0.0 ? totalCommands / (gpuStats.msProcessingDisplayLists * 1000000.0) : 0.0,
+		gpuStats.numStateRunHits, stateRunLookups,
+		stateRunLookups > 0 ? 100.0 * gpuStats.numStateRunHits / stateRunLookups : 0.0,
+		gpuStats.numStateRunCommands,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numClears,
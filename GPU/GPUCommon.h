@@ -1,5 +1,8 @@
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include "ppsspp_config.h"
 #include "Common/Common.h"
 #include "Common/MemoryUtil.h"
@@ -285,6 +288,7 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void UpdateVsyncInterval(bool force);
 
 	virtual void FastRunLoop(DisplayList &list);
+	bool ReplayStateRun(DisplayList &list, int &dc);
 
 	void SlowRunLoop(DisplayList &list);
 	void UpdatePC(u32 currentPC, u32 newPC);
@@ -389,6 +393,17 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	std::string reportingPrimaryInfo_;
 	std::string reportingFullInfo_;
 
+	// Runs of plain state commands (nothing to execute), keyed by address.  Games tend to
+	// resubmit the same lists every frame, so we keep the last write per command and replay
+	// that while the memory still hashes the same.
+	struct StateRun {
+		u32 length;  // In commands, zero if too short to be worth it.
+		u32 firstOp;
+		u64 hash;
+		std::vector<u32> ops;
+	};
+	std::unordered_map<u32, StateRun> stateRunCache_;
+
 private:
 	void CheckDepthUsage(VirtualFramebuffer *vfb);
 	void DoBlockTransfer(u32 skipDrawReason);
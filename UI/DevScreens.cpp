@@ -380,6 +380,8 @@ static const JitDisableFlag jitDisableFlags[] = {
 	{ MIPSComp::JitDisable::LSU_UNALIGNED, "LSU_UNALIGNED" },
 	{ MIPSComp::JitDisable::LSU_FPU, "LSU_FPU" },
 	{ MIPSComp::JitDisable::LSU_VFPU, "LSU_VFPU" },
+	{ MIPSComp::JitDisable::LSU_COMBINE, "IR load/store reorder and merge" },
+	{ MIPSComp::JitDisable::REG_LIVENESS, "IR cross-block register liveness" },
 	{ MIPSComp::JitDisable::SIMD, "SIMD" },
 	{ MIPSComp::JitDisable::BLOCKLINK, "Block Linking" },
 	{ MIPSComp::JitDisable::POINTERIFY, "Pointerify" },
@@ -967,6 +969,14 @@ void JitCompareScreen::UpdateDisasm() {
 	int numHost = rightDisasm_->GetNumSubviews();
 
 	snprintf(temp, sizeof(temp), "%d to %d : %d%%", numMips, numHost, 100 * numHost / numMips);
+	if (debugInfo.traceLength != 0) {
+		size_t len = strlen(temp);
+		snprintf(temp + len, sizeof(temp) - len, " (trace of %d blocks)", debugInfo.traceLength);
+	}
+	if (debugInfo.execCount != 0) {
+		size_t len = strlen(temp);
+		snprintf(temp + len, sizeof(temp) - len, ", run %u times", debugInfo.execCount);
+	}
 	blockStats_->SetText(temp);
 }
 
@@ -1003,6 +1013,8 @@ UI::EventReturn JitCompareScreen::OnShowStats(UI::EventParams &e) {
 	NOTICE_LOG(JIT, "Average Bloat: %0.2f%%", 100 * bcStats.avgBloat);
 	NOTICE_LOG(JIT, "Min Bloat: %0.2f%%  (%08x)", 100 * bcStats.minBloat, bcStats.minBloatBlock);
 	NOTICE_LOG(JIT, "Max Bloat: %0.2f%%  (%08x)", 100 * bcStats.maxBloat, bcStats.maxBloatBlock);
+	NOTICE_LOG(JIT, "Code occupancy: %0.2f%%", 100 * bcStats.codeOccupancy);
+	NOTICE_LOG(JIT, "Evictions: %d regions, %d blocks, %d recompiled", bcStats.numEvictions, bcStats.numEvictedBlocks, bcStats.numRecompiles);
 
 	int ctr = 0, sz = (int)bcStats.bloatMap.size();
 	for (auto iter : bcStats.bloatMap) {
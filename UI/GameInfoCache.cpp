@@ -209,6 +209,53 @@ bool GameInfo::LoadFromPath(const Path &gamePath) {
 	return true;
 }
 
+void GameInfo::LoadFromIndexEntry(const Path &gamePath, const GameInfoIndexEntry &entry) {
+	std::lock_guard<std::mutex> guard(lock);
+	filePath_ = gamePath;
+	fileType = entry.fileType;
+	if (!entry.paramSFO.empty()) {
+		paramSFO.ReadSFO((const u8 *)entry.paramSFO.data(), entry.paramSFO.size());
+	}
+	paramSFOLoaded = entry.paramSFOLoaded;
+	id = entry.id;
+	id_version = entry.id_version;
+	title = entry.title;
+	disc_total = entry.disc_total;
+	disc_number = entry.disc_number;
+	region = entry.region;
+	icon.data = entry.icon;
+	icon.dataLoaded = !icon.data.empty();
+	pending = false;
+}
+
+bool GameInfo::SaveToIndexEntry(GameInfoIndexEntry *entry) {
+	std::lock_guard<std::mutex> guard(lock);
+	// The UI thread drops the icon data once it's turned into a texture, in that case
+	// we'll just have to catch it next time.
+	if (icon.data.empty()) {
+		return false;
+	}
+	entry->fileType = fileType;
+	entry->paramSFOLoaded = paramSFOLoaded;
+	entry->paramSFO.clear();
+	if (paramSFOLoaded && !paramSFO.GetKeys().empty()) {
+		u8 *data = nullptr;
+		size_t size = 0;
+		if (paramSFO.WriteSFO(&data, &size)) {
+			entry->paramSFO.assign((const char *)data, size);
+		}
+		delete[] data;
+	}
+	entry->id = id;
+	entry->id_version = id_version;
+	entry->title = title;
+	entry->disc_total = disc_total;
+	entry->disc_number = disc_number;
+	entry->region = region;
+	entry->icon = icon.data;
+	return true;
+}
+
 std::shared_ptr<FileLoader> GameInfo::GetFileLoader() {
 	if (filePath_.empty()) {
 		// Happens when workqueue tries to figure out priorities,
@@ -327,11 +374,202 @@ static bool ReadVFSToString(const char *filename, std::string *contents, std::mu
 	return data != nullptr;
 }
 
+#define GAMEINFO_INDEX_MAGIC 0x58444947  // GIDX
+#define GAMEINFO_INDEX_VERSION 1
+
+struct GameInfoIndexHeader {
+	u32 magic;
+	u32 version;
+	u32 numEntries;
+	u32 reserved;
+};
+
+// The whole index is read with a single file read at startup, and written back on shutdown
+// if anything changed. Accessed both from the UI thread and from work items.
+class GameInfoIndex {
+public:
+	void Load(const Path &filename);
+	void Save(const Path &filename);
+
+	bool Lookup(const std::string &path, GameInfoIndexEntry *entry) {
+		std::lock_guard<std::mutex> guard(lock_);
+		auto iter = entries_.find(path);
+		if (iter == entries_.end())
+			return false;
+		*entry = iter->second;
+		return true;
+	}
+
+	bool IsValid(const std::string &path, const File::FileInfo &fileInfo) {
+		std::lock_guard<std::mutex> guard(lock_);
+		auto iter = entries_.find(path);
+		return iter != entries_.end() && iter->second.fileSize == fileInfo.size && iter->second.mtime == fileInfo.mtime;
+	}
+
+	void Update(const std::string &path, const GameInfoIndexEntry &entry) {
+		std::lock_guard<std::mutex> guard(lock_);
+		entries_[path] = entry;
+		dirty_ = true;
+	}
+
+	void Remove(const std::string &path) {
+		std::lock_guard<std::mutex> guard(lock_);
+		if (entries_.erase(path) != 0)
+			dirty_ = true;
+	}
+
+private:
+	std::mutex lock_;
+	std::map<std::string, GameInfoIndexEntry> entries_;
+	bool dirty_ = false;
+};
+
+static void AppendU32(std::string &out, u32 value) {
+	out.append((const char *)&value, sizeof(value));
+}
+
+static void AppendU64(std::string &out, u64 value) {
+	out.append((const char *)&value, sizeof(value));
+}
+
+static void AppendString(std::string &out, const std::string &str) {
+	AppendU32(out, (u32)str.size());
+	out.append(str);
+}
+
+// Bounds-checked reads from the loaded index, any failure invalidates the rest of it.
+struct GameInfoIndexReader {
+	const u8 *ptr;
+	const u8 *end;
+	bool ok = true;
+
+	u32 ReadU32() {
+		u32 value = 0;
+		if (end - ptr < (ptrdiff_t)sizeof(value)) {
+			ok = false;
+			return 0;
+		}
+		memcpy(&value, ptr, sizeof(value));
+		ptr += sizeof(value);
+		return value;
+	}
+
+	u64 ReadU64() {
+		u64 value = 0;
+		if (end - ptr < (ptrdiff_t)sizeof(value)) {
+			ok = false;
+			return 0;
+		}
+		memcpy(&value, ptr, sizeof(value));
+		ptr += sizeof(value);
+		return value;
+	}
+
+	std::string ReadString() {
+		u32 size = ReadU32();
+		if (!ok || (size_t)(end - ptr) < size) {
+			ok = false;
+			return std::string();
+		}
+		std::string str((const char *)ptr, size);
+		ptr += size;
+		return str;
+	}
+};
+
+void GameInfoIndex::Load(const Path &filename) {
+	size_t size = 0;
+	uint8_t *data = File::ReadLocalFile(filename, &size);
+	if (!data) {
+		return;
+	}
+
+	GameInfoIndexHeader header{};
+	if (size >= sizeof(header)) {
+		memcpy(&header, data, sizeof(header));
+	}
+	if (header.magic != GAMEINFO_INDEX_MAGIC || header.version != GAMEINFO_INDEX_VERSION) {
+		INFO_LOG(LOADER, "Ignoring outdated or invalid game info index '%s'", filename.c_str());
+		delete[] data;
+		return;
+	}
+
+	GameInfoIndexReader reader{ data + sizeof(header), data + size };
+	std::lock_guard<std::mutex> guard(lock_);
+	for (u32 i = 0; i < header.numEntries; i++) {
+		std::string path = reader.ReadString();
+		GameInfoIndexEntry entry;
+		entry.fileSize = reader.ReadU64();
+		entry.mtime = reader.ReadU64();
+		entry.fileType = (IdentifiedFileType)reader.ReadU32();
+		entry.id = reader.ReadString();
+		entry.id_version = reader.ReadString();
+		entry.title = reader.ReadString();
+		entry.disc_total = (int)reader.ReadU32();
+		entry.disc_number = (int)reader.ReadU32();
+		entry.region = (int)reader.ReadU32();
+		entry.paramSFOLoaded = reader.ReadU32() != 0;
+		entry.paramSFO = reader.ReadString();
+		entry.icon = reader.ReadString();
+		if (!reader.ok) {
+			ERROR_LOG(LOADER, "Game info index '%s' is truncated, ignoring the rest", filename.c_str());
+			break;
+		}
+		entries_[path] = std::move(entry);
+	}
+	delete[] data;
+
+	INFO_LOG(LOADER, "Loaded %d entries from the game info index", (int)entries_.size());
+}
+
+void GameInfoIndex::Save(const Path &filename) {
+	std::string out;
+	{
+		std::lock_guard<std::mutex> guard(lock_);
+		if (!dirty_) {
+			return;
+		}
+
+		GameInfoIndexHeader header{};
+		header.magic = GAMEINFO_INDEX_MAGIC;
+		header.version = GAMEINFO_INDEX_VERSION;
+		header.numEntries = (u32)entries_.size();
+		out.append((const char *)&header, sizeof(header));
+
+		for (const auto &iter : entries_) {
+			const GameInfoIndexEntry &entry = iter.second;
+			AppendString(out, iter.first);
+			AppendU64(out, entry.fileSize);
+			AppendU64(out, entry.mtime);
+			AppendU32(out, (u32)entry.fileType);
+			AppendString(out, entry.id);
+			AppendString(out, entry.id_version);
+			AppendString(out, entry.title);
+			AppendU32(out, (u32)entry.disc_total);
+			AppendU32(out, (u32)entry.disc_number);
+			AppendU32(out, (u32)entry.region);
+			AppendU32(out, entry.paramSFOLoaded ? 1 : 0);
+			AppendString(out, entry.paramSFO);
+			AppendString(out, entry.icon);
+		}
+		dirty_ = false;
+	}
+
+	// A half-written index is detected as truncated on load, so no need for a temporary file.
+	File::CreateFullPath(filename.NavigateUp());
+	if (!File::WriteStringToFile(false, out, filename)) {
+		ERROR_LOG(LOADER, "Failed to save the game info index to '%s'", filename.c_str());
+	}
+}
+
+static Path GameInfoIndexFilename() {
+	return GetSysDirectory(DIRECTORY_CACHE) / "gameinfo.idx";
+}
 
 class GameInfoWorkItem : public Task {
 public:
-	GameInfoWorkItem(const Path &gamePath, std::shared_ptr<GameInfo> &info)
-		: gamePath_(gamePath), info_(info) {
+	GameInfoWorkItem(const Path &gamePath, std::shared_ptr<GameInfo> &info, const std::shared_ptr<GameInfoIndex> &index, bool revalidate)
+		: gamePath_(gamePath), info_(info), index_(index), revalidate_(revalidate) {
 	}
 
 	~GameInfoWorkItem() override {
@@ -348,6 +586,21 @@ class GameInfoWorkItem : public Task {
 	void Run() override {
 		// An early-return will result in the destructor running, where we can set
 		// flags like working and pending.
+		if (revalidate_) {
+			// The info was filled in from the index, just check that the file hasn't changed.
+			info_->working = true;
+			File::FileInfo fileInfo;
+			if (File::GetFileInfo(gamePath_, &fileInfo) && index_->IsValid(gamePath_.ToString(), fileInfo)) {
+				info_->hasConfig = g_Config.hasGameConfig(info_->id);
+				return;
+			}
+			// Don't reload into this info, its icon may already be a texture on the UI thread.
+			index_->Remove(gamePath_.ToString());
+			INFO_LOG(LOADER, "Game info index entry for '%s' is stale, reloading", gamePath_.c_str());
+			info_->indexStale = true;
+			return;
+		}
+
 		if (!info_->LoadFromPath(gamePath_)) {
 			return;
 		}
@@ -646,12 +899,40 @@ class GameInfoWorkItem : public Task {
 			info_->installDataSize = info_->GetInstallDataSizeInBytes();
 		}
 
+		UpdateIndex();
+
 		// INFO_LOG(SYSTEM, "Completed writing info for %s", info_->GetTitle().c_str());
 	}
 
 private:
+	void UpdateIndex() {
+		// Only the kinds of files that are slow to open are worth remembering.
+		switch (info_->fileType) {
+		case IdentifiedFileType::PSP_ISO:
+		case IdentifiedFileType::PSP_PBP:
+		case IdentifiedFileType::PSP_ELF:
+			break;
+		default:
+			return;
+		}
+
+		File::FileInfo fileInfo;
+		if (!File::GetFileInfo(gamePath_, &fileInfo) || fileInfo.isDirectory) {
+			return;
+		}
+
+		GameInfoIndexEntry entry;
+		if (info_->SaveToIndexEntry(&entry)) {
+			entry.fileSize = fileInfo.size;
+			entry.mtime = fileInfo.mtime;
+			index_->Update(gamePath_.ToString(), entry);
+		}
+	}
+
 	Path gamePath_;
 	std::shared_ptr<GameInfo> info_;
+	std::shared_ptr<GameInfoIndex> index_;
+	bool revalidate_;
 	DISALLOW_COPY_AND_ASSIGN(GameInfoWorkItem);
 };
 
@@ -664,10 +945,14 @@ GameInfoCache::~GameInfoCache() {
 	Shutdown();
 }
 
-void GameInfoCache::Init() {}
+void GameInfoCache::Init() {
+	index_ = std::make_shared<GameInfoIndex>();
+	index_->Load(GameInfoIndexFilename());
+}
 
 void GameInfoCache::Shutdown() {
 	CancelAll();
+	index_->Save(GameInfoIndexFilename());
 }
 
 void GameInfoCache::Clear() {
@@ -727,7 +1012,12 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 
 	auto iter = info_.find(pathStr);
 	if (iter != info_.end()) {
-		info = iter->second;
+		if (iter->second->indexStale) {
+			// Start over with a fresh info, the old one goes away with its texture once unused.
+			info_.erase(iter);
+		} else {
+			info = iter->second;
+		}
 	}
 
 	// If wantFlags don't match, we need to start over.  We'll just queue the work item again.
@@ -745,6 +1035,21 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 		return info;
 	}
 
+	// If all that's wanted is the title and icon, the persistent index can serve it right away.
+	// The file is then checked for changes in the background.
+	const int indexableFlags = GAMEINFO_WANTBG | GAMEINFO_WANTSND | GAMEINFO_WANTSIZE;
+	GameInfoIndexEntry entry;
+	if (!info && (wantFlags & indexableFlags) == 0 && index_->Lookup(pathStr, &entry)) {
+		info = std::make_shared<GameInfo>();
+		info->LoadFromIndexEntry(gamePath, entry);
+		info->wantFlags = wantFlags;
+		info->lastAccessedTime = time_now_d();
+		info_[pathStr] = info;
+
+		g_threadManager.EnqueueTask(new GameInfoWorkItem(gamePath, info, index_, true));
+		return info;
+	}
+
 	if (!info) {
 		info = std::make_shared<GameInfo>();
 	}
@@ -762,7 +1067,7 @@ std::shared_ptr<GameInfo> GameInfoCache::GetInfo(Draw::DrawContext *draw, const
 		info->pending = true;
 	}
 
-	GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info);
+	GameInfoWorkItem *item = new GameInfoWorkItem(gamePath, info, index_, false);
 	g_threadManager.EnqueueTask(item);
 
 	// Don't re-insert if we already have it.
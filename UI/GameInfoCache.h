@@ -25,6 +25,7 @@
 
 #include "Common/Thread/Event.h"
 #include "Core/ELF/ParamSFO.h"
+#include "Core/Loaders.h"
 #include "Common/File/Path.h"
 #include "UI/TextureUtil.h"
 
@@ -59,7 +60,25 @@ enum GameInfoWantFlags {
 };
 
 class FileLoader;
-enum class IdentifiedFileType;
+class GameInfoIndex;
+
+// Compact summary of a GameInfo that is persisted between runs, so that the game browser
+// can show titles and icons without opening every file at startup.
+// Validated against the file's size and modification time.
+struct GameInfoIndexEntry {
+	uint64_t fileSize = 0;
+	uint64_t mtime = 0;
+	IdentifiedFileType fileType = IdentifiedFileType::UNKNOWN;
+	std::string id;
+	std::string id_version;
+	std::string title;
+	int disc_total = 0;
+	int disc_number = 0;
+	int region = -1;
+	bool paramSFOLoaded = false;
+	std::string paramSFO;
+	std::string icon;
+};
 
 struct GameInfoTex {
 	std::string data;
@@ -86,6 +105,8 @@ class GameInfo {
 	bool Delete();  // Better be sure what you're doing when calling this.
 	bool DeleteAllSaveData();
 	bool LoadFromPath(const Path &gamePath);
+	void LoadFromIndexEntry(const Path &gamePath, const GameInfoIndexEntry &entry);
+	bool SaveToIndexEntry(GameInfoIndexEntry *entry);
 
 	bool HasFileLoader() const {
 		return fileLoader.get() != nullptr;
@@ -147,6 +168,8 @@ class GameInfo {
 
 	std::atomic<bool> pending{};
 	std::atomic<bool> working{};
+	// Set when the file changed since it was served from the index, GetInfo() then replaces it.
+	std::atomic<bool> indexStale{};
 
 	Event readyEvent;
 
@@ -189,6 +212,8 @@ class GameInfoCache {
 	// Maps ISO path to info. Need to use shared_ptr as we can return these pointers - 
 	// and if they get destructed while being in use, that's bad.
 	std::map<std::string, std::shared_ptr<GameInfo> > info_;
+	// Shared with the work items, which may outlive us.
+	std::shared_ptr<GameInfoIndex> index_;
 };
 
 // This one can be global, no good reason not to.
@@ -17,6 +17,7 @@
 
 #include "ppsspp_config.h"
 #include <algorithm>
+#include <atomic>
 #include <thread>
 #include <mutex>
 
@@ -48,7 +49,7 @@ using namespace UI;
 static const char *REPORT_HOSTNAME = "report.ppsspp.org";
 static const int REPORT_PORT = 80;
 
-static bool scanCancelled = false;
+static std::atomic<bool> scanCancelled{};
 static bool scanAborted = false;
 
 enum class ServerAllowStatus {
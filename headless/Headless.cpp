@@ -3,6 +3,7 @@
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
 #include "ppsspp_config.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
@@ -35,6 +36,7 @@
 #include "Core/WebServer.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
+#include "Core/MIPS/MIPSTables.h"
 #include "Core/SaveState.h"
 #include "GPU/Common/FramebufferManagerCommon.h"
 #include "Log.h"
@@ -42,6 +44,7 @@
 
 #include "Compare.h"
 #include "StubHost.h"
+#include "TestRunner.h"
 #if defined(_WIN32)
 #include "WindowsHeadlessHost.h"
 #elif defined(SDL)
@@ -140,6 +143,10 @@ int printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
 	fprintf(stderr, "  --bench               run multiple times and output speed\n");
+	fprintf(stderr, "                        with -i, also compares against no decode cache\n");
+	fprintf(stderr, "  --jobs=N              run N tests at a time in worker processes\n");
+	fprintf(stderr, "  --junit=FILE          write results as JUnit XML\n");
+	fprintf(stderr, "  --json=FILE           write results as JSON\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
@@ -277,11 +284,14 @@ int main(int argc, const char* argv[])
 	GPUCore gpuCore = GPUCORE_SOFTWARE;
 	CPUCore cpuCore = CPUCore::JIT;
 	int debuggerPort = -1;
+	int jobs = 1;
 
 	std::vector<std::string> testFilenames;
 	const char *mountIso = nullptr;
 	const char *mountRoot = nullptr;
 	const char *screenshotFilename = nullptr;
+	const char *junitFilename = nullptr;
+	const char *jsonFilename = nullptr;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -343,6 +353,12 @@ int main(int argc, const char* argv[])
 			testOptions.maxScreenshotError = strtod(argv[i] + strlen("--max-mse="), nullptr);
 		else if (!strncmp(argv[i], "--debugger=", strlen("--debugger=")) && strlen(argv[i]) > strlen("--debugger="))
 			debuggerPort = (int)strtoul(argv[i] + strlen("--debugger="), NULL, 10);
+		else if (!strncmp(argv[i], "--jobs=", strlen("--jobs=")) && strlen(argv[i]) > strlen("--jobs="))
+			jobs = std::max(1, (int)strtol(argv[i] + strlen("--jobs="), nullptr, 10));
+		else if (!strncmp(argv[i], "--junit=", strlen("--junit=")) && strlen(argv[i]) > strlen("--junit="))
+			junitFilename = argv[i] + strlen("--junit=");
+		else if (!strncmp(argv[i], "--json=", strlen("--json=")) && strlen(argv[i]) > strlen("--json="))
+			jsonFilename = argv[i] + strlen("--json=");
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
@@ -366,6 +382,8 @@ int main(int argc, const char* argv[])
 
 	if (testFilenames.empty())
 		return printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
+	if (jobs > 1 && (testOptions.bench || debuggerPort > 0 || stateToLoad != nullptr))
+		return printUsage(argv[0], "--jobs can't be used with --bench, --debugger, or --state");
 
 	LogManager::Init(&g_Config.bEnableLogging);
 	LogManager *logman = LogManager::GetInstance();
@@ -379,21 +397,41 @@ int main(int argc, const char* argv[])
 	}
 	logman->AddListener(printfLogger);
 
-	// Needs to be after log so we don't interfere with test output.
-	g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
+	HeadlessHost *headlessHost = nullptr;
+	CoreParameter coreParameter;
 
-	HeadlessHost *headlessHost = getHost(gpuCore);
-	headlessHost->SetGraphicsCore(gpuCore);
-	host = headlessHost;
+	// Threads and graphics contexts don't survive fork(), so with --jobs each worker does this.
+	auto initProcess = [&]() {
+		// Needs to be after log so we don't interfere with test output.
+		g_threadManager.Init(cpu_info.num_cores, cpu_info.logical_cpu_count);
 
-	std::string error_string;
-	GraphicsContext *graphicsContext = nullptr;
-	bool glWorking = host->InitGraphics(&error_string, &graphicsContext);
+		headlessHost = getHost(gpuCore);
+		headlessHost->SetGraphicsCore(gpuCore);
+		host = headlessHost;
+
+		std::string error_string;
+		GraphicsContext *graphicsContext = nullptr;
+		bool glWorking = host->InitGraphics(&error_string, &graphicsContext);
+
+		coreParameter.gpuCore = glWorking ? gpuCore : GPUCORE_SOFTWARE;
+		coreParameter.graphicsContext = graphicsContext;
+		g_Config.bSoftwareRendering = coreParameter.gpuCore == GPUCORE_SOFTWARE;
+
+		if (screenshotFilename)
+			headlessHost->SetComparisonScreenshot(Path(std::string(screenshotFilename)), testOptions.maxScreenshotError);
+		headlessHost->SetWriteFailureScreenshot(!teamCityMode && !getenv("GITHUB_ACTIONS") && !testOptions.bench);
+	};
+
+	auto shutdownProcess = [&]() {
+		host->ShutdownGraphics();
+		delete host;
+		host = nullptr;
+		headlessHost = nullptr;
+
+		g_threadManager.Teardown();
+	};
 
-	CoreParameter coreParameter;
 	coreParameter.cpuCore = cpuCore;
-	coreParameter.gpuCore = glWorking ? gpuCore : GPUCORE_SOFTWARE;
-	coreParameter.graphicsContext = graphicsContext;
 	coreParameter.enableSound = false;
 	coreParameter.mountIso = mountIso ? Path(std::string(mountIso)) : Path();
 	coreParameter.mountRoot = mountRoot ? Path(std::string(mountRoot)) : Path();
@@ -430,7 +468,6 @@ int main(int argc, const char* argv[])
 	g_Config.bEnableLogging = fullLog;
 	g_Config.bSoftwareSkinning = true;
 	g_Config.bVertexDecoderJit = true;
-	g_Config.bSoftwareRendering = coreParameter.gpuCore == GPUCORE_SOFTWARE;
 	g_Config.bSoftwareRenderingJit = true;
 	g_Config.bBlockTransferGPU = true;
 	g_Config.iSplineBezierQuality = 2;
@@ -466,10 +503,6 @@ int main(int argc, const char* argv[])
 	if (!File::Exists(g_Config.flash0Directory))
 		g_Config.flash0Directory = File::GetExeDirectory() / "assets/flash0";
 
-	if (screenshotFilename)
-		headlessHost->SetComparisonScreenshot(Path(std::string(screenshotFilename)), testOptions.maxScreenshotError);
-	headlessHost->SetWriteFailureScreenshot(!teamCityMode && !getenv("GITHUB_ACTIONS") && !testOptions.bench);
-
 #if PPSSPP_PLATFORM(ANDROID)
 	// For some reason the debugger installs it with this name?
 	if (File::Exists(Path("/data/app/org.ppsspp.ppsspp-2.apk"))) {
@@ -484,51 +517,101 @@ int main(int argc, const char* argv[])
 
 	UpdateUIState(UISTATE_INGAME);
 
-	if (debuggerPort > 0) {
-		g_Config.iRemoteISOPort = debuggerPort;
-		coreParameter.startBreak = true;
-		StartWebServer(WebServerFlags::DEBUGGER);
-	}
-
-	if (stateToLoad != NULL)
-		SaveState::Load(Path(stateToLoad), -1);
-
-	std::vector<std::string> failedTests;
-	std::vector<std::string> passedTests;
+	std::vector<TestResult> results(testFilenames.size());
 	for (size_t i = 0; i < testFilenames.size(); ++i)
-	{
+		results[i].name = GetTestName(Path(testFilenames[i]));
+
+	auto runTest = [&](size_t i) {
 		coreParameter.fileToStart = Path(testFilenames[i]);
 		if (testOptions.compare)
 			printf("%s:\n", coreParameter.fileToStart.c_str());
-		bool passed = RunAutoTest(headlessHost, coreParameter, testOptions);
-		if (testOptions.bench) {
-			double st = time_now_d();
-			double deadline = st + testOptions.timeout;
-			double runs = 0.0;
-			for (int i = 0; i < 100; ++i) {
-				RunAutoTest(headlessHost, coreParameter, testOptions);
-				runs++;
-
-				if (time_now_d() > deadline)
-					break;
-			}
-			double et = time_now_d();
+		return RunAutoTest(headlessHost, coreParameter, testOptions);
+	};
+
+	bool ranInWorkers = false;
+	if (jobs > 1) {
+		TestWorkerCallbacks callbacks;
+		callbacks.init = initProcess;
+		callbacks.run = [&](size_t i) {
+			bool passed = runTest(i);
+			if (testOptions.compare && passed)
+				printf("  %s - passed!\n", results[i].name.c_str());
+			return passed;
+		};
+		callbacks.shutdown = shutdownProcess;
+		// Allow for startup and shutdown before giving up on a worker.
+		ranInWorkers = RunTestsInWorkers(jobs, testOptions.timeout + 30.0, callbacks, results);
+		if (!ranInWorkers)
+			fprintf(stderr, "--jobs is not supported on this platform, running tests one at a time\n");
+	}
+
+	if (!ranInWorkers) {
+		initProcess();
 
-			std::string testName = GetTestName(coreParameter.fileToStart);
-			printf("  %s - %f seconds average\n", testName.c_str(), (et - st) / runs);
+		if (debuggerPort > 0) {
+			g_Config.iRemoteISOPort = debuggerPort;
+			coreParameter.startBreak = true;
+			StartWebServer(WebServerFlags::DEBUGGER);
 		}
-		if (testOptions.compare) {
-			std::string testName = GetTestName(coreParameter.fileToStart);
-			if (passed) {
-				passedTests.push_back(testName);
-				printf("  %s - passed!\n", testName.c_str());
+
+		if (stateToLoad != NULL)
+			SaveState::Load(Path(stateToLoad), -1);
+
+		for (size_t i = 0; i < testFilenames.size(); ++i)
+		{
+			double testStart = time_now_d();
+			bool passed = runTest(i);
+			results[i].passed = passed;
+			results[i].seconds = time_now_d() - testStart;
+			if (testOptions.bench) {
+				auto runBench = [&]() {
+					double st = time_now_d();
+					double deadline = st + testOptions.timeout;
+					double runs = 0.0;
+					for (int i = 0; i < 100; ++i) {
+						RunAutoTest(headlessHost, coreParameter, testOptions);
+						runs++;
+
+						if (time_now_d() > deadline)
+							break;
+					}
+					double et = time_now_d();
+					return (et - st) / runs;
+				};
+
+				const std::string &testName = results[i].name;
+				if (cpuCore == CPUCore::INTERPRETER) {
+					// Also measure without the decode cache, to see what it buys us.
+					MIPSInterpret_EnableCache(false);
+					double uncached = runBench();
+					MIPSInterpret_EnableCache(true);
+					double cached = runBench();
+					printf("  %s - %f seconds average (%f without decode cache, %0.2fx)\n", testName.c_str(), cached, uncached, uncached / cached);
+				} else {
+					printf("  %s - %f seconds average\n", testName.c_str(), runBench());
+				}
 			}
-			else
-				failedTests.push_back(testName);
+			if (testOptions.compare && passed)
+				printf("  %s - passed!\n", results[i].name.c_str());
+		}
+
+		if (debuggerPort > 0) {
+			ShutdownWebServer();
 		}
+
+		shutdownProcess();
 	}
 
+	std::vector<std::string> failedTests;
+	std::vector<std::string> passedTests;
 	if (testOptions.compare) {
+		for (const TestResult &result : results) {
+			if (result.passed)
+				passedTests.push_back(result.name);
+			else
+				failedTests.push_back(result.name);
+		}
+
 		printf("%d tests passed, %d tests failed.\n", (int)passedTests.size(), (int)failedTests.size());
 		if (!failedTests.empty())
 		{
@@ -539,14 +622,10 @@ int main(int argc, const char* argv[])
 		}
 	}
 
-	if (debuggerPort > 0) {
-		ShutdownWebServer();
-	}
-
-	host->ShutdownGraphics();
-	delete host;
-	host = nullptr;
-	headlessHost = nullptr;
+	if (junitFilename && !WriteJUnitReport(Path(std::string(junitFilename)), results))
+		fprintf(stderr, "Unable to write JUnit results to %s\n", junitFilename);
+	if (jsonFilename && !WriteJSONReport(Path(std::string(jsonFilename)), results))
+		fprintf(stderr, "Unable to write JSON results to %s\n", jsonFilename);
 
 	VFSShutdown();
 	LogManager::Shutdown();
@@ -556,8 +635,6 @@ int main(int argc, const char* argv[])
 	timeEndPeriod(1);
 #endif
 
-	g_threadManager.Teardown();
-
 	if (!failedTests.empty() && !teamCityMode)
 		return 1;
 	return 0;
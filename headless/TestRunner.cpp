@@ -0,0 +1,435 @@
+// Copyright (c) 2023- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#if !PPSSPP_PLATFORM(WINDOWS)
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Common/Data/Format/JSONWriter.h"
+#include "Common/File/FileUtil.h"
+#include "Common/StringUtils.h"
+#include "Common/TimeUtil.h"
+#include "headless/TestRunner.h"
+
+#if !PPSSPP_PLATFORM(WINDOWS)
+
+static const uint32_t WORKER_QUIT = 0xFFFFFFFF;
+
+struct WorkerReply {
+	uint32_t index;
+	uint32_t passed;
+	double seconds;
+	uint32_t outputSize;
+};
+
+struct Worker {
+	pid_t pid = -1;
+	int cmdFd = -1;
+	int resultFd = -1;
+	// Test index being run, or -1 if idle.
+	int64_t current = -1;
+	double started = 0.0;
+};
+
+static bool ReadAll(int fd, void *data, size_t size) {
+	uint8_t *p = (uint8_t *)data;
+	while (size > 0) {
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool WriteAll(int fd, const void *data, size_t size) {
+	const uint8_t *p = (const uint8_t *)data;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+static void CloseWorkerFds(Worker &w) {
+	if (w.cmdFd != -1)
+		close(w.cmdFd);
+	if (w.resultFd != -1)
+		close(w.resultFd);
+	w.cmdFd = -1;
+	w.resultFd = -1;
+}
+
+static bool RunCapturedTest(const TestWorkerCallbacks &callbacks, uint32_t index, WorkerReply &reply, std::string &output) {
+	FILE *capture = tmpfile();
+	if (!capture)
+		return false;
+
+	fflush(stdout);
+	int savedStdout = dup(STDOUT_FILENO);
+	dup2(fileno(capture), STDOUT_FILENO);
+
+	double st = time_now_d();
+	reply.passed = callbacks.run(index) ? 1 : 0;
+	reply.seconds = time_now_d() - st;
+
+	fflush(stdout);
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdout);
+
+	output.clear();
+	rewind(capture);
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), capture)) > 0)
+		output.append(buf, n);
+	fclose(capture);
+
+	reply.index = index;
+	reply.outputSize = (uint32_t)output.size();
+	return true;
+}
+
+static void WorkerMain(const TestWorkerCallbacks &callbacks, int cmdFd, int resultFd) {
+	callbacks.init();
+
+	uint32_t index;
+	std::string output;
+	while (ReadAll(cmdFd, &index, sizeof(index)) && index != WORKER_QUIT) {
+		WorkerReply reply{};
+		if (!RunCapturedTest(callbacks, index, reply, output))
+			break;
+		if (!WriteAll(resultFd, &reply, sizeof(reply)) || !WriteAll(resultFd, output.data(), output.size()))
+			break;
+	}
+
+	callbacks.shutdown();
+	fflush(stdout);
+	fflush(stderr);
+	// Skip static destructors, they belong to the parent.
+	_exit(0);
+}
+
+static bool SpawnWorker(const TestWorkerCallbacks &callbacks, std::vector<Worker> &workers, size_t which) {
+	int cmdPipe[2];
+	int resultPipe[2];
+	if (pipe(cmdPipe) != 0)
+		return false;
+	if (pipe(resultPipe) != 0) {
+		close(cmdPipe[0]);
+		close(cmdPipe[1]);
+		return false;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(cmdPipe[0]);
+		close(cmdPipe[1]);
+		close(resultPipe[0]);
+		close(resultPipe[1]);
+		return false;
+	}
+
+	if (pid == 0) {
+		// Other workers' pipes must not stay open here, or we'd hide their exit from the parent.
+		for (Worker &w : workers)
+			CloseWorkerFds(w);
+		close(cmdPipe[1]);
+		close(resultPipe[0]);
+		WorkerMain(callbacks, cmdPipe[0], resultPipe[1]);
+	}
+
+	close(cmdPipe[0]);
+	close(resultPipe[1]);
+	Worker &w = workers[which];
+	w.pid = pid;
+	w.cmdFd = cmdPipe[1];
+	w.resultFd = resultPipe[0];
+	w.current = -1;
+	return true;
+}
+
+static void StopWorker(Worker &w, bool kill) {
+	if (w.pid == -1)
+		return;
+	if (kill) {
+		::kill(w.pid, SIGKILL);
+	} else if (w.cmdFd != -1) {
+		WriteAll(w.cmdFd, &WORKER_QUIT, sizeof(WORKER_QUIT));
+	}
+	CloseWorkerFds(w);
+	int status = 0;
+	while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+		continue;
+	w.pid = -1;
+	w.current = -1;
+}
+
+static std::string DescribeWorkerExit(pid_t pid) {
+	int status = 0;
+	if (waitpid(pid, &status, 0) < 0)
+		return "Worker exited";
+	if (WIFSIGNALED(status))
+		return StringFromFormat("Worker crashed with signal %d", WTERMSIG(status));
+	return StringFromFormat("Worker exited with status %d", WEXITSTATUS(status));
+}
+
+bool RunTestsInWorkers(int jobs, double timeout, const TestWorkerCallbacks &callbacks, std::vector<TestResult> &results) {
+	size_t count = results.size();
+	if (jobs > (int)count)
+		jobs = (int)count;
+	if (jobs < 1)
+		return true;
+
+	std::vector<Worker> workers(jobs);
+	std::vector<bool> done(count, false);
+	size_t nextTest = 0;
+	size_t nextPrint = 0;
+	size_t finished = 0;
+
+	auto printReady = [&]() {
+		while (nextPrint < count && done[nextPrint]) {
+			fwrite(results[nextPrint].output.data(), 1, results[nextPrint].output.size(), stdout);
+			++nextPrint;
+		}
+		fflush(stdout);
+	};
+
+	auto giveWork = [&](Worker &w) {
+		if (nextTest >= count) {
+			StopWorker(w, false);
+			return;
+		}
+		uint32_t index = (uint32_t)nextTest++;
+		w.current = index;
+		w.started = time_now_d();
+		// If this fails, the worker died and we'll see that when reading its result.
+		WriteAll(w.cmdFd, &index, sizeof(index));
+	};
+
+	auto failCurrent = [&](Worker &w, const std::string &reason) {
+		if (w.current < 0)
+			return;
+		TestResult &result = results[w.current];
+		result.passed = false;
+		result.seconds = time_now_d() - w.started;
+		result.output = result.name + ": " + reason + "\n";
+		done[w.current] = true;
+		++finished;
+		w.current = -1;
+	};
+
+	for (int i = 0; i < jobs; ++i) {
+		if (!SpawnWorker(callbacks, workers, i)) {
+			fprintf(stderr, "Failed to start test worker %d\n", i);
+			continue;
+		}
+		giveWork(workers[i]);
+	}
+
+	while (finished < count) {
+		std::vector<pollfd> fds;
+		std::vector<size_t> fdWorkers;
+		for (size_t i = 0; i < workers.size(); ++i) {
+			if (workers[i].pid == -1)
+				continue;
+			pollfd pfd{};
+			pfd.fd = workers[i].resultFd;
+			pfd.events = POLLIN;
+			fds.push_back(pfd);
+			fdWorkers.push_back(i);
+		}
+		if (fds.empty()) {
+			// Every worker failed to start, nothing more we can do.
+			for (size_t i = 0; i < count; ++i) {
+				if (!done[i]) {
+					results[i].passed = false;
+					results[i].output = results[i].name + ": No worker could be started\n";
+					done[i] = true;
+					++finished;
+				}
+			}
+			break;
+		}
+
+		int pollTimeout = std::isinf(timeout) ? -1 : 100;
+		int ready = poll(fds.data(), fds.size(), pollTimeout);
+		if (ready < 0 && errno != EINTR) {
+			perror("poll");
+			break;
+		}
+
+		for (size_t i = 0; i < fds.size(); ++i) {
+			Worker &w = workers[fdWorkers[i]];
+			bool replace = false;
+			if (fds[i].revents != 0) {
+				WorkerReply reply{};
+				std::string output;
+				bool ok = ReadAll(w.resultFd, &reply, sizeof(reply));
+				if (ok) {
+					output.resize(reply.outputSize);
+					ok = ReadAll(w.resultFd, &output[0], output.size()) && (int64_t)reply.index == w.current;
+				}
+
+				if (ok) {
+					TestResult &result = results[reply.index];
+					result.passed = reply.passed != 0;
+					result.seconds = reply.seconds;
+					result.output = std::move(output);
+					done[reply.index] = true;
+					++finished;
+					w.current = -1;
+					giveWork(w);
+				} else {
+					// Make sure it's gone, this doesn't change the status if it already crashed.
+					::kill(w.pid, SIGKILL);
+					CloseWorkerFds(w);
+					failCurrent(w, DescribeWorkerExit(w.pid));
+					w.pid = -1;
+					replace = true;
+				}
+			} else if (w.current >= 0 && time_now_d() - w.started > timeout) {
+				failCurrent(w, "TIMEOUT (worker killed)");
+				StopWorker(w, true);
+				replace = true;
+			}
+
+			if (replace && nextTest < count) {
+				if (SpawnWorker(callbacks, workers, fdWorkers[i]))
+					giveWork(w);
+			}
+		}
+
+		printReady();
+	}
+
+	for (Worker &w : workers)
+		StopWorker(w, false);
+	printReady();
+	return true;
+}
+
+#else
+
+bool RunTestsInWorkers(int jobs, double timeout, const TestWorkerCallbacks &callbacks, std::vector<TestResult> &results) {
+	return false;
+}
+
+#endif
+
+static std::string XMLEscape(const std::string &str) {
+	std::string escaped;
+	escaped.reserve(str.size());
+	for (char c : str) {
+		switch (c) {
+		case '&': escaped += "&amp;"; break;
+		case '<': escaped += "&lt;"; break;
+		case '>': escaped += "&gt;"; break;
+		case '"': escaped += "&quot;"; break;
+		case '\'': escaped += "&apos;"; break;
+		default:
+			// Most control characters can't appear in XML at all.
+			if ((unsigned char)c >= 0x20 || c == '\t' || c == '\n' || c == '\r')
+				escaped += c;
+			break;
+		}
+	}
+	return escaped;
+}
+
+bool WriteJUnitReport(const Path &filename, const std::vector<TestResult> &results) {
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp)
+		return false;
+
+	int failures = 0;
+	double seconds = 0.0;
+	for (const TestResult &result : results) {
+		if (!result.passed)
+			failures++;
+		seconds += result.seconds;
+	}
+
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(fp, "<testsuite name=\"PPSSPPHeadless\" tests=\"%d\" failures=\"%d\" time=\"%0.3f\">\n", (int)results.size(), failures, seconds);
+	for (const TestResult &result : results) {
+		fprintf(fp, "  <testcase name=\"%s\" time=\"%0.3f\">\n", XMLEscape(result.name).c_str(), result.seconds);
+		if (!result.passed)
+			fprintf(fp, "    <failure message=\"Test failed\"/>\n");
+		if (!result.output.empty())
+			fprintf(fp, "    <system-out>%s</system-out>\n", XMLEscape(result.output).c_str());
+		fprintf(fp, "  </testcase>\n");
+	}
+	fprintf(fp, "</testsuite>\n");
+	fclose(fp);
+	return true;
+}
+
+bool WriteJSONReport(const Path &filename, const std::vector<TestResult> &results) {
+	FILE *fp = File::OpenCFile(filename, "wb");
+	if (!fp)
+		return false;
+
+	int passed = 0;
+	for (const TestResult &result : results) {
+		if (result.passed)
+			passed++;
+	}
+
+	json::JsonWriter writer(json::JsonWriter::PRETTY);
+	writer.begin();
+	writer.writeInt("passed", passed);
+	writer.writeInt("failed", (int)results.size() - passed);
+	writer.pushArray("tests");
+	for (const TestResult &result : results) {
+		writer.pushDict();
+		writer.writeString("name", result.name);
+		writer.writeBool("passed", result.passed);
+		writer.writeRaw("seconds", StringFromFormat("%0.3f", result.seconds));
+		if (!result.output.empty())
+			writer.writeString("output", result.output);
+		writer.pop();
+	}
+	writer.pop();
+	writer.end();
+
+	std::string str = writer.str();
+	fwrite(str.data(), 1, str.size(), fp);
+	fclose(fp);
+	return true;
+}
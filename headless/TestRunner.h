@@ -0,0 +1,52 @@
+// Copyright (c) 2023- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Common/File/Path.h"
+
+struct TestResult {
+	std::string name;
+	bool passed = false;
+	double seconds = 0.0;
+	// What the test printed, only captured when running in workers.
+	std::string output;
+};
+
+struct TestWorkerCallbacks {
+	// Called once in each worker before its first test.
+	std::function<void()> init;
+	// Runs one test, returns true if it passed.
+	std::function<bool(size_t index)> run;
+	// Called once in each worker after its last test.
+	std::function<void()> shutdown;
+};
+
+// Runs the tests in up to jobs forked worker processes, which take tests from a shared queue.
+// Each test's stdout is captured and printed in test order, so the output doesn't depend on
+// which worker ran what.  A worker that crashes or hangs past timeout seconds fails its test
+// and is replaced.  results must already have one entry per test, with names set.
+// Returns false without running anything if workers aren't supported on this platform.
+bool RunTestsInWorkers(int jobs, double timeout, const TestWorkerCallbacks &callbacks, std::vector<TestResult> &results);
+
+bool WriteJUnitReport(const Path &filename, const std::vector<TestResult> &results);
+bool WriteJSONReport(const Path &filename, const std::vector<TestResult> &results);
@@ -16,21 +16,40 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "ppsspp_config.h"
 
+#include "Common/Data/Random/Rng.h"
+#include "Common/ExceptionHandlerSetup.h"
+#include "Common/File/FileUtil.h"
+#include "Common/File/Path.h"
+#include "Common/MachineContext.h"
+#include "Common/Math/math_util.h"
+#include "Common/StringUtils.h"
 #include "Common/System/NativeApp.h"
 #include "Common/System/System.h"
 #include "Common/TimeUtil.h"
+#include "Core/Config.h"
 #include "Core/ConfigValues.h"
 #include "Core/Debugger/SymbolMap.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/IR/IRFrontend.h"
+#include "Core/MIPS/IR/IRInst.h"
+#include "Core/MIPS/IR/IRInterpreter.h"
+#include "Core/MIPS/IR/IRPassSimplify.h"
+#include "Core/MIPS/MIPSAnalyst.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/MIPS/MIPSDebugInterface.h"
 #include "Core/MIPS/MIPSAsm.h"
 #include "Core/MIPS/MIPSTables.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
+#include "Core/MemFault.h"
 #include "Core/MemMap.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
@@ -203,3 +222,848 @@ bool TestJit() {
 
 	return jit_speed >= interp_speed;
 }
+
+// Fills every code region with throwaway blocks until the region holding a linked-to block is
+// reused, then checks that the block linking into it was unlinked instead of jumping into new code.
+bool TestJitCodeRegionEviction() {
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64) || PPSSPP_ARCH(ARM64)
+	SetupJitHarness();
+	const bool oldRecycle = g_Config.bJitRecycleCodeSpace;
+	g_Config.bJitRecycleCodeSpace = true;
+
+	// target ends the run, linker jumps to it, filler only gets compiled.
+	const u32 target = PSP_GetUserMemoryBase();
+	const u32 linker = target + 0x100;
+	const u32 filler = target + 0x1000;
+	const int FILLER_OPS = 1000;
+	Memory::Write_U32(MIPS_MAKE_ADDIU(MIPS_REG_V0, MIPS_REG_V0, 1), target);
+	Memory::Write_U32(MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator"), target + 4);
+	Memory::Write_U32(MIPS_MAKE_BREAK(1), target + 8);
+	Memory::Write_U32(MIPS_MAKE_ADDIU(MIPS_REG_V1, MIPS_REG_V1, 1), linker);
+	Memory::Write_U32(MIPS_MAKE_J(target), linker + 4);
+	Memory::Write_U32(MIPS_MAKE_NOP(), linker + 8);
+	for (int i = 0; i < FILLER_OPS; ++i)
+		Memory::Write_U32(MIPS_MAKE_ADDIU(MIPS_REG_A0, MIPS_REG_A0, 1), filler + i * 4);
+	Memory::Write_U32(MIPS_MAKE_JR_RA(), filler + FILLER_OPS * 4);
+	Memory::Write_U32(MIPS_MAKE_NOP(), filler + FILLER_OPS * 4 + 4);
+
+	mipsr4k.UpdateCore(CPUCore::JIT);
+	JitBlockCache *cache = MIPSComp::jit->GetBlockCache();
+	auto evictions = [&] {
+		BlockCacheStats stats{};
+		cache->ComputeStats(stats);
+		return stats.numEvictions;
+	};
+	auto fill = [&](int untilEvictions) {
+		for (int i = 0; i < 100000 && evictions() < untilEvictions; ++i) {
+			MIPSComp::jit->Compile(filler);
+			MIPSComp::jit->InvalidateCacheAt(filler, FILLER_OPS * 4 + 8);
+		}
+	};
+
+	// The first region holds target, and linker is compiled into the last one.
+	MIPSComp::jit->Compile(target);
+	fill(JitBlockCache::NUM_CODE_REGIONS - 1);
+	bool success = evictions() == JitBlockCache::NUM_CODE_REGIONS - 1;
+	MIPSComp::jit->Compile(linker);
+	success = success && cache->GetBlockNumberFromStartAddress(target) >= 0 && cache->GetBlockNumberFromStartAddress(linker) >= 0;
+
+	// Reusing the first region has to take target down, and linker with it.  Then overwrite target's old code.
+	fill(JitBlockCache::NUM_CODE_REGIONS);
+	for (int i = 0; i < 4; ++i) {
+		MIPSComp::jit->Compile(filler);
+		MIPSComp::jit->InvalidateCacheAt(filler, FILLER_OPS * 4 + 8);
+	}
+	success = success && evictions() == JitBlockCache::NUM_CODE_REGIONS;
+	success = success && cache->GetBlockNumberFromStartAddress(target) == -1 && cache->GetBlockNumberFromStartAddress(linker) == -1;
+
+	// Running linker now has to go back through the dispatcher to a freshly compiled target.
+	currentMIPS->r[MIPS_REG_V0] = 0;
+	currentMIPS->r[MIPS_REG_V1] = 0;
+	currentMIPS->r[MIPS_REG_A0] = 0;
+	currentMIPS->pc = linker;
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING)
+		mipsr4k.RunLoopUntil(1000000);
+	success = success && currentMIPS->r[MIPS_REG_V0] == 1 && currentMIPS->r[MIPS_REG_V1] == 1 && currentMIPS->r[MIPS_REG_A0] == 0;
+
+	g_Config.bJitRecycleCodeSpace = oldRecycle;
+	DestroyJitHarness();
+	if (!success)
+		printf("JitCodeRegionEviction: stale link into an evicted code region\n");
+	return success;
+#else
+	// Only the x86 and ARM64 jits recycle code regions.
+	return true;
+#endif
+}
+
+// A loop with a mostly taken branch and a call, run well past the trace threshold.
+// The loop counter is in a0, and the results are v0, v1, a1, a2, a3 and the word at s0.
+static const int IR_TRACE_LOOP_COUNT = 5000;
+
+static void WriteIRTraceLoop(u32 base) {
+	auto itype = [](int op, int rs, int rt, int imm) -> u32 {
+		return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xFFFF);
+	};
+	auto rtype = [](int funct, int rs, int rt, int rd, int sa) -> u32 {
+		return (rs << 21) | (rt << 16) | (rd << 11) | (sa << 6) | funct;
+	};
+	const u32 ops[] = {
+		/* 00 loop */ MIPS_MAKE_ADDIU(MIPS_REG_A0, MIPS_REG_A0, 1),
+		/* 04 */ itype(12, MIPS_REG_A0, MIPS_REG_T0, 7),  // andi t0, a0, 7
+		/* 08 */ itype(5, MIPS_REG_T0, MIPS_REG_ZERO, 2),  // bne t0, zero, skip
+		/* 0C */ rtype(0x21, MIPS_REG_V0, MIPS_REG_A0, MIPS_REG_V0, 0),  // addu v0, v0, a0
+		/* 10 */ MIPS_MAKE_ADDIU(MIPS_REG_V1, MIPS_REG_V1, 3),
+		/* 14 skip */ (u32)MIPS_MAKE_JAL(base + 0x30),
+		/* 18 */ rtype(0x26, MIPS_REG_A1, MIPS_REG_A0, MIPS_REG_A1, 0),  // xor a1, a1, a0
+		/* 1C */ itype(11, MIPS_REG_A0, MIPS_REG_T1, IR_TRACE_LOOP_COUNT),  // sltiu t1, a0, count
+		/* 20 */ itype(5, MIPS_REG_T1, MIPS_REG_ZERO, -9),  // bne t1, zero, loop
+		/* 24 */ itype(43, MIPS_REG_S0, MIPS_REG_V0, 0),  // sw v0, 0(s0)
+		/* 28 */ MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator"),
+		/* 2C */ MIPS_MAKE_BREAK(1),
+		/* 30 func */ rtype(0x21, MIPS_REG_A2, MIPS_REG_V0, MIPS_REG_A2, 0),  // addu a2, a2, v0
+		/* 34 */ MIPS_MAKE_JR_RA(),
+		/* 38 */ rtype(0x00, 0, MIPS_REG_A2, MIPS_REG_A3, 1),  // sll a3, a2, 1
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(ops); ++i)
+		Memory::Write_U32(ops[i], base + (u32)i * 4);
+}
+
+static void RunIRTraceLoop(bool traces, u32 base, u32 scratch, u32 regs[32], u32 *stored, int *longestTrace) {
+	// Switching cores drops the old jit, its emuhack ops get overwritten by the fresh copy.
+	mipsr4k.UpdateCore(CPUCore::INTERPRETER);
+	g_Config.bJitTraces = traces;
+	WriteIRTraceLoop(base);
+	Memory::Write_U32(0, scratch);
+	memset(currentMIPS->r, 0, sizeof(currentMIPS->r));
+	currentMIPS->r[MIPS_REG_S0] = scratch;
+	mipsr4k.UpdateCore(CPUCore::IR_JIT);
+
+	currentMIPS->pc = base;
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING)
+		mipsr4k.RunLoopUntil(1000000);
+
+	memcpy(regs, currentMIPS->r, sizeof(currentMIPS->r));
+	*stored = Memory::Read_U32(scratch);
+	*longestTrace = 0;
+	JitBlockCacheDebugInterface *debug = MIPSComp::jit->GetBlockCacheDebugInterface();
+	for (int i = 0; i < debug->GetNumBlocks(); ++i)
+		*longestTrace = std::max(*longestTrace, debug->GetBlockDebugInfo(i).traceLength);
+}
+
+// Runs a hot loop on the IR jit with traces, which have to form and chain back into the
+// regular blocks on the exits they don't follow, and compares against the plain IR blocks.
+bool TestIRJitTraces() {
+	SetupJitHarness();
+	const bool oldTraces = g_Config.bJitTraces;
+	const u32 base = PSP_GetUserMemoryBase();
+	const u32 scratch = base + 0x10000;
+
+	u32 plainRegs[32], traceRegs[32];
+	u32 plainStored, traceStored;
+	int plainTrace, traceTrace;
+	RunIRTraceLoop(false, base, scratch, plainRegs, &plainStored, &plainTrace);
+	RunIRTraceLoop(true, base, scratch, traceRegs, &traceStored, &traceTrace);
+
+	g_Config.bJitTraces = oldTraces;
+	DestroyJitHarness();
+
+	bool success = true;
+	if (plainRegs[MIPS_REG_A0] != IR_TRACE_LOOP_COUNT) {
+		printf("IRJitTraces: loop ran %d times\n", (int)plainRegs[MIPS_REG_A0]);
+		success = false;
+	}
+	if (plainTrace != 0 || traceTrace < 2) {
+		printf("IRJitTraces: longest trace %d blocks without traces, %d with\n", plainTrace, traceTrace);
+		success = false;
+	}
+	for (int i = 0; i < 32; ++i) {
+		if (plainRegs[i] != traceRegs[i]) {
+			printf("IRJitTraces: r%d is %08x with traces, %08x without\n", i, traceRegs[i], plainRegs[i]);
+			success = false;
+		}
+	}
+	if (plainStored != traceStored) {
+		printf("IRJitTraces: stored %08x with traces, %08x without\n", traceStored, plainStored);
+		success = false;
+	}
+	return success;
+}
+
+// Two fastmem loads from unmapped memory in one IR block.  Each fault has to come back to
+// the dispatcher, the second one only arrives if the first left the signal unblocked.
+bool TestIRJitMemoryFaults() {
+#if defined(MACHINE_CONTEXT_SUPPORTED) && !PPSSPP_PLATFORM(WINDOWS) && !defined(__APPLE__)
+	SetupJitHarness();
+	InstallExceptionHandler(&Memory::HandleFault);
+	const bool oldFastMemory = g_Config.bFastMemory;
+	const bool oldIgnoreBadMemAccess = g_Config.bIgnoreBadMemAccess;
+	g_Config.bFastMemory = true;
+	g_Config.bIgnoreBadMemAccess = true;
+
+	auto itype = [](int op, int rs, int rt, int imm) -> u32 {
+		return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xFFFF);
+	};
+	const u32 base = PSP_GetUserMemoryBase();
+	const u32 scratch = base + 0x10000;
+	const u32 ops[] = {
+		itype(15, 0, MIPS_REG_T0, 0x0100),  // lui t0, 0x0100, nothing is mapped there
+		itype(35, MIPS_REG_T0, MIPS_REG_T1, 0),  // lw t1, 0(t0)
+		itype(35, MIPS_REG_T0, MIPS_REG_T2, 8),  // lw t2, 8(t0)
+		itype(13, MIPS_REG_ZERO, MIPS_REG_T3, 0x1234),  // ori t3, zero, 0x1234
+		itype(43, MIPS_REG_S0, MIPS_REG_T3, 0),  // sw t3, 0(s0)
+		MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator"),
+		MIPS_MAKE_BREAK(1),
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(ops); ++i)
+		Memory::Write_U32(ops[i], base + (u32)i * 4);
+	Memory::Write_U32(0, scratch);
+	currentMIPS->r[MIPS_REG_S0] = scratch;
+	mipsr4k.UpdateCore(CPUCore::IR_JIT);
+
+	const int64_t skippedBefore = Memory::MemFault_GetNumSkippedBadAccesses();
+	currentMIPS->pc = base;
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING)
+		mipsr4k.RunLoopUntil(1000000);
+	const int64_t skipped = Memory::MemFault_GetNumSkippedBadAccesses() - skippedBefore;
+	const CoreState endState = coreState;
+	const u32 stored = Memory::Read_U32(scratch);
+
+	g_Config.bFastMemory = oldFastMemory;
+	g_Config.bIgnoreBadMemAccess = oldIgnoreBadMemAccess;
+	UninstallExceptionHandler();
+	DestroyJitHarness();
+
+	bool success = true;
+	if (skipped != 2) {
+		printf("IRJitMemoryFaults: %d bad accesses skipped, expected 2\n", (int)skipped);
+		success = false;
+	}
+	// The terminator powers down, a fault that wasn't skipped stops with a runtime error.
+	if (endState != CORE_POWERDOWN || stored != 0x1234) {
+		printf("IRJitMemoryFaults: block didn't finish, state %d, stored %08x\n", (int)endState, stored);
+		success = false;
+	}
+	return success;
+#else
+	// Faults in the IR interpreter can only be recovered from with the POSIX signal handlers.
+	return true;
+#endif
+}
+
+// Scratch memory that random register states point into.  Blocks may only touch memory here.
+static const u32 IR_CORPUS_WINDOW = 0x09F00000;
+static const u32 IR_CORPUS_WINDOW_SIZE = 0x00040000;
+static const int IR_CORPUS_STATES = 32;
+static const int IR_CORPUS_TIMING_REPS = 20;
+
+struct IRCorpusBlock {
+	u32 address;
+	std::vector<u32> ops;
+};
+
+struct IRCorpusCPUState {
+	u32 r[32];
+	u32 fi[32];
+	u32 vi[128];
+	u32 vfpuCtrl[16];
+	u32 pc;
+	u32 lo;
+	u32 hi;
+	u32 fcr31;
+	u32 fpcond;
+	int llBit;
+	GMRng rng;
+};
+
+struct IRCorpusPassStats {
+	const char *name;
+	double seconds;
+	size_t instsIn;
+	size_t instsOut;
+	// Blocks the pass changed anything in.
+	int blocksChanged;
+};
+
+static bool IRInstsEqual(const std::vector<IRInst> &a, const std::vector<IRInst> &b) {
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].op != b[i].op || a[i].dest != b[i].dest || a[i].src1 != b[i].src1 || a[i].src2 != b[i].src2 || a[i].constant != b[i].constant)
+			return false;
+	}
+	return true;
+}
+
+// Blocks which branch back to their own start, so each is a single block ending at its delay slot.
+static const char *const irCorpusSnippets[][12] = {
+	{
+		"lw t0, 0(a1)",
+		"lw t1, 4(a1)",
+		"addiu a1, a1, 8",
+		"sw t0, 0(a0)",
+		"sw t1, 4(a0)",
+		"addiu a2, a2, -8",
+		"bgtz a2, 0x%08x",
+		"addiu a0, a0, 8",
+	},
+	{
+		"addiu sp, sp, -32",
+		"sw ra, 28(sp)",
+		"sw s0, 24(sp)",
+		"sw s1, 20(sp)",
+		"move s0, a0",
+		"lui v0, 0x0890",
+		"ori v0, v0, 0x1234",
+		"sll v1, a1, 2",
+		"addu v1, v1, v0",
+		"jr ra",
+		"sw v1, 0(sp)",
+	},
+	{
+		"lbu t0, 0(a0)",
+		"lhu t1, 2(a0)",
+		"sb t0, 1(a1)",
+		"sh t1, 4(a1)",
+		"slt t2, t0, t1",
+		"sltiu t3, a2, 100",
+		"movz t4, t0, t2",
+		"movn t5, t1, t3",
+		"xor v0, t4, t5",
+		"beq v0, zero, 0x%08x",
+		"sra v1, v0, 3",
+	},
+	{
+		"lwc1 f0, 0(a0)",
+		"lwc1 f1, 4(a0)",
+		"add.s f2, f0, f1",
+		"mul.s f3, f2, f0",
+		"c.lt.s f3, f1",
+		"swc1 f3, 8(a0)",
+		"mfc1 v0, f2",
+		"bc1t 0x%08x",
+		"nop",
+	},
+	{
+		"mult a0, a1",
+		"mflo v0",
+		"mfhi v1",
+		"addu v0, v0, v1",
+		"ext t2, a0, 4, 8",
+		"ins t3, a1, 8, 4",
+		"seb t4, a0",
+		"wsbh t5, a1",
+		"clz t6, a2",
+		"max t7, a0, a1",
+		"j 0x%08x",
+		"nop",
+	},
+	{
+		"lwl t0, 3(a0)",
+		"lwr t0, 0(a0)",
+		"swl t0, 11(a1)",
+		"swr t0, 8(a1)",
+		"lw t1, 4(a1)",
+		"bnel t0, t1, 0x%08x",
+		"addiu v0, v0, 1",
+	},
+	{
+		"lv.q C100, 0(a0)",
+		"lv.q C200, 16(a0)",
+		"vadd.q C000, C100, C200",
+		"vmul.q C010, C100, C200",
+		"vdot.q S020, C100, C200",
+		"sv.q C000, 0(a1)",
+		"sv.q C010, 16(a1)",
+		"j 0x%08x",
+		"nop",
+	},
+	{
+		"vadd.s S002, S012, S022",
+		"vadd.s S000, S010, S020",
+		"vadd.s S001, S011, S021",
+		"vadd.s S003, S013, S023",
+		"vmul.s S100, S000, S030",
+		"vmul.s S101, S001, S030",
+		"vmul.s S102, S002, S030",
+		"vmul.s S103, S003, S030",
+		"sv.q C100, 0(a0)",
+		"j 0x%08x",
+		"nop",
+	},
+	{
+		"vadd.s S000, S011, S020",
+		"vadd.s S001, S010, S021",
+		"vadd.s S002, S013, S022",
+		"vadd.s S003, S012, S023",
+		"sv.q C000, 0(a0)",
+		"j 0x%08x",
+		"nop",
+	},
+	{
+		// t0 is written again on both exits before anyone reads it, so the first op is dead.
+		// Everything after the delay slot is only there for the function scan and liveness.
+		"addiu t0, a0, 4",
+		"addu v0, v0, a1",
+		"addiu a2, a2, -1",
+		"bne a2, zero, 0x%08x",
+		"nop",
+		"addiu t0, zero, 1",
+		"jr ra",
+		"move v1, t0",
+	},
+};
+
+static bool AssembleIRCorpusSnippets(std::vector<IRCorpusBlock> &blocks) {
+	u32 base = PSP_GetUserMemoryBase() + 0x4000;
+	for (size_t i = 0; i < ARRAY_SIZE(irCorpusSnippets); ++i, base += 0x100) {
+		IRCorpusBlock block;
+		block.address = base;
+
+		u32 addr = base;
+		bool success = true;
+		for (const char *line : irCorpusSnippets[i]) {
+			if (!line)
+				break;
+			char buf[256];
+			snprintf(buf, sizeof(buf), line, base);
+			if (!MIPSAsm::MipsAssembleOpcode(buf, currentDebugMIPS, addr)) {
+				printf("Unable to assemble '%s': %s\n", buf, MIPSAsm::GetAssembleError().c_str());
+				success = false;
+				break;
+			}
+			block.ops.push_back(Memory::Read_U32(addr));
+			addr += 4;
+		}
+
+		if (success)
+			blocks.push_back(block);
+	}
+	return !blocks.empty();
+}
+
+// Reads blocks written by the DumpIRBlocks option: one per line, an address followed by opcodes, in hex.
+static bool LoadIRCorpus(const Path &filename, std::vector<IRCorpusBlock> &blocks) {
+	std::string data;
+	if (!File::ReadFileToString(true, filename, data)) {
+		printf("Unable to read IR corpus %s\n", filename.c_str());
+		return false;
+	}
+
+	std::vector<std::string> lines;
+	SplitString(data, '\n', lines);
+	for (const std::string &line : lines) {
+		std::vector<std::string> words;
+		SplitString(line, ' ', words);
+		if (words.size() < 2)
+			continue;
+
+		IRCorpusBlock block;
+		block.address = (u32)strtoul(words[0].c_str(), nullptr, 16);
+		for (size_t i = 1; i < words.size(); ++i)
+			block.ops.push_back((u32)strtoul(words[i].c_str(), nullptr, 16));
+
+		// Must fit in RAM and stay clear of the scratch window.
+		u32 size = (u32)block.ops.size() * 4;
+		if (!Memory::IsValidRange(block.address, size) || (block.address & 3) != 0)
+			continue;
+		if (block.address < IR_CORPUS_WINDOW + IR_CORPUS_WINDOW_SIZE && IR_CORPUS_WINDOW < block.address + size)
+			continue;
+		blocks.push_back(block);
+	}
+	return !blocks.empty();
+}
+
+static void SaveIRCorpusState(const MIPSState *mips, IRCorpusCPUState &state) {
+	memcpy(state.r, mips->r, sizeof(state.r));
+	memcpy(state.fi, mips->fi, sizeof(state.fi));
+	memcpy(state.vi, mips->vi, sizeof(state.vi));
+	memcpy(state.vfpuCtrl, mips->vfpuCtrl, sizeof(state.vfpuCtrl));
+	state.pc = mips->pc;
+	state.lo = mips->lo;
+	state.hi = mips->hi;
+	state.fcr31 = mips->fcr31;
+	state.fpcond = mips->fpcond;
+	state.llBit = mips->llBit;
+	state.rng = mips->rng;
+}
+
+static void LoadIRCorpusState(MIPSState *mips, const IRCorpusCPUState &state) {
+	memcpy(mips->r, state.r, sizeof(state.r));
+	memcpy(mips->fi, state.fi, sizeof(state.fi));
+	memcpy(mips->vi, state.vi, sizeof(state.vi));
+	memcpy(mips->vfpuCtrl, state.vfpuCtrl, sizeof(state.vfpuCtrl));
+	mips->pc = state.pc;
+	mips->lo = state.lo;
+	mips->hi = state.hi;
+	mips->fcr31 = state.fcr31;
+	mips->fpcond = state.fpcond;
+	mips->llBit = state.llBit;
+	mips->rng = state.rng;
+	mips->nextPC = 0;
+	mips->inDelaySlot = false;
+	mips->downcount = 1000000;
+}
+
+static void RandomizeIRCorpusState(MIPSState *mips, GMRng &rng, u32 blockAddress) {
+	auto randomPointer = [&]() {
+		return (IR_CORPUS_WINDOW + IR_CORPUS_WINDOW_SIZE / 4 + rng.R32() % (IR_CORPUS_WINDOW_SIZE / 2)) & ~15;
+	};
+
+	mips->r[0] = 0;
+	for (int i = 1; i < 32; ++i) {
+		switch (rng.R32() & 3) {
+		case 0:
+		case 1:
+			mips->r[i] = randomPointer();
+			break;
+		case 2:
+			mips->r[i] = rng.R32();
+			break;
+		default:
+			// Small values matter for shifts, compares, and ext/ins.
+			mips->r[i] = (rng.R32() & 63) - 32;
+			break;
+		}
+	}
+	mips->r[MIPS_REG_SP] = randomPointer();
+	mips->r[MIPS_REG_RA] = blockAddress;
+	mips->lo = rng.R32();
+	mips->hi = rng.R32();
+
+	for (int i = 0; i < 32; ++i)
+		mips->f[i] = (rng.F() - 0.5f) * 200.0f;
+	for (int i = 0; i < 128; ++i)
+		mips->v[i] = (rng.F() - 0.5f) * 8.0f;
+	mips->fpcond = rng.R32() & 1;
+	mips->fcr31 = (mips->fcr31 & ~(1 << 23)) | (mips->fpcond << 23);
+	mips->llBit = rng.R32() & 1;
+	mips->pc = blockAddress;
+
+	u8 *window = Memory::GetPointerWrite(IR_CORPUS_WINDOW);
+	for (u32 i = 0; i < IR_CORPUS_WINDOW_SIZE; i += 4) {
+		u32 value = rng.R32();
+		memcpy(window + i, &value, 4);
+	}
+}
+
+// Whether the op at pc stays inside the scratch window and jumps somewhere valid, given the current state.
+static bool IsIRCorpusOpSafe(u32 pc) {
+	MIPSAnalyst::MipsOpcodeInfo info = MIPSAnalyst::GetOpcodeInfo(currentDebugMIPS, pc);
+	if (info.isBranch && (!Memory::IsValidAddress(info.branchTarget) || (info.branchTarget & 3) != 0))
+		return false;
+
+	if (info.isDataAccess) {
+		u32 addr = info.dataAddress;
+		if (addr < IR_CORPUS_WINDOW || addr + info.dataSize > IR_CORPUS_WINDOW + IR_CORPUS_WINDOW_SIZE)
+			return false;
+		// lwl/lwr/swl/swr are meant to be unaligned, but other misaligned accesses raise exceptions.
+		int opcode = info.encodedOpcode.encoding >> 26;
+		bool leftRight = opcode == 34 || opcode == 38 || opcode == 42 || opcode == 46;
+		if (!leftRight && (addr & (info.dataSize - 1)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// Steps the interpreter through one block, handling delay slots like MIPSInterpret_RunUntil.
+// Returns false if the state can't be used, because it would leave the scratch window.
+static bool InterpretIRCorpusBlock(MIPSState *mips, u32 start, u32 end) {
+	for (int steps = 0; steps < 1024; ++steps) {
+		u32 pc = mips->pc;
+		if (pc < start || pc >= end)
+			return true;
+		if (!IsIRCorpusOpSafe(pc))
+			return false;
+
+		bool wasInDelaySlot = mips->inDelaySlot;
+		MIPSInterpret(Memory::Read_Instruction(pc, true));
+		if (mips->inDelaySlot) {
+			// The branch itself, the delay slot is next.
+			if (!wasInDelaySlot)
+				continue;
+			mips->pc = mips->nextPC;
+			mips->inDelaySlot = false;
+			return true;
+		}
+		// Likely branches skip their delay slot, and the IR block ends either way.
+		if (mips->pc != pc + 4)
+			return true;
+	}
+	return true;
+}
+
+// Returns a description of the first difference, or an empty string if they match.
+// Only the GPRs in liveGPRs are compared, since the passes may leave dead ones with any value.
+static std::string CompareIRCorpusState(const IRCorpusCPUState &expected, const IRCorpusCPUState &actual, const u8 *expectedMem, const u8 *actualMem, u32 liveGPRs) {
+	if (expected.pc != actual.pc)
+		return StringFromFormat("pc %08x, expected %08x", actual.pc, expected.pc);
+	for (int i = 1; i < 32; ++i) {
+		if ((liveGPRs & (1U << i)) != 0 && expected.r[i] != actual.r[i])
+			return StringFromFormat("%s = %08x, expected %08x", currentDebugMIPS->GetRegName(0, i), actual.r[i], expected.r[i]);
+	}
+	if (expected.lo != actual.lo || expected.hi != actual.hi)
+		return StringFromFormat("hi/lo = %08x/%08x, expected %08x/%08x", actual.hi, actual.lo, expected.hi, expected.lo);
+	for (int i = 0; i < 32; ++i) {
+		if (expected.fi[i] != actual.fi[i])
+			return StringFromFormat("f%d = %08x, expected %08x", i, actual.fi[i], expected.fi[i]);
+	}
+	if (expected.fpcond != actual.fpcond)
+		return StringFromFormat("fpcond = %d, expected %d", actual.fpcond, expected.fpcond);
+	for (int i = 0; i < 128; ++i) {
+		if (expected.vi[i] != actual.vi[i])
+			return StringFromFormat("%s = %08x, expected %08x", currentDebugMIPS->GetRegName(2, i), actual.vi[i], expected.vi[i]);
+	}
+	for (int i = 0; i < 16; ++i) {
+		if (expected.vfpuCtrl[i] != actual.vfpuCtrl[i])
+			return StringFromFormat("vfpu ctrl %d = %08x, expected %08x", i, actual.vfpuCtrl[i], expected.vfpuCtrl[i]);
+	}
+	for (u32 i = 0; i < IR_CORPUS_WINDOW_SIZE; ++i) {
+		if (expectedMem[i] != actualMem[i])
+			return StringFromFormat("mem %08x = %02x, expected %02x", IR_CORPUS_WINDOW + i, actualMem[i], expectedMem[i]);
+	}
+	return "";
+}
+
+static void RunIRCorpusInstructions(MIPSState *mips, const std::vector<IRInst> &insts, u32 blockAddress) {
+	mips->pc = blockAddress;
+	mips->pc = IRInterpret(mips, insts.data(), (int)insts.size());
+}
+
+static void LogIRCorpusBlock(const IRCorpusBlock &block, const std::vector<IRInst> &insts) {
+	for (size_t i = 0; i < block.ops.size(); ++i) {
+		char line[512];
+		u32 addr = block.address + (u32)i * 4;
+		MIPSDisAsm(Memory::Read_Instruction(addr), addr, line, true);
+		printf("  M: %08x  %s\n", addr, line);
+	}
+	for (const IRInst &inst : insts) {
+		char buf[256];
+		DisassembleIR(buf, sizeof(buf), inst);
+		printf("  I: %s\n", buf);
+	}
+}
+
+static bool IsIRCorpusBlockUsable(const std::vector<IRInst> &insts) {
+	if (insts.empty())
+		return false;
+	for (const IRInst &inst : insts) {
+		switch (inst.op) {
+		case IROp::Syscall:
+		case IROp::CallReplacement:
+		case IROp::Break:
+		case IROp::Breakpoint:
+		case IROp::MemoryCheck:
+			return false;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+// Checks the GPR liveness that EliminateDeadGPRs relies on, for ops the tables only partly describe.
+bool TestFunctionLiveness() {
+	SetupJitHarness();
+
+	const u32 start = PSP_GetUserMemoryBase() + 0x8000;
+	const u32 ops[] = {
+		MIPS_MAKE_ADDIU(MIPS_REG_T0, MIPS_REG_ZERO, 5),
+		// mtic t0: only marked OUT_OTHER in the tables, but it reads t0.
+		0x70000000 | (MIPS_REG_T0 << 16) | 38,
+		MIPS_MAKE_ADDIU(MIPS_REG_T0, MIPS_REG_ZERO, 0),
+		MIPS_MAKE_JR_RA(),
+		MIPS_MAKE_NOP(),
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(ops); ++i)
+		Memory::Write_U32(ops[i], start + (u32)i * 4);
+	MIPSAnalyst::RegisterFunction(start, sizeof(ops), "liveness");
+
+	MIPSAnalyst::FunctionLiveness liveness;
+	bool success = MIPSAnalyst::ComputeFunctionLiveness(start, liveness);
+	// The write of 5 has to stay, since mtic reads it.
+	success = success && (liveness.LiveAt(start + 4) & (1U << MIPS_REG_T0)) != 0;
+	// But it's still dead right before the last write.
+	success = success && (liveness.LiveAt(start + 8) & (1U << MIPS_REG_T0)) == 0;
+	// And anything can be read after returning.
+	success = success && liveness.LiveAt(start + 16) == 0xFFFFFFFE;
+	if (!success)
+		printf("FunctionLiveness: t0 at %08x %08x\n", liveness.LiveAt(start + 4), liveness.LiveAt(start + 8));
+
+	MIPSAnalyst::Reset();
+	DestroyJitHarness();
+	return success;
+}
+
+// Replays a corpus of MIPS blocks through the IR frontend and passes.  Reports time per pass, how many
+// blocks each pass changed, instruction count reduction, and any results that differ from the interpreter
+// on random states.
+// Set PPSSPP_IR_CORPUS to a file written by the DumpIRBlocks option to use real game code.
+bool TestIRCorpus() {
+	SetupJitHarness();
+	InitIR();
+
+	std::vector<IRCorpusBlock> blocks;
+	const char *corpusFile = getenv("PPSSPP_IR_CORPUS");
+	bool loaded = corpusFile ? LoadIRCorpus(Path(corpusFile), blocks) : AssembleIRCorpusSnippets(blocks);
+	if (!loaded) {
+		printf("No usable blocks in IR corpus\n");
+		DestroyJitHarness();
+		return false;
+	}
+
+	MIPSComp::IRFrontend frontend(true);
+	IROptions frontendOpts{};
+	frontendOpts.unalignedLoadStore = true;
+	// Validating the experimental passes is the point.
+	frontendOpts.experimentalPasses = true;
+	frontend.SetOptions(frontendOpts);
+
+	size_t passCount;
+	const IRNamedPass *passes = MIPSComp::IRFrontend::GetPasses(passCount);
+	std::vector<IRCorpusPassStats> stats;
+	stats.push_back({ "Frontend", 0.0, 0, 0, 0 });
+	for (size_t i = 0; i < passCount; ++i)
+		stats.push_back({ passes[i].name, 0.0, 0, 0, 0 });
+
+	// Exit liveness comes from the scanned functions, like after a module load.
+	u32 scanStart = 0xFFFFFFFF, scanEnd = 0;
+	for (const IRCorpusBlock &block : blocks) {
+		for (size_t i = 0; i < block.ops.size(); ++i)
+			Memory::Write_U32(block.ops[i], block.address + (u32)i * 4);
+		scanStart = std::min(scanStart, block.address);
+		scanEnd = std::max(scanEnd, block.address + (u32)block.ops.size() * 4);
+	}
+	MIPSAnalyst::ScanForFunctions(scanStart, scanEnd - 4, false);
+
+	MIPSState *mips = currentMIPS;
+	GMRng rng;
+	rng.Init(0x1234);
+	std::vector<u8> initialMem(IR_CORPUS_WINDOW_SIZE), expectedMem(IR_CORPUS_WINDOW_SIZE);
+	u8 *window = Memory::GetPointerWrite(IR_CORPUS_WINDOW);
+
+	int compiledBlocks = 0;
+	int skippedBlocks = 0;
+	int statesChecked = 0;
+	int statesSkipped = 0;
+	int frontendMismatches = 0;
+	int passMismatches = 0;
+	size_t mipsOps = 0;
+	for (const IRCorpusBlock &block : blocks) {
+		for (size_t i = 0; i < block.ops.size(); ++i)
+			Memory::Write_U32(block.ops[i], block.address + (u32)i * 4);
+
+		std::vector<IRInst> raw;
+		u32 mipsBytes = 0;
+		double st = time_now_d();
+		for (int rep = 0; rep < IR_CORPUS_TIMING_REPS; ++rep)
+			frontend.DoJitRaw(block.address, raw, mipsBytes);
+		double frontendSeconds = time_now_d() - st;
+		if (!IsIRCorpusBlockUsable(raw)) {
+			skippedBlocks++;
+			continue;
+		}
+		stats[0].seconds += frontendSeconds;
+		stats[0].instsOut += raw.size();
+
+		std::unordered_map<u32, u32> exitLiveGPRs;
+		IROptions passOpts = frontend.GetPassOptions(raw, exitLiveGPRs);
+		IRWriter code;
+		for (const IRInst &inst : raw)
+			code.Write(inst);
+		for (size_t i = 0; i < passCount; ++i) {
+			IRWriter out;
+			st = time_now_d();
+			for (int rep = 0; rep < IR_CORPUS_TIMING_REPS; ++rep) {
+				out = IRWriter();
+				passes[i].func(code, out, passOpts);
+			}
+			stats[i + 1].seconds += time_now_d() - st;
+			stats[i + 1].instsIn += code.GetInstructions().size();
+			stats[i + 1].instsOut += out.GetInstructions().size();
+			if (!IRInstsEqual(code.GetInstructions(), out.GetInstructions()))
+				stats[i + 1].blocksChanged++;
+			code = std::move(out);
+		}
+		const std::vector<IRInst> &optimized = code.GetInstructions();
+		compiledBlocks++;
+		mipsOps += mipsBytes / 4;
+
+		bool loggedBlock = false;
+		for (int s = 0; s < IR_CORPUS_STATES; ++s) {
+			RandomizeIRCorpusState(mips, rng, block.address);
+			IRCorpusCPUState initial, expected, actual;
+			SaveIRCorpusState(mips, initial);
+			memcpy(&initialMem[0], window, IR_CORPUS_WINDOW_SIZE);
+
+			if (!InterpretIRCorpusBlock(mips, block.address, block.address + mipsBytes)) {
+				statesSkipped++;
+				continue;
+			}
+			SaveIRCorpusState(mips, expected);
+			memcpy(&expectedMem[0], window, IR_CORPUS_WINDOW_SIZE);
+			statesChecked++;
+			auto exitLive = exitLiveGPRs.find(expected.pc);
+			const u32 liveGPRs = exitLive != exitLiveGPRs.end() ? exitLive->second : 0xFFFFFFFF;
+
+			LoadIRCorpusState(mips, initial);
+			memcpy(window, &initialMem[0], IR_CORPUS_WINDOW_SIZE);
+			RunIRCorpusInstructions(mips, raw, block.address);
+			SaveIRCorpusState(mips, actual);
+			std::string rawDiff = CompareIRCorpusState(expected, actual, &expectedMem[0], window, liveGPRs);
+
+			LoadIRCorpusState(mips, initial);
+			memcpy(window, &initialMem[0], IR_CORPUS_WINDOW_SIZE);
+			RunIRCorpusInstructions(mips, optimized, block.address);
+			SaveIRCorpusState(mips, actual);
+			std::string optimizedDiff = CompareIRCorpusState(expected, actual, &expectedMem[0], window, liveGPRs);
+
+			// If the unoptimized IR is already wrong, the passes aren't to blame.
+			if (!rawDiff.empty()) {
+				frontendMismatches++;
+				if (!loggedBlock) {
+					printf("Block %08x: IR differs from interpreter: %s\n", block.address, rawDiff.c_str());
+					LogIRCorpusBlock(block, raw);
+					loggedBlock = true;
+				}
+			} else if (!optimizedDiff.empty()) {
+				passMismatches++;
+				if (!loggedBlock) {
+					printf("Block %08x: optimized IR differs from interpreter: %s\n", block.address, optimizedDiff.c_str());
+					LogIRCorpusBlock(block, optimized);
+					loggedBlock = true;
+				}
+			}
+		}
+	}
+
+	printf("IR corpus: %d blocks compiled (%d skipped), %d MIPS instructions\n", compiledBlocks, skippedBlocks, (int)mipsOps);
+	for (const IRCorpusPassStats &s : stats) {
+		double usPerBlock = compiledBlocks == 0 ? 0.0 : s.seconds * 1000000.0 / (compiledBlocks * IR_CORPUS_TIMING_REPS);
+		if (s.instsIn == 0)
+			printf("  %-26s %8.2f us/block, %d instructions\n", s.name, usPerBlock, (int)s.instsOut);
+		else
+			printf("  %-26s %8.2f us/block, %d -> %d instructions, changed %d blocks\n", s.name, usPerBlock, (int)s.instsIn, (int)s.instsOut, s.blocksChanged);
+	}
+	if (!stats.empty() && stats[0].instsOut != 0)
+		printf("  Total: %d -> %d instructions (%.1f%%)\n", (int)stats[0].instsOut, (int)stats.back().instsOut, 100.0 * stats.back().instsOut / stats[0].instsOut);
+	printf("  Differential: %d states checked (%d skipped), %d frontend mismatches, %d pass mismatches\n", statesChecked, statesSkipped, frontendMismatches, passMismatches);
+
+	// The built in snippets include dead writes, if nothing got removed the liveness never made it to the passes.
+	bool eliminated = true;
+	if (!corpusFile) {
+		for (const IRCorpusPassStats &s : stats) {
+			if (!strcmp(s.name, "EliminateDeadGPRs") && s.blocksChanged == 0) {
+				printf("  EliminateDeadGPRs didn't change any block\n");
+				eliminated = false;
+			}
+		}
+	}
+
+	MIPSAnalyst::Reset();
+	DestroyJitHarness();
+	return frontendMismatches == 0 && passMismatches == 0 && eliminated;
+}
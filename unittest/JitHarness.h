@@ -18,3 +18,8 @@
 #pragma once
 
 bool TestJit();
+bool TestJitCodeRegionEviction();
+bool TestIRJitTraces();
+bool TestIRJitMemoryFaults();
+bool TestIRCorpus();
+bool TestFunctionLiveness();
@@ -17,6 +17,8 @@
 
 #include <cstdio>
 #include <cstring>
+#include <unordered_map>
+#include "Common/Common.h"
 #include "Core/MIPS/IR/IRInst.h"
 #include "Core/MIPS/IR/IRPassSimplify.h"
 
@@ -25,6 +27,8 @@ struct IRVerification {
 	const std::vector<IRInst> input;
 	const std::vector<IRInst> expected;
 	const std::vector<IRPassFunc> passes;
+	// Live GPRs at exit targets, for passes that use liveness.
+	const std::unordered_map<u32, u32> exitLiveGPRs;
 };
 
 static void LogInstructions(const std::vector<IRInst> &insts) {
@@ -39,6 +43,8 @@ static bool VerifyPass(const IRVerification &v) {
 	IRWriter in, out;
 	IROptions opts{};
 	opts.unalignedLoadStore = true;
+	if (!v.exitLiveGPRs.empty())
+		opts.exitLiveGPRs = &v.exitLiveGPRs;
 
 	for (const auto &inst : v.input)
 		in.Write(inst);
@@ -166,8 +172,352 @@ static const IRVerification tests[] = {
 		},
 		{ &PropagateConstants },
 	},
+	{
+		"MergeLoadStoreForward",
+		{
+			{ IROp::Store32, { MIPS_REG_A1 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_SP, 0, 0x10 },
+		},
+		{
+			{ IROp::Store32, { MIPS_REG_A1 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::Mov, { MIPS_REG_V0 }, MIPS_REG_A1 },
+		},
+		{ &MergeLoadStore },
+	},
+	{
+		// Different offsets must not be forwarded.
+		"MergeLoadStoreOtherOffset",
+		{
+			{ IROp::Store32, { MIPS_REG_A1 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_SP, 0, 0x14 },
+		},
+		{
+			{ IROp::Store32, { MIPS_REG_A1 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_SP, 0, 0x14 },
+		},
+		{ &MergeLoadStore },
+	},
+	{
+		"MergeStoreZeroBytes",
+		{
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0x20 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0x21 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0x22 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0x23 },
+		},
+		{
+			{ IROp::Store32, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0x20 },
+		},
+		{ &MergeLoadStore },
+	},
+	{
+		"ReorderLoadsByOffset",
+		{
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_A0, 0, 8 },
+			{ IROp::AddConst, { MIPS_REG_T0 }, MIPS_REG_T1, 0, 1 },
+			{ IROp::Load32, { MIPS_REG_V1 }, MIPS_REG_A0, 0, 4 },
+			{ IROp::ExitToReg, { 0 }, MIPS_REG_RA },
+		},
+		{
+			{ IROp::Load32, { MIPS_REG_V1 }, MIPS_REG_A0, 0, 4 },
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_A0, 0, 8 },
+			{ IROp::AddConst, { MIPS_REG_T0 }, MIPS_REG_T1, 0, 1 },
+			{ IROp::ExitToReg, { 0 }, MIPS_REG_RA },
+		},
+		{ &ReorderLoadStore },
+	},
+	{
+		// A load can't move above an op that reads its dest.
+		"ReorderLoadStoreDependency",
+		{
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_A0, 0, 8 },
+			{ IROp::AddConst, { MIPS_REG_T0 }, MIPS_REG_V1, 0, 1 },
+			{ IROp::Load32, { MIPS_REG_V1 }, MIPS_REG_A0, 0, 4 },
+			{ IROp::ExitToReg, { 0 }, MIPS_REG_RA },
+		},
+		{
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_A0, 0, 8 },
+			{ IROp::AddConst, { MIPS_REG_T0 }, MIPS_REG_V1, 0, 1 },
+			{ IROp::Load32, { MIPS_REG_V1 }, MIPS_REG_A0, 0, 4 },
+			{ IROp::ExitToReg, { 0 }, MIPS_REG_RA },
+		},
+		{ &ReorderLoadStore },
+	},
+	{
+		"EliminateDeadGPRs",
+		{
+			{ IROp::SetConst, { MIPS_REG_T0 }, 0, 0, 0x08800000 },
+			{ IROp::SetConst, { MIPS_REG_T1 }, 0, 0, 0x00001234 },
+			{ IROp::Load32, { MIPS_REG_T2 }, MIPS_REG_T0, 0, 0 },
+			{ IROp::ExitToConstIfEq, { 0 }, MIPS_REG_T2, MIPS_REG_ZERO, 0x08804000 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{
+			{ IROp::SetConst, { MIPS_REG_T0 }, 0, 0, 0x08800000 },
+			{ IROp::Load32, { MIPS_REG_T2 }, MIPS_REG_T0, 0, 0 },
+			{ IROp::ExitToConstIfEq, { 0 }, MIPS_REG_T2, MIPS_REG_ZERO, 0x08804000 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{ &EliminateDeadGPRs },
+		// T1 is overwritten at both targets, T0 is read at one of them.
+		{ { 0x08804000, (1U << MIPS_REG_T0) | (1U << MIPS_REG_V0) }, { 0x08804010, 1U << MIPS_REG_V0 } },
+	},
+	{
+		// Unknown exits and syscalls keep everything.
+		"EliminateDeadGPRsUnknownExit",
+		{
+			{ IROp::SetConst, { MIPS_REG_T1 }, 0, 0, 0x00001234 },
+			{ IROp::ExitToConstIfEq, { 0 }, MIPS_REG_T2, MIPS_REG_ZERO, 0x08805000 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{
+			{ IROp::SetConst, { MIPS_REG_T1 }, 0, 0, 0x00001234 },
+			{ IROp::ExitToConstIfEq, { 0 }, MIPS_REG_T2, MIPS_REG_ZERO, 0x08805000 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{ &EliminateDeadGPRs },
+		{ { 0x08804010, 1U << MIPS_REG_V0 } },
+	},
+	{
+		// Dead loads stay if the address might be bad, so they still fault.
+		"EliminateDeadGPRsLoads",
+		{
+			{ IROp::Load32, { MIPS_REG_T1 }, MIPS_REG_T0, 0, 0 },
+			{ IROp::Load8, { MIPS_REG_T2 }, MIPS_REG_ZERO, 0, 0x00000010 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{
+			{ IROp::Load32, { MIPS_REG_T1 }, MIPS_REG_T0, 0, 0 },
+			{ IROp::Load8, { MIPS_REG_T2 }, MIPS_REG_ZERO, 0, 0x00000010 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804010 },
+		},
+		{ &EliminateDeadGPRs },
+		{ { 0x08804010, 1U << MIPS_REG_V0 } },
+	},
+	{
+		"VectorizeVFPUAdd",
+		{
+			{ IROp::FAdd, { 34 }, 50, 66 },
+			{ IROp::FAdd, { 32 }, 48, 64 },
+			{ IROp::Add, { MIPS_REG_A0 }, MIPS_REG_A1, MIPS_REG_A2 },
+			{ IROp::FAdd, { 33 }, 49, 65 },
+			{ IROp::FAdd, { 35 }, 51, 67 },
+		},
+		{
+			{ IROp::Add, { MIPS_REG_A0 }, MIPS_REG_A1, MIPS_REG_A2 },
+			{ IROp::Vec4Add, { 32 }, 48, 64 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		"VectorizeVFPUScale",
+		{
+			{ IROp::FMul, { 32 }, 48, 2 },
+			{ IROp::FMul, { 33 }, 49, 2 },
+			{ IROp::FMul, { 34 }, 50, 2 },
+			{ IROp::FMul, { 35 }, 51, 2 },
+		},
+		{
+			{ IROp::Vec4Scale, { 32 }, 48, 2 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		"VectorizeVFPUInPlace",
+		{
+			{ IROp::FNeg, { 36 }, 36 },
+			{ IROp::FNeg, { 37 }, 37 },
+			{ IROp::FNeg, { 38 }, 38 },
+			{ IROp::FNeg, { 39 }, 39 },
+		},
+		{
+			{ IROp::Vec4Neg, { 36 }, 36 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		"VectorizeVFPUDependency",
+		{
+			{ IROp::FAdd, { 32 }, 48, 64 },
+			{ IROp::FAdd, { 33 }, 49, 65 },
+			// Reads lane 1 before the group is complete, so it can't move down.
+			{ IROp::FMov, { 100 }, 33 },
+			{ IROp::FAdd, { 34 }, 50, 66 },
+			{ IROp::FAdd, { 35 }, 51, 67 },
+		},
+		{
+			{ IROp::FAdd, { 32 }, 48, 64 },
+			{ IROp::FAdd, { 33 }, 49, 65 },
+			{ IROp::FMov, { 100 }, 33 },
+			{ IROp::FAdd, { 34 }, 50, 66 },
+			{ IROp::FAdd, { 35 }, 51, 67 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		// Swizzled sources get shuffled into a temp first.
+		"VectorizeVFPUShuffle",
+		{
+			{ IROp::FAdd, { 32 }, 49, 64 },
+			{ IROp::FAdd, { 33 }, 48, 65 },
+			{ IROp::FAdd, { 34 }, 51, 66 },
+			{ IROp::FAdd, { 35 }, 50, 67 },
+		},
+		{
+			{ IROp::Vec4Shuffle, { IRVTEMP_0 }, 48, 0xB1 },
+			{ IROp::Vec4Add, { 32 }, IRVTEMP_0, 64 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		// FCmovVfpuCC may keep the old value, so the temp it targets is still live.
+		"VectorizeVFPUShuffleCmovTemp",
+		{
+			{ IROp::FAdd, { 32 }, 49, 64 },
+			{ IROp::FAdd, { 33 }, 48, 65 },
+			{ IROp::FAdd, { 34 }, 51, 66 },
+			{ IROp::FAdd, { 35 }, 50, 67 },
+			{ IROp::FCmovVfpuCC, { IRVTEMP_0 }, 68, 0 },
+		},
+		{
+			{ IROp::Vec4Shuffle, { IRVTEMP_PFX_T }, 48, 0xB1 },
+			{ IROp::Vec4Add, { 32 }, IRVTEMP_PFX_T, 64 },
+			{ IROp::FCmovVfpuCC, { IRVTEMP_0 }, 68, 0 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		// The second lane reads what the first one wrote.
+		"VectorizeVFPUShuffleInPlace",
+		{
+			{ IROp::FMov, { 32 }, 33 },
+			{ IROp::FMov, { 33 }, 32 },
+			{ IROp::FMov, { 34 }, 34 },
+			{ IROp::FMov, { 35 }, 35 },
+		},
+		{
+			{ IROp::FMov, { 32 }, 33 },
+			{ IROp::FMov, { 33 }, 32 },
+			{ IROp::FMov, { 34 }, 34 },
+			{ IROp::FMov, { 35 }, 35 },
+		},
+		{ &VectorizeVFPU },
+	},
+	{
+		"VectorizeVFPUUnaligned",
+		{
+			{ IROp::FMov, { 32 }, 49 },
+			{ IROp::FMov, { 33 }, 50 },
+			{ IROp::FMov, { 34 }, 51 },
+			{ IROp::FMov, { 35 }, 52 },
+		},
+		{
+			{ IROp::FMov, { 32 }, 49 },
+			{ IROp::FMov, { 33 }, 50 },
+			{ IROp::FMov, { 34 }, 51 },
+			{ IROp::FMov, { 35 }, 52 },
+		},
+		{ &VectorizeVFPU },
+	},
+};
+
+// Representative blocks as the frontend emits them, before any passes.  Used to measure the pipeline.
+struct IRCorpusBlock {
+	const char *name;
+	const std::vector<IRInst> input;
+	const std::unordered_map<u32, u32> exitLiveGPRs;
 };
 
+static const IRCorpusBlock corpus[] = {
+	{
+		"Prologue",
+		{
+			{ IROp::AddConst, { MIPS_REG_SP }, MIPS_REG_SP, 0, (u32)-0x20 },
+			{ IROp::Store32, { MIPS_REG_S1 }, MIPS_REG_SP, 0, 0x14 },
+			{ IROp::Store32, { MIPS_REG_S0 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::Store32, { MIPS_REG_RA }, MIPS_REG_SP, 0, 0x18 },
+			{ IROp::Mov, { MIPS_REG_S0 }, MIPS_REG_A0 },
+			{ IROp::Load32, { MIPS_REG_V0 }, MIPS_REG_SP, 0, 0x10 },
+			{ IROp::SetConst, { MIPS_REG_RA }, 0, 0, 0x08804020 },
+			{ IROp::Downcount, { 0 }, 0, 0, 8 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08900000 },
+		},
+		{ { 0x08900000, 0xFFFFFFFF & ~(1U << MIPS_REG_V0) } },
+	},
+	{
+		"ZeroFill",
+		{
+			{ IROp::SetConst, { MIPS_REG_COMPILER_SCRATCH }, 0, 0, 0x08810000 },
+			{ IROp::OrConst, { MIPS_REG_A0 }, MIPS_REG_COMPILER_SCRATCH, 0, 0x100 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 0 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 1 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 2 },
+			{ IROp::Store8, { MIPS_REG_ZERO }, MIPS_REG_A0, 0, 3 },
+			{ IROp::Downcount, { 0 }, 0, 0, 6 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804100 },
+		},
+		// $at is an assembler temp, it's overwritten before being read again.
+		{ { 0x08804100, (1U << MIPS_REG_A0) | (1U << MIPS_REG_RA) | (1U << MIPS_REG_SP) } },
+	},
+	{
+		"LoopBody",
+		{
+			{ IROp::Load32, { MIPS_REG_T0 }, MIPS_REG_A1, 0, 8 },
+			{ IROp::Load32, { MIPS_REG_T1 }, MIPS_REG_A1, 0, 4 },
+			{ IROp::Add, { MIPS_REG_V0 }, MIPS_REG_V0, MIPS_REG_T0 },
+			{ IROp::Add, { MIPS_REG_V0 }, MIPS_REG_V0, MIPS_REG_T1 },
+			{ IROp::AddConst, { MIPS_REG_A1 }, MIPS_REG_A1, 0, 12 },
+			{ IROp::Mov, { IRTEMP_LHS }, MIPS_REG_A1 },
+			{ IROp::Mov, { IRTEMP_RHS }, MIPS_REG_A2 },
+			{ IROp::Downcount, { 0 }, 0, 0, 7 },
+			{ IROp::ExitToConstIfEq, { 0 }, IRTEMP_LHS, IRTEMP_RHS, 0x08804220 },
+			{ IROp::ExitToConst, { 0 }, 0, 0, 0x08804200 },
+		},
+		{
+			{ 0x08804200, (1U << MIPS_REG_A1) | (1U << MIPS_REG_A2) | (1U << MIPS_REG_V0) | (1U << MIPS_REG_RA) },
+			{ 0x08804220, (1U << MIPS_REG_V0) | (1U << MIPS_REG_RA) },
+		},
+	},
+};
+
+static void MeasureCorpus() {
+	static const IRPassFunc passes[] = {
+		&RemoveLoadStoreLeftRight,
+		&OptimizeFPMoves,
+		&PropagateConstants,
+		&PurgeTemps,
+		&EliminateDeadGPRs,
+		&VectorizeVFPU,
+		&ReorderLoadStore,
+		&MergeLoadStore,
+	};
+
+	int totalBefore = 0;
+	int totalLocal = 0;
+	int totalAfter = 0;
+	for (const auto &block : corpus) {
+		IRWriter in, local, out;
+		for (const auto &inst : block.input)
+			in.Write(inst);
+
+		// First without any liveness, as block-local passes only.
+		IROptions opts{};
+		opts.unalignedLoadStore = true;
+		IRApplyPasses(passes, ARRAY_SIZE(passes), in, local, opts);
+		opts.exitLiveGPRs = &block.exitLiveGPRs;
+		IRApplyPasses(passes, ARRAY_SIZE(passes), in, out, opts);
+
+		int before = (int)in.GetInstructions().size();
+		int localCount = (int)local.GetInstructions().size();
+		int after = (int)out.GetInstructions().size();
+		printf("  %s: %d -> %d (block local), %d (with liveness)\n", block.name, before, localCount, after);
+		totalBefore += before;
+		totalLocal += localCount;
+		totalAfter += after;
+	}
+	printf("  Corpus: %d -> %d (block local), %d (with liveness) instructions\n", totalBefore, totalLocal, totalAfter);
+}
+
 bool TestIRPassSimplify() {
 	InitIR();
 
@@ -176,5 +526,6 @@ bool TestIRPassSimplify() {
 			return false;
 	}
 
+	MeasureCorpus();
 	return true;
 }
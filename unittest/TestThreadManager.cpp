@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <vector>
 
@@ -115,11 +117,95 @@ bool TestMultithreadedScheduling() {
 
 	threads.clear();
 
-	printf("Stress test elapsed: %0.2f", start.Elapsed());
+	printf("Stress test elapsed: %0.2f\n", start.Elapsed());
 
 	return true;
 }
 
+const int THROUGHPUT_WORK = 200;
+
+class ThroughputTask : public Task {
+public:
+	ThroughputTask(ThreadManager *threadMan, std::vector<std::atomic<int>> *runs, int index, int children, std::atomic<int> *remaining, LimitedWaitable *done)
+		: threadMan_(threadMan), runs_(runs), index_(index), children_(children), remaining_(remaining), done_(done) {}
+
+	TaskType Type() const override { return TaskType::CPU_COMPUTE; }
+
+	void Run() override {
+		// A little work, like a small slice of a parallel loop.
+		uint32_t x = index_;
+		for (int i = 0; i < THROUGHPUT_WORK; ++i)
+			x = x * 1664525 + 1013904223;
+		sink_ += x;
+
+		// Spawned from a worker, so these land in its own deque for others to steal.
+		for (int i = 1; i <= children_; ++i)
+			threadMan_->EnqueueTask(new ThroughputTask(threadMan_, runs_, index_ + i, 0, remaining_, done_));
+
+		(*runs_)[index_]++;
+		if (--*remaining_ == 0)
+			done_->Notify();
+	}
+
+	static std::atomic<uint32_t> sink_;
+
+private:
+	ThreadManager *threadMan_;
+	std::vector<std::atomic<int>> *runs_;
+	int index_;
+	int children_;
+	std::atomic<int> *remaining_;
+	LimitedWaitable *done_;
+};
+
+std::atomic<uint32_t> ThroughputTask::sink_;
+
+// Runs roots * (1 + children) small tasks, and returns tasks per second.
+static double RunThroughput(ThreadManager *threadMan, int roots, int children, bool *ok) {
+	const int total = roots * (1 + children);
+	std::vector<std::atomic<int>> runs(total);
+	std::atomic<int> remaining(total);
+	LimitedWaitable *done = new LimitedWaitable();
+
+	double start = time_now_d();
+	for (int i = 0; i < roots; ++i)
+		threadMan->EnqueueTask(new ThroughputTask(threadMan, &runs, i * (1 + children), children, &remaining, done));
+	done->WaitAndRelease();
+	double elapsed = time_now_d() - start;
+
+	for (int i = 0; i < total; ++i) {
+		if (runs[i] != 1)
+			*ok = false;
+	}
+	return total / elapsed;
+}
+
+// Every task, queued from outside or spawned by a worker, has to run exactly once.
+static bool TestTaskRunsOnce(ThreadManager *threadMan) {
+	bool ok = true;
+	RunThroughput(threadMan, 1000, 0, &ok);
+	RunThroughput(threadMan, 100, 9, &ok);
+	EXPECT_TRUE(ok);
+	return true;
+}
+
+// Shows how task throughput scales with the number of compute threads.
+bool TestTaskThroughputBenchmark() {
+	int maxThreads = std::min((int)std::thread::hardware_concurrency(), 16);
+	bool ok = true;
+	for (int threads = 1; threads <= std::max(maxThreads, 1); threads *= 2) {
+		ThreadManager manager;
+		manager.Init(threads, 1);
+		// Tasks queued from outside, and tasks spawned by workers.
+		double flat = RunThroughput(&manager, 100000, 0, &ok);
+		double spawned = RunThroughput(&manager, 1000, 99, &ok);
+		manager.Teardown();
+		printf("ThreadManager: %2d threads: %9.0f tasks/s queued, %9.0f tasks/s spawned\n", threads, flat, spawned);
+	}
+	EXPECT_TRUE(ok);
+	return true;
+}
+
 bool TestThreadManager() {
 	ThreadManager manager;
 	manager.Init(8, 1);
@@ -148,5 +234,11 @@ bool TestThreadManager() {
 		return false;
 	}
 
+	if (!TestTaskRunsOnce(&manager)) {
+		return false;
+	}
+
+	manager.Teardown();
+
 	return true;
 }
@@ -25,13 +25,16 @@
 // Or just integrate with an existing testing framework.
 //
 // To use, set command line parameter to one or more of the tests below, or "all".
-// Search for "availableTests".
+// Search for "availableTests".  Benchmarks are only run by name, search for "availableBenchmarks".
 
 #include "ppsspp_config.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include <string>
 #include <sstream>
@@ -47,19 +50,34 @@
 #include "Common/File/Path.h"
 #include "Common/Input/InputState.h"
 #include "Common/Math/math_util.h"
+#include "Common/Net/HTTPClient.h"
+#include "Common/Net/HTTPServer.h"
+#include "Common/Net/Resolve.h"
+#include "Common/Net/Sinks.h"
 #include "Common/Render/DrawBuffer.h"
 #include "Common/System/NativeApp.h"
 #include "Common/System/System.h"
+#include "Common/Thread/ThreadManager.h"
+#include "Common/Thread/Waitable.h"
 
 #include "Common/ArmEmitter.h"
 #include "Common/BitScan.h"
 #include "Common/CPUDetect.h"
+#include "Common/StringUtils.h"
 #include "Common/Log.h"
+#include "Common/TimeUtil.h"
 #include "Core/Config.h"
+#include "Core/FileLoaders/HTTPFileLoader.h"
 #include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/HLE/proAdhocServer.h"
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
+#include "Core/System.h"
+#include "Core/Util/BlockAllocator.h"
+#include "GPU/Common/SoftwareTransformCommon.h"
+#include "GPU/Common/SplineCommon.h"
 #include "GPU/Common/TextureDecoder.h"
+#include "GPU/Math3D.h"
 
 #include "android/jni/AndroidContentURI.h"
 
@@ -386,6 +404,112 @@ bool TestVFPUSinCos() {
 	return true;
 }
 
+static uint32_t VFPUFloatBits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static float VFPUBitsFloat(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// What vfpu_sin/vfpu_cos computed with libm before they were table based, for inputs that
+// the modulus leaves alone.
+static float VFPULibmSin(float x) {
+	return VFPUBitsFloat(VFPUFloatBits((float)sin((double)x * M_PI_2)) & 0xFFFFFFFC);
+}
+
+static float VFPULibmCos(float x) {
+	return VFPUBitsFloat(VFPUFloatBits((float)cos((double)x * M_PI_2)) & 0xFFFFFFFC);
+}
+
+template <typename F>
+static double VFPUSinCosThroughput(const float *inputs, int count, F func) {
+	float out[4];
+	float sum = 0.0f;
+	int total = 0;
+	double st = time_now_d();
+	do {
+		for (int i = 0; i < count; i += 4) {
+			func(&inputs[i], out);
+			sum += out[0] + out[1] + out[2] + out[3];
+		}
+		total += count;
+	} while (time_now_d() - st < 0.25);
+	double elapsed = time_now_d() - st;
+	// Keep the work from being optimized out.
+	if (sum == 12345.0f)
+		printf(" ");
+	return total / elapsed / 1000000.0;
+}
+
+bool TestVFPUSinCosTable() {
+	InitVFPUSinCos();
+
+	// Everything from 2^-23 up to 2 is used as is, skip through it in both signs.
+	for (uint32_t bits = 0x34000000; bits < 0x40000000; bits += 97) {
+		for (uint32_t sign : { 0x00000000U, 0x80000000U }) {
+			float x = VFPUBitsFloat(bits | sign);
+			EXPECT_EQ_HEX(VFPUFloatBits(vfpu_sin(x)), VFPUFloatBits(VFPULibmSin(x)));
+			if (x == 1.0f || x == -1.0f)
+				continue;
+			EXPECT_EQ_HEX(VFPUFloatBits(vfpu_cos(x)), VFPUFloatBits(VFPULibmCos(x)));
+			float sine, cosine;
+			vfpu_sincos(x, sine, cosine);
+			EXPECT_EQ_HEX(VFPUFloatBits(sine), VFPUFloatBits(VFPULibmSin(x)));
+			EXPECT_EQ_HEX(VFPUFloatBits(cosine), VFPUFloatBits(VFPULibmCos(x)));
+		}
+	}
+
+	// The four lane versions have to match per lane, special cases included.
+	static const float lanes[] = {
+		0.0f, -0.0f, 1.0f, -1.0f,
+		2.0f, 3.5f, -7.25f, 1e-10f,
+		12345.678f, -1e30f, INFINITY, -INFINITY,
+		NAN, 0.3f, -1.9999f, 4.0f,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(lanes); i += 4) {
+		float sines[4], cosines[4];
+		vfpu_sin4(&lanes[i], sines);
+		vfpu_cos4(&lanes[i], cosines);
+		for (int j = 0; j < 4; ++j) {
+			EXPECT_EQ_HEX(VFPUFloatBits(sines[j]), VFPUFloatBits(vfpu_sin(lanes[i + j])));
+			EXPECT_EQ_HEX(VFPUFloatBits(cosines[j]), VFPUFloatBits(vfpu_cos(lanes[i + j])));
+		}
+	}
+	return true;
+}
+
+// Takes about a second, so it's not part of "all".
+bool TestVFPUSinCosBenchmark() {
+	InitVFPUSinCos();
+
+	const int COUNT = 4096;
+	std::vector<float> inputs(COUNT);
+	uint32_t seed = 0x12345678;
+	for (int i = 0; i < COUNT; ++i) {
+		seed = seed * 1664525 + 1013904223;
+		inputs[i] = (float)(seed >> 8) * (4.0f / 16777216.0f) - 2.0f;
+	}
+
+	double libmRate = VFPUSinCosThroughput(inputs.data(), COUNT, [](const float *in, float *out) {
+		for (int j = 0; j < 4; ++j)
+			out[j] = VFPULibmSin(in[j]);
+	});
+	double scalarRate = VFPUSinCosThroughput(inputs.data(), COUNT, [](const float *in, float *out) {
+		for (int j = 0; j < 4; ++j)
+			out[j] = vfpu_sin(in[j]);
+	});
+	double vec4Rate = VFPUSinCosThroughput(inputs.data(), COUNT, [](const float *in, float *out) {
+		vfpu_sin4(in, out);
+	});
+	printf("vfpu_sin: libm %0.1f, table %0.1f, table x4 %0.1f million lanes/s\n", libmRate, scalarRate, vec4Rate);
+	return true;
+}
+
 bool TestMatrixTranspose() {
 	MatrixSize sz = M_4x4;
 	int matrix = 0;  // M000
@@ -569,6 +693,318 @@ bool TestCLZ() {
 	return true;
 }
 
+static bool CompareTransformedPos(const TransformedVertex &a, const TransformedVertex &b, int components) {
+#if defined(_M_SSE)
+	// Same operations in the same order, so this should be exact.
+	return memcmp(a.pos, b.pos, components * sizeof(float)) == 0;
+#else
+	// The compiler may fuse multiply-adds differently, so allow a tiny difference.
+	for (int i = 0; i < components; ++i) {
+		if (fabsf(a.pos[i] - b.pos[i]) > fabsf(b.pos[i]) * 1e-6f + 1e-6f)
+			return false;
+	}
+	return true;
+#endif
+}
+
+static bool TestSoftwareTransformBatch() {
+	float world[12], view[12], proj[16];
+	u32 seed = 0x5EED;
+	auto random = [&]() {
+		seed = seed * 1664525 + 1013904223;
+		return (float)(int)(seed >> 8) / (float)(1 << 20) - 8.0f;
+	};
+	for (float &f : world)
+		f = random();
+	for (float &f : view)
+		f = random();
+	for (float &f : proj)
+		f = random();
+	const float fogEnd = random();
+	const float fogSlope = random();
+
+	// Odd counts to also cover the leftover vertices after the batches of four.
+	for (int count = 0; count < 14; ++count) {
+		TransformedVertex batch[14]{};
+		TransformedVertex scalar[14]{};
+		for (int i = 0; i < count; ++i) {
+			batch[i].x = random();
+			batch[i].y = random();
+			batch[i].z = random();
+			scalar[i] = batch[i];
+		}
+
+		TransformVertexPositions43(batch, count, world);
+		for (int i = 0; i < count; ++i) {
+			float in[3] = { scalar[i].x, scalar[i].y, scalar[i].z };
+			Vec3ByMatrix43(scalar[i].pos, in, world);
+			EXPECT_TRUE(CompareTransformedPos(batch[i], scalar[i], 3));
+		}
+
+		TransformVertexViewProj(batch, count, view, proj, fogEnd, fogSlope);
+		for (int i = 0; i < count; ++i) {
+			float in[3] = { scalar[i].x, scalar[i].y, scalar[i].z };
+			float v[3];
+			Vec3ByMatrix43(v, in, view);
+			scalar[i].fog = (v[2] + fogEnd) * fogSlope;
+			Vec3ByMatrix44(scalar[i].pos, v, proj);
+			EXPECT_TRUE(CompareTransformedPos(batch[i], scalar[i], 4));
+			EXPECT_APPROX_EQ_FLOAT(batch[i].fog, scalar[i].fog);
+		}
+	}
+	return true;
+}
+
+static bool TestSplineTessellationCache() {
+	Spline::BezierSurface surface{};
+	surface.tess_u = 4;
+	surface.tess_v = 4;
+	surface.num_points_u = 4;
+	surface.num_points_v = 4;
+	surface.num_patches_u = 1;
+	surface.num_patches_v = 1;
+	surface.primType = GE_PATCHPRIM_TRIANGLES;
+	surface.num_verts_per_patch = (surface.tess_u + 1) * (surface.tess_v + 1);
+	const int numVerts = surface.GetNumVertices();
+
+	Vec3f pos[16];
+	Vec2f tex[16];
+	Vec4f col[16];
+	for (int i = 0; i < 16; ++i) {
+		pos[i] = Vec3f((float)(i & 3), 0.0f, (float)(i >> 2));
+		tex[i] = Vec2f(0.0f, 0.0f);
+		col[i] = Vec4f(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+	Spline::ControlPoints points;
+	points.pos = pos;
+	points.tex = tex;
+	points.col = col;
+	points.defcolor = 0xFFFFFFFF;
+
+	auto tessellate = [&](std::vector<Vec3Packedf> &out) {
+		std::vector<SimpleVertex> vertices(numVerts);
+		std::vector<u16> indices(surface.tess_u * surface.tess_v * 6);
+		Spline::OutputBuffers output{ vertices.data(), indices.data(), 0 };
+		Spline::SoftwareTessellation(output, surface, 0, points);
+		out.clear();
+		for (const SimpleVertex &v : vertices)
+			out.push_back(v.pos);
+		return output.count;
+	};
+
+	std::vector<Vec3Packedf> first, cached, changed, restored;
+	EXPECT_EQ_INT(tessellate(first), surface.tess_u * surface.tess_v * 6);
+	// The second run is served from the cache and must match.
+	EXPECT_EQ_INT(tessellate(cached), surface.tess_u * surface.tess_v * 6);
+	EXPECT_TRUE(memcmp(first.data(), cached.data(), sizeof(Vec3Packedf) * numVerts) == 0);
+
+	// Lifting an inner control point has to bend the surface, not reuse the flat patch.
+	pos[5].y = 4.0f;
+	tessellate(changed);
+	bool differs = false;
+	for (int i = 0; i < numVerts; ++i)
+		differs = differs || changed[i].y != first[i].y;
+	EXPECT_TRUE(differs);
+
+	pos[5].y = 0.0f;
+	tessellate(restored);
+	EXPECT_TRUE(memcmp(first.data(), restored.data(), sizeof(Vec3Packedf) * numVerts) == 0);
+	return true;
+}
+
+// Plain linear first fit over a vector, the way BlockAllocator used to search.
+// Used as the reference for results, and as the baseline for timing.
+struct RefBlockAllocator {
+	struct Block {
+		u32 start;
+		u32 size;
+		bool taken;
+	};
+
+	void Init(u32 rangeStart, u32 rangeSize, u32 grain) {
+		blocks.clear();
+		blocks.push_back({ rangeStart, rangeSize, false });
+		rangeSize_ = rangeSize;
+		grain_ = grain;
+	}
+
+	u32 AllocAligned(u32 &size, u32 sizeGrain, u32 grain, bool fromTop) {
+		if (size == 0 || size > rangeSize_)
+			return -1;
+		if (grain < grain_)
+			grain = grain_;
+		if (sizeGrain < grain_)
+			sizeGrain = grain_;
+		size = (size + sizeGrain - 1) & ~(sizeGrain - 1);
+
+		for (size_t n = 0; n < blocks.size(); ++n) {
+			size_t i = fromTop ? blocks.size() - 1 - n : n;
+			Block b = blocks[i];
+			u32 offset;
+			if (fromTop) {
+				offset = (b.start + b.size - size) % grain;
+			} else {
+				offset = b.start % grain;
+				if (offset != 0)
+					offset = grain - offset;
+			}
+			u32 needed = offset + size;
+			if (b.taken || b.size < needed)
+				continue;
+
+			// Split into [before][taken][after], only keeping the free pieces that are big enough.
+			u32 before = fromTop ? b.size - needed : (offset >= grain_ ? offset : 0);
+			u32 after = fromTop ? (offset >= grain_ ? offset : 0) : b.size - needed;
+			Block taken{ b.start + before, b.size - before - after, true };
+			blocks[i] = taken;
+			if (after != 0)
+				blocks.insert(blocks.begin() + i + 1, Block{ taken.start + taken.size, after, false });
+			if (before != 0)
+				blocks.insert(blocks.begin() + i, Block{ b.start, before, false });
+			return taken.start;
+		}
+		return -1;
+	}
+
+	bool Free(u32 position) {
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			if (blocks[i].start <= position && blocks[i].start + blocks[i].size > position) {
+				if (!blocks[i].taken)
+					return false;
+				blocks[i].taken = false;
+				if (i + 1 < blocks.size() && !blocks[i + 1].taken) {
+					blocks[i].size += blocks[i + 1].size;
+					blocks.erase(blocks.begin() + i + 1);
+				}
+				if (i > 0 && !blocks[i - 1].taken) {
+					blocks[i - 1].size += blocks[i].size;
+					blocks.erase(blocks.begin() + i);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	u32 GetLargestFreeBlockSize() const {
+		u32 largest = 0;
+		for (const Block &b : blocks) {
+			if (!b.taken && b.size > largest)
+				largest = b.size;
+		}
+		return largest;
+	}
+
+	std::vector<Block> blocks;
+	u32 rangeSize_ = 0;
+	u32 grain_ = 0;
+};
+
+struct BlockAllocatorTraceOp {
+	bool alloc;
+	u32 size;
+	u32 align;
+	bool fromTop;
+	u32 freeIndex;
+};
+
+// Something like a game juggling VPL/FPL sized allocations, with the odd big one.
+static std::vector<BlockAllocatorTraceOp> GenerateBlockAllocatorTrace(int count) {
+	std::vector<BlockAllocatorTraceOp> ops;
+	u32 seed = 0x12345678;
+	auto next = [&]() {
+		seed = seed * 1664525 + 1013904223;
+		return seed >> 8;
+	};
+	static const u32 aligns[] = { 0x10, 0x100, 0x100, 0x100, 0x1000, 0x4000 };
+
+	int live = 0;
+	for (int i = 0; i < count; ++i) {
+		BlockAllocatorTraceOp op{};
+		op.alloc = live == 0 || (next() % 100) < (live < 1000 ? 55 : 40);
+		if (op.alloc) {
+			u32 r = next() % 100;
+			op.size = r < 70 ? 0x10 + next() % 0x800 : (r < 99 ? 0x800 + next() % 0x8000 : 0x10000 + next() % 0x40000);
+			op.align = aligns[next() % ARRAY_SIZE(aligns)];
+			op.fromTop = (next() % 4) == 0;
+			live++;
+		} else {
+			op.freeIndex = next();
+			live--;
+		}
+		ops.push_back(op);
+	}
+	return ops;
+}
+
+static bool TestBlockAllocator() {
+	const u32 rangeStart = 0x08800000;
+	const u32 rangeSize = 0x01800000;
+	const std::vector<BlockAllocatorTraceOp> ops = GenerateBlockAllocatorTrace(100000);
+
+	BlockAllocator alloc(0x100);
+	RefBlockAllocator ref;
+	alloc.Init(rangeStart, rangeSize, false);
+	ref.Init(rangeStart, rangeSize, 0x100);
+
+	// First check every single result matches.
+	std::vector<u32> live;
+	for (const auto &op : ops) {
+		if (op.alloc) {
+			u32 size = op.size;
+			u32 refSize = op.size;
+			u32 addr = alloc.AllocAligned(size, 0x100, op.align, op.fromTop, "test");
+			u32 refAddr = ref.AllocAligned(refSize, 0x100, op.align, op.fromTop);
+			EXPECT_EQ_HEX(addr, refAddr);
+			EXPECT_EQ_HEX(size, refSize);
+			if (addr != (u32)-1)
+				live.push_back(addr);
+		} else if (!live.empty()) {
+			size_t index = op.freeIndex % live.size();
+			EXPECT_TRUE(alloc.Free(live[index]));
+			EXPECT_TRUE(ref.Free(live[index]));
+			live[index] = live.back();
+			live.pop_back();
+		}
+		EXPECT_EQ_HEX(alloc.GetLargestFreeBlockSize(), ref.GetLargestFreeBlockSize());
+	}
+	EXPECT_EQ_INT(alloc.GetBlockStartFromAddress(ref.blocks.back().start), ref.blocks.back().start);
+	EXPECT_EQ_INT(alloc.IsBlockFree(ref.blocks.back().start), !ref.blocks.back().taken);
+
+	// Then time the same trace on both.
+	auto runTrace = [&](auto &allocator, auto allocFunc) {
+		std::vector<u32> live;
+		double start = time_now_d();
+		for (const auto &op : ops) {
+			if (op.alloc) {
+				u32 size = op.size;
+				u32 addr = allocFunc(allocator, size, op);
+				if (addr != (u32)-1)
+					live.push_back(addr);
+			} else if (!live.empty()) {
+				size_t index = op.freeIndex % live.size();
+				allocator.Free(live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		return time_now_d() - start;
+	};
+
+	alloc.Init(rangeStart, rangeSize, false);
+	ref.Init(rangeStart, rangeSize, 0x100);
+	double indexed = runTrace(alloc, [](BlockAllocator &a, u32 &size, const BlockAllocatorTraceOp &op) {
+		return a.AllocAligned(size, 0x100, op.align, op.fromTop, "test");
+	});
+	double linear = runTrace(ref, [](RefBlockAllocator &a, u32 &size, const BlockAllocatorTraceOp &op) {
+		return a.AllocAligned(size, 0x100, op.align, op.fromTop);
+	});
+	printf("BlockAllocator trace (%d ops): indexed %0.2f ms, linear %0.2f ms\n", (int)ops.size(), indexed * 1000.0, linear * 1000.0);
+
+	alloc.Shutdown();
+	return true;
+}
+
 static bool TestMemMap() {
 	Memory::g_MemorySize = Memory::RAM_DOUBLE_SIZE;
 
@@ -782,6 +1218,449 @@ static bool TestWrapText() {
 	return true;
 }
 
+// A LAN party's worth of clients, each from its own loopback address since the server allows
+// one user per IP, joining groups and chatting through the built-in ad-hoc server.
+static bool TestAdhocServer() {
+	const int CLIENTS = 64;
+	const int GROUP_SIZE = 8;
+	const int MESSAGES = 50;
+	const uint16_t PORT = 27399;
+
+	net::Init();
+
+	auto openClientSocket = [](uint32_t ip, uint16_t port) {
+		int fd = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(ip);
+		addr.sin_port = htons(port);
+		if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+			if (fd >= 0)
+				closesocket(fd);
+			return -1;
+		}
+		return fd;
+	};
+
+	// Some platforms only have 127.0.0.1, and the port may be taken.
+	int probe = openClientSocket(0x7F000002, PORT);
+	if (probe < 0) {
+		printf("AdhocServer: skipped, can't bind 127.0.0.2:%d\n", PORT);
+		net::Shutdown();
+		return true;
+	}
+	closesocket(probe);
+
+	CoreState prevCoreState = coreState;
+	coreState = CORE_POWERDOWN;
+	__AdhocServerInit();
+	std::thread serverThread([=] {
+		proAdhocServerThread(PORT);
+	});
+	for (int i = 0; i < 200 && !adhocServerRunning; ++i)
+		sleep_ms(10);
+	EXPECT_TRUE(adhocServerRunning);
+
+	std::atomic<int> joined(0);
+	std::atomic<int> failures(0);
+	double start = 0.0;
+	std::vector<double> finish(CLIENTS);
+	auto clientFunc = [&](int index) {
+		int fd = openClientSocket(0x7F000002 + index, 0);
+		sockaddr_in server{};
+		server.sin_family = AF_INET;
+		server.sin_addr.s_addr = htonl(0x7F000001);
+		server.sin_port = htons(PORT);
+		if (fd < 0 || connect(fd, (sockaddr *)&server, sizeof(server)) != 0) {
+			failures++;
+			joined++;
+			return;
+		}
+#ifdef _WIN32
+		DWORD timeout = 5000;
+#else
+		timeval timeout{ 5, 0 };
+#endif
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+
+		SceNetAdhocctlLoginPacketC2S login{};
+		login.base.opcode = OPCODE_LOGIN;
+		login.mac.data[0] = 0x02;
+		login.mac.data[5] = (uint8_t)(index + 1);
+		snprintf((char *)login.name.data, sizeof(login.name.data), "Player%d", index);
+		memcpy(login.game.data, "ULUS10391", PRODUCT_CODE_LENGTH);
+		SceNetAdhocctlConnectPacketC2S connectPacket{};
+		connectPacket.base.opcode = OPCODE_CONNECT;
+		snprintf((char *)connectPacket.group.data, sizeof(connectPacket.group.data), "Group%d", index / GROUP_SIZE);
+		send(fd, (const char *)&login, sizeof(login), 0);
+		send(fd, (const char *)&connectPacket, sizeof(connectPacket), 0);
+
+		// Parse the S2C stream, counting what we care about.
+		std::vector<uint8_t> rx;
+		int peers = 0, bssids = 0, chats = 0;
+		auto receiveUntil = [&](const std::function<bool()> &done) {
+			while (!done()) {
+				uint8_t buf[4096];
+				int len = recv(fd, (char *)buf, sizeof(buf), 0);
+				if (len <= 0)
+					return false;
+				rx.insert(rx.end(), buf, buf + len);
+
+				size_t pos = 0;
+				while (pos < rx.size()) {
+					size_t size = 0;
+					switch (rx[pos]) {
+					case OPCODE_CONNECT: size = sizeof(SceNetAdhocctlConnectPacketS2C); break;
+					case OPCODE_DISCONNECT: size = sizeof(SceNetAdhocctlDisconnectPacketS2C); break;
+					case OPCODE_SCAN: size = sizeof(SceNetAdhocctlScanPacketS2C); break;
+					case OPCODE_SCAN_COMPLETE: size = 1; break;
+					case OPCODE_CONNECT_BSSID: size = sizeof(SceNetAdhocctlConnectBSSIDPacketS2C); break;
+					case OPCODE_CHAT: size = sizeof(SceNetAdhocctlChatPacketS2C); break;
+					default: return false;
+					}
+					if (pos + size > rx.size())
+						break;
+					peers += rx[pos] == OPCODE_CONNECT;
+					bssids += rx[pos] == OPCODE_CONNECT_BSSID;
+					chats += rx[pos] == OPCODE_CHAT;
+					pos += size;
+				}
+				rx.erase(rx.begin(), rx.begin() + pos);
+			}
+			return true;
+		};
+
+		// Everyone in the group hears about everyone else, whichever order they joined in.
+		bool ok = receiveUntil([&] { return peers == GROUP_SIZE - 1 && bssids == 1; });
+		joined++;
+		while (joined < CLIENTS)
+			sleep_ms(1);
+
+		SceNetAdhocctlChatPacketC2S chat{};
+		chat.base.opcode = OPCODE_CHAT;
+		for (int i = 0; ok && i < MESSAGES; ++i) {
+			snprintf(chat.message, sizeof(chat.message), "Message %d from %d", i, index);
+			send(fd, (const char *)&chat, sizeof(chat), 0);
+		}
+		ok = ok && receiveUntil([&] { return chats == (GROUP_SIZE - 1) * MESSAGES; });
+		finish[index] = time_now_d();
+		if (!ok)
+			failures++;
+		closesocket(fd);
+	};
+
+	std::vector<std::thread> clients;
+	for (int i = 0; i < CLIENTS; ++i)
+		clients.push_back(std::thread(clientFunc, i));
+	while (joined < CLIENTS)
+		sleep_ms(1);
+	start = time_now_d();
+	for (auto &t : clients)
+		t.join();
+
+	adhocServerRunning = false;
+	serverThread.join();
+	coreState = prevCoreState;
+	net::Shutdown();
+	EXPECT_EQ_INT((int)failures, 0);
+
+	std::sort(finish.begin(), finish.end());
+	double elapsed = finish.back() - start;
+	int delivered = CLIENTS * MESSAGES * (GROUP_SIZE - 1);
+	printf("AdhocServer: %d clients delivered %d chat packets in %0.1f ms (%0.0f packets/s), median client done at %0.1f ms\n",
+		CLIENTS, delivered, elapsed * 1000.0, delivered / elapsed, (finish[CLIENTS / 2] - start) * 1000.0);
+	return true;
+}
+
+// Serves a temp file over keep-alive range requests from several clients, like remote ISO
+// streaming does, and checks every byte.
+static bool TestHTTPServer() {
+	const int FILE_SIZE = 8 * 1024 * 1024;
+	const int RANGE_SIZE = 64 * 1024;
+	const int CLIENTS = 4;
+	const int REQUESTS_PER_CLIENT = 200;
+
+	FILE *fp = tmpfile();
+	EXPECT_TRUE(fp != nullptr);
+	std::vector<u8> data(FILE_SIZE);
+	u32 seed = 0x1234;
+	for (int i = 0; i < FILE_SIZE; ++i) {
+		seed = seed * 1664525 + 1013904223;
+		data[i] = (u8)(seed >> 24);
+	}
+	EXPECT_TRUE(fwrite(&data[0], FILE_SIZE, 1, fp) == 1);
+	fflush(fp);
+
+	net::Init();
+	std::mutex fileLock;
+	http::Server server(new WorkerPoolExecutor(CLIENTS));
+	server.RegisterHandler("/file", [&](const http::Request &request) {
+		std::string range;
+		long long begin = 0, last = 0;
+		if (!request.GetHeader("range", &range) || sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last) != 2) {
+			request.WriteHttpResponseHeader("1.0", 400, -1, "text/plain");
+			return;
+		}
+		char contentRange[256];
+		snprintf(contentRange, sizeof(contentRange), "Content-Range: bytes %lld-%lld/%d\r\n", begin, last, FILE_SIZE);
+		request.WriteHttpResponseHeader("1.0", 206, last - begin + 1, "application/octet-stream", contentRange);
+		// The copy fallback seeks the shared FILE.
+		std::lock_guard<std::mutex> guard(fileLock);
+		request.WriteFileRange(fp, begin, last - begin + 1);
+	});
+	EXPECT_TRUE(server.Listen(0, net::DNSType::IPV4));
+
+	std::atomic<bool> running(true);
+	std::thread serverThread([&] {
+		while (running)
+			server.RunSlice(0.1);
+	});
+
+	std::atomic<int> failures(0);
+	std::vector<double> latencies[CLIENTS];
+	auto clientFunc = [&](int index) {
+		http::Client client;
+		client.SetKeepAlive(true);
+		if (!client.Resolve("127.0.0.1", server.Port()) || !client.Connect()) {
+			failures++;
+			return;
+		}
+		u32 pick = 0x5EED + index;
+		for (int i = 0; i < REQUESTS_PER_CLIENT; ++i) {
+			pick = pick * 1664525 + 1013904223;
+			int begin = (int)((pick >> 8) % (FILE_SIZE - RANGE_SIZE));
+			char headers[256];
+			snprintf(headers, sizeof(headers), "Range: bytes=%d-%d\r\n", begin, begin + RANGE_SIZE - 1);
+
+			double start = time_now_d();
+			http::RequestProgress progress;
+			http::RequestParams req("/file", "*/*");
+			net::Buffer readbuf;
+			std::vector<std::string> responseHeaders;
+			Buffer output;
+			int code = client.SendRequest("GET", req, headers, &progress);
+			if (code >= 0)
+				code = client.ReadResponseHeaders(&readbuf, responseHeaders, &progress);
+			if (code != 206 || client.ReadResponseEntity(&readbuf, responseHeaders, &output, &progress) != 0 || !client.CanReuseConnection(responseHeaders)) {
+				failures++;
+				return;
+			}
+			latencies[index].push_back(time_now_d() - start);
+
+			std::string body;
+			output.TakeAll(&body);
+			if (body.size() != RANGE_SIZE || memcmp(body.data(), &data[begin], RANGE_SIZE) != 0) {
+				failures++;
+				return;
+			}
+		}
+	};
+
+	double start = time_now_d();
+	std::vector<std::thread> clients;
+	for (int i = 0; i < CLIENTS; ++i)
+		clients.push_back(std::thread(clientFunc, i));
+	for (auto &t : clients)
+		t.join();
+	double elapsed = time_now_d() - start;
+
+	running = false;
+	serverThread.join();
+	server.Stop();
+	net::Shutdown();
+	fclose(fp);
+	EXPECT_EQ_INT((int)failures, 0);
+
+	std::vector<double> all;
+	for (auto &l : latencies)
+		all.insert(all.end(), l.begin(), l.end());
+	std::sort(all.begin(), all.end());
+	EXPECT_EQ_INT((int)all.size(), CLIENTS * REQUESTS_PER_CLIENT);
+	double mb = (double)all.size() * RANGE_SIZE / (1024.0 * 1024.0);
+	printf("HTTPServer: %d clients, %d ranges: %0.1f MB/s, p50 %0.3f ms, p99 %0.3f ms\n", CLIENTS, (int)all.size(),
+		mb / elapsed, all[all.size() / 2] * 1000.0, all[all.size() * 99 / 100] * 1000.0);
+	return true;
+}
+
+// An upgraded connection (like the debugger websocket) keeps its handler running for as long as
+// it's open, which must not use up the workers that plain requests need.
+static bool TestHTTPServerUpgrade() {
+	net::Init();
+	LimitedWaitable upgraded;
+	LimitedWaitable release;
+	std::atomic<bool> upgradeDone(false);
+	http::Server server(new WorkerPoolExecutor(1));
+	server.RegisterHandler("/upgrade", [&](const http::Request &request) {
+		upgraded.Notify();
+		release.WaitFor(10.0);
+		upgradeDone = true;
+		request.WriteHttpResponseHeader("1.0", 400, -1, "text/plain");
+	});
+	server.RegisterHandler("/plain", [&](const http::Request &request) {
+		request.WriteHttpResponseHeader("1.0", 200, 2, "text/plain");
+		request.Out()->Push("ok");
+	});
+	EXPECT_TRUE(server.Listen(0, net::DNSType::IPV4));
+
+	std::atomic<bool> running(true);
+	std::thread serverThread([&] {
+		while (running)
+			server.RunSlice(0.1);
+	});
+
+	http::Client upgradeClient;
+	http::RequestProgress upgradeProgress;
+	bool success = upgradeClient.Resolve("127.0.0.1", server.Port()) && upgradeClient.Connect();
+	success = success && upgradeClient.SendRequest("GET", http::RequestParams("/upgrade", "*/*"), "Upgrade: websocket\r\nConnection: Upgrade\r\n", &upgradeProgress) >= 0;
+	success = success && upgraded.WaitFor(10.0);
+
+	// The only worker in the pool is now busy with the upgrade.
+	if (success) {
+		http::Client client;
+		http::RequestProgress progress;
+		Buffer output;
+		std::string body;
+		success = client.Resolve("127.0.0.1", server.Port()) && client.Connect();
+		success = success && client.GET(http::RequestParams("/plain"), &output, &progress) == 200;
+		output.TakeAll(&body);
+		success = success && body == "ok" && !upgradeDone;
+	}
+
+	release.Notify();
+	running = false;
+	serverThread.join();
+	server.Stop();
+	net::Shutdown();
+	EXPECT_TRUE(success);
+	return true;
+}
+
+class HTTPFileLoaderReadTask : public Task {
+public:
+	HTTPFileLoaderReadTask(FileLoader *loader, s64 pos, size_t bytes, u8 *dest, size_t *result, LimitedWaitable *done)
+		: loader_(loader), pos_(pos), bytes_(bytes), dest_(dest), result_(result), done_(done) {}
+
+	TaskType Type() const override {
+		return TaskType::IO_BLOCKING;
+	}
+
+	void Run() override {
+		*result_ = loader_->ReadAt(pos_, bytes_, dest_);
+		done_->Notify();
+	}
+
+private:
+	FileLoader *loader_;
+	s64 pos_;
+	size_t bytes_;
+	u8 *dest_;
+	size_t *result_;
+	LimitedWaitable *done_;
+};
+
+// Streams a file from the in-tree HTTP server through HTTPFileLoader, like remote ISO play does:
+// sequential reads (read-ahead), large reads (parallel ranges), random reads, and a read from a
+// thread manager worker, which must not wait on its own queue.
+static bool TestHTTPFileLoader() {
+	const int FILE_SIZE = 8 * 1024 * 1024;
+
+	std::vector<u8> data(FILE_SIZE);
+	u32 seed = 0x4321;
+	for (int i = 0; i < FILE_SIZE; ++i) {
+		seed = seed * 1664525 + 1013904223;
+		data[i] = (u8)(seed >> 24);
+	}
+
+	net::Init();
+	std::atomic<int> rangeRequests(0);
+	http::Server server(new WorkerPoolExecutor(8));
+	server.RegisterHandler("/disc.iso", [&](const http::Request &request) {
+		// Same responses as the web server's disc handler.
+		if (request.Method() == http::RequestHeader::HEAD) {
+			request.WriteHttpResponseHeader("1.0", 200, FILE_SIZE, "application/octet-stream", "Accept-Ranges: bytes\r\n");
+			return;
+		}
+		std::string range;
+		long long begin = 0, last = 0;
+		if (!request.GetHeader("range", &range) || sscanf(range.c_str(), "bytes=%lld-%lld", &begin, &last) != 2 || begin > last || last >= FILE_SIZE) {
+			request.WriteHttpResponseHeader("1.0", 416, -1, "text/plain");
+			return;
+		}
+		rangeRequests++;
+		char contentRange[256];
+		snprintf(contentRange, sizeof(contentRange), "Content-Range: bytes %lld-%lld/%d\r\n", begin, last, FILE_SIZE);
+		request.WriteHttpResponseHeader("1.0", 206, last - begin + 1, "application/octet-stream", contentRange);
+		request.Out()->Push((const char *)&data[begin], (size_t)(last - begin + 1));
+	});
+	EXPECT_TRUE(server.Listen(0, net::DNSType::IPV4));
+
+	std::atomic<bool> running(true);
+	std::thread serverThread([&] {
+		while (running)
+			server.RunSlice(0.1);
+	});
+
+	const bool ownThreads = !g_threadManager.IsInitialized();
+	if (ownThreads)
+		g_threadManager.Init(4, 1);
+
+	bool success = true;
+	{
+		HTTPFileLoader loader(Path(StringFromFormat("http://127.0.0.1:%d/disc.iso", server.Port())));
+		success = success && loader.Exists() && loader.FileSize() == FILE_SIZE;
+
+		std::vector<u8> buf(2 * 1024 * 1024);
+		// Sequential sector reads, which grow the read-ahead window.
+		for (int pos = 0; success && pos < 1024 * 1024; pos += 2048 * 8) {
+			success = loader.ReadAt(pos, 2048 * 8, &buf[0]) == 2048 * 8 && memcmp(&buf[0], &data[pos], 2048 * 8) == 0;
+		}
+		// One big read, split over several connections.
+		if (success) {
+			success = loader.ReadAt(3 * 1024 * 1024 + 2048, buf.size(), &buf[0], FileLoader::Flags::HINT_UNCACHED) == buf.size();
+			success = success && memcmp(&buf[0], &data[3 * 1024 * 1024 + 2048], buf.size()) == 0;
+		}
+		// Random reads, including past the end.
+		u32 pick = 0x5EED;
+		for (int i = 0; success && i < 64; ++i) {
+			pick = pick * 1664525 + 1013904223;
+			const int pos = (int)((pick >> 8) % (FILE_SIZE - 1000));
+			const size_t expected = std::min(65536, FILE_SIZE - pos);
+			success = loader.ReadAt(pos, 65536, &buf[0]) == expected && memcmp(&buf[0], &data[pos], expected) == 0;
+		}
+
+		// A large read from a worker has to stay on that worker.
+		if (success) {
+			size_t result = 0;
+			LimitedWaitable done;
+			g_threadManager.EnqueueTask(new HTTPFileLoaderReadTask(&loader, 5 * 1024 * 1024, buf.size(), &buf[0], &result, &done));
+			success = done.WaitFor(20.0);
+			if (!success) {
+				// The task writes into buf, result and done, so it has to finish before they go away.
+				loader.Cancel();
+				done.Wait();
+			}
+			success = success && result == buf.size() && memcmp(&buf[0], &data[5 * 1024 * 1024], buf.size()) == 0;
+		}
+
+		// Cancelling sticks, even when new connections are opened.
+		if (success) {
+			loader.Cancel();
+			success = loader.ReadAt(7 * 1024 * 1024, 4096, &buf[0], FileLoader::Flags::HINT_UNCACHED) == 0;
+		}
+	}
+
+	if (ownThreads)
+		g_threadManager.Teardown();
+	running = false;
+	serverThread.join();
+	server.Stop();
+	net::Shutdown();
+
+	printf("HTTPFileLoader: %d range requests\n", (int)rangeRequests);
+	EXPECT_TRUE(success);
+	return true;
+}
+
 typedef bool (*TestFunc)();
 struct TestItem {
 	const char *name;
@@ -798,6 +1677,7 @@ bool TestShaderGenerators();
 bool TestSoftwareGPUJit();
 bool TestIRPassSimplify();
 bool TestThreadManager();
+bool TestTaskThroughputBenchmark();
 
 TestItem availableTests[] = {
 #if PPSSPP_ARCH(ARM64) || PPSSPP_ARCH(AMD64) || PPSSPP_ARCH(X86)
@@ -816,24 +1696,43 @@ TestItem availableTests[] = {
 	TEST_ITEM(Asin),
 	TEST_ITEM(SinCos),
 	TEST_ITEM(VFPUSinCos),
+	TEST_ITEM(VFPUSinCosTable),
 	TEST_ITEM(MathUtil),
 	TEST_ITEM(Parsers),
 	TEST_ITEM(IRPassSimplify),
 	TEST_ITEM(Jit),
+	TEST_ITEM(JitCodeRegionEviction),
+	TEST_ITEM(IRJitTraces),
+	TEST_ITEM(IRJitMemoryFaults),
+	TEST_ITEM(IRCorpus),
+	TEST_ITEM(FunctionLiveness),
 	TEST_ITEM(MatrixTranspose),
 	TEST_ITEM(ParseLBN),
 	TEST_ITEM(QuickTexHash),
 	TEST_ITEM(CLZ),
+	TEST_ITEM(BlockAllocator),
+	TEST_ITEM(SoftwareTransformBatch),
+	TEST_ITEM(SplineTessellationCache),
 	TEST_ITEM(MemMap),
 	TEST_ITEM(ShaderGenerators),
 	TEST_ITEM(SoftwareGPUJit),
 	TEST_ITEM(Path),
 	TEST_ITEM(AndroidContentURI),
 	TEST_ITEM(ThreadManager),
+	TEST_ITEM(HTTPServer),
+	TEST_ITEM(HTTPServerUpgrade),
+	TEST_ITEM(HTTPFileLoader),
+	TEST_ITEM(AdhocServer),
 	TEST_ITEM(WrapText),
 	TEST_ITEM(TinySet),
 };
 
+// Not run by "all", since they take a while and only print numbers.
+TestItem availableBenchmarks[] = {
+	TEST_ITEM(VFPUSinCosBenchmark),
+	TEST_ITEM(TaskThroughputBenchmark),
+};
+
 int main(int argc, const char *argv[]) {
 	cpu_info.bNEON = true;
 	cpu_info.bVFP = true;
@@ -853,6 +1752,12 @@ int main(int argc, const char *argv[]) {
 				break;
 			}
 		}
+		for (auto f : availableBenchmarks) {
+			if (!strcasecmp(argv[1], f.name)) {
+				testFunc = f.func;
+				break;
+			}
+		}
 	}
 
 	if (allTests) {
@@ -879,6 +1784,11 @@ int main(int argc, const char *argv[]) {
 		for (auto f : availableTests) {
 			fprintf(stderr, "  * %s\n", f.name);
 		}
+		fprintf(stderr, "\n");
+		fprintf(stderr, "Available benchmarks:\n");
+		for (auto f : availableBenchmarks) {
+			fprintf(stderr, "  * %s\n", f.name);
+		}
 		return 1;
 	} else {
 		if (!testFunc()) {